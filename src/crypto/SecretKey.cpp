@@ -28,7 +28,6 @@ namespace stellar
 
 static std::mutex gVerifySigCacheMutex;
 static cache::lru_cache<Hash, bool> gVerifySigCache(0xffff);
-static std::unique_ptr<SHA256> gHasher = SHA256::create();
 static uint64_t gVerifyCacheHit = 0;
 static uint64_t gVerifyCacheMiss = 0;
 
@@ -38,11 +37,13 @@ verifySigCacheKey(PublicKey const& key, Signature const& signature,
 {
     assert(key.type() == PUBLIC_KEY_TYPE_ED25519);
 
-    gHasher->reset();
-    gHasher->add(key.ed25519());
-    gHasher->add(signature);
-    gHasher->add(bin);
-    return gHasher->finish();
+    // one hasher per thread, signatures are verified from worker threads
+    static thread_local std::unique_ptr<SHA256> hasher = SHA256::create();
+    hasher->reset();
+    hasher->add(key.ed25519());
+    hasher->add(signature);
+    hasher->add(bin);
+    return hasher->finish();
 }
 
 SecretKey::SecretKey() : mKeyType(PUBLIC_KEY_TYPE_ED25519)
@@ -278,8 +279,9 @@ PubKeyUtils::verifySig(PublicKey const& key, Signature const& signature,
         return false;
     }
 
+    // the key is hashed outside of the lock, so that threads verifying
+    // signatures only contend on the cache itself
     auto cacheKey = verifySigCacheKey(key, signature, bin);
-
     {
         std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
         if (gVerifySigCache.exists(cacheKey))
@@ -289,11 +291,11 @@ PubKeyUtils::verifySig(PublicKey const& key, Signature const& signature,
         }
     }
 
-    ++gVerifyCacheMiss;
     bool ok =
         (crypto_sign_verify_detached(signature.data(), bin.data(), bin.size(),
                                      key.ed25519().data()) == 0);
     std::lock_guard<std::mutex> guard(gVerifySigCacheMutex);
+    ++gVerifyCacheMiss;
     gVerifySigCache.put(cacheKey, ok);
     return ok;
 }
@@ -5,6 +5,7 @@
 #include "database/Database.h"
 #include "crypto/Hex.h"
 #include "database/DatabaseConnectionString.h"
+#include "lib/json/json.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "overlay/StellarXDR.h"
@@ -29,6 +30,8 @@
 #include "medida/metrics_registry.h"
 #include "medida/timer.h"
 
+#include <algorithm>
+#include <atomic>
 #include <sstream>
 #include <stdexcept>
 #include <thread>
@@ -51,7 +54,7 @@ using namespace std;
 
 bool Database::gDriversRegistered = false;
 
-static unsigned long const SCHEMA_VERSION = 8;
+static unsigned long const SCHEMA_VERSION = 9;
 
 static void
 setSerializable(soci::session& sess)
@@ -60,6 +63,52 @@ setSerializable(soci::session& sess)
             "SERIALIZABLE";
 }
 
+static bool
+isWriteStatement(std::string const& query)
+{
+    auto start = query.find_first_not_of(" \t\n(");
+    if (start == std::string::npos)
+    {
+        return false;
+    }
+    auto verb = query.substr(start, 6);
+    std::transform(verb.begin(), verb.end(), verb.begin(), ::toupper);
+    return verb == "INSERT" || verb == "UPDATE" || verb == "DELETE";
+}
+
+// Logs, in the server log, the plan and actual timings of a sample of the
+// statements run on the main connection (EXPLAIN ANALYZE). This needs the
+// auto_explain module, which only superusers can load at runtime.
+static void
+enableSampledExplain(soci::session& sess, uint32_t percent)
+{
+    try
+    {
+        sess << "LOAD 'auto_explain'";
+        sess << "SET auto_explain.log_min_duration = 0";
+        sess << "SET auto_explain.log_analyze = on";
+        sess << "SET auto_explain.sample_rate = " << (percent / 100.0);
+    }
+    catch (std::exception& e)
+    {
+        CLOG(WARNING, "Database")
+            << "Could not enable auto_explain (SQL_EXPLAIN_SAMPLE_PERCENT): "
+            << e.what();
+    }
+}
+
+StatementProfile::StatementProfile(bool isWrite) : mIsWrite(isWrite)
+{
+}
+
+// registered statements may be first used from worker threads
+static std::atomic<size_t> gNextStatementID{0};
+
+RegisteredStatement::RegisteredStatement(std::string sql)
+    : mID(gNextStatementID++), mSQL(std::move(sql))
+{
+}
+
 void
 Database::registerDrivers()
 {
@@ -77,6 +126,7 @@ Database::Database(Application& app)
     : mApp(app)
     , mQueryMeter(
           app.getMetrics().NewMeter({"database", "query", "exec"}, "query"))
+    , mRegisteredStatementsCount(0)
     , mStatementsSize(
           app.getMetrics().NewCounter({"database", "memory", "statements"}))
     , mExcludedQueryTime(0)
@@ -100,13 +150,18 @@ Database::Database(Application& app)
     else
     {
         setSerializable(mSession);
+        if (app.getConfig().SQL_EXPLAIN_SAMPLE_PERCENT > 0)
+        {
+            enableSampledExplain(mSession,
+                                 app.getConfig().SQL_EXPLAIN_SAMPLE_PERCENT);
+        }
     }
 }
 
 void
 Database::applySchemaUpgrade(unsigned long vers)
 {
-    clearPreparedStatementCache();
+    clearAllPreparedStatements();
 
     switch (vers)
     {
@@ -159,6 +214,18 @@ Database::applySchemaUpgrade(unsigned long vers)
         mSession << "ALTER TABLE trustlines ADD debt BIGINT";
         break;
 
+    case 9:
+        // answers the best offers query in order (sellingissuerindex is a
+        // prefix of it)
+        mSession << "CREATE INDEX bestoffersindex ON offers (sellingissuer, "
+                    "sellingassetcode, buyingissuer, buyingassetcode, price, "
+                    "offerid)";
+        mSession << "DROP INDEX IF EXISTS sellingissuerindex";
+        // few trustlines carry a debt
+        mSession << "CREATE INDEX debtholdersindex ON trustlines (issuer, "
+                    "assetcode, accountid) WHERE debt <> 0";
+        break;
+
     default:
         throw std::runtime_error("Unknown DB schema version");
         break;
@@ -279,6 +346,13 @@ Database::isSqlite() const
            std::string::npos;
 }
 
+uint32_t
+Database::getHistoryPartitionLedgers() const
+{
+    // SQLite has no partitioned tables
+    return isSqlite() ? 0 : mApp.getConfig().HISTORY_PARTITION_LEDGERS;
+}
+
 bool
 Database::canUsePool() const
 {
@@ -288,20 +362,36 @@ Database::canUsePool() const
 void
 Database::clearPreparedStatementCache()
 {
-    // Flush all prepared statements; in sqlite they represent open cursors
-    // and will conflict with any DROP TABLE commands issued below
     for (auto st : mStatements)
     {
         st.second->clean_up(true);
     }
     mStatements.clear();
+    mStatementsSize.set_count(mStatements.size() + mRegisteredStatementsCount);
+}
+
+void
+Database::clearAllPreparedStatements()
+{
+    clearPreparedStatementCache();
+    for (auto& st : mRegisteredStatements)
+    {
+        if (st)
+        {
+            st->clean_up(true);
+            st.reset();
+        }
+    }
+    mRegisteredStatementsCount = 0;
     mStatementsSize.set_count(mStatements.size());
 }
 
 void
 Database::initialize()
 {
-    clearPreparedStatementCache();
+    // Flush all prepared statements; in sqlite they represent open cursors
+    // and will conflict with any DROP TABLE commands issued below
+    clearAllPreparedStatements();
     // normally you do not want to touch this section as
     // schema updates are done in applySchemaUpgrade
 
@@ -331,6 +421,7 @@ Database::getSession()
 soci::connection_pool&
 Database::getPool()
 {
+    std::lock_guard<std::mutex> lock(mPoolMutex);
     if (!mPool)
     {
         auto const& c = mApp.getConfig().DATABASE;
@@ -349,7 +440,11 @@ Database::getPool()
             LOG(DEBUG) << "Opening pool entry " << i;
             soci::session& sess = mPool->at(i);
             sess.open(c.value);
-            if (!isSqlite())
+            if (isSqlite())
+            {
+                sess << "PRAGMA busy_timeout = 10000";
+            }
+            else
             {
                 setSerializable(sess);
             }
@@ -359,6 +454,38 @@ Database::getPool()
     return *mPool;
 }
 
+static std::unique_ptr<soci::session>
+makePooledSession(Database& db)
+{
+    return db.canUsePool() ? std::make_unique<soci::session>(db.getPool())
+                           : nullptr;
+}
+
+ReadSnapshot::ReadSnapshot(Database& db)
+    : mPooledSession(makePooledSession(db))
+    , mSession(mPooledSession ? *mPooledSession : db.getSession())
+    , mTransaction(mSession)
+{
+    if (!db.isSqlite())
+    {
+        // pooled sessions are SERIALIZABLE, which gives nothing more to a
+        // read-only transaction but the overhead of tracking its reads
+        mSession << "SET TRANSACTION ISOLATION LEVEL REPEATABLE READ READ ONLY";
+    }
+}
+
+soci::session&
+ReadSnapshot::session()
+{
+    return mSession;
+}
+
+bool
+ReadSnapshot::isPooled() const
+{
+    return mPooledSession != nullptr;
+}
+
 class SQLLogContext : NonCopyable
 {
     std::string mName;
@@ -395,6 +522,26 @@ class SQLLogContext : NonCopyable
     }
 };
 
+std::shared_ptr<StatementProfile>&
+Database::getStatementProfile(std::string const& query)
+{
+    auto& profile = mStatementProfiles[query];
+    if (!profile)
+    {
+        profile = std::make_shared<StatementProfile>(isWriteStatement(query));
+    }
+    return profile;
+}
+
+std::shared_ptr<soci::statement>
+Database::prepare(std::string const& query)
+{
+    auto p = std::make_shared<soci::statement>(mSession);
+    p->alloc();
+    p->prepare(query);
+    return p;
+}
+
 StatementContext
 Database::getPreparedStatement(std::string const& query)
 {
@@ -402,20 +549,89 @@ Database::getPreparedStatement(std::string const& query)
     std::shared_ptr<soci::statement> p;
     if (i == mStatements.end())
     {
-        p = std::make_shared<soci::statement>(mSession);
-        p->alloc();
-        p->prepare(query);
+        p = prepare(query);
         mStatements.insert(std::make_pair(query, p));
-        mStatementsSize.set_count(mStatements.size());
+        mStatementsSize.set_count(mStatements.size() +
+                                  mRegisteredStatementsCount);
     }
     else
     {
         p = i->second;
     }
-    StatementContext sc(p);
+    StatementContext sc(p, getStatementProfile(query));
     return sc;
 }
 
+StatementContext
+Database::getPreparedStatement(RegisteredStatement const& query)
+{
+    auto id = query.getID();
+    if (id >= mRegisteredStatements.size())
+    {
+        mRegisteredStatements.resize(id + 1);
+        mRegisteredProfiles.resize(id + 1);
+    }
+    auto& p = mRegisteredStatements[id];
+    if (!p)
+    {
+        p = prepare(query.getSQL());
+        ++mRegisteredStatementsCount;
+        mStatementsSize.set_count(mStatements.size() +
+                                  mRegisteredStatementsCount);
+    }
+    auto& profile = mRegisteredProfiles[id];
+    if (!profile)
+    {
+        // shared with the statements borrowed by the same SQL text, if any
+        profile = getStatementProfile(query.getSQL());
+    }
+    StatementContext sc(p, profile);
+    return sc;
+}
+
+Json::Value
+Database::getStatementProfiles(size_t count) const
+{
+    std::vector<std::pair<std::string, StatementProfile*>> profiles;
+    for (auto const& p : mStatementProfiles)
+    {
+        profiles.emplace_back(p.first, p.second.get());
+    }
+    auto totalTime = [](StatementProfile const* p) {
+        return p->mTimer.count() * p->mTimer.mean();
+    };
+    std::sort(profiles.begin(), profiles.end(),
+              [&](std::pair<std::string, StatementProfile*> const& a,
+                  std::pair<std::string, StatementProfile*> const& b) {
+                  return totalTime(a.second) > totalTime(b.second);
+              });
+    if (profiles.size() > count)
+    {
+        profiles.resize(count);
+    }
+
+    Json::Value res(Json::arrayValue);
+    for (auto const& p : profiles)
+    {
+        auto const& timer = p.second->mTimer;
+        auto snapshot = timer.GetSnapshot();
+        Json::Value st;
+        st["sql"] = p.first;
+        st["count"] = static_cast<Json::UInt64>(timer.count());
+        st["borrow_total_ms"] = totalTime(p.second);
+        st["borrow_mean_ms"] = timer.mean();
+        st["borrow_p99_ms"] = snapshot.get99thPercentile();
+        st["borrow_max_ms"] = timer.max();
+        if (p.second->mIsWrite)
+        {
+            st["rows_mean"] = p.second->mRows.mean();
+            st["rows_max"] = p.second->mRows.max();
+        }
+        res.append(st);
+    }
+    return res;
+}
+
 std::shared_ptr<SQLLogContext>
 Database::captureAndLogSQL(std::string contextName)
 {
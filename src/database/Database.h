@@ -4,13 +4,21 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "lib/json/json-forwards.h"
+#include "medida/histogram.h"
+#include "medida/timer.h"
 #include "medida/timer_context.h"
 #include "overlay/StellarXDR.h"
 #include "util/NonCopyable.h"
 #include "util/Timer.h"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <soci.h>
 #include <string>
+#include <vector>
 
 namespace medida
 {
@@ -24,6 +32,47 @@ namespace stellar
 class Application;
 class SQLLogContext;
 
+// Time for which one prepared statement was borrowed (see
+// Database::getPreparedStatement), which includes binding, executing and
+// processing its rows, and the rows changed by its uses. The metrics are not
+// registered with the application's registry: there is one per distinct SQL
+// statement.
+struct StatementProfile : NonMovableOrCopyable
+{
+    explicit StatementProfile(bool isWrite);
+
+    // true for INSERT / UPDATE / DELETE, the only statements for which
+    // mRows is recorded
+    bool const mIsWrite;
+    medida::Timer mTimer;
+    medida::Histogram mRows;
+};
+
+// An SQL statement registered once, usually as a function-local static, so
+// that Database::getPreparedStatement finds its handle by index instead of
+// hashing the SQL text on every use. Queries that vary with their arguments
+// register one statement per variant. The handles of registered statements are
+// kept by Database::clearPreparedStatementCache.
+class RegisteredStatement
+{
+    size_t mID;
+    std::string mSQL;
+
+  public:
+    explicit RegisteredStatement(std::string sql);
+
+    size_t
+    getID() const
+    {
+        return mID;
+    }
+    std::string const&
+    getSQL() const
+    {
+        return mSQL;
+    }
+};
+
 /**
  * Helper class for borrowing a SOCI prepared statement handle into a local
  * scope and cleaning it up once done with it. Returned by
@@ -32,21 +81,47 @@ class SQLLogContext;
 class StatementContext : NonCopyable
 {
     std::shared_ptr<soci::statement> mStmt;
+    std::shared_ptr<StatementProfile> mProfile;
+    std::chrono::steady_clock::time_point mStart;
 
   public:
-    StatementContext(std::shared_ptr<soci::statement> stmt) : mStmt(stmt)
+    StatementContext(std::shared_ptr<soci::statement> stmt,
+                     std::shared_ptr<StatementProfile> profile = nullptr)
+        : mStmt(stmt)
+        , mProfile(profile)
+        , mStart(std::chrono::steady_clock::now())
     {
         mStmt->clean_up(false);
     }
     StatementContext(StatementContext&& other)
     {
         mStmt = other.mStmt;
+        mProfile = other.mProfile;
+        mStart = other.mStart;
         other.mStmt.reset();
+        other.mProfile.reset();
     }
     ~StatementContext()
     {
         if (mStmt)
         {
+            if (mProfile)
+            {
+                // the statement is timed for as long as it is borrowed, which
+                // includes fetching (and processing) the rows it returns
+                mProfile->mTimer.Update(std::chrono::steady_clock::now() -
+                                        mStart);
+                if (mProfile->mIsWrite)
+                {
+                    // negative for statements that were not executed or
+                    // failed
+                    auto rows = mStmt->get_affected_rows();
+                    if (rows >= 0)
+                    {
+                        mProfile->mRows.Update(rows);
+                    }
+                }
+            }
             mStmt->clean_up(false);
         }
     }
@@ -75,7 +150,8 @@ class StatementContext : NonCopyable
  * Database may establish additional connections for worker threads to read
  * data, from a separate connection pool, if worker threads request them. The
  * pool will connect to the same target and only one connection will be made per
- * worker thread.
+ * worker thread. ReadSnapshot wraps such a connection in a read-only
+ * transaction.
  *
  * All database connections and transactions are set to snapshot isolation level
  * (SQL isolation level 'SERIALIZABLE' in Postgresql and Sqlite, neither of
@@ -86,10 +162,24 @@ class Database : NonMovableOrCopyable
     Application& mApp;
     medida::Meter& mQueryMeter;
     soci::session mSession;
+    // the pool is created on first use, which may happen on a worker thread
+    std::mutex mPoolMutex;
     std::unique_ptr<soci::connection_pool> mPool;
 
     std::map<std::string, std::shared_ptr<soci::statement>> mStatements;
+    // indexed by RegisteredStatement::getID, survive
+    // clearPreparedStatementCache
+    std::vector<std::shared_ptr<soci::statement>> mRegisteredStatements;
+    std::vector<std::shared_ptr<StatementProfile>> mRegisteredProfiles;
+    size_t mRegisteredStatementsCount;
     medida::Counter& mStatementsSize;
+    // survive clearPreparedStatementCache
+    std::map<std::string, std::shared_ptr<StatementProfile>>
+        mStatementProfiles;
+
+    std::shared_ptr<StatementProfile>&
+    getStatementProfile(std::string const& query);
+    std::shared_ptr<soci::statement> prepare(std::string const& query);
 
     // Helpers for maintaining the total query time and calculating
     // idle percentage.
@@ -138,10 +228,22 @@ class Database : NonMovableOrCopyable
     // when the statement context is destroyed.
     StatementContext getPreparedStatement(std::string const& query);
 
-    // Purge all cached prepared statements, closing their handles with the
-    // database.
+    // Same as above for a registered statement, without looking up its SQL.
+    StatementContext getPreparedStatement(RegisteredStatement const& query);
+
+    // Purge the prepared statements borrowed by SQL text, closing their
+    // handles with the database. Those of registered statements are kept.
     void clearPreparedStatementCache();
 
+    // Purge all prepared statements, registered or not. Needed before schema
+    // changes: in sqlite the handles represent open cursors, that conflict
+    // with DROP TABLE.
+    void clearAllPreparedStatements();
+
+    // Return, as JSON, the profiles of the `count` prepared statements that
+    // were borrowed for the most time in total, slowest first.
+    Json::Value getStatementProfiles(size_t count) const;
+
     // Return metric-gathering timers for various families of SQL operation.
     // These timers automatically count the time they are alive for,
     // so only acquire them immediately before executing an SQL statement.
@@ -158,6 +260,10 @@ class Database : NonMovableOrCopyable
     // Return true if the Database target is SQLite, otherwise false.
     bool isSqlite() const;
 
+    // Return the number of ledgers per partition of the history tables (see
+    // DatabaseUtils::historyPartitionClause), 0 if they are not partitioned.
+    uint32_t getHistoryPartitionLedgers() const;
+
     // Return true if a connection pool is available for worker threads
     // to read from the database through, otherwise false.
     bool canUsePool() const;
@@ -186,6 +292,39 @@ class Database : NonMovableOrCopyable
     soci::connection_pool& getPool();
 };
 
+/**
+ * Read-only, consistent view of the database for queries that do not need to
+ * go through the main connection (and wait behind ledger close), such as
+ * queries made from worker threads.
+ *
+ * When the pool can be used, the snapshot borrows a session from it and opens
+ * a read-only transaction on it: REPEATABLE READ on postgres, a deferred
+ * transaction on SQLite (in WAL mode, readers see the database as of their
+ * first read and do not block the writer). All the queries made through the
+ * snapshot see the same state of the database. It can be used from any
+ * thread, but by only one at a time.
+ *
+ * Otherwise (in-memory SQLite) it falls back to a transaction on the main
+ * session, and so can only be used from the main thread.
+ */
+class ReadSnapshot : NonMovableOrCopyable
+{
+    std::unique_ptr<soci::session> mPooledSession;
+    soci::session& mSession;
+    soci::transaction mTransaction;
+
+  public:
+    explicit ReadSnapshot(Database& db);
+
+    // the transaction is rolled back, nothing was written anyway
+    ~ReadSnapshot() = default;
+
+    soci::session& session();
+
+    // true if the snapshot does not use the main session
+    bool isPooled() const;
+};
+
 class DBTimeExcluder : NonCopyable
 {
     Application& mApp;
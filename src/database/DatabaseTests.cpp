@@ -5,7 +5,10 @@
 #include "util/asio.h"
 #include "crypto/Hex.h"
 #include "database/Database.h"
+#include "database/DatabaseUtils.h"
+#include "ledger/LedgerStateSQLStore.h"
 #include "lib/catch.hpp"
+#include "lib/json/json.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "test/TestUtils.h"
@@ -187,6 +190,149 @@ TEST_CASE("sqlite MVCC test", "[db]")
     checkMVCCIsolation(app);
 }
 
+TEST_CASE("statement profiles", "[db]")
+{
+    Config const& cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto& db = app->getDatabase();
+
+    db.getSession() << "CREATE TEMPORARY TABLE profiled (x INTEGER)";
+    std::string const insert = "INSERT INTO profiled (x) VALUES (:x)";
+    std::string const select = "SELECT x FROM profiled WHERE x = :x";
+    for (int i = 0; i < 5; ++i)
+    {
+        auto prep = db.getPreparedStatement(insert);
+        auto& st = prep.statement();
+        st.exchange(soci::use(i));
+        st.define_and_bind();
+        st.execute(true);
+    }
+    {
+        int x = 0, y = 0;
+        auto prep = db.getPreparedStatement(select);
+        auto& st = prep.statement();
+        st.exchange(soci::into(y));
+        st.exchange(soci::use(x));
+        st.define_and_bind();
+        st.execute(true);
+    }
+    // clearing the cache of prepared statements keeps their profiles
+    db.clearPreparedStatementCache();
+
+    auto profiles = db.getStatementProfiles(100);
+    auto find = [&](std::string const& sql) {
+        for (auto const& p : profiles)
+        {
+            if (p["sql"].asString() == sql)
+            {
+                return p;
+            }
+        }
+        return Json::Value();
+    };
+
+    auto ins = find(insert);
+    REQUIRE(ins["count"].asUInt64() == 5);
+    REQUIRE(ins["rows_mean"].asDouble() == 1.0);
+    REQUIRE(ins["borrow_total_ms"].asDouble() >=
+            ins["borrow_max_ms"].asDouble());
+
+    auto sel = find(select);
+    REQUIRE(sel["count"].asUInt64() == 1);
+    REQUIRE(!sel.isMember("rows_mean"));
+
+    REQUIRE(db.getStatementProfiles(1).size() == 1);
+}
+
+TEST_CASE("registered statements", "[db]")
+{
+    Config const& cfg = getTestConfig();
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    auto& db = app->getDatabase();
+
+    db.getSession() << "CREATE TEMPORARY TABLE registered (x INTEGER)";
+    static RegisteredStatement const insert(
+        "INSERT INTO registered (x) VALUES (:x)");
+    RegisteredStatement const other("SELECT x FROM registered");
+    REQUIRE(insert.getID() != other.getID());
+
+    auto doInsert = [&](int x) {
+        auto prep = db.getPreparedStatement(insert);
+        auto& st = prep.statement();
+        st.exchange(soci::use(x));
+        st.define_and_bind();
+        st.execute(true);
+        return &st;
+    };
+
+    auto handle = doInsert(0);
+    REQUIRE(doInsert(1) == handle);
+
+    // maintenance only flushes the statements borrowed by SQL text
+    db.clearPreparedStatementCache();
+    REQUIRE(doInsert(2) == handle);
+
+    // the profile is shared with the uses of the same SQL text
+    {
+        int x = 3;
+        auto prep = db.getPreparedStatement(insert.getSQL());
+        auto& st = prep.statement();
+        st.exchange(soci::use(x));
+        st.define_and_bind();
+        st.execute(true);
+    }
+    auto profiles = db.getStatementProfiles(100);
+    bool found = false;
+    for (auto const& p : profiles)
+    {
+        if (p["sql"].asString() == insert.getSQL())
+        {
+            REQUIRE(p["count"].asUInt64() == 4);
+            found = true;
+        }
+    }
+    REQUIRE(found);
+
+    int count = 0;
+    db.getSession() << "SELECT COUNT(*) FROM registered", soci::into(count);
+    REQUIRE(count == 4);
+
+    db.clearAllPreparedStatements();
+    doInsert(4);
+    db.getSession() << "SELECT COUNT(*) FROM registered", soci::into(count);
+    REQUIRE(count == 5);
+}
+
+TEST_CASE("postgres array literals", "[db]")
+{
+    REQUIRE(DatabaseUtils::toPGArray(std::vector<int>{}) == "{}");
+    REQUIRE(DatabaseUtils::toPGArray(std::vector<int>{1, -2, 3}) ==
+            "{1,-2,3}");
+    REQUIRE(DatabaseUtils::toPGArray(std::vector<std::string>{"a+/=", ""}) ==
+            "{\"a+/=\",\"\"}");
+    REQUIRE(DatabaseUtils::toPGArray(std::vector<std::string>{"\"\\"}) ==
+            "{\"\\\"\\\\\"}");
+
+#ifdef USE_POSTGRES
+    SECTION("round trip through unnest")
+    {
+        Config const& cfg = getTestConfig(0, Config::TESTDB_POSTGRESQL);
+        VirtualClock clock;
+        Application::pointer app = createTestApplication(clock, cfg);
+
+        std::vector<std::string> values{"a,b", "{c}", "\"d\"", "e\\f", ""};
+        std::string literal = DatabaseUtils::toPGArray(values);
+        std::vector<std::string> res(values.size());
+        app->getDatabase().getSession()
+            << "SELECT unnest(:v::TEXT[])",
+            soci::use(literal), soci::into(res);
+        REQUIRE(res == values);
+    }
+#endif
+}
+
 #ifdef USE_POSTGRES
 TEST_CASE("postgres smoketest", "[db]")
 {
@@ -324,6 +470,63 @@ TEST_CASE("postgres performance", "[db][pgperf][!hide]")
 
 #endif
 
+static void
+checkReadSnapshot(Application::pointer app)
+{
+    auto& db = app->getDatabase();
+    auto& session = db.getSession();
+    int x = 0;
+
+    session << "DROP TABLE IF EXISTS test";
+    session << "CREATE TABLE test (x INTEGER)";
+    session << "INSERT INTO test (x) VALUES (1)";
+
+    {
+        ReadSnapshot snapshot(db);
+        REQUIRE(snapshot.isPooled() == db.canUsePool());
+        snapshot.session() << "SELECT x FROM test", soci::into(x);
+        REQUIRE(x == 1);
+
+        if (snapshot.isPooled())
+        {
+            // writes made after the first read are not seen by the snapshot
+            session << "UPDATE test SET x = 2";
+            snapshot.session() << "SELECT x FROM test", soci::into(x);
+            REQUIRE(x == 1);
+            ReadSnapshot other(db);
+            other.session() << "SELECT x FROM test", soci::into(x);
+            REQUIRE(x == 2);
+        }
+    }
+
+    session << "DROP TABLE test";
+}
+
+TEST_CASE("read snapshot", "[db]")
+{
+    VirtualClock clock;
+
+    SECTION("in-memory sqlite")
+    {
+        Config const& cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
+        checkReadSnapshot(createTestApplication(clock, cfg));
+    }
+
+    SECTION("on-disk sqlite")
+    {
+        Config const& cfg = getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE);
+        checkReadSnapshot(createTestApplication(clock, cfg));
+    }
+
+#ifdef USE_POSTGRES
+    SECTION("postgres")
+    {
+        Config const& cfg = getTestConfig(0, Config::TESTDB_POSTGRESQL);
+        checkReadSnapshot(createTestApplication(clock, cfg));
+    }
+#endif
+}
+
 TEST_CASE("schema test", "[db]")
 {
     Config const& cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
@@ -337,3 +540,81 @@ TEST_CASE("schema test", "[db]")
     auto av = db.getAppSchemaVersion();
     REQUIRE(dbv == av);
 }
+
+// The queries of loadBestOffers and loadDebtHolders, with literals in place of
+// their parameters
+static std::vector<std::string>
+indexedQueries()
+{
+    std::vector<std::string> queries = {
+        LedgerStateSQLStore::bestOffersSQL(false, false),
+        LedgerStateSQLStore::bestOffersSQL(true, false),
+        LedgerStateSQLStore::bestOffersSQL(false, true),
+        LedgerStateSQLStore::debtHoldersSQL()};
+    std::vector<std::pair<std::string, std::string>> const literals = {
+        {":sac", "'USD'"}, {":si", "'issuer1'"},
+        {":bac", "'EUR'"}, {":bi", "'issuer2'"},
+        {":n", "5"},       {":o", "0"},
+        {":issuer", "'issuer1'"},
+        {":asset", "'USD'"}};
+    for (auto& query : queries)
+    {
+        for (auto const& kv : literals)
+        {
+            auto pos = query.find(kv.first);
+            if (pos != std::string::npos)
+            {
+                query.replace(pos, kv.first.size(), kv.second);
+            }
+        }
+    }
+    return queries;
+}
+
+TEST_CASE("ledger queries use indexes", "[db]")
+{
+    Config const& cfg = getTestConfig(0, Config::TESTDB_IN_MEMORY_SQLITE);
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto& session = app->getDatabase().getSession();
+    for (auto const& query : indexedQueries())
+    {
+        soci::rowset<soci::row> plan =
+            (session.prepare << "EXPLAIN QUERY PLAN " + query);
+        for (auto const& step : plan)
+        {
+            auto detail = step.get<std::string>(3);
+            INFO(query << ": " << detail);
+            REQUIRE(detail.find("SCAN") == std::string::npos);
+            REQUIRE(detail.find("TEMP B-TREE") == std::string::npos);
+        }
+    }
+}
+
+#ifdef USE_POSTGRES
+TEST_CASE("postgres ledger queries use indexes", "[db]")
+{
+    Config const& cfg = getTestConfig(0, Config::TESTDB_POSTGRESQL);
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+    app->start();
+
+    // the tables are empty, which would make any plan look good enough
+    auto& session = app->getDatabase().getSession();
+    session << "SET enable_seqscan = off";
+    for (auto const& query : indexedQueries())
+    {
+        soci::rowset<std::string> plan =
+            (session.prepare << "EXPLAIN " + query);
+        for (auto const& step : plan)
+        {
+            INFO(query << ": " << step);
+            REQUIRE(step.find("Seq Scan") == std::string::npos);
+        }
+    }
+    session << "SET enable_seqscan = on";
+}
+#endif
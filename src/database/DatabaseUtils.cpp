@@ -3,6 +3,9 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "DatabaseUtils.h"
+#include "util/Logging.h"
+#include <algorithm>
+#include <cctype>
 
 namespace stellar
 {
@@ -30,5 +33,178 @@ deleteOldEntriesHelper(soci::session& sess, uint32_t ledgerSeq, uint32_t count,
              << " <= " << m;
     }
 }
+
+bool
+getOldestLedger(soci::session& sess, std::string const& tableName,
+                std::string const& ledgerSeqColumn, uint32_t& ledgerSeq)
+{
+    soci::indicator gotMin;
+    soci::statement st = (sess.prepare << "SELECT MIN(" << ledgerSeqColumn
+                                       << ") FROM " << tableName,
+                          soci::into(ledgerSeq, gotMin));
+    st.execute(true);
+    return st.got_data() && gotMin == soci::i_ok;
+}
+
+bool
+deleteOldEntriesBatch(soci::session& sess, uint32_t ledgerSeq, uint32_t batch,
+                      std::string const& tableName,
+                      std::string const& ledgerSeqColumn)
+{
+    uint32_t curMin = 0;
+    if (batch == 0 ||
+        !getOldestLedger(sess, tableName, ledgerSeqColumn, curMin) ||
+        curMin > ledgerSeq)
+    {
+        return false;
+    }
+    // at most ledgerSeq, so it fits
+    auto m = static_cast<uint32_t>(
+        std::min<uint64>(static_cast<uint64>(curMin) + batch - 1, ledgerSeq));
+    sess << "DELETE FROM " << tableName << " WHERE " << ledgerSeqColumn
+         << " <= " << m;
+    return m < ledgerSeq;
+}
+
+std::string
+historyPartitionClause(Database& db)
+{
+    if (db.getHistoryPartitionLedgers() == 0)
+    {
+        return "";
+    }
+    return " PARTITION BY RANGE (ledgerseq)";
+}
+
+void
+createHistoryPartitions(Database& db, std::string const& tableName)
+{
+    auto partitionLedgers = db.getHistoryPartitionLedgers();
+    if (partitionLedgers == 0)
+    {
+        return;
+    }
+    db.getSession() << "CREATE TABLE " << tableName << "_default PARTITION OF "
+                    << tableName << " DEFAULT";
+    createPartitions(db.getSession(), tableName, partitionLedgers, 0,
+                     2 * partitionLedgers - 1);
+}
+
+bool
+isPartitioned(soci::session& sess, std::string const& tableName)
+{
+    int count = 0;
+    sess << "SELECT COUNT(*) FROM pg_partitioned_table pt "
+            "JOIN pg_class c ON c.oid = pt.partrelid "
+            "WHERE c.relname = :t",
+        soci::into(count), soci::use(tableName);
+    return count != 0;
+}
+
+void
+createPartitions(soci::session& sess, std::string const& tableName,
+                 uint32_t partitionLedgers, uint32_t firstLedgerSeq,
+                 uint32_t lastLedgerSeq)
+{
+    for (uint64 i = firstLedgerSeq / partitionLedgers;
+         i <= lastLedgerSeq / partitionLedgers; ++i)
+    {
+        auto name = tableName + "_" + std::to_string(i);
+        try
+        {
+            sess << "CREATE TABLE IF NOT EXISTS " << name << " PARTITION OF "
+                 << tableName << " FOR VALUES FROM (" << i * partitionLedgers
+                 << ") TO (" << (i + 1) * partitionLedgers << ")";
+        }
+        catch (soci::soci_error& e)
+        {
+            // the rows of these ledgers stay in the default partition, where
+            // maintenance deletes them like the rows of unpartitioned tables
+            CLOG(WARNING, "Database") << "Could not create partition " << name
+                                      << ": " << e.what();
+        }
+    }
+}
+
+size_t
+dropOldPartitions(soci::session& sess, std::string const& tableName,
+                  uint32_t partitionLedgers, uint32_t ledgerSeq)
+{
+    std::vector<std::string> old;
+    {
+        std::string name;
+        soci::statement st =
+            (sess.prepare << "SELECT c.relname FROM pg_inherits i "
+                             "JOIN pg_class c ON c.oid = i.inhrelid "
+                             "JOIN pg_class p ON p.oid = i.inhparent "
+                             "WHERE p.relname = :t",
+             soci::into(name), soci::use(tableName));
+        st.execute(true);
+        auto prefix = tableName + "_";
+        while (st.got_data())
+        {
+            auto suffix = name.size() > prefix.size() &&
+                                  name.compare(0, prefix.size(), prefix) == 0
+                              ? name.substr(prefix.size())
+                              : std::string();
+            if (!suffix.empty() &&
+                std::all_of(suffix.begin(), suffix.end(), ::isdigit))
+            {
+                auto end = (std::stoull(suffix) + 1) * partitionLedgers;
+                if (end <= static_cast<uint64>(ledgerSeq) + 1)
+                {
+                    old.emplace_back(name);
+                }
+            }
+            st.fetch();
+        }
+    }
+    for (auto const& name : old)
+    {
+        sess << "DROP TABLE " << name;
+    }
+    return old.size();
+}
+
+std::string
+toPGArray(std::vector<std::string> const& values)
+{
+    std::string res = "{";
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        if (i != 0)
+        {
+            res += ',';
+        }
+        res += '"';
+        for (char c : values[i])
+        {
+            if (c == '"' || c == '\\')
+            {
+                res += '\\';
+            }
+            res += c;
+        }
+        res += '"';
+    }
+    res += '}';
+    return res;
+}
+
+std::string
+toPGArray(std::vector<int> const& values)
+{
+    std::string res = "{";
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        if (i != 0)
+        {
+            res += ',';
+        }
+        res += std::to_string(values[i]);
+    }
+    res += '}';
+    return res;
+}
+}
 }
-}
\ No newline at end of file
@@ -5,6 +5,8 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "Database.h"
+#include <string>
+#include <vector>
 
 namespace stellar
 {
@@ -13,5 +15,50 @@ namespace DatabaseUtils
 void deleteOldEntriesHelper(soci::session& sess, uint32_t ledgerSeq,
                             uint32_t count, std::string const& tableName,
                             std::string const& ledgerSeqColumn);
+
+// Smallest value of ledgerSeqColumn in tableName, false if it is empty.
+bool getOldestLedger(soci::session& sess, std::string const& tableName,
+                     std::string const& ledgerSeqColumn, uint32_t& ledgerSeq);
+
+// Deletes the rows of the oldest `batch` ledgers of tableName, but none after
+// ledgerSeq, with a range over the index of ledgerSeqColumn. Returns false
+// once no row at or before ledgerSeq is left.
+bool deleteOldEntriesBatch(soci::session& sess, uint32_t ledgerSeq,
+                           uint32_t batch, std::string const& tableName,
+                           std::string const& ledgerSeqColumn);
+
+// Range partitioning of the history tables by ledgerseq, on postgres when
+// HISTORY_PARTITION_LEDGERS is set (see Database::getHistoryPartitionLedgers).
+// Partition i of a table is named <table>_<i> and holds the ledgers from
+// i * partitionLedgers (included) to (i + 1) * partitionLedgers (excluded).
+// The rows of the ledgers no partition covers go to <table>_default.
+//
+// historyPartitionClause returns the clause to append to the CREATE TABLE of
+// a history table (empty if the tables are not partitioned), and
+// createHistoryPartitions then creates its first partitions.
+std::string historyPartitionClause(Database& db);
+void createHistoryPartitions(Database& db, std::string const& tableName);
+
+// true if tableName is a partitioned table (which it may not be, even with
+// HISTORY_PARTITION_LEDGERS set, if it was created before it was set)
+bool isPartitioned(soci::session& sess, std::string const& tableName);
+
+// Creates, if missing, the partitions of tableName that cover the ledgers up
+// to lastLedgerSeq. A partition whose ledgers are already in the default
+// partition cannot be created, in which case a warning is logged.
+void createPartitions(soci::session& sess, std::string const& tableName,
+                      uint32_t partitionLedgers, uint32_t firstLedgerSeq,
+                      uint32_t lastLedgerSeq);
+
+// Drops the partitions of tableName whose ledgers are all at or before
+// ledgerSeq, returns how many were dropped.
+size_t dropOldPartitions(soci::session& sess, std::string const& tableName,
+                         uint32_t partitionLedgers, uint32_t ledgerSeq);
+
+// Formats values as a PostgreSQL array literal ({"a","b"} or {1,2}), to be
+// bound as a single parameter and expanded with unnest() so that many rows
+// can be inserted with one statement (and one round trip to the server).
+std::string toPGArray(std::vector<std::string> const& values);
+std::string toPGArray(std::vector<int> const& values);
 }
 }
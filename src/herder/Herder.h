@@ -15,6 +15,11 @@
 #include <memory>
 #include <string>
 
+namespace medida
+{
+class Timer;
+}
+
 namespace stellar
 {
 class Application;
@@ -114,6 +119,16 @@ class Herder
     // We are learning about a new envelope.
     virtual EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope) = 0;
 
+    // We are learning about a new envelope from the network. Envelopes that
+    // recvSCPEnvelope would discard right away, and copies of envelopes
+    // already being checked, are dropped; the signature of the others gets
+    // checked on the worker pool (or right away if it is busy) before they
+    // are passed to recvSCPEnvelope, the ones with an invalid signature being
+    // dropped. processTimer times the processing of the envelope by
+    // recvSCPEnvelope, whenever it happens.
+    virtual void queueSCPEnvelope(SCPEnvelope const& envelope,
+                                  medida::Timer& processTimer) = 0;
+
     // We are learning about a new fully-fetched envelope.
     virtual EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope,
                                            const SCPQuorumSet& qset,
@@ -6,6 +6,7 @@
 #include "crypto/Hex.h"
 #include "crypto/KeyUtils.h"
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
 #include "herder/HerderPersistence.h"
 #include "herder/HerderUtils.h"
 #include "herder/LedgerCloseData.h"
@@ -25,10 +26,12 @@
 #include "util/Logging.h"
 #include "util/StatusManager.h"
 #include "util/Timer.h"
+#include "util/WorkerPool.h"
 
 #include "medida/counter.h"
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include "util/Decoder.h"
 #include "util/XDRStream.h"
 #include "xdrpp/marshal.h"
@@ -55,6 +58,12 @@ HerderImpl::SCPMetrics::SCPMetrics(Application& app)
           app.getMetrics().NewMeter({"scp", "envelope", "emit"}, "envelope"))
     , mEnvelopeReceive(
           app.getMetrics().NewMeter({"scp", "envelope", "receive"}, "envelope"))
+    , mEnvelopeVerifySig(
+          app.getMetrics().NewTimer({"scp", "envelope", "verify-sig"}))
+    , mEnvelopeDroppedInvalidSig(app.getMetrics().NewMeter(
+          {"scp", "envelope", "dropped-invalidsig"}, "envelope"))
+    , mTriggerNominate(
+          app.getMetrics().NewTimer({"scp", "timing", "trigger-nominate"}))
 
     , mKnownSlotsSize(
           app.getMetrics().NewCounter({"scp", "memory", "known-slots"}))
@@ -83,6 +92,7 @@ HerderImpl::HerderImpl(Application& app)
     , mApp(app)
     , mLedgerManager(app.getLedgerManager())
     , mSCPMetrics(app)
+    , mSigCheckToken(std::make_shared<bool>(true))
 {
     Hash hash = getSCP().getLocalNode()->getQuorumSetHash();
     mPendingEnvelopes.addSCPQuorumSet(hash,
@@ -370,6 +380,14 @@ HerderImpl::recvTransaction(TransactionFramePtr tx)
     auto txmap = findOrAdd(mPendingTransactions[0], acc);
     txmap->addTx(tx);
 
+    // tx was validated against the last closed ledger on top of the pending
+    // transactions of its account, so the candidate stays valid
+    if (mTxSetCandidate)
+    {
+        mTxSetCandidate->add(tx);
+        recordTxSetCandidateValid();
+    }
+
     return TX_STATUS_PENDING;
 }
 
@@ -398,6 +416,22 @@ HerderImpl::recvSCPEnvelope(SCPEnvelope const& envelope)
 
     mSCPMetrics.mEnvelopeReceive.Mark();
 
+    if (!isSCPEnvelopeInRange(envelope))
+    {
+        return Herder::ENVELOPE_STATUS_DISCARDED;
+    }
+
+    auto status = mPendingEnvelopes.recvSCPEnvelope(envelope);
+    if (status == Herder::ENVELOPE_STATUS_READY)
+    {
+        processSCPQueue();
+    }
+    return status;
+}
+
+bool
+HerderImpl::isSCPEnvelopeInRange(SCPEnvelope const& envelope)
+{
     uint32_t minLedgerSeq = getCurrentLedgerSeq();
     if (minLedgerSeq > MAX_SLOTS_TO_REMEMBER)
     {
@@ -426,15 +460,131 @@ HerderImpl::recvSCPEnvelope(SCPEnvelope const& envelope)
         CLOG(DEBUG, "Herder") << "Ignoring SCPEnvelope outside of range: "
                               << envelope.statement.slotIndex << "( "
                               << minLedgerSeq << "," << maxLedgerSeq << ")";
-        return Herder::ENVELOPE_STATUS_DISCARDED;
+        return false;
     }
+    return true;
+}
 
-    auto status = mPendingEnvelopes.recvSCPEnvelope(envelope);
-    if (status == Herder::ENVELOPE_STATUS_READY)
+void
+HerderImpl::queueSCPEnvelope(SCPEnvelope const& envelope,
+                             medida::Timer& processTimer)
+{
+    // the checks that do not need the signature come first: they are cheap
+    // and recvSCPEnvelope repeats them anyway once the signature is checked
+    if (mApp.getConfig().MANUAL_CLOSE ||
+        envelope.statement.nodeID == getSCP().getLocalNode()->getNodeID() ||
+        !isSCPEnvelopeInRange(envelope))
     {
-        processSCPQueue();
+        return;
+    }
+
+    auto const& sender = envelope.statement.nodeID;
+    bool known = mPendingEnvelopes.isKnown(envelope);
+    if (known && mQueuedEnvelopes.find(sender) == mQueuedEnvelopes.end())
+    {
+        // an identical envelope (signature included) was checked already
+        // and nothing from the same sender is waiting before it
+        auto t = processTimer.TimeScope();
+        recvSCPEnvelope(envelope);
+        return;
+    }
+
+    auto hash = sha256(xdr::xdr_to_opaque(envelope));
+    if (!mEnvelopesBeingVerified.insert(hash).second)
+    {
+        return;
+    }
+
+    auto arrival = mEnvelopeArrivals++;
+    mQueuedEnvelopes[sender].push_back(
+        {arrival, hash, envelope, &processTimer, known, known});
+    if (known)
+    {
+        return;
+    }
+
+    // libsodium does not offer batch verification of ed25519 signatures, so
+    // envelopes are verified one by one but concurrently on the worker pool;
+    // the result lands in the signature cache, making the check done later
+    // by SCP cheap
+    auto networkID = mApp.getNetworkID();
+    auto& verifyTimer = mSCPMetrics.mEnvelopeVerifySig;
+    auto verify = [envelope, networkID, &verifyTimer]() {
+        auto t = verifyTimer.TimeScope();
+        return PubKeyUtils::verifySig(
+            envelope.statement.nodeID, envelope.signature,
+            xdr::xdr_to_opaque(networkID, ENVELOPE_TYPE_SCP,
+                               envelope.statement));
+    };
+
+    auto& app = mApp;
+    std::weak_ptr<bool> token = mSigCheckToken;
+    auto posted = app.getWorkerPool().tryPost(
+        [this, &app, token, sender, arrival, verify]() {
+            auto valid = verify();
+            app.postOnMainThread([this, token, sender, arrival, valid]() {
+                if (token.lock())
+                {
+                    envelopeVerified(sender, arrival, valid);
+                }
+            });
+        });
+    if (!posted)
+    {
+        // the pool has no thread or is saturated
+        envelopeVerified(sender, arrival, verify());
+    }
+}
+
+void
+HerderImpl::envelopeVerified(NodeID const& sender, uint64_t arrival,
+                             bool valid)
+{
+    auto it = mQueuedEnvelopes.find(sender);
+    if (it == mQueuedEnvelopes.end())
+    {
+        return;
+    }
+    for (auto& queued : it->second)
+    {
+        if (queued.mArrival == arrival)
+        {
+            queued.mVerified = true;
+            queued.mValid = valid;
+            break;
+        }
+    }
+
+    // recvSCPEnvelope may queue more envelopes, so the queue is looked up
+    // again for each envelope passed on
+    while (true)
+    {
+        it = mQueuedEnvelopes.find(sender);
+        if (it == mQueuedEnvelopes.end() || !it->second.front().mVerified)
+        {
+            return;
+        }
+        auto queued = std::move(it->second.front());
+        it->second.pop_front();
+        if (it->second.empty())
+        {
+            mQueuedEnvelopes.erase(it);
+        }
+        mEnvelopesBeingVerified.erase(queued.mHash);
+
+        if (queued.mValid)
+        {
+            auto t = queued.mProcessTimer->TimeScope();
+            recvSCPEnvelope(queued.mEnvelope);
+        }
+        else
+        {
+            CLOG(DEBUG, "Herder")
+                << "Dropping envelope with invalid signature from "
+                << mApp.getConfig().toShortString(sender);
+            mSCPMetrics.mEnvelopeDroppedInvalidSig.Mark();
+        }
     }
-    return status;
 }
 
 Herder::EnvelopeStatus
@@ -546,6 +696,7 @@ HerderImpl::ledgerClosed()
 
     auto lastIndex = mHerderSCPDriver.lastConsensusLedgerIndex();
 
+    mHerderSCPDriver.ledgerClosed();
     mPendingEnvelopes.slotClosed(lastIndex);
 
     mApp.getOverlayManager().ledgerClosed(lastIndex);
@@ -578,6 +729,9 @@ HerderImpl::ledgerClosed()
         return;
     }
 
+    // prepare the set to nominate now rather than when the trigger fires
+    rebuildTxSetCandidate();
+
     auto seconds = mApp.getConfig().getExpectedLedgerCloseTime();
 
     // bootstrap with a pessimistic estimate of when
@@ -723,35 +877,39 @@ HerderImpl::triggerNextLedger(uint32_t ledgerSeqToTrigger)
     }
     updateSCPCounters();
 
+    auto timer = mSCPMetrics.mTriggerNominate.TimeScope();
+
     // our first choice for this round's set is all the tx we have collected
     // during last ledger close
     auto const& lcl = mLedgerManager.getLastClosedLedgerHeader();
-    auto proposedSet = std::make_shared<TxSetFrame>(lcl.hash);
-
-    for (auto const& m : mPendingTransactions)
+    if (!mTxSetCandidate || mTxSetCandidate->previousLedgerHash() != lcl.hash)
     {
-        for (auto const& pair : m)
-        {
-            for (auto const& tx : pair.second->mTransactions)
-            {
-                proposedSet->add(tx.second);
-            }
-        }
+        rebuildTxSetCandidate();
     }
 
-    std::vector<TransactionFramePtr> removed;
-    proposedSet->trimInvalid(mApp, removed);
-    removeReceivedTxs(removed);
-
-    proposedSet->surgePricingFilter(mApp);
+    // nominate a copy as the candidate keeps growing
+    auto proposedSet = std::make_shared<TxSetFrame>(*mTxSetCandidate);
 
-    if (!proposedSet->checkValid(mApp))
+    if (proposedSet->size() > lcl.header.maxTxSetSize)
     {
-        throw std::runtime_error("wanting to emit an invalid txSet");
+        proposedSet->surgePricingFilter(mApp);
+        // surge pricing keeps, for each account, the transactions of the
+        // candidate with the lowest sequence numbers, which are valid on
+        // their own
+        mHerderSCPDriver.recordTxSetValid(proposedSet->getContentsHash(),
+                                          true);
     }
 
     auto txSetHash = proposedSet->getContentsHash();
 
+    // the validity of the candidate was recorded when it was built or
+    // extended, so this is a lookup that guards against a bug in that
+    // bookkeeping; SCP finds the same result when it validates the value
+    if (!mHerderSCPDriver.checkTxSetValid(txSetHash, proposedSet))
+    {
+        throw std::runtime_error("wanting to emit an invalid txSet");
+    }
+
     // use the slot index from ledger manager here as our vote is based off
     // the last closed ledger stored in ledger manager
     uint32_t slotIndex = lcl.header.ledgerSeq + 1;
@@ -798,11 +956,50 @@ HerderImpl::triggerNextLedger(uint32_t ledgerSeqToTrigger)
         }
     }
 
+    timer.Stop();
+
     getHerderSCPDriver().recordSCPEvent(slotIndex, true);
     mHerderSCPDriver.nominate(slotIndex, newProposedValue, proposedSet,
                               lcl.header.scpValue);
 }
 
+void
+HerderImpl::rebuildTxSetCandidate()
+{
+    auto const& lcl = mLedgerManager.getLastClosedLedgerHeader();
+    mTxSetCandidate = std::make_shared<TxSetFrame>(lcl.hash);
+
+    for (auto const& m : mPendingTransactions)
+    {
+        for (auto const& pair : m)
+        {
+            for (auto const& tx : pair.second->mTransactions)
+            {
+                mTxSetCandidate->add(tx.second);
+            }
+        }
+    }
+
+    std::vector<TransactionFramePtr> removed;
+    mTxSetCandidate->trimInvalid(mApp, removed);
+    removeReceivedTxs(removed);
+
+    recordTxSetCandidateValid();
+}
+
+void
+HerderImpl::recordTxSetCandidateValid()
+{
+    // only the transactions that are valid on top of the last closed ledger
+    // go into the candidate (see rebuildTxSetCandidate and recvTransaction)
+    if (mTxSetCandidate->previousLedgerHash() ==
+        mLedgerManager.getLastClosedLedgerHeader().hash)
+    {
+        mHerderSCPDriver.recordTxSetValid(mTxSetCandidate->getContentsHash(),
+                                          true);
+    }
+}
+
 void
 HerderImpl::setUpgrades(Upgrades::UpgradeParameters const& upgrades)
 {
@@ -8,11 +8,14 @@
 #include "herder/Herder.h"
 #include "herder/HerderSCPDriver.h"
 #include "herder/Upgrades.h"
+#include "util/HashOfHash.h"
 #include "util/Timer.h"
 #include "util/XDROperators.h"
 #include <deque>
+#include <map>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace medida
@@ -54,6 +57,14 @@ class HerderImpl : public Herder
         return mHerderSCPDriver;
     }
 
+    // the set triggerNextLedger nominates next (before surge pricing), null
+    // until a ledger closes
+    TxSetFramePtr
+    getTxSetCandidate() const
+    {
+        return mTxSetCandidate;
+    }
+
     void valueExternalized(uint64 slotIndex, StellarValue const& value);
     void emitEnvelope(SCPEnvelope const& envelope);
 
@@ -63,6 +74,8 @@ class HerderImpl : public Herder
     EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope,
                                    const SCPQuorumSet& qset,
                                    TxSetFrame txset) override;
+    void queueSCPEnvelope(SCPEnvelope const& envelope,
+                          medida::Timer& processTimer) override;
 
     void sendSCPStateToPeer(uint32 ledgerSeq, Peer::pointer peer) override;
 
@@ -112,6 +125,40 @@ class HerderImpl : public Herder
 
     void processSCPQueueUpToIndex(uint64 slotIndex);
 
+    // false if the envelope is for a slot outside of the validity bracket
+    bool isSCPEnvelopeInRange(SCPEnvelope const& envelope);
+
+    // an envelope queued by queueSCPEnvelope
+    struct QueuedEnvelope
+    {
+        uint64_t mArrival;
+        Hash mHash;
+        SCPEnvelope mEnvelope;
+        medida::Timer* mProcessTimer;
+        // set once the signature has been checked
+        bool mVerified;
+        bool mValid;
+    };
+
+    // envelopes queued by queueSCPEnvelope of each sender, in the order
+    // they arrived: they are passed on to recvSCPEnvelope in that order,
+    // each one once its signature and those of the ones before it have been
+    // checked
+    std::map<NodeID, std::deque<QueuedEnvelope>> mQueuedEnvelopes;
+    uint64_t mEnvelopeArrivals{0};
+
+    // hashes of the envelopes in mQueuedEnvelopes, later copies of them are
+    // dropped
+    std::unordered_set<Hash> mEnvelopesBeingVerified;
+
+    // only lives as long as this object, lets callbacks posted by worker
+    // threads detect that the herder is gone
+    std::shared_ptr<bool> mSigCheckToken;
+
+    // records the result of the signature check of a queued envelope, then
+    // passes on the envelopes of its sender that are ready
+    void envelopeVerified(NodeID const& sender, uint64_t arrival, bool valid);
+
     // 0- tx we got during ledger close
     // 1- one ledger ago. rebroadcast
     // 2- two ledgers ago. rebroadcast
@@ -121,6 +168,15 @@ class HerderImpl : public Herder
     void
     updatePendingTransactions(std::vector<TransactionFramePtr> const& applied);
 
+    // transaction set to nominate for the ledger following the last closed
+    // one: rebuilt (and trimmed) when a ledger closes, then extended as
+    // transactions are received so that triggerNextLedger does not have to
+    // revalidate every pending transaction
+    TxSetFramePtr mTxSetCandidate;
+    void rebuildTxSetCandidate();
+    // hashes the candidate and records it as valid in mHerderSCPDriver
+    void recordTxSetCandidateValid();
+
     PendingEnvelopes mPendingEnvelopes;
     Upgrades mUpgrades;
     HerderSCPDriver mHerderSCPDriver;
@@ -164,6 +220,13 @@ class HerderImpl : public Herder
         medida::Meter& mEnvelopeEmit;
         medida::Meter& mEnvelopeReceive;
 
+        // signature checks done by queueSCPEnvelope
+        medida::Timer& mEnvelopeVerifySig;
+        medida::Meter& mEnvelopeDroppedInvalidSig;
+
+        // time spent by triggerNextLedger before nominating
+        medida::Timer& mTriggerNominate;
+
         // Counters for stuff in parent class (SCP)
         // that we monitor on a best-effort basis from
         // here.
@@ -5,6 +5,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -32,6 +33,11 @@ class HerderPersistence
     virtual void saveSCPHistory(uint32_t seq,
                                 std::vector<SCPEnvelope> const& envs) = 0;
 
+    // Calls f on the main thread once the SCP history saved so far is in the
+    // database (immediately if it is already there): with
+    // BACKGROUND_SCP_HISTORY, saveSCPHistory only queues the messages.
+    virtual void whenWritten(std::function<void()> f) = 0;
+
     static size_t copySCPHistoryToStream(Database& db, soci::session& sess,
                                          uint32_t ledgerSeq,
                                          uint32_t ledgerCount,
@@ -8,23 +8,39 @@
 #include "database/DatabaseUtils.h"
 #include "herder/Herder.h"
 #include "main/Application.h"
+#include "main/Config.h"
 #include "scp/Slot.h"
 #include "util/Decoder.h"
+#include "util/Logging.h"
+#include "util/WorkerPool.h"
 #include "util/XDRStream.h"
 
+#include "medida/counter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include <soci.h>
 #include <xdrpp/marshal.h>
 
 namespace stellar
 {
 
+// failed background writes in a row after which the queued ledgers are
+// written on the main thread
+static uint32_t const MAX_FAILED_WRITES = 3;
+
 std::unique_ptr<HerderPersistence>
 HerderPersistence::create(Application& app)
 {
     return std::make_unique<HerderPersistenceImpl>(app);
 }
 
-HerderPersistenceImpl::HerderPersistenceImpl(Application& app) : mApp(app)
+HerderPersistenceImpl::HerderPersistenceImpl(Application& app)
+    : mApp(app)
+    , mBackground(app.getConfig().BACKGROUND_SCP_HISTORY &&
+                  app.getDatabase().canUsePool())
+    , mWriteTimer(app.getMetrics().NewTimer({"scp", "history", "write"}))
+    , mQueuedLedgers(app.getMetrics().NewCounter({"scp", "history", "queued"}))
+    , mWriteToken(std::make_shared<bool>(true))
 {
 }
 
@@ -41,23 +57,8 @@ HerderPersistenceImpl::saveSCPHistory(uint32_t seq,
         return;
     }
 
+    SCPHistoryRows rows;
     auto usedQSets = std::unordered_map<Hash, SCPQuorumSetPtr>{};
-    auto& db = mApp.getDatabase();
-
-    soci::transaction txscope(db.getSession());
-
-    {
-        auto prepClean = db.getPreparedStatement(
-            "DELETE FROM scphistory WHERE ledgerseq =:l");
-
-        auto& st = prepClean.statement();
-        st.exchange(soci::use(seq));
-        st.define_and_bind();
-        {
-            auto timer = db.getDeleteTimer("scphistory");
-            st.execute(true);
-        }
-    }
     for (auto const& e : envs)
     {
         auto const& qHash =
@@ -65,77 +66,254 @@ HerderPersistenceImpl::saveSCPHistory(uint32_t seq,
         usedQSets.insert(
             std::make_pair(qHash, mApp.getHerder().getQSet(qHash)));
 
-        std::string nodeIDStrKey = KeyUtils::toStrKey(e.statement.nodeID);
-
         auto envelopeBytes(xdr::xdr_to_opaque(e));
+        rows.mEnvelopes.emplace_back(KeyUtils::toStrKey(e.statement.nodeID),
+                                     decoder::encode_b64(envelopeBytes));
+    }
+    for (auto const& p : usedQSets)
+    {
+        auto qSetBytes(xdr::xdr_to_opaque(*p.second));
+        rows.mQuorumSets.emplace_back(binToHex(p.first),
+                                      decoder::encode_b64(qSetBytes));
+    }
 
-        std::string envelopeEncoded;
-        envelopeEncoded = decoder::encode_b64(envelopeBytes);
+    if (!mBackground)
+    {
+        SCPHistoryBatch batch;
+        batch.emplace(seq, std::move(rows));
+        auto timer = mWriteTimer.TimeScope();
+        writeSCPHistory(&mApp.getDatabase(), mApp.getDatabase().getSession(),
+                        batch);
+        return;
+    }
 
-        auto prepEnv =
-            db.getPreparedStatement("INSERT INTO scphistory "
-                                    "(nodeid, ledgerseq, envelope) VALUES "
-                                    "(:n, :l, :e)");
+    // saving a ledger again replaces its messages, so only the latest rows
+    // of a ledger need to be written
+    mQueued[seq] = std::move(rows);
+    mQueuedLedgers.set_count(mQueued.size());
+    maybeStartWriting();
+}
 
-        auto& st = prepEnv.statement();
-        st.exchange(soci::use(nodeIDStrKey));
-        st.exchange(soci::use(seq));
-        st.exchange(soci::use(envelopeEncoded));
-        st.define_and_bind();
+void
+HerderPersistenceImpl::whenWritten(std::function<void()> f)
+{
+    if (!mWriting && mQueued.empty())
+    {
+        f();
+        return;
+    }
+    mWhenWritten.emplace_back(std::move(f));
+    maybeStartWriting();
+}
+
+void
+HerderPersistenceImpl::maybeStartWriting()
+{
+    if (mWriting || mQueued.empty())
+    {
+        return;
+    }
+    if (mFailedWrites >= MAX_FAILED_WRITES)
+    {
+        writeQueuedOnMainThread();
+        return;
+    }
+
+    auto batch = std::make_shared<SCPHistoryBatch>(std::move(mQueued));
+    mQueued.clear();
+
+    // the application and its metrics outlive the workers, which it joins
+    // before it is destroyed, but this object may not
+    auto& app = mApp;
+    auto& timer = mWriteTimer;
+    std::weak_ptr<bool> token = mWriteToken;
+    auto posted = app.getWorkerPool().tryPost([this, &app, &timer, token,
+                                               batch]() {
+        std::string error;
+        try
         {
-            auto timer = db.getInsertTimer("scphistory");
-            st.execute(true);
+            soci::session sess(app.getDatabase().getPool());
+            auto t = timer.TimeScope();
+            writeSCPHistory(nullptr, sess, *batch);
         }
-        if (st.get_affected_rows() != 1)
+        catch (std::exception& e)
         {
-            throw std::runtime_error("Could not update data in SQL");
+            error = e.what();
         }
+        app.postOnMainThread([this, token, batch, error]() {
+            if (token.lock())
+            {
+                writingDone(std::move(*batch), error);
+            }
+        });
+    });
+    if (!posted)
+    {
+        // the pool has no thread or is saturated
+        mQueued = std::move(*batch);
+        writeQueuedOnMainThread();
+        return;
     }
+    mWriting = true;
+    mQueuedLedgers.set_count(0);
+}
 
-    for (auto const& p : usedQSets)
+void
+HerderPersistenceImpl::writingDone(SCPHistoryBatch&& batch,
+                                   std::string const& error)
+{
+    mWriting = false;
+    if (!error.empty())
+    {
+        // keep the ledgers that were not saved again in the meantime, they
+        // are retried with the next ones
+        ++mFailedWrites;
+        CLOG(ERROR, "Herder") << "Could not save SCP history of ledgers "
+                              << batch.begin()->first << " to "
+                              << batch.rbegin()->first << " (attempt "
+                              << mFailedWrites << "): " << error;
+        mQueued.insert(std::make_move_iterator(batch.begin()),
+                       std::make_move_iterator(batch.end()));
+        mQueuedLedgers.set_count(mQueued.size());
+        if (mFailedWrites >= MAX_FAILED_WRITES)
+        {
+            writeQueuedOnMainThread();
+        }
+        return;
+    }
+    mFailedWrites = 0;
+
+    if (!mQueued.empty())
+    {
+        maybeStartWriting();
+        return;
+    }
+    notifyWritten();
+}
+
+void
+HerderPersistenceImpl::writeQueuedOnMainThread()
+{
+    // throws, like the writes done at ledger close without
+    // BACKGROUND_SCP_HISTORY, if the database refuses the messages
     {
-        std::string qSetH = binToHex(p.first);
+        auto timer = mWriteTimer.TimeScope();
+        writeSCPHistory(&mApp.getDatabase(), mApp.getDatabase().getSession(),
+                        mQueued);
+    }
+    mQueued.clear();
+    mQueuedLedgers.set_count(0);
+    mFailedWrites = 0;
+    notifyWritten();
+}
 
-        auto prepUpQSet =
-            db.getPreparedStatement("UPDATE scpquorums SET "
-                                    "lastledgerseq = :l WHERE qsethash = :h");
+void
+HerderPersistenceImpl::notifyWritten()
+{
+    auto whenWritten = std::move(mWhenWritten);
+    mWhenWritten.clear();
+    for (auto& f : whenWritten)
+    {
+        f();
+    }
+}
 
-        auto& stUp = prepUpQSet.statement();
-        stUp.exchange(soci::use(seq));
-        stUp.exchange(soci::use(qSetH));
-        stUp.define_and_bind();
+void
+HerderPersistenceImpl::writeSCPHistory(Database* db, soci::session& sess,
+                                       SCPHistoryBatch const& batch)
+{
+    static RegisteredStatement const cleanSql(
+        "DELETE FROM scphistory WHERE ledgerseq =:l");
+    static RegisteredStatement const envSql(
+        "INSERT INTO scphistory (nodeid, ledgerseq, envelope) "
+        "VALUES (:n, :l, :e)");
+    static RegisteredStatement const upQSetSql(
+        "UPDATE scpquorums SET lastledgerseq = :l WHERE qsethash = :h");
+    static RegisteredStatement const insQSetSql(
+        "INSERT INTO scpquorums (qsethash, lastledgerseq, qset) "
+        "VALUES (:h, :l, :v)");
+    auto prepare = [db, &sess](RegisteredStatement const& sql) {
+        return db ? db->getPreparedStatement(sql)
+                  : StatementContext(std::make_shared<soci::statement>(
+                        sess.prepare << sql.getSQL()));
+    };
+    // on the main session each statement is timed like the other writes of
+    // ledger close, the pooled writes are timed as a whole by mWriteTimer
+    auto execute = [db](soci::statement& st,
+                        medida::TimerContext (Database::*timer)(
+                            std::string const&),
+                        std::string const& table) {
+        if (db)
         {
-            auto timer = db.getInsertTimer("scpquorums");
-            stUp.execute(true);
+            auto t = (db->*timer)(table);
+            st.execute(true);
         }
-        if (stUp.get_affected_rows() != 1)
+        else
         {
-            auto qSetBytes(xdr::xdr_to_opaque(*p.second));
-
-            std::string qSetEncoded;
-            qSetEncoded = decoder::encode_b64(qSetBytes);
-
-            auto prepInsQSet = db.getPreparedStatement(
-                "INSERT INTO scpquorums "
-                "(qsethash, lastledgerseq, qset) VALUES "
-                "(:h, :l, :v);");
+            st.execute(true);
+        }
+    };
+
+    uint32_t seq = 0;
+    std::string nodeIDStrKey, envelopeEncoded, qSetH, qSetEncoded;
+
+    auto prepClean = prepare(cleanSql);
+    auto& stClean = prepClean.statement();
+    stClean.exchange(soci::use(seq));
+    stClean.define_and_bind();
+
+    auto prepEnv = prepare(envSql);
+    auto& stEnv = prepEnv.statement();
+    stEnv.exchange(soci::use(nodeIDStrKey));
+    stEnv.exchange(soci::use(seq));
+    stEnv.exchange(soci::use(envelopeEncoded));
+    stEnv.define_and_bind();
+
+    auto prepUpQSet = prepare(upQSetSql);
+    auto& stUpQSet = prepUpQSet.statement();
+    stUpQSet.exchange(soci::use(seq));
+    stUpQSet.exchange(soci::use(qSetH));
+    stUpQSet.define_and_bind();
+
+    auto prepInsQSet = prepare(insQSetSql);
+    auto& stInsQSet = prepInsQSet.statement();
+    stInsQSet.exchange(soci::use(qSetH));
+    stInsQSet.exchange(soci::use(seq));
+    stInsQSet.exchange(soci::use(qSetEncoded));
+    stInsQSet.define_and_bind();
+
+    soci::transaction txscope(sess);
+    for (auto const& ledger : batch)
+    {
+        seq = ledger.first;
+        execute(stClean, &Database::getDeleteTimer, "scphistory");
 
-            auto& stIns = prepInsQSet.statement();
-            stIns.exchange(soci::use(qSetH));
-            stIns.exchange(soci::use(seq));
-            stIns.exchange(soci::use(qSetEncoded));
-            stIns.define_and_bind();
+        for (auto const& e : ledger.second.mEnvelopes)
+        {
+            nodeIDStrKey = e.first;
+            envelopeEncoded = e.second;
+            execute(stEnv, &Database::getInsertTimer, "scphistory");
+            if (stEnv.get_affected_rows() != 1)
             {
-                auto timer = db.getInsertTimer("scpquorums");
-                stIns.execute(true);
+                throw std::runtime_error("Could not update data in SQL");
             }
-            if (stIns.get_affected_rows() != 1)
+        }
+
+        for (auto const& q : ledger.second.mQuorumSets)
+        {
+            qSetH = q.first;
+            execute(stUpQSet, &Database::getInsertTimer, "scpquorums");
+            if (stUpQSet.get_affected_rows() != 1)
             {
-                throw std::runtime_error("Could not update data in SQL");
+                qSetEncoded = q.second;
+                execute(stInsQSet, &Database::getInsertTimer, "scpquorums");
+                if (stInsQSet.get_affected_rows() != 1)
+                {
+                    throw std::runtime_error("Could not update data in SQL");
+                }
             }
         }
     }
-
     txscope.commit();
 }
 
@@ -254,7 +432,9 @@ HerderPersistence::dropAll(Database& db)
                        "nodeid      CHARACTER(56) NOT NULL,"
                        "ledgerseq   INT NOT NULL CHECK (ledgerseq >= 0),"
                        "envelope    TEXT NOT NULL"
-                       ")";
+                       ")"
+                    << DatabaseUtils::historyPartitionClause(db);
+    DatabaseUtils::createHistoryPartitions(db, "scphistory");
 
     db.getSession() << "CREATE INDEX scpenvsbyseq ON scphistory(ledgerseq)";
 
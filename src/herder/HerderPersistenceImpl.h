@@ -6,6 +6,17 @@
 
 #include "herder/HerderPersistence.h"
 
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace medida
+{
+class Counter;
+class Timer;
+}
+
 namespace stellar
 {
 class Application;
@@ -20,7 +31,53 @@ class HerderPersistenceImpl : public HerderPersistence
     void saveSCPHistory(uint32_t seq,
                         std::vector<SCPEnvelope> const& envs) override;
 
+    void whenWritten(std::function<void()> f) override;
+
   private:
+    // SCP messages of a ledger and the quorum sets they use, already encoded
+    // so that they can be written from any thread
+    struct SCPHistoryRows
+    {
+        // (nodeid, envelope)
+        std::vector<std::pair<std::string, std::string>> mEnvelopes;
+        // (qsethash, qset)
+        std::vector<std::pair<std::string, std::string>> mQuorumSets;
+    };
+    typedef std::map<uint32_t, SCPHistoryRows> SCPHistoryBatch;
+
+    // Writes batch in one transaction. On the main session (db is given)
+    // the statements come from the cache of db and are timed like the other
+    // writes; on a pooled session they are prepared for the batch.
+    static void writeSCPHistory(Database* db, soci::session& sess,
+                                SCPHistoryBatch const& batch);
+
+    // Starts writing all the queued ledgers on a worker thread, unless a
+    // write is already in progress (the ledgers queued meanwhile are written
+    // by the next one, so at most two batches are ever outstanding). Writes
+    // them on the main thread instead when no worker takes the batch or
+    // after MAX_FAILED_WRITES failures in a row, so that a database that
+    // keeps refusing them fails there rather than silently stopping the
+    // publication of history.
+    void maybeStartWriting();
+    void writingDone(SCPHistoryBatch&& batch, std::string const& error);
+    void writeQueuedOnMainThread();
+    // runs the callbacks of whenWritten
+    void notifyWritten();
+
     Application& mApp;
+    bool const mBackground;
+
+    // main thread only
+    SCPHistoryBatch mQueued;
+    bool mWriting{false};
+    uint32_t mFailedWrites{0};
+    std::vector<std::function<void()>> mWhenWritten;
+
+    // only lives as long as this object, lets the callbacks posted by the
+    // writer detect that it is gone
+    std::shared_ptr<bool> mWriteToken;
+
+    medida::Timer& mWriteTimer;
+    medida::Counter& mQueuedLedgers;
 };
 }
@@ -19,6 +19,8 @@
 #include <util/format.h>
 #include <xdrpp/marshal.h>
 
+#define TXSET_VALID_CACHE_SIZE 1000
+
 namespace stellar
 {
 
@@ -34,6 +36,10 @@ HerderSCPDriver::SCPMetrics::SCPMetrics(Application& app)
           app.getMetrics().NewMeter({"scp", "value", "invalid"}, "value"))
     , mValueExternalize(
           app.getMetrics().NewMeter({"scp", "value", "externalize"}, "value"))
+    , mTxSetValidCacheHit(app.getMetrics().NewMeter(
+          {"scp", "txset-valid-cache", "hit"}, "txset"))
+    , mTxSetValidCacheMiss(app.getMetrics().NewMeter(
+          {"scp", "txset-valid-cache", "miss"}, "txset"))
     , mQuorumHeard(
           app.getMetrics().NewMeter({"scp", "quorum", "heard"}, "quorum"))
     , mNominatingValue(
@@ -71,6 +77,7 @@ HerderSCPDriver::HerderSCPDriver(Application& app, HerderImpl& herder,
     , mSCP(*this, mApp.getConfig().NODE_SEED.getPublicKey(),
            mApp.getConfig().NODE_IS_VALIDATOR, mApp.getConfig().QUORUM_SET)
     , mSCPMetrics{mApp}
+    , mTxSetValidCache{TXSET_VALID_CACHE_SIZE}
     , mLastStateChange{mApp.getClock().now()}
 {
 }
@@ -123,6 +130,12 @@ HerderSCPDriver::syncMetrics()
     }
 }
 
+void
+HerderSCPDriver::ledgerClosed()
+{
+    mTxSetValidCache.clear();
+}
+
 void
 HerderSCPDriver::restoreSCPState(uint64_t index, StellarValue const& value)
 {
@@ -179,6 +192,44 @@ HerderSCPDriver::isSlotCompatibleWithCurrentState(uint64_t slotIndex) const
     return res;
 }
 
+void
+HerderSCPDriver::clearStaleTxSetValidCache() const
+{
+    // the outcome of checkValid only depends on the txSet and on the state
+    // of the last closed ledger, so it can be reused across the many
+    // validateValue calls SCP makes for the same value
+    auto const& lclHash = mLedgerManager.getLastClosedLedgerHeader().hash;
+    if (lclHash != mTxSetValidCacheLCL)
+    {
+        mTxSetValidCache.clear();
+        mTxSetValidCacheLCL = lclHash;
+    }
+}
+
+bool
+HerderSCPDriver::checkTxSetValid(Hash const& txSetHash,
+                                 TxSetFramePtr txSet) const
+{
+    clearStaleTxSetValidCache();
+    if (mTxSetValidCache.exists(txSetHash))
+    {
+        mSCPMetrics.mTxSetValidCacheHit.Mark();
+        return mTxSetValidCache.get(txSetHash);
+    }
+
+    mSCPMetrics.mTxSetValidCacheMiss.Mark();
+    bool res = txSet->checkValid(mApp);
+    mTxSetValidCache.put(txSetHash, res);
+    return res;
+}
+
+void
+HerderSCPDriver::recordTxSetValid(Hash const& txSetHash, bool valid)
+{
+    clearStaleTxSetValidCache();
+    mTxSetValidCache.put(txSetHash, valid);
+}
+
 SCPDriver::ValidationLevel
 HerderSCPDriver::validateValueHelper(uint64_t slotIndex,
                                      StellarValue const& b) const
@@ -285,7 +336,7 @@ HerderSCPDriver::validateValueHelper(uint64_t slotIndex,
 
         res = SCPDriver::kInvalidValue;
     }
-    else if (!txSet->checkValid(mApp))
+    else if (!checkTxSetValid(txSetHash, txSet))
     {
         if (Logging::logDebug("Herder"))
             CLOG(DEBUG, "Herder") << "HerderSCPDriver::validateValue"
@@ -6,6 +6,7 @@
 
 #include "herder/Herder.h"
 #include "herder/TxSetFrame.h"
+#include "lib/util/lrucache.hpp"
 #include "scp/SCPDriver.h"
 #include "xdr/Stellar-ledger.h"
 
@@ -53,6 +54,10 @@ class HerderSCPDriver : public SCPDriver
 
     void syncMetrics();
 
+    // called by Herder when a new ledger got closed: drops cached txSet
+    // validation results as they were computed against the previous ledger
+    void ledgerClosed();
+
     ConsensusData*
     trackingSCP() const
     {
@@ -137,6 +142,13 @@ class HerderSCPDriver : public SCPDriver
 
     optional<VirtualClock::time_point> getPrepareStart(uint64_t slotIndex);
 
+    // returns the (possibly cached) result of txSet->checkValid
+    bool checkTxSetValid(Hash const& txSetHash, TxSetFramePtr txSet) const;
+
+    // caches the result of checkValid for a txSet built on top of the last
+    // closed ledger and validated by the caller
+    void recordTxSetValid(Hash const& txSetHash, bool valid);
+
   private:
     Application& mApp;
     HerderImpl& mHerder;
@@ -156,6 +168,10 @@ class HerderSCPDriver : public SCPDriver
 
         medida::Meter& mValueExternalize;
 
+        // txSet validation cache
+        medida::Meter& mTxSetValidCacheHit;
+        medida::Meter& mTxSetValidCacheMiss;
+
         // listeners
         medida::Meter& mQuorumHeard;
         medida::Meter& mNominatingValue;
@@ -189,6 +205,12 @@ class HerderSCPDriver : public SCPDriver
     // * first prepare to externalize
     std::map<uint64_t, SCPTiming> mSCPExecutionTimes;
 
+    // results of TxSetFrame::checkValid, keyed by txSet hash; only valid
+    // for the last closed ledger identified by mTxSetValidCacheLCL
+    mutable cache::lru_cache<Hash, bool> mTxSetValidCache;
+    mutable Hash mTxSetValidCacheLCL;
+    void clearStaleTxSetValidCache() const;
+
     uint32_t mLedgerSeqNominating;
     Value mCurrentValue;
 
@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "herder/HerderImpl.h"
+#include "herder/HerderPersistence.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "scp/SCP.h"
@@ -23,6 +24,10 @@
 #include "overlay/OverlayManager.h"
 #include "test/TxTests.h"
 
+#include "medida/counter.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include "xdrpp/marshal.h"
 
 using namespace stellar;
@@ -107,6 +112,9 @@ TEST_CASE("standalone", "[herder]")
         REQUIRE(a1.getBalance() == startingBalance);
         REQUIRE(b1.getBalance() == startingBalance);
         REQUIRE(c1.getBalance() == startingBalance);
+        REQUIRE(app->getMetrics()
+                    .NewTimer({"scp", "timing", "trigger-nominate"})
+                    .count() > 0);
 
         SECTION("txset with valid txs - but failing later")
         {
@@ -215,6 +223,51 @@ TEST_CASE("standalone", "[herder]")
     }
 }
 
+TEST_CASE("SCP history written in the background", "[herder]")
+{
+    SIMULATION_CREATE_NODE(0);
+
+    Config cfg(getTestConfig(0, Config::TESTDB_ON_DISK_SQLITE));
+
+    cfg.NODE_SEED = v0SecretKey;
+
+    cfg.QUORUM_SET.threshold = 1;
+    cfg.QUORUM_SET.validators.clear();
+    cfg.QUORUM_SET.validators.push_back(v0NodeID);
+    cfg.BACKGROUND_SCP_HISTORY = true;
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    app->start();
+
+    auto& lm = app->getLedgerManager();
+    auto const last = lm.getLastClosedLedgerNum() + 3;
+    while (lm.getLastClosedLedgerNum() < last)
+    {
+        clock.crank(true);
+    }
+
+    bool written = false;
+    app->getHerderPersistence().whenWritten([&]() { written = true; });
+    while (!written)
+    {
+        clock.crank(true);
+    }
+
+    auto& sess = app->getDatabase().getSession();
+    for (uint32_t seq = last - 2; seq <= last; ++seq)
+    {
+        int n = 0;
+        sess << "SELECT COUNT(*) FROM scphistory WHERE ledgerseq = :s",
+            soci::into(n), soci::use(seq);
+        REQUIRE(n == 1);
+    }
+    REQUIRE(app->getMetrics()
+                .NewCounter({"scp", "history", "queued"})
+                .count() == 0);
+}
+
 TEST_CASE("txset", "[herder]")
 {
     Config cfg(getTestConfig());
@@ -358,6 +411,131 @@ TEST_CASE("txset", "[herder]")
     }
 }
 
+TEST_CASE("txset candidate", "[herder]")
+{
+    SIMULATION_CREATE_NODE(0);
+
+    Config cfg(getTestConfig());
+
+    cfg.NODE_SEED = v0SecretKey;
+
+    cfg.QUORUM_SET.threshold = 1;
+    cfg.QUORUM_SET.validators.clear();
+    cfg.QUORUM_SET.validators.push_back(v0NodeID);
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    app->start();
+
+    auto& herder = static_cast<HerderImpl&>(app->getHerder());
+    auto& lm = app->getLedgerManager();
+    auto closeNextLedger = [&]() {
+        auto target = lm.getLastClosedLedgerNum() + 1;
+        while (lm.getLastClosedLedgerNum() < target)
+        {
+            clock.crank(true);
+        }
+    };
+
+    // rebuilt when a ledger closes
+    closeNextLedger();
+    auto candidate = herder.getTxSetCandidate();
+    REQUIRE(candidate);
+    REQUIRE(candidate->previousLedgerHash() ==
+            lm.getLastClosedLedgerHeader().hash);
+    REQUIRE(candidate->size() == 0);
+
+    // extended by the transactions received
+    auto root = TestAccount::createRoot(*app);
+    auto minBalance = lm.getLastMinBalance(0);
+    auto tx1 = root.tx({createAccount(getAccount("A").getPublicKey(),
+                                      minBalance)});
+    auto tx2 = root.tx({createAccount(getAccount("B").getPublicKey(),
+                                      minBalance)});
+    REQUIRE(herder.recvTransaction(tx1) == Herder::TX_STATUS_PENDING);
+    REQUIRE(herder.recvTransaction(tx2) == Herder::TX_STATUS_PENDING);
+    candidate = herder.getTxSetCandidate();
+    REQUIRE(candidate->size() == 2);
+    REQUIRE(std::find(candidate->mTransactions.begin(),
+                      candidate->mTransactions.end(),
+                      tx1) != candidate->mTransactions.end());
+    REQUIRE(std::find(candidate->mTransactions.begin(),
+                      candidate->mTransactions.end(),
+                      tx2) != candidate->mTransactions.end());
+    REQUIRE(candidate->checkValid(*app));
+
+    // recorded as valid as it was extended, so that checking it when it is
+    // nominated does not validate it again
+    auto& misses = app->getMetrics().NewMeter(
+        {"scp", "txset-valid-cache", "miss"}, "txset");
+    auto missesBefore = misses.count();
+    REQUIRE(herder.getHerderSCPDriver().checkTxSetValid(
+        candidate->getContentsHash(), candidate));
+    REQUIRE(misses.count() == missesBefore);
+
+    // rebuilt without the transactions once a ledger applied them
+    while (root.loadSequenceNumber() < tx2->getSeqNum())
+    {
+        closeNextLedger();
+    }
+    candidate = herder.getTxSetCandidate();
+    REQUIRE(candidate->previousLedgerHash() ==
+            lm.getLastClosedLedgerHeader().hash);
+    REQUIRE(candidate->size() == 0);
+}
+
+TEST_CASE("txset parallel validation", "[herder]")
+{
+    Config cfg(getTestConfig());
+    cfg.PARALLEL_TX_SET_VALIDATION = true;
+
+    VirtualClock clock;
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    const int64_t paymentAmount = app->getLedgerManager().getLastMinBalance(0);
+    auto txfee = app->getLedgerManager().getLastTxFee();
+
+    const int nbAccounts = 10;
+    const int nbTransactions = 3;
+
+    TxSetFramePtr txSet = std::make_shared<TxSetFrame>(
+        app->getLedgerManager().getLastClosedLedgerHeader().hash);
+
+    std::vector<TestAccount> accounts;
+    for (int i = 0; i < nbAccounts; i++)
+    {
+        accounts.emplace_back(root.create(
+            "A" + std::to_string(i),
+            paymentAmount + nbTransactions * (paymentAmount + txfee)));
+        for (int j = 0; j < nbTransactions; j++)
+        {
+            txSet->add(accounts.back().tx({payment(root, paymentAmount)}));
+        }
+    }
+    txSet->sortForHash();
+    REQUIRE(txSet->checkValid(*app));
+
+    SECTION("bad signature")
+    {
+        auto tx = accounts[0].tx({payment(root, paymentAmount)});
+        tx->getEnvelope().signatures.clear();
+        tx->addSignature(getAccount("not-a-signer"));
+        txSet->add(tx);
+        txSet->sortForHash();
+        REQUIRE(!txSet->checkValid(*app));
+
+        std::vector<TransactionFramePtr> removed;
+        txSet->trimInvalid(*app, removed);
+        REQUIRE(removed.size() == 1);
+        REQUIRE(removed[0] == tx);
+        REQUIRE(txSet->checkValid(*app));
+    }
+}
+
 // under surge
 // over surge
 // make sure it drops the correct txs
@@ -598,6 +776,84 @@ TEST_CASE("SCP Driver", "[herder]")
         REQUIRE(sv.txSetHash == txSet1->getContentsHash());
     }
 
+    SECTION("validateValue caches txSet validity")
+    {
+        auto& herder = static_cast<HerderImpl&>(app->getHerder());
+        auto& hits = app->getMetrics().NewMeter(
+            {"scp", "txset-valid-cache", "hit"}, "txset");
+        auto& misses = app->getMetrics().NewMeter(
+            {"scp", "txset-valid-cache", "miss"}, "txset");
+
+        TxSetFramePtr txSet = makeTransactions(lcl.hash, 0);
+        auto p = makeTxPair(txSet, lcl.header.scpValue.closeTime + 1);
+        auto envelope = makeEnvelope(p, {}, herder.getCurrentLedgerSeq());
+        REQUIRE(herder.recvSCPEnvelope(envelope) ==
+                Herder::ENVELOPE_STATUS_FETCHING);
+        REQUIRE(herder.recvTxSet(p.second->getContentsHash(), *p.second));
+
+        auto slotIndex = lcl.header.ledgerSeq + 1;
+        auto hits0 = hits.count();
+        auto misses0 = misses.count();
+        auto& driver = herder.getHerderSCPDriver();
+        for (int i = 0; i < 3; i++)
+        {
+            REQUIRE(driver.validateValue(slotIndex, p.first, false) ==
+                    SCPDriver::kFullyValidatedValue);
+        }
+        REQUIRE(misses.count() == misses0 + 1);
+        REQUIRE(hits.count() == hits0 + 2);
+
+        driver.ledgerClosed();
+        REQUIRE(driver.validateValue(slotIndex, p.first, false) ==
+                SCPDriver::kFullyValidatedValue);
+        REQUIRE(misses.count() == misses0 + 2);
+    }
+
+    SECTION("queued envelopes get their signature checked")
+    {
+        auto& herder = static_cast<HerderImpl&>(app->getHerder());
+        auto& verified =
+            app->getMetrics().NewTimer({"scp", "envelope", "verify-sig"});
+        auto& dropped = app->getMetrics().NewMeter(
+            {"scp", "envelope", "dropped-invalidsig"}, "envelope");
+        auto& received = app->getMetrics().NewMeter(
+            {"scp", "envelope", "receive"}, "envelope");
+
+        auto p = makeTxPair(makeTransactions(lcl.hash, 0), 10);
+        auto envelope = makeEnvelope(p, {}, herder.getCurrentLedgerSeq());
+        envelope.statement.nodeID = root.getPublicKey();
+        envelope.signature = root.getSecretKey().sign(xdr::xdr_to_opaque(
+            app->getNetworkID(), ENVELOPE_TYPE_SCP, envelope.statement));
+        auto badEnvelope = envelope;
+        badEnvelope.statement.slotIndex++;
+
+        auto& processed =
+            app->getMetrics().NewTimer({"overlay", "recv", "scp-prepare"});
+        auto received0 = received.count();
+        auto processed0 = processed.count();
+
+        // outside of the validity bracket: dropped before any check
+        auto outOfRange = envelope;
+        outOfRange.statement.slotIndex = 0;
+        herder.queueSCPEnvelope(outOfRange, processed);
+        REQUIRE(verified.count() == 0);
+
+        // the copy is not checked again, and the envelopes of a node are
+        // passed on in the order they arrived: the bad one is dropped before
+        // the good one is processed
+        herder.queueSCPEnvelope(badEnvelope, processed);
+        herder.queueSCPEnvelope(envelope, processed);
+        herder.queueSCPEnvelope(envelope, processed);
+        while (processed.count() < processed0 + 1)
+        {
+            clock.crank(true);
+        }
+
+        REQUIRE(verified.count() == 2);
+        REQUIRE(dropped.count() == 1);
+        REQUIRE(received.count() >= received0 + 1);
+    }
+
     SECTION("accept qset and txset")
     {
         auto makePublicKey = [](int i) {
@@ -7,6 +7,7 @@
 #include "main/Application.h"
 #include "main/Config.h"
 #include "scp/QuorumSetUtils.h"
+#include "util/HashOfHash.h"
 #include "util/Logging.h"
 #include <overlay/OverlayManager.h>
 #include <scp/Slot.h>
@@ -21,6 +22,13 @@ using namespace std;
 namespace stellar
 {
 
+size_t
+SCPEnvelopeHash::operator()(SCPEnvelope const& envelope) const
+{
+    auto bytes = xdr::xdr_to_opaque(envelope);
+    return shortHash(bytes.data(), bytes.size());
+}
+
 PendingEnvelopes::PendingEnvelopes(Application& app, HerderImpl& herder)
     : mApp(app)
     , mHerder(herder)
@@ -191,8 +199,7 @@ PendingEnvelopes::recvSCPEnvelope(SCPEnvelope const& envelope)
 
         if (fetching == set.end())
         { // we aren't fetching this envelope
-            if (find(processedList.begin(), processedList.end(), envelope) ==
-                processedList.end())
+            if (processedList.find(envelope) == processedList.end())
             { // we haven't seen this envelope before
                 // insert it into the fetching set
                 fetching = set.insert(envelope).first;
@@ -210,7 +217,7 @@ PendingEnvelopes::recvSCPEnvelope(SCPEnvelope const& envelope)
         if (isFullyFetched(envelope))
         {
             // move the item from fetching to processed
-            processedList.emplace_back(*fetching);
+            processedList.emplace(*fetching);
             set.erase(fetching);
             envelopeReady(envelope);
             return Herder::ENVELOPE_STATUS_READY;
@@ -227,6 +234,20 @@ PendingEnvelopes::recvSCPEnvelope(SCPEnvelope const& envelope)
     }
 }
 
+bool
+PendingEnvelopes::isKnown(SCPEnvelope const& envelope) const
+{
+    auto it = mEnvelopes.find(envelope.statement.slotIndex);
+    if (it == mEnvelopes.end())
+    {
+        return false;
+    }
+    auto const& slot = it->second;
+    return slot.mFetchingEnvelopes.count(envelope) != 0 ||
+           slot.mDiscardedEnvelopes.count(envelope) != 0 ||
+           slot.mProcessedEnvelopes.count(envelope) != 0;
+}
+
 void
 PendingEnvelopes::discardSCPEnvelope(SCPEnvelope const& envelope)
 {
@@ -9,6 +9,7 @@
 #include <medida/medida.h>
 #include <queue>
 #include <set>
+#include <unordered_set>
 #include <util/optional.h>
 
 /*
@@ -21,10 +22,16 @@ namespace stellar
 
 class HerderImpl;
 
+// hashes the XDR of an envelope with shortHash
+struct SCPEnvelopeHash
+{
+    size_t operator()(SCPEnvelope const& envelope) const;
+};
+
 struct SlotEnvelopes
 {
-    // list of envelopes we have processed already
-    std::vector<SCPEnvelope> mProcessedEnvelopes;
+    // envelopes we have processed already
+    std::unordered_set<SCPEnvelope, SCPEnvelopeHash> mProcessedEnvelopes;
     // list of envelopes we have discarded already
     std::set<SCPEnvelope> mDiscardedEnvelopes;
     // list of envelopes we are fetching right now
@@ -74,6 +81,12 @@ class PendingEnvelopes
      */
     Herder::EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope);
 
+    /**
+     * Return true if @p envelope was received already (it is being fetched,
+     * was processed or was discarded).
+     */
+    bool isKnown(SCPEnvelope const& envelope) const;
+
     /**
      * Add @p qset identified by @p hash to local cache. Notifies
      * @see ItemFetcher about that event - it may cause calls to Herder's
@@ -5,7 +5,10 @@
 #include "util/asio.h"
 #include "TxSetFrame.h"
 #include "crypto/Hex.h"
+#include "crypto/KeyUtils.h"
 #include "crypto/SHA.h"
+#include "crypto/SecretKey.h"
+#include "crypto/SignerKey.h"
 #include "database/Database.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerState.h"
@@ -13,11 +16,14 @@
 #include "ledger/LedgerStateHeader.h"
 #include "main/Application.h"
 #include "main/Config.h"
+#include "transactions/SignatureUtils.h"
 #include "transactions/TransactionUtils.h"
 #include "util/Logging.h"
+#include "util/WorkerPool.h"
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
 #include <algorithm>
+#include <unordered_map>
 
 #include "xdrpp/printer.h"
 
@@ -194,6 +200,114 @@ TxSetFrame::surgePricingFilter(Application& app)
     }
 }
 
+namespace
+{
+// signatures of a transaction together with the ed25519 keys that may have
+// produced them
+struct SignatureBatch
+{
+    Hash mContentsHash;
+    xdr::xvector<DecoratedSignature, 20> mSignatures;
+    std::vector<SignerKey> mKeys;
+};
+
+void
+verifySignatureBatches(std::vector<SignatureBatch> const& batches, size_t begin,
+                       size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        auto const& batch = batches[i];
+        for (auto const& sig : batch.mSignatures)
+        {
+            for (auto const& key : batch.mKeys)
+            {
+                if (SignatureUtils::verify(sig, key, batch.mContentsHash))
+                {
+                    break;
+                }
+            }
+        }
+    }
+}
+}
+
+// Verifies the signatures of all transactions on the worker pool and the
+// calling thread. This only warms the process-wide signature verification
+// cache: the serial validation that follows stays the sole source of truth (so
+// results are deterministic) but only pays for cache lookups.
+static void
+preverifySignatures(
+    Application& app, AbstractLedgerState& ls,
+    unordered_map<AccountID, vector<TransactionFramePtr>> const& accountTxMap)
+{
+    // ed25519 signers for each account involved, loaded on the main thread
+    // as LedgerState is not thread safe
+    unordered_map<AccountID, std::vector<SignerKey>> accountKeys;
+    auto getKeys =
+        [&](AccountID const& accountID) -> std::vector<SignerKey> const& {
+        auto it = accountKeys.find(accountID);
+        if (it != accountKeys.end())
+        {
+            return it->second;
+        }
+
+        std::vector<SignerKey> keys;
+        keys.emplace_back(KeyUtils::convertKey<SignerKey>(accountID));
+        auto account = stellar::loadAccountWithoutRecord(ls, accountID);
+        if (account)
+        {
+            for (auto const& signer : account.current().data.account().signers)
+            {
+                if (signer.key.type() == SIGNER_KEY_TYPE_ED25519)
+                {
+                    keys.emplace_back(signer.key);
+                }
+            }
+        }
+        return accountKeys.emplace(accountID, keys).first->second;
+    };
+
+    std::vector<SignatureBatch> batches;
+    for (auto const& item : accountTxMap)
+    {
+        for (auto const& tx : item.second)
+        {
+            SignatureBatch batch;
+            batch.mContentsHash = tx->getContentsHash();
+            batch.mSignatures = tx->getEnvelope().signatures;
+            batch.mKeys = getKeys(tx->getSourceID());
+            for (auto const& op : tx->getOperations())
+            {
+                if (!(op->getSourceID() == tx->getSourceID()))
+                {
+                    auto const& opKeys = getKeys(op->getSourceID());
+                    batch.mKeys.insert(batch.mKeys.end(), opKeys.begin(),
+                                       opKeys.end());
+                }
+            }
+            batches.emplace_back(std::move(batch));
+        }
+    }
+
+    // the calling thread takes its share, so nothing waits for a worker that
+    // is busy elsewhere (or missing)
+    auto& pool = app.getWorkerPool();
+    size_t workers = std::max<size_t>(
+        1, std::min(pool.getThreadCount() + 1, batches.size()));
+    size_t chunk = (batches.size() + workers - 1) / workers;
+
+    std::vector<std::function<void()>> tasks;
+    for (size_t begin = 0; begin < batches.size(); begin += chunk)
+    {
+        size_t end = std::min(begin + chunk, batches.size());
+        tasks.emplace_back([&batches, begin, end]() {
+            verifySignatureBatches(batches, begin, end);
+        });
+    }
+    pool.run(std::move(tasks));
+}
+
 bool
 TxSetFrame::checkOrTrim(
     Application& app,
@@ -204,7 +318,8 @@ TxSetFrame::checkOrTrim(
 {
     LedgerState ls(app.getLedgerStateRoot());
 
-    map<AccountID, vector<TransactionFramePtr>> accountTxMap;
+    // accounts are checked independently of each other, in no particular order
+    unordered_map<AccountID, vector<TransactionFramePtr>> accountTxMap;
 
     Hash lastHash;
     for (auto& tx : mTransactions)
@@ -220,6 +335,11 @@ TxSetFrame::checkOrTrim(
         lastHash = tx->getFullHash();
     }
 
+    if (app.getConfig().PARALLEL_TX_SET_VALIDATION)
+    {
+        preverifySignatures(app, ls, accountTxMap);
+    }
+
     for (auto& item : accountTxMap)
     {
         // order by sequence number
@@ -339,7 +339,9 @@ Upgrades::dropAll(Database& db)
                        "upgrade      TEXT NOT NULL, "
                        "changes      TEXT NOT NULL, "
                        "PRIMARY KEY (ledgerseq, upgradeindex)"
-                       ")";
+                       ")"
+                    << DatabaseUtils::historyPartitionClause(db);
+    DatabaseUtils::createHistoryPartitions(db, "upgradehistory");
     db.getSession()
         << "CREATE INDEX upgradehistbyseq ON upgradehistory (ledgerseq);";
 }
@@ -4,6 +4,7 @@
 
 #include "historywork/WriteSnapshotWork.h"
 #include "database/Database.h"
+#include "herder/HerderPersistence.h"
 #include "history/StateSnapshot.h"
 #include "historywork/Progress.h"
 #include "main/Application.h"
@@ -38,16 +39,21 @@ WriteSnapshotWork::onStart()
         snap->mApp.postOnMainThread([handler, ec]() { handler(ec); });
     };
 
-    // Throw the work over to a worker thread if we can use DB pools,
-    // otherwise run on main thread.
-    if (mApp.getDatabase().canUsePool())
-    {
-        mApp.postOnBackgroundThread(work);
-    }
-    else
-    {
-        work();
-    }
+    // The SCP messages of the last ledgers may still be queued to be written
+    // by a worker thread: only take the snapshot once they are in the
+    // database. Then throw the work over to a worker thread if we can use DB
+    // pools, otherwise run on main thread.
+    auto& app = mApp;
+    mApp.getHerderPersistence().whenWritten([&app, work]() {
+        if (app.getDatabase().canUsePool())
+        {
+            app.postOnBackgroundThread(work);
+        }
+        else
+        {
+            work();
+        }
+    });
 }
 
 void
@@ -5,57 +5,99 @@
 #include "invariant/BucketListIsConsistentWithDatabase.h"
 #include "bucket/Bucket.h"
 #include "bucket/BucketInputIterator.h"
+#include "bucket/LedgerCmp.h"
 #include "crypto/Hex.h"
 #include "invariant/InvariantManager.h"
 #include "ledger/LedgerRange.h"
 #include "ledger/LedgerState.h"
-#include "ledger/LedgerStateEntry.h"
 #include "lib/util/format.h"
 #include "main/Application.h"
+#include "util/WorkerPool.h"
 #include "xdrpp/printer.h"
+#include <algorithm>
+#include <deque>
+#include <map>
 
 namespace stellar
 {
 
-static std::string
-checkAgainstDatabase(AbstractLedgerState& ls, LedgerEntry const& entry)
+// number of rows scanned from the database before they are handed to a worker
+// thread to be compared with the bucket
+static size_t const CHUNK_SIZE = 4096;
+
+// most LIVEENTRYs held in memory at once: the ledger range of a bucket with
+// more is split in windows of at most that many entries of a type (unless a
+// single ledger modified more), each compared with its own range scan
+static size_t const WINDOW_SIZE = 1 << 18;
+
+static LedgerEntryType const ENTRY_TYPES[] = {ACCOUNT, TRUSTLINE, OFFER, DATA};
+
+static bool
+entryIdLess(LedgerEntry const& lhs, LedgerEntry const& rhs)
 {
-    auto fromDb = ls.loadWithoutRecord(LedgerEntryKey(entry));
-    if (!fromDb)
-    {
-        std::string s{
-            "Inconsistent state between objects (not found in database): "};
-        s += xdr::xdr_to_string(entry, "live");
-        return s;
-    }
+    return LedgerEntryIdCmp{}(lhs.data, rhs.data);
+}
 
-    if (fromDb.current() == entry)
-    {
-        return {};
-    }
-    else
+// Checks that every entry of fromDb is identical to the entry with the same
+// key in live, which is sorted by key. This is called on worker threads.
+static std::string
+checkAgainstBucket(std::vector<LedgerEntry> const& live,
+                   std::vector<LedgerEntry> const& fromDb)
+{
+    for (auto const& entry : fromDb)
     {
-        std::string s{"Inconsistent state between objects: "};
-        s += xdr::xdr_to_string(fromDb.current(), "db");
-        s += xdr::xdr_to_string(entry, "live");
-        return s;
+        auto iter =
+            std::lower_bound(live.begin(), live.end(), entry, entryIdLess);
+        if (iter == live.end() || entryIdLess(entry, *iter))
+        {
+            std::string s{
+                "Inconsistent state between objects (not found in bucket): "};
+            s += xdr::xdr_to_string(entry, "db");
+            return s;
+        }
+        if (!(*iter == entry))
+        {
+            std::string s{"Inconsistent state between objects: "};
+            s += xdr::xdr_to_string(entry, "db");
+            s += xdr::xdr_to_string(*iter, "live");
+            return s;
+        }
     }
+    return {};
 }
 
 static std::string
-checkAgainstDatabase(AbstractLedgerState& ls, LedgerKey const& key)
+checkAgainstDatabase(LedgerStateRoot& lsRoot, LedgerKey const& key)
 {
-    auto fromDb = ls.loadWithoutRecord(key);
+    auto fromDb = lsRoot.getNewestVersion(key);
     if (!fromDb)
     {
         return {};
     }
 
     std::string s = "Entry with type DEADENTRY found in database ";
-    s += xdr::xdr_to_string(fromDb.current(), "db");
+    s += xdr::xdr_to_string(*fromDb, "db");
     return s;
 }
 
+static std::string
+entryTypeName(LedgerEntryType let)
+{
+    switch (let)
+    {
+    case ACCOUNT:
+        return "Account";
+    case TRUSTLINE:
+        return "TrustLine";
+    case OFFER:
+        return "Offer";
+    case DATA:
+        return "Data";
+    default:
+        abort();
+    }
+}
+
 std::shared_ptr<Invariant>
 BucketListIsConsistentWithDatabase::registerInvariant(Application& app)
 {
@@ -75,110 +117,202 @@ BucketListIsConsistentWithDatabase::getName() const
     return "BucketListIsConsistentWithDatabase";
 }
 
+// returns the LIVEENTRYs of type let last modified in the given range
+static std::vector<LedgerEntry>
+loadLiveEntries(std::shared_ptr<Bucket const> bucket, LedgerEntryType let,
+                LedgerRange const& range)
+{
+    std::vector<LedgerEntry> live;
+    for (BucketInputIterator iter(bucket); iter; ++iter)
+    {
+        auto const& e = *iter;
+        if (e.type() == LIVEENTRY && e.liveEntry().data.type() == let &&
+            e.liveEntry().lastModifiedLedgerSeq >= range.first() &&
+            e.liveEntry().lastModifiedLedgerSeq <= range.last())
+        {
+            live.emplace_back(e.liveEntry());
+        }
+    }
+    return live;
+}
+
+std::string
+BucketListIsConsistentWithDatabase::checkEntriesOfType(
+    LedgerEntryType let, std::vector<LedgerEntry>&& live,
+    LedgerRange const& range)
+{
+    auto sharedLive =
+        std::make_shared<std::vector<LedgerEntry> const>(std::move(live));
+
+    // The session is only used on this thread, rows are decoded here while
+    // the previous chunks are compared on the worker pool. As there is at
+    // most one row per key, if every row in the range matches a LIVEENTRY of
+    // the bucket and there are as many rows as LIVEENTRYs then the bucket and
+    // the database contain the same entries.
+    struct PendingChunk
+    {
+        WorkerPool::TaskPtr task;
+        std::shared_ptr<std::string> result;
+    };
+    auto& pool = mApp.getWorkerPool();
+    // the scan does not get more than this many chunks ahead of the
+    // comparisons, joining a chunk no worker has started compares it here
+    size_t const maxPending = pool.getThreadCount() + 1;
+    std::deque<PendingChunk> pending;
+    std::string res;
+    auto joinOldest = [&pending, &res]() {
+        auto oldest = std::move(pending.front());
+        pending.pop_front();
+        WorkerPool::join(*oldest.task);
+        if (res.empty())
+        {
+            res = std::move(*oldest.result);
+        }
+    };
+
+    uint64_t nInDb = 0;
+    mApp.getLedgerStateRoot().loadObjects(
+        let, range, CHUNK_SIZE, [&](std::vector<LedgerEntry>&& chunk) {
+            nInDb += chunk.size();
+            auto fromDb = std::make_shared<std::vector<LedgerEntry> const>(
+                std::move(chunk));
+            auto result = std::make_shared<std::string>();
+            auto task = pool.post([sharedLive, fromDb, result]() {
+                *result = checkAgainstBucket(*sharedLive, *fromDb);
+            });
+            pending.push_back({task, result});
+            if (pending.size() > maxPending)
+            {
+                joinOldest();
+            }
+        });
+    while (!pending.empty())
+    {
+        joinOldest();
+    }
+
+    if (res.empty() && nInDb != sharedLive->size())
+    {
+        res = fmt::format("Incorrect {} count: Bucket = {} Database = {}",
+                          entryTypeName(let), sharedLive->size(), nInDb);
+    }
+    return res;
+}
+
 std::string
 BucketListIsConsistentWithDatabase::checkOnBucketApply(
     std::shared_ptr<Bucket const> bucket, uint32_t oldestLedger,
     uint32_t newestLedger)
 {
-    uint64_t nAccounts = 0, nTrustLines = 0, nOffers = 0, nData = 0;
+    LedgerRange range{oldestLedger, newestLedger};
+    auto& lsRoot = mApp.getLedgerStateRoot();
+
+    // The first pass over the bucket checks the order of its entries and its
+    // DEADENTRYs, and counts the LIVEENTRYs of each type modified in each
+    // ledger. It also keeps the LIVEENTRYs (sorted by key within each type)
+    // unless there are more than WINDOW_SIZE of them.
+    std::map<LedgerEntryType, std::map<uint32_t, size_t>> counts;
+    std::map<LedgerEntryType, std::vector<LedgerEntry>> live;
+    size_t nLive = 0;
+
+    bool hasPreviousEntry = false;
+    BucketEntry previousEntry;
+    for (BucketInputIterator iter(bucket); iter; ++iter)
     {
-        LedgerState ls(mApp.getLedgerStateRoot());
+        auto const& e = *iter;
+        if (hasPreviousEntry && !BucketEntryIdCmp{}(previousEntry, e))
+        {
+            std::string s = "Bucket has out of order entries: ";
+            s += xdr::xdr_to_string(previousEntry, "previous");
+            s += xdr::xdr_to_string(e, "current");
+            return s;
+        }
+        previousEntry = e;
+        hasPreviousEntry = true;
 
-        bool hasPreviousEntry = false;
-        BucketEntry previousEntry;
-        for (BucketInputIterator iter(bucket); iter; ++iter)
+        if (e.type() == LIVEENTRY)
         {
-            auto const& e = *iter;
-            if (hasPreviousEntry && !BucketEntryIdCmp{}(previousEntry, e))
+            if (e.liveEntry().lastModifiedLedgerSeq < oldestLedger)
             {
-                std::string s = "Bucket has out of order entries: ";
-                s += xdr::xdr_to_string(previousEntry, "previous");
-                s += xdr::xdr_to_string(e, "current");
+                auto s = fmt::format("lastModifiedLedgerSeq beneath lower"
+                                     " bound for this bucket ({} < {}): ",
+                                     e.liveEntry().lastModifiedLedgerSeq,
+                                     oldestLedger);
+                s += xdr::xdr_to_string(e.liveEntry(), "live");
+                return s;
+            }
+            if (e.liveEntry().lastModifiedLedgerSeq > newestLedger)
+            {
+                auto s = fmt::format("lastModifiedLedgerSeq above upper"
+                                     " bound for this bucket ({} > {}): ",
+                                     e.liveEntry().lastModifiedLedgerSeq,
+                                     newestLedger);
+                s += xdr::xdr_to_string(e.liveEntry(), "live");
                 return s;
             }
-            previousEntry = e;
-            hasPreviousEntry = true;
 
-            if (e.type() == LIVEENTRY)
+            auto let = e.liveEntry().data.type();
+            ++counts[let][e.liveEntry().lastModifiedLedgerSeq];
+            if (++nLive <= WINDOW_SIZE)
             {
-                if (e.liveEntry().lastModifiedLedgerSeq < oldestLedger)
-                {
-                    auto s = fmt::format("lastModifiedLedgerSeq beneath lower"
-                                         " bound for this bucket ({} < {}): ",
-                                         e.liveEntry().lastModifiedLedgerSeq,
-                                         oldestLedger);
-                    s += xdr::xdr_to_string(e.liveEntry(), "live");
-                    return s;
-                }
-                if (e.liveEntry().lastModifiedLedgerSeq > newestLedger)
-                {
-                    auto s = fmt::format("lastModifiedLedgerSeq above upper"
-                                         " bound for this bucket ({} > {}): ",
-                                         e.liveEntry().lastModifiedLedgerSeq,
-                                         newestLedger);
-                    s += xdr::xdr_to_string(e.liveEntry(), "live");
-                    return s;
-                }
+                live[let].emplace_back(e.liveEntry());
+            }
+            else if (!live.empty())
+            {
+                live.clear();
+            }
+        }
+        else if (e.type() == DEADENTRY)
+        {
+            auto s = checkAgainstDatabase(lsRoot, e.deadEntry());
+            if (!s.empty())
+            {
+                return s;
+            }
+        }
+    }
 
-                switch (e.liveEntry().data.type())
-                {
-                case ACCOUNT:
-                    ++nAccounts;
-                    break;
-                case TRUSTLINE:
-                    ++nTrustLines;
-                    break;
-                case OFFER:
-                    ++nOffers;
-                    break;
-                case DATA:
-                    ++nData;
-                    break;
-                default:
-                    abort();
-                }
-                auto s = checkAgainstDatabase(ls, e.liveEntry());
-                if (!s.empty())
-                {
-                    return s;
-                }
+    for (auto let : ENTRY_TYPES)
+    {
+        if (nLive <= WINDOW_SIZE)
+        {
+            auto s = checkEntriesOfType(let, std::move(live[let]), range);
+            if (!s.empty())
+            {
+                return s;
             }
-            else if (e.type() == DEADENTRY)
+            continue;
+        }
+
+        // the windows cover the whole range so that the rows of the database
+        // outside of the ledgers of the LIVEENTRYs are scanned as well
+        uint32_t first = oldestLedger;
+        size_t inWindow = 0;
+        auto checkWindow = [&](uint32_t last) {
+            LedgerRange window{first, last};
+            return checkEntriesOfType(
+                let, loadLiveEntries(bucket, let, window), window);
+        };
+        for (auto const& kv : counts[let])
+        {
+            if (inWindow != 0 && inWindow + kv.second > WINDOW_SIZE)
             {
-                auto s = checkAgainstDatabase(ls, e.deadEntry());
+                auto s = checkWindow(kv.first - 1);
                 if (!s.empty())
                 {
                     return s;
                 }
+                first = kv.first;
+                inWindow = 0;
             }
+            inWindow += kv.second;
+        }
+        auto s = checkWindow(newestLedger);
+        if (!s.empty())
+        {
+            return s;
         }
     }
-
-    LedgerRange range{oldestLedger, newestLedger};
-    std::string countFormat = "Incorrect {} count: Bucket = {} Database = {}";
-    auto& lsRoot = mApp.getLedgerStateRoot();
-    uint64_t nAccountsInDb = lsRoot.countObjects(ACCOUNT, range);
-    if (nAccountsInDb != nAccounts)
-    {
-        return fmt::format(countFormat, "Account", nAccounts, nAccountsInDb);
-    }
-    uint64_t nTrustLinesInDb = lsRoot.countObjects(TRUSTLINE, range);
-    if (nTrustLinesInDb != nTrustLines)
-    {
-        return fmt::format(countFormat, "TrustLine", nTrustLines,
-                           nTrustLinesInDb);
-    }
-    uint64_t nOffersInDb = lsRoot.countObjects(OFFER, range);
-    if (nOffersInDb != nOffers)
-    {
-        return fmt::format(countFormat, "Offer", nOffers, nOffersInDb);
-    }
-    uint64_t nDataInDb = lsRoot.countObjects(DATA, range);
-    if (nDataInDb != nData)
-    {
-        return fmt::format(countFormat, "Data", nData, nDataInDb);
-    }
-
     return {};
 }
 }
@@ -5,11 +5,14 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "invariant/Invariant.h"
+#include "xdr/Stellar-ledger-entries.h"
+#include <vector>
 
 namespace stellar
 {
 
 class Application;
+class LedgerRange;
 
 // This Invariant is used to validate that the BucketList and Database are
 // in a consistent state after a bucket apply, such as during catchup-minimal.
@@ -24,6 +27,13 @@ class Application;
 // database, while the third condition shows that the database does not
 // contain any entry in the appropriate ledger range other than those in
 // the bucket.
+//
+// Rather than loading the entries of the bucket one by one, the rows of each
+// table in the appropriate ledger range are scanned in chunks and every chunk
+// is compared with the (sorted) LIVEENTRYs of the bucket on the worker pool.
+// Only DEADENTRYs are still looked up individually. To bound the memory used
+// by large buckets, the range is split in windows of ledgers and the bucket
+// is read again for the LIVEENTRYs of each window.
 class BucketListIsConsistentWithDatabase : public Invariant
 {
   public:
@@ -39,5 +49,9 @@ class BucketListIsConsistentWithDatabase : public Invariant
 
   private:
     Application& mApp;
+
+    std::string checkEntriesOfType(LedgerEntryType let,
+                                   std::vector<LedgerEntry>&& live,
+                                   LedgerRange const& range);
 };
 }
@@ -44,6 +44,11 @@ class InvariantManager
                                        OperationResult const& opres,
                                        LedgerStateDelta const& lsDelta) = 0;
 
+    // When DEFERRED_INVARIANT_CHECKS is set, checkOnOperationApply only starts
+    // the checks. joinOperationChecks waits for all the checks that were
+    // started and reports their failures (in the order of the operations).
+    virtual void joinOperationChecks() = 0;
+
     virtual void registerInvariant(std::shared_ptr<Invariant> invariant) = 0;
 
     virtual void enableInvariant(std::string const& name) = 0;
@@ -12,11 +12,14 @@
 #include "ledger/LedgerState.h"
 #include "lib/util/format.h"
 #include "main/Application.h"
+#include "main/Config.h"
 #include "util/Logging.h"
+#include "util/WorkerPool.h"
 #include "xdrpp/printer.h"
 
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
 #include <memory>
 #include <numeric>
@@ -28,11 +31,15 @@ namespace stellar
 std::unique_ptr<InvariantManager>
 InvariantManager::create(Application& app)
 {
-    return std::make_unique<InvariantManagerImpl>(app.getMetrics());
+    return std::make_unique<InvariantManagerImpl>(app);
 }
 
-InvariantManagerImpl::InvariantManagerImpl(medida::MetricsRegistry& registry)
-    : mMetricsRegistry(registry)
+InvariantManagerImpl::InvariantManagerImpl(Application& app)
+    : mApp(app)
+    , mMetricsRegistry(app.getMetrics())
+    , mJoinOperationChecks(app.getMetrics().NewTimer(
+          {"invariant", "operation", "join"}))
+    , mDeferOperationChecks(app.getConfig().DEFERRED_INVARIANT_CHECKS)
 {
 }
 
@@ -96,6 +103,30 @@ InvariantManagerImpl::checkOnBucketApply(std::shared_ptr<Bucket const> bucket,
     }
 }
 
+InvariantManagerImpl::OperationCheckFailures
+InvariantManagerImpl::checkOperation(
+    std::vector<std::shared_ptr<Invariant>> const& invariants,
+    Operation const& operation, OperationResult const& opres,
+    LedgerStateDelta const& lsDelta)
+{
+    OperationCheckFailures failures;
+    for (auto const& invariant : invariants)
+    {
+        auto result =
+            invariant->checkOnOperationApply(operation, opres, lsDelta);
+        if (result.empty())
+        {
+            continue;
+        }
+
+        auto message = fmt::format(
+            R"(Invariant "{}" does not hold on operation: {}{}{})",
+            invariant->getName(), result, "\n", xdr::xdr_to_string(operation));
+        failures.emplace_back(invariant, message);
+    }
+    return failures;
+}
+
 void
 InvariantManagerImpl::checkOnOperationApply(Operation const& operation,
                                             OperationResult const& opres,
@@ -106,20 +137,65 @@ InvariantManagerImpl::checkOnOperationApply(Operation const& operation,
         return;
     }
 
-    for (auto invariant : mEnabled)
+    uint32_t ledger = lsDelta.header.current.ledgerSeq;
+    if (!mDeferOperationChecks)
     {
-        auto result =
-            invariant->checkOnOperationApply(operation, opres, lsDelta);
-        if (result.empty())
+        for (auto const& failure :
+             checkOperation(mEnabled, operation, opres, lsDelta))
         {
-            continue;
+            onInvariantFailure(failure.first, failure.second, ledger);
         }
+        return;
+    }
 
-        auto message = fmt::format(
-            R"(Invariant "{}" does not hold on operation: {}{}{})",
-            invariant->getName(), result, "\n", xdr::xdr_to_string(operation));
-        onInvariantFailure(invariant, message,
-                           lsDelta.header.current.ledgerSeq);
+    // The entries of the delta are not modified once the LedgerState that
+    // produced it is sealed, so sharing them with a worker thread is safe.
+    // The task owns everything it uses (the operation and its result may not
+    // outlive the transaction), so it does not depend on this object. Checks
+    // the pool has no room or no thread for are run by joinOperationChecks.
+    auto failures = std::make_shared<OperationCheckFailures>();
+    auto task = mApp.getWorkerPool().post(
+        [invariants = mEnabled, operation, opres, lsDelta, failures]() {
+            *failures = checkOperation(invariants, operation, opres, lsDelta);
+        });
+    mPendingOperationChecks.push_back({ledger, task, failures});
+}
+
+void
+InvariantManagerImpl::joinOperationChecks()
+{
+    auto timer = mJoinOperationChecks.TimeScope();
+    std::vector<PendingOperationCheck> pending;
+    pending.swap(mPendingOperationChecks);
+
+    // wait for every check before reporting any failure, so that none is left
+    // running if a strict invariant throws
+    std::exception_ptr error;
+    for (auto& p : pending)
+    {
+        try
+        {
+            WorkerPool::join(*p.task);
+        }
+        catch (...)
+        {
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    for (auto const& p : pending)
+    {
+        for (auto const& failure : *p.failures)
+        {
+            onInvariantFailure(failure.first, failure.second, p.ledger);
+        }
     }
 }
 
@@ -5,12 +5,14 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "invariant/InvariantManager.h"
+#include "util/WorkerPool.h"
 #include <map>
 #include <vector>
 
 namespace medida
 {
 class MetricsRegistry;
+class Timer;
 }
 
 namespace stellar
@@ -18,9 +20,31 @@ namespace stellar
 
 class InvariantManagerImpl : public InvariantManager
 {
+    Application& mApp;
     std::map<std::string, std::shared_ptr<Invariant>> mInvariants;
     std::vector<std::shared_ptr<Invariant>> mEnabled;
     medida::MetricsRegistry& mMetricsRegistry;
+    medida::Timer& mJoinOperationChecks;
+    bool const mDeferOperationChecks;
+
+    // invariants that do not hold on an operation, with their message
+    typedef std::vector<std::pair<std::shared_ptr<Invariant>, std::string>>
+        OperationCheckFailures;
+
+    // checks posted to the worker pool, in the order of the operations; the
+    // failures are filled in by the task
+    struct PendingOperationCheck
+    {
+        uint32_t ledger;
+        WorkerPool::TaskPtr task;
+        std::shared_ptr<OperationCheckFailures> failures;
+    };
+    std::vector<PendingOperationCheck> mPendingOperationChecks;
+
+    static OperationCheckFailures
+    checkOperation(std::vector<std::shared_ptr<Invariant>> const& invariants,
+                   Operation const& operation, OperationResult const& opres,
+                   LedgerStateDelta const& lsDelta);
 
     struct InvariantFailureInformation
     {
@@ -30,7 +54,7 @@ class InvariantManagerImpl : public InvariantManager
     std::map<std::string, InvariantFailureInformation> mFailureInformation;
 
   public:
-    InvariantManagerImpl(medida::MetricsRegistry& registry);
+    InvariantManagerImpl(Application& app);
 
     virtual Json::Value getJsonInfo() override;
 
@@ -41,6 +65,8 @@ class InvariantManagerImpl : public InvariantManager
                           OperationResult const& opres,
                           LedgerStateDelta const& lsDelta) override;
 
+    virtual void joinOperationChecks() override;
+
     virtual void checkOnBucketApply(std::shared_ptr<Bucket const> bucket,
                                     uint32_t ledger, uint32_t level,
                                     bool isCurr) override;
@@ -214,3 +214,39 @@ TEST_CASE("onOperationApply fail/succeed", "[invariant]")
             {}, res, ls.getDelta()));
     }
 }
+
+TEST_CASE("onOperationApply deferred", "[invariant]")
+{
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.DEFERRED_INVARIANT_CHECKS = true;
+    Application::pointer app = createTestApplication(clock, cfg);
+
+    OperationResult res;
+    SECTION("Fail")
+    {
+        app->getInvariantManager().registerInvariant<TestInvariant>(0, true);
+        app->getInvariantManager().enableInvariant(
+            TestInvariant::toString(0, true));
+
+        LedgerState ls(app->getLedgerStateRoot());
+        REQUIRE_NOTHROW(app->getInvariantManager().checkOnOperationApply(
+            {}, res, ls.getDelta()));
+        REQUIRE_THROWS_AS(app->getInvariantManager().joinOperationChecks(),
+                          InvariantDoesNotHold);
+
+        // failures are only reported once
+        REQUIRE_NOTHROW(app->getInvariantManager().joinOperationChecks());
+    }
+    SECTION("Succeed")
+    {
+        app->getInvariantManager().registerInvariant<TestInvariant>(0, false);
+        app->getInvariantManager().enableInvariant(
+            TestInvariant::toString(0, false));
+
+        LedgerState ls(app->getLedgerStateRoot());
+        REQUIRE_NOTHROW(app->getInvariantManager().checkOnOperationApply(
+            {}, res, ls.getDelta()));
+        REQUIRE_NOTHROW(app->getInvariantManager().joinOperationChecks());
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SecretKey.h"
+#include "util/HashOfHash.h"
+#include "xdr/Stellar-ledger.h"
+#include <functional>
+
+// Hashes used by the unordered containers keyed by LedgerKey. Every part of a
+// key that a peer can choose (account IDs, asset codes, data names) goes
+// through the keyed shortHash (see util/HashOfHash.h), so keys cannot be
+// crafted to collide. Hashing a key is still cheaper than the deep
+// comparisons done at each level of an ordered container.
+
+namespace stellar
+{
+inline void
+hashCombine(size_t& seed, size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+}
+
+namespace std
+{
+template <> struct hash<stellar::Asset>
+{
+    size_t
+    operator()(stellar::Asset const& asset) const noexcept
+    {
+        size_t res = asset.type();
+        switch (asset.type())
+        {
+        case stellar::ASSET_TYPE_NATIVE:
+            break;
+        case stellar::ASSET_TYPE_CREDIT_ALPHANUM4:
+        {
+            auto const& code = asset.alphaNum4().assetCode;
+            stellar::hashCombine(res,
+                                 stellar::shortHash(code.data(), code.size()));
+            stellar::hashCombine(
+                res, std::hash<stellar::PublicKey>()(asset.alphaNum4().issuer));
+            break;
+        }
+        case stellar::ASSET_TYPE_CREDIT_ALPHANUM12:
+        {
+            auto const& code = asset.alphaNum12().assetCode;
+            stellar::hashCombine(res,
+                                 stellar::shortHash(code.data(), code.size()));
+            stellar::hashCombine(res, std::hash<stellar::PublicKey>()(
+                                          asset.alphaNum12().issuer));
+            break;
+        }
+        }
+        return res;
+    }
+};
+
+// Not noexcept on purpose: unordered containers then store the hash of each
+// key in its node (at least with libstdc++), which spares rehashing and most
+// deep comparisons of keys when probing a bucket.
+template <> struct hash<stellar::LedgerKey>
+{
+    size_t
+    operator()(stellar::LedgerKey const& key) const
+    {
+        size_t res = key.type();
+        switch (key.type())
+        {
+        case stellar::ACCOUNT:
+            stellar::hashCombine(res, std::hash<stellar::PublicKey>()(
+                                          key.account().accountID));
+            break;
+        case stellar::TRUSTLINE:
+            stellar::hashCombine(res, std::hash<stellar::PublicKey>()(
+                                          key.trustLine().accountID));
+            stellar::hashCombine(
+                res, std::hash<stellar::Asset>()(key.trustLine().asset));
+            break;
+        case stellar::OFFER:
+            stellar::hashCombine(
+                res, std::hash<stellar::PublicKey>()(key.offer().sellerID));
+            stellar::hashCombine(res,
+                                 std::hash<uint64_t>()(key.offer().offerID));
+            break;
+        case stellar::DATA:
+        {
+            stellar::hashCombine(
+                res, std::hash<stellar::PublicKey>()(key.data().accountID));
+            auto const& name = key.data().dataName;
+            stellar::hashCombine(res,
+                                 stellar::shortHash(name.data(), name.size()));
+            break;
+        }
+        }
+        return res;
+    }
+};
+}
@@ -8,11 +8,17 @@
 #include "history/HistoryManager.h"
 #include <memory>
 
+namespace medida
+{
+class Timer;
+}
+
 namespace stellar
 {
 
 class LedgerCloseData;
 class Database;
+class MarketData;
 
 /**
  * LedgerManager maintains, in memory, a logical pair of ledgers:
@@ -130,6 +136,13 @@ class LedgerManager
 
     virtual Database& getDatabase() = 0;
 
+    // Market data of the configured trading pairs as of the LCL.
+    virtual MarketData& getMarketData() = 0;
+
+    // Time spent applying the operations of the given type (see
+    // OperationFrame::getApplyTimer).
+    virtual medida::Timer& getOperationApplyTimer(OperationType type) = 0;
+
     // Called by application lifecycle events, system startup.
     virtual void startNewLedger() = 0;
 
@@ -24,6 +24,7 @@
 #include "main/Application.h"
 #include "main/Config.h"
 #include "overlay/OverlayManager.h"
+#include "transactions/OperationFrame.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
 #include "util/format.h"
@@ -118,11 +119,36 @@ LedgerManagerImpl::LedgerManagerImpl(Application& app)
           app.getMetrics().NewTimer({"ledger", "state", "changes"}))
     , mLastClose(mApp.getClock().now())
     , mLastStateChange(mApp.getClock().now())
+    , mArenaAllocations(app.getMetrics().NewHistogram(
+          {"ledger", "state-arena", "allocations"}))
+    , mArenaHeapAllocations(app.getMetrics().NewHistogram(
+          {"ledger", "state-arena", "heap-allocations"}))
+    , mEntryCacheHits(
+          app.getMetrics().NewCounter({"ledger", "entry-cache", "hit"}))
+    , mEntryCacheMisses(
+          app.getMetrics().NewCounter({"ledger", "entry-cache", "miss"}))
+    , mEntryCacheEvictions(
+          app.getMetrics().NewCounter({"ledger", "entry-cache", "eviction"}))
+    , mEntryCacheSize(
+          app.getMetrics().NewCounter({"ledger", "entry-cache", "size"}))
+    , mEntryCacheBytes(
+          app.getMetrics().NewCounter({"ledger", "entry-cache", "bytes"}))
     , mSyncingLedgersSize(
           app.getMetrics().NewCounter({"ledger", "memory", "syncing-ledgers"}))
+    , mMarketData(app)
     , mState(LM_BOOTING_STATE)
 
 {
+    // looked up for every operation applied, the names are only built once
+    for (auto type : xdr::xdr_traits<OperationType>::enum_values())
+    {
+        if (mOperationApplyTimers.size() <= static_cast<size_t>(type))
+        {
+            mOperationApplyTimers.resize(type + 1, nullptr);
+        }
+        mOperationApplyTimers[type] = &OperationFrame::getApplyTimer(
+            app.getMetrics(), static_cast<OperationType>(type));
+    }
 }
 
 void
@@ -329,6 +355,18 @@ LedgerManagerImpl::getDatabase()
     return mApp.getDatabase();
 }
 
+MarketData&
+LedgerManagerImpl::getMarketData()
+{
+    return mMarketData;
+}
+
+medida::Timer&
+LedgerManagerImpl::getOperationApplyTimer(OperationType type)
+{
+    return *mOperationApplyTimers.at(type);
+}
+
 uint32_t
 LedgerManagerImpl::getLastMaxTxSetSize() const
 {
@@ -685,6 +723,8 @@ LedgerManagerImpl::historyCaughtup(asio::error_code const& ec,
             ls.commit();
 
             mLastClosedLedger = lastClosed;
+            // the entries of the buckets did not go through closeLedger
+            mMarketData.invalidate();
             return;
         }
         case CatchupWork::ProgressState::APPLIED_TRANSACTIONS:
@@ -871,7 +911,7 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
 
             auto ledgerSeq = lsUpgrade.loadHeader().current().ledgerSeq;
             // Note: Index from 1 rather than 0 to match the behavior of
-            // storeTransaction and storeTransactionFee.
+            // appendTransaction and appendTransactionFee.
             Upgrades::storeUpgradeHistory(getDatabase(), ledgerSeq, lupgrade,
                                           lsUpgrade.getChanges(),
                                           static_cast<int>(i + 1));
@@ -887,6 +927,11 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
         }
     }
 
+    // operations may still be checked on the worker threads, a strict
+    // invariant that does not hold must abort the close before anything is
+    // stored
+    mApp.getInvariantManager().joinOperationChecks();
+
     ledgerClosed(ls);
 
     // The next 4 steps happen in a relatively non-obvious, subtle order.
@@ -911,6 +956,7 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     hm.maybeQueueHistoryCheckpoint();
 
     // step 2
+    updateEntryCacheMetrics();
     ls.commit();
 
     // step 3
@@ -921,6 +967,17 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     mApp.getBucketManager().forgetUnreferencedBuckets();
 }
 
+void
+LedgerManagerImpl::updateEntryCacheMetrics()
+{
+    auto counters = mApp.getLedgerStateRoot().getEntryCacheCounters();
+    mEntryCacheHits.set_count(static_cast<int64_t>(counters.mHits));
+    mEntryCacheMisses.set_count(static_cast<int64_t>(counters.mMisses));
+    mEntryCacheEvictions.set_count(static_cast<int64_t>(counters.mEvictions));
+    mEntryCacheSize.set_count(static_cast<int64_t>(counters.mSize));
+    mEntryCacheBytes.set_count(static_cast<int64_t>(counters.mFootprint));
+}
+
 void
 LedgerManagerImpl::deleteOldEntries(Database& db, uint32_t ledgerSeq,
                                     uint32_t count)
@@ -957,14 +1014,16 @@ LedgerManagerImpl::processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
     {
         LedgerState ls(lsOuter);
         auto ledgerSeq = ls.loadHeader().current().ledgerSeq;
+        TransactionFeeHistoryRows feeRows;
         for (auto tx : txs)
         {
             LedgerState lsTx(ls);
             tx->processFeeSeqNum(lsTx);
-            tx->storeTransactionFee(mApp.getDatabase(), ledgerSeq,
-                                    lsTx.getChanges(), ++index);
+            tx->appendTransactionFee(feeRows, ledgerSeq, lsTx.getChanges(),
+                                     ++index);
             lsTx.commit();
         }
+        TransactionFrame::storeTransactionFees(mApp.getDatabase(), feeRows);
         ls.commit();
     }
     catch (std::exception& e)
@@ -991,12 +1050,23 @@ LedgerManagerImpl::applyTransactions(std::vector<TransactionFramePtr>& txs,
         mTransactionCount.Update(static_cast<int64_t>(numTxs));
     }
 
+    // Allocations made by the LedgerState objects of the transactions, served
+    // by the arena or by the heap (if the arena is disabled or for the
+    // containers of ls itself)
+    auto arena = mApp.getConfig().LEDGER_STATE_ARENA ? &mLedgerStateArena
+                                                     : nullptr;
+    auto arenaAllocations = mLedgerStateArena.getAllocationCount();
+    auto heapAllocations = getArenaAllocatorHeapAllocationCount();
+
+    auto ledgerSeq = ls.loadHeader().current().ledgerSeq;
+    TransactionHistoryRows historyRows;
     for (auto tx : txs)
     {
         auto txTime = mTransactionApply.TimeScope();
         TransactionMeta tm(1);
         try
         {
+            LedgerStateArenaScope arenaScope(arena);
             CLOG(DEBUG, "Tx")
                 << " tx#" << index << " = " << hexAbbrev(tx->getFullHash())
                 << " txseq=" << tx->getSeqNum() << " (@ "
@@ -1017,10 +1087,15 @@ LedgerManagerImpl::applyTransactions(std::vector<TransactionFramePtr>& txs,
             CLOG(ERROR, "Ledger") << "Unknown exception during tx->apply";
             tx->getResult().result.code(txINTERNAL_ERROR);
         }
-        auto ledgerSeq = ls.loadHeader().current().ledgerSeq;
-        tx->storeTransaction(mApp.getDatabase(), ledgerSeq, tm, ++index,
-                             txResultSet);
+        tx->appendTransaction(historyRows, ledgerSeq, tm, ++index,
+                              txResultSet);
     }
+    TransactionFrame::storeTransactions(mApp.getDatabase(), historyRows);
+
+    mArenaAllocations.Update(static_cast<int64_t>(
+        mLedgerStateArena.getAllocationCount() - arenaAllocations));
+    mArenaHeapAllocations.Update(static_cast<int64_t>(
+        getArenaAllocatorHeapAllocationCount() - heapAllocations));
 }
 
 void
@@ -1056,8 +1131,11 @@ void
 LedgerManagerImpl::ledgerClosed(AbstractLedgerState& ls)
 {
     auto ledgerSeq = ls.loadHeader().current().ledgerSeq;
-    mApp.getBucketManager().addBatch(mApp, ledgerSeq, ls.getLiveEntries(),
-                                     ls.getDeadEntries());
+    auto liveEntries = ls.getLiveEntries();
+    auto deadEntries = ls.getDeadEntries();
+    mMarketData.ledgerClosed(liveEntries, deadEntries);
+    mApp.getBucketManager().addBatch(mApp, ledgerSeq, liveEntries,
+                                     deadEntries);
 
     ls.unsealHeader([this](LedgerHeader& lh) {
         mApp.getBucketManager().snapshotLedger(lh);
@@ -7,9 +7,11 @@
 
 #include "history/HistoryManager.h"
 #include "ledger/LedgerManager.h"
+#include "ledger/MarketData.h"
 #include "ledger/SyncingLedgerChain.h"
 #include "main/PersistentState.h"
 #include "transactions/TransactionFrame.h"
+#include "util/Arena.h"
 #include "xdr/Stellar-ledger.h"
 #include <string>
 
@@ -48,12 +50,31 @@ class LedgerManagerImpl : public LedgerManager
     VirtualClock::time_point mLastClose;
     VirtualClock::time_point mLastStateChange;
 
+    medida::Histogram& mArenaAllocations;
+    medida::Histogram& mArenaHeapAllocations;
+    // scratch memory of the LedgerState objects of the transaction being
+    // applied, see Config::LEDGER_STATE_ARENA
+    Arena mLedgerStateArena;
+
+    // totals of the entry cache of the LedgerStateRoot, and its size when the
+    // last ledger was closed (it is cleared when the ledger is committed)
+    medida::Counter& mEntryCacheHits;
+    medida::Counter& mEntryCacheMisses;
+    medida::Counter& mEntryCacheEvictions;
+    medida::Counter& mEntryCacheSize;
+    medida::Counter& mEntryCacheBytes;
+
     medida::Counter& mSyncingLedgersSize;
     SyncingLedgerChain mSyncingLedgers;
     uint32_t mCatchupTriggerLedger{0};
 
     CatchupState mCatchupState{CatchupState::NONE};
 
+    MarketData mMarketData;
+
+    // indexed by OperationType, null for the values that are not one
+    std::vector<medida::Timer*> mOperationApplyTimers;
+
     void initializeCatchup(LedgerCloseData const& ledgerData);
     void continueCatchup(LedgerCloseData const& ledgerData);
     void finalizeCatchup(LedgerCloseData const& ledgerData);
@@ -66,6 +87,8 @@ class LedgerManagerImpl : public LedgerManager
                          LedgerHeaderHistoryEntry const& lastClosed);
     void applyBufferedLedgers();
 
+    void updateEntryCacheMetrics();
+
     void processFeesSeqNums(std::vector<TransactionFramePtr>& txs,
                             AbstractLedgerState& lsOuter);
 
@@ -118,6 +141,9 @@ class LedgerManagerImpl : public LedgerManager
 
     Database& getDatabase() override;
 
+    MarketData& getMarketData() override;
+    medida::Timer& getOperationApplyTimer(OperationType type) override;
+
     void startCatchup(CatchupConfiguration configuration,
                       bool manualCatchup) override;
 
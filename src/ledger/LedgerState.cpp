@@ -11,16 +11,30 @@
 #include "ledger/LedgerStateEntry.h"
 #include "ledger/LedgerStateHeader.h"
 #include "ledger/LedgerStateImpl.h"
+#include "ledger/LedgerStateSQLStore.h"
 #include "util/GlobalChecks.h"
 #include "util/XDROperators.h"
 #include "util/types.h"
 #include "xdr/Stellar-ledger-entries.h"
 #include "xdrpp/marshal.h"
-#include <soci.h>
+#include <atomic>
 
 namespace stellar
 {
 
+static std::atomic<uint64_t> gEntryCopyCount{0};
+
+// arena of the innermost LedgerStateArenaScope of the thread
+static thread_local Arena* gLedgerStateArena = nullptr;
+
+std::shared_ptr<LedgerEntry>
+copyLedgerEntry(LedgerEntry const& entry)
+{
+    auto copy = std::make_shared<LedgerEntry>(entry);
+    gEntryCopyCount.fetch_add(1, std::memory_order_relaxed);
+    return copy;
+}
+
 // Implementation of AbstractLedgerStateParent --------------------------------
 AbstractLedgerStateParent::~AbstractLedgerStateParent()
 {
@@ -65,6 +79,12 @@ EntryIterator::entry() const
     return getImpl()->entry();
 }
 
+std::shared_ptr<LedgerEntry const> const&
+EntryIterator::entryPtr() const
+{
+    return getImpl()->entryPtr();
+}
+
 bool
 EntryIterator::entryExists() const
 {
@@ -77,6 +97,45 @@ EntryIterator::key() const
     return getImpl()->key();
 }
 
+// Implementation of OrderBookCursor ------------------------------------------
+OrderBookCursor::OrderBookCursor(std::unique_ptr<AbstractImpl>&& impl)
+    : mImpl(std::move(impl))
+{
+}
+
+OrderBookCursor::OrderBookCursor(OrderBookCursor&& other)
+    : mImpl(std::move(other.mImpl))
+{
+}
+
+std::unique_ptr<OrderBookCursor::AbstractImpl> const&
+OrderBookCursor::getImpl() const
+{
+    if (!mImpl)
+    {
+        throw std::runtime_error("OrderBookCursor is empty");
+    }
+    return mImpl;
+}
+
+OrderBookCursor&
+OrderBookCursor::operator++()
+{
+    getImpl()->advance();
+    return *this;
+}
+
+OrderBookCursor::operator bool() const
+{
+    return !getImpl()->atEnd();
+}
+
+LedgerEntry const&
+OrderBookCursor::entry() const
+{
+    return getImpl()->entry();
+}
+
 // Implementation of AbstractLedgerState --------------------------------------
 AbstractLedgerState::~AbstractLedgerState()
 {
@@ -96,13 +155,32 @@ LedgerState::LedgerState(LedgerState& parent, bool shouldUpdateLastModified)
 
 LedgerState::Impl::Impl(LedgerState& self, AbstractLedgerStateParent& parent,
                         bool shouldUpdateLastModified)
-    : mParent(parent)
+    : mArena(gLedgerStateArena)
+    , mParent(parent)
     , mChild(nullptr)
     , mHeader(std::make_unique<LedgerHeader>(mParent.getHeader()))
+    , mEntry(EntryMap::allocator_type(mArena))
+    , mActive(ActiveMap::allocator_type(mArena))
     , mShouldUpdateLastModified(shouldUpdateLastModified)
     , mIsSealed(false)
 {
     mParent.addChild(self);
+
+    // Arena::addUser does not throw
+    if (mArena)
+    {
+        mArena->addUser();
+    }
+}
+
+LedgerState::Impl::~Impl()
+{
+    // Deallocation is a no-op for an arena, so the nodes of the maps may be
+    // destroyed after the arena stops counting this LedgerState as a user
+    if (mArena)
+    {
+        mArena->removeUser();
+    }
 }
 
 LedgerState::~LedgerState()
@@ -113,6 +191,12 @@ LedgerState::~LedgerState()
     }
 }
 
+uint64_t
+LedgerState::getEntryCopyCount()
+{
+    return gEntryCopyCount.load(std::memory_order_relaxed);
+}
+
 std::unique_ptr<LedgerState::Impl> const&
 LedgerState::getImpl() const
 {
@@ -197,9 +281,11 @@ LedgerState::Impl::commitChild(EntryIterator iter)
         for (; (bool)iter; ++iter)
         {
             auto const& key = iter.key();
+            indexOffer(key);
             if (iter.entryExists())
             {
-                mEntry[key] = std::make_shared<LedgerEntry>(iter.entry());
+                // the child is done with its entries, keep them as they are
+                mEntry[key] = iter.entryPtr();
             }
             else if (!mParent.getNewestVersion(key))
             { // Created in this LedgerState
@@ -244,19 +330,46 @@ LedgerState::Impl::create(LedgerState& self, LedgerEntry const& entry)
         throw std::runtime_error("Key already exists");
     }
 
-    auto current = std::make_shared<LedgerEntry>(entry);
-    auto impl = LedgerStateEntry::makeSharedImpl(self, *current);
+    return activate(self, key, copyLedgerEntry(entry));
+}
 
-    // Set the key to active before constructing the LedgerStateEntry, as this
-    // can throw and the LedgerStateEntry destructor requires that mActive
-    // contains key. LedgerStateEntry constructor does not throw so this is
-    // still exception safe.
-    mActive.emplace(key, toEntryImplBase(impl));
-    LedgerStateEntry lse(impl);
+LedgerStateEntry
+LedgerState::Impl::activate(LedgerState& self, LedgerKey const& key,
+                            std::shared_ptr<LedgerEntry const> current)
+{
+    // The LedgerStateEntry refers to the element of mEntry (which is only
+    // replaced with a copy when the entry is modified), so the element has to
+    // exist before it is constructed. C++14 requirements for exception safety
+    // of associative containers guarantee that if emplace throws when
+    // inserting a single element then the insertion has no effect.
+    indexOffer(key);
+    auto res = mEntry.emplace(key, nullptr);
+    auto iter = res.first;
+    try
+    {
+        auto impl = LedgerStateEntry::makeSharedImpl(self, iter->second);
+
+        // Set the key to active before constructing the LedgerStateEntry, as
+        // this can throw and the LedgerStateEntry destructor requires that
+        // mActive contains key. LedgerStateEntry constructor does not throw so
+        // this is still exception safe.
+        mActive.emplace(key, toEntryImplBase(impl));
+        LedgerStateEntry lse(impl);
 
-    // std::shared_ptr assignment is noexcept
-    mEntry[key] = current;
-    return lse;
+        // std::shared_ptr assignment is noexcept
+        iter->second = std::move(current);
+        return lse;
+    }
+    catch (...)
+    {
+        if (res.second)
+        {
+            // C++14 requirements for exception safety of containers guarantee
+            // that erase(iter) does not throw
+            mEntry.erase(iter);
+        }
+        throw;
+    }
 }
 
 void
@@ -329,6 +442,7 @@ LedgerState::Impl::erase(LedgerKey const& key)
             // C++14 requirements for exception safety of associative containers
             // guarantee that if emplace throws when inserting a single element
             // then the insertion has no effect
+            indexOffer(key);
             mEntry.emplace(key, nullptr);
         }
     }
@@ -414,7 +528,7 @@ LedgerState::Impl::getBestOffer(Asset const& buying, Asset const& selling,
     std::shared_ptr<LedgerEntry const> bestOffer;
     if (bestOfferIter != end)
     {
-        bestOffer = std::make_shared<LedgerEntry const>(*bestOfferIter->second);
+        bestOffer = bestOfferIter->second;
     }
 
     auto parentBestOffer = mParent.getBestOffer(buying, selling, exclude);
@@ -440,10 +554,23 @@ LedgerState::Impl::getChanges()
 {
     LedgerEntryChanges changes;
     maybeUpdateLastModifiedThenInvokeThenSeal([&](EntryMap const& entries) {
+        // changes are part of the transaction meta, so they are ordered by key
+        std::vector<EntryMap::value_type const*> sorted;
+        sorted.reserve(entries.size());
         for (auto const& kv : entries)
         {
-            auto const& key = kv.first;
-            auto const& entry = kv.second;
+            sorted.emplace_back(&kv);
+        }
+        std::sort(sorted.begin(), sorted.end(),
+                  [](EntryMap::value_type const* lhs,
+                     EntryMap::value_type const* rhs) {
+                      return lhs->first < rhs->first;
+                  });
+
+        for (auto kv : sorted)
+        {
+            auto const& key = kv->first;
+            auto const& entry = kv->second;
 
             auto previous = mParent.getNewestVersion(key);
             if (previous)
@@ -792,37 +919,36 @@ LedgerState::Impl::getNewestVersion(LedgerKey const& key) const
     return mParent.getNewestVersion(key);
 }
 
-std::map<LedgerKey, LedgerEntry>
+std::set<LedgerKey>
 LedgerState::getOffersByAccountAndAsset(AccountID const& account,
                                         Asset const& asset)
 {
     return getImpl()->getOffersByAccountAndAsset(account, asset);
 }
 
-std::map<LedgerKey, LedgerEntry>
+std::set<LedgerKey>
 LedgerState::Impl::getOffersByAccountAndAsset(AccountID const& account,
                                               Asset const& asset)
 {
     auto offers = mParent.getOffersByAccountAndAsset(account, asset);
-    for (auto const& kv : mEntry)
+    auto sellerIter = mOffersBySeller.find(account);
+    if (sellerIter == mOffersBySeller.end())
     {
-        auto const& key = kv.first;
-        auto const& entry = kv.second;
-        if (key.type() != OFFER)
-        {
-            continue;
-        }
-        if (!entry)
+        return offers;
+    }
+    for (auto const& key : sellerIter->second)
+    {
+        auto iter = mEntry.find(key);
+        if (iter == mEntry.end())
         {
-            offers.erase(key);
             continue;
         }
 
-        auto const& oe = entry->data.offer();
-        if (oe.sellerID == account &&
-            (oe.selling == asset || oe.buying == asset))
+        auto const& entry = iter->second;
+        if (entry && (entry->data.offer().selling == asset ||
+                      entry->data.offer().buying == asset))
         {
-            offers[key] = *entry;
+            offers.insert(key);
         }
         else
         {
@@ -832,6 +958,54 @@ LedgerState::Impl::getOffersByAccountAndAsset(AccountID const& account,
     return offers;
 }
 
+void
+LedgerState::Impl::indexOffer(LedgerKey const& key)
+{
+    if (key.type() == OFFER)
+    {
+        // C++14 requirements for exception safety of associative containers
+        // guarantee that if emplace throws when inserting a single element
+        // then the insertion has no effect
+        mOffersBySeller[key.offer().sellerID].emplace(key);
+    }
+}
+
+OrderBookCursor
+LedgerState::getOrderBook(Asset const& buying, Asset const& selling)
+{
+    return getImpl()->getOrderBook(buying, selling);
+}
+
+OrderBookCursor
+LedgerState::Impl::getOrderBook(Asset const& buying, Asset const& selling)
+{
+    std::vector<std::shared_ptr<LedgerEntry const>> offers;
+    for (auto const& kv : mEntry)
+    {
+        auto const& key = kv.first;
+        auto const& entry = kv.second;
+        if (key.type() != OFFER || !entry)
+        {
+            continue;
+        }
+
+        auto const& oe = entry->data.offer();
+        if (oe.buying == buying && oe.selling == selling)
+        {
+            offers.emplace_back(entry);
+        }
+    }
+    std::sort(offers.begin(), offers.end(),
+              [](std::shared_ptr<LedgerEntry const> const& lhs,
+                 std::shared_ptr<LedgerEntry const> const& rhs) {
+                  return isBetterOffer(*lhs, *rhs);
+              });
+
+    auto cursorImpl = std::make_unique<OrderBookCursorImpl>(
+        mEntry, std::move(offers), mParent.getOrderBook(buying, selling));
+    return OrderBookCursor(std::move(cursorImpl));
+}
+
 LedgerStateEntry
 LedgerState::load(LedgerKey const& key)
 {
@@ -854,19 +1028,9 @@ LedgerState::Impl::load(LedgerState& self, LedgerKey const& key)
         return {};
     }
 
-    auto current = std::make_shared<LedgerEntry>(*newest);
-    auto impl = LedgerStateEntry::makeSharedImpl(self, *current);
-
-    // Set the key to active before constructing the LedgerStateEntry, as this
-    // can throw and the LedgerStateEntry destructor requires that mActive
-    // contains key. LedgerStateEntry constructor does not throw so this is
-    // still exception safe.
-    mActive.emplace(key, toEntryImplBase(impl));
-    LedgerStateEntry lse(impl);
-
-    // std::shared_ptr assignment is noexcept
-    mEntry[key] = current;
-    return lse;
+    // newest is shared with the parent (or is already stored here) until it is
+    // modified
+    return activate(self, key, newest);
 }
 
 std::map<AccountID, std::vector<LedgerStateEntry>>
@@ -896,9 +1060,10 @@ LedgerState::Impl::loadAllOffers(LedgerState& self)
     }
     catch (...)
     {
-        // For associative containers, swap does not throw unless the exception
-        // is thrown by the swap of the Compare object (which is of type
-        // std::less<LedgerKey>, so this should not throw when swapped)
+        // For unordered associative containers, swap does not throw unless
+        // the exception is thrown by the swap of the Hash or Pred objects
+        // (which are of type std::hash<LedgerKey> and std::equal_to<LedgerKey>,
+        // so this should not throw when swapped)
         mEntry.swap(previousEntries);
         throw;
     }
@@ -966,18 +1131,19 @@ LedgerState::Impl::loadOffersByAccountAndAsset(LedgerState& self,
     try
     {
         std::vector<LedgerStateEntry> res;
-        for (auto const& kv : offers)
+        res.reserve(offers.size());
+        for (auto const& key : offers)
         {
-            auto const& key = kv.first;
             res.emplace_back(load(self, key));
         }
         return res;
     }
     catch (...)
     {
-        // For associative containers, swap does not throw unless the exception
-        // is thrown by the swap of the Compare object (which is of type
-        // std::less<LedgerKey>, so this should not throw when swapped)
+        // For unordered associative containers, swap does not throw unless
+        // the exception is thrown by the swap of the Hash or Pred objects
+        // (which are of type std::hash<LedgerKey> and std::equal_to<LedgerKey>,
+        // so this should not throw when swapped)
         mEntry.swap(previousEntries);
         throw;
     }
@@ -1005,7 +1171,7 @@ LedgerState::Impl::loadWithoutRecord(LedgerState& self, LedgerKey const& key)
         return {};
     }
 
-    auto impl = ConstLedgerStateEntry::makeSharedImpl(self, *newest);
+    auto impl = ConstLedgerStateEntry::makeSharedImpl(self, newest);
 
     // Set the key to active before constructing the ConstLedgerStateEntry, as
     // this can throw and the LedgerStateEntry destructor requires that mActive
@@ -1078,22 +1244,23 @@ LedgerState::Impl::maybeUpdateLastModified() const
     throwIfSealed();
     throwIfChild();
 
-    // Note: We do a deep copy here since a shallow copy would not be exception
-    // safe.
-    EntryMap entries;
+    // Note: The entries of mEntry are never modified here since that would not
+    // be exception safe. An entry is copied only if its last modified ledger
+    // has to change, which is not the case for an entry that was already
+    // modified in this ledger.
+    EntryMap entries(mEntry.size(), mEntry.get_allocator());
     for (auto const& kv : mEntry)
     {
         auto const& key = kv.first;
-        std::shared_ptr<LedgerEntry> entry;
-        if (kv.second)
+        auto entry = kv.second;
+        if (entry && mShouldUpdateLastModified &&
+            entry->lastModifiedLedgerSeq != mHeader->ledgerSeq)
         {
-            entry = std::make_shared<LedgerEntry>(*kv.second);
-            if (mShouldUpdateLastModified)
-            {
-                entry->lastModifiedLedgerSeq = mHeader->ledgerSeq;
-            }
+            auto updated = copyLedgerEntry(*entry);
+            updated->lastModifiedLedgerSeq = mHeader->ledgerSeq;
+            entry = std::move(updated);
         }
-        entries.emplace(key, entry);
+        entries.emplace(key, std::move(entry));
     }
     return entries;
 }
@@ -1109,9 +1276,10 @@ LedgerState::Impl::maybeUpdateLastModifiedThenInvokeThenSeal(
 
         f(entries);
 
-        // For associative containers, swap does not throw unless the exception
-        // is thrown by the swap of the Compare object (which is of type
-        // std::less<LedgerKey>, so this should not throw when swapped)
+        // For unordered associative containers, swap does not throw unless
+        // the exception is thrown by the swap of the Hash or Pred objects
+        // (which are of type std::hash<LedgerKey> and std::equal_to<LedgerKey>,
+        // so this should not throw when swapped)
         mEntry.swap(entries);
 
         // std::set<...>::clear does not throw
@@ -1151,6 +1319,12 @@ LedgerState::Impl::EntryIteratorImpl::entry() const
     return *(mIter->second);
 }
 
+std::shared_ptr<LedgerEntry const> const&
+LedgerState::Impl::EntryIteratorImpl::entryPtr() const
+{
+    return mIter->second;
+}
+
 bool
 LedgerState::Impl::EntryIteratorImpl::entryExists() const
 {
@@ -1163,19 +1337,130 @@ LedgerState::Impl::EntryIteratorImpl::key() const
     return mIter->first;
 }
 
+// Implementation of LedgerState::Impl::OrderBookCursorImpl -------------------
+LedgerState::Impl::OrderBookCursorImpl::OrderBookCursorImpl(
+    LedgerState::Impl::EntryMap const& entries,
+    std::vector<std::shared_ptr<LedgerEntry const>>&& offers,
+    OrderBookCursor&& parentCursor)
+    : mEntry(entries)
+    , mOffers(std::move(offers))
+    , mNext(0)
+    , mParentCursor(std::move(parentCursor))
+    , mFromParent(false)
+{
+    skipShadowed();
+    selectCurrent();
+}
+
+void
+LedgerState::Impl::OrderBookCursorImpl::skipShadowed()
+{
+    // every offer stored here (including erased ones) hides the version
+    // stored by the parent
+    while (mParentCursor &&
+           mEntry.find(LedgerEntryKey(mParentCursor.entry())) != mEntry.end())
+    {
+        ++mParentCursor;
+    }
+}
+
+void
+LedgerState::Impl::OrderBookCursorImpl::selectCurrent()
+{
+    if (mNext == mOffers.size())
+    {
+        mFromParent = true;
+    }
+    else if (!mParentCursor)
+    {
+        mFromParent = false;
+    }
+    else
+    {
+        mFromParent = isBetterOffer(mParentCursor.entry(), *mOffers[mNext]);
+    }
+}
+
+void
+LedgerState::Impl::OrderBookCursorImpl::advance()
+{
+    if (mFromParent)
+    {
+        ++mParentCursor;
+        skipShadowed();
+    }
+    else
+    {
+        ++mNext;
+    }
+    selectCurrent();
+}
+
+bool
+LedgerState::Impl::OrderBookCursorImpl::atEnd() const
+{
+    return mNext == mOffers.size() && !mParentCursor;
+}
+
+LedgerEntry const&
+LedgerState::Impl::OrderBookCursorImpl::entry() const
+{
+    return mFromParent ? mParentCursor.entry() : *mOffers[mNext];
+}
+
+// Implementation of LedgerStateArenaScope ------------------------------------
+LedgerStateArenaScope::LedgerStateArenaScope(Arena* arena)
+    : mArena(arena), mPrevious(gLedgerStateArena)
+{
+    gLedgerStateArena = mArena;
+}
+
+LedgerStateArenaScope::~LedgerStateArenaScope()
+{
+    gLedgerStateArena = mPrevious;
+    if (mArena && mArena != mPrevious)
+    {
+        // does nothing if a LedgerState constructed in the scope is still
+        // alive, the arena will be reset by a later scope
+        mArena->reset();
+    }
+}
+
 // Implementation of LedgerStateRoot ------------------------------------------
+// the entry cache is read by a single thread for now, the shards only bound the
+// cost of the scans of the clock hand
+static size_t const ENTRY_CACHE_SHARDS = 16;
+
+// approximate memory held by a cached entry: the serialized size of an entry
+// is close to the size of the heap allocations it makes (signers, strings...)
+static size_t
+getEntryFootprint(std::shared_ptr<LedgerEntry const> const& entry)
+{
+    return entry ? sizeof(LedgerEntry) + xdr::xdr_size(*entry) : 0;
+}
+
 LedgerStateRoot::LedgerStateRoot(Database& db, size_t entryCacheSize,
                                  size_t bestOfferCacheSize)
-    : mImpl(std::make_unique<Impl>(db, entryCacheSize, bestOfferCacheSize))
+    : LedgerStateRoot(std::make_unique<LedgerStateSQLStore>(db),
+                      entryCacheSize, bestOfferCacheSize)
 {
 }
 
-LedgerStateRoot::Impl::Impl(Database& db, size_t entryCacheSize,
-                            size_t bestOfferCacheSize)
-    : mDatabase(db)
+LedgerStateRoot::LedgerStateRoot(std::unique_ptr<LedgerStateStore> store,
+                                 size_t entryCacheSize,
+                                 size_t bestOfferCacheSize)
+    : mImpl(std::make_unique<Impl>(std::move(store), entryCacheSize,
+                                   bestOfferCacheSize))
+{
+}
+
+LedgerStateRoot::Impl::Impl(std::unique_ptr<LedgerStateStore> store,
+                            size_t entryCacheSize, size_t bestOfferCacheSize)
+    : mStore(std::move(store))
     , mHeader(std::make_unique<LedgerHeader>())
-    , mEntryCache(entryCacheSize)
+    , mEntryCache(entryCacheSize, ENTRY_CACHE_SHARDS, getEntryFootprint)
     , mBestOffersCache(bestOfferCacheSize)
+    , mOffersByAccountCache(bestOfferCacheSize)
     , mChild(nullptr)
 {
 }
@@ -1205,7 +1490,7 @@ LedgerStateRoot::Impl::addChild(AbstractLedgerState& child)
     {
         throw std::runtime_error("LedgerStateRoot already has child");
     }
-    mTransaction = std::make_unique<soci::transaction>(mDatabase.getSession());
+    mStore->beginTransaction();
     mChild = &child;
 }
 
@@ -1235,28 +1520,18 @@ LedgerStateRoot::Impl::commitChild(EntryIterator iter)
     {
         for (; (bool)iter; ++iter)
         {
-            auto const& key = iter.key();
-            switch (key.type())
+            if (iter.entryExists())
+            {
+                auto const previous = getNewestVersion(iter.key());
+                mStore->store(iter.entry(), previous);
+            }
+            else
             {
-            case ACCOUNT:
-                storeAccount(iter);
-                break;
-            case DATA:
-                storeData(iter);
-                break;
-            case OFFER:
-                storeOffer(iter);
-                break;
-            case TRUSTLINE:
-                storeTrustLine(iter);
-                break;
-            default:
-                throw std::runtime_error("Unknown key type");
+                mStore->erase(iter.key());
             }
         }
 
-        mTransaction->commit();
-        mDatabase.clearPreparedStatementCache();
+        mStore->commitTransaction();
     }
     catch (std::exception& e)
     {
@@ -1271,34 +1546,14 @@ LedgerStateRoot::Impl::commitChild(EntryIterator iter)
 
     // Clearing the cache does not throw
     mBestOffersCache.clear();
+    mOffersByAccountCache.clear();
     mEntryCache.clear();
 
-    // std::unique_ptr<...>::reset does not throw
-    mTransaction.reset();
-
     // std::unique_ptr<...>::swap does not throw
     mHeader.swap(childHeader);
     mChild = nullptr;
 }
 
-std::string
-LedgerStateRoot::Impl::tableFromLedgerEntryType(LedgerEntryType let)
-{
-    switch (let)
-    {
-    case ACCOUNT:
-        return "accounts";
-    case DATA:
-        return "accountdata";
-    case OFFER:
-        return "offers";
-    case TRUSTLINE:
-        return "trustlines";
-    default:
-        throw std::runtime_error("Unknown ledger entry type");
-    }
-}
-
 uint64_t
 LedgerStateRoot::countObjects(LedgerEntryType let) const
 {
@@ -1308,14 +1563,8 @@ LedgerStateRoot::countObjects(LedgerEntryType let) const
 uint64_t
 LedgerStateRoot::Impl::countObjects(LedgerEntryType let) const
 {
-    using namespace soci;
     throwIfChild();
-
-    std::string query =
-        "SELECT COUNT(*) FROM " + tableFromLedgerEntryType(let) + ";";
-    uint64_t count = 0;
-    mDatabase.getSession() << query, into(count);
-    return count;
+    return mStore->countObjects(let);
 }
 
 uint64_t
@@ -1329,16 +1578,26 @@ uint64_t
 LedgerStateRoot::Impl::countObjects(LedgerEntryType let,
                                     LedgerRange const& ledgers) const
 {
-    using namespace soci;
     throwIfChild();
+    return mStore->countObjects(let, ledgers);
+}
+
+void
+LedgerStateRoot::loadObjects(LedgerEntryType let, LedgerRange const& ledgers,
+                             size_t chunkSize, ObjectsChunkFn const& f) const
+{
+    mImpl->loadObjects(let, ledgers, chunkSize, f);
+}
 
-    std::string query = "SELECT COUNT(*) FROM " +
-                        tableFromLedgerEntryType(let) +
-                        " WHERE lastmodified >= :v1 AND lastmodified <= :v2;";
-    uint64_t count = 0;
-    mDatabase.getSession() << query, into(count), use(ledgers.first()),
-        use(ledgers.last());
-    return count;
+void
+LedgerStateRoot::Impl::loadObjects(LedgerEntryType let,
+                                   LedgerRange const& ledgers,
+                                   size_t chunkSize,
+                                   ObjectsChunkFn const& f) const
+{
+    throwIfChild();
+    assert(chunkSize > 0);
+    mStore->loadObjects(let, ledgers, chunkSize, f);
 }
 
 void
@@ -1351,48 +1610,59 @@ void
 LedgerStateRoot::Impl::deleteObjectsModifiedOnOrAfterLedger(
     uint32_t ledger) const
 {
-    using namespace soci;
     throwIfChild();
     mEntryCache.clear();
     mBestOffersCache.clear();
-
-    {
-        std::string query =
-            "DELETE FROM signers WHERE accountid IN"
-            " (SELECT accountid FROM accounts WHERE lastmodified >= :v1)";
-        mDatabase.getSession() << query, use(ledger);
-    }
-
-    for (auto let : {ACCOUNT, DATA, TRUSTLINE, OFFER})
-    {
-        std::string query = "DELETE FROM " + tableFromLedgerEntryType(let) +
-                            " WHERE lastmodified >= :v1";
-        mDatabase.getSession() << query, use(ledger);
-    }
+    mOffersByAccountCache.clear();
+    mStore->deleteObjectsModifiedOnOrAfterLedger(ledger);
 }
 
 void
 LedgerStateRoot::dropAccounts()
 {
-    mImpl->dropAccounts();
+    mImpl->drop(ACCOUNT);
 }
 
 void
 LedgerStateRoot::dropData()
 {
-    mImpl->dropData();
+    mImpl->drop(DATA);
 }
 
 void
 LedgerStateRoot::dropOffers()
 {
-    mImpl->dropOffers();
+    mImpl->drop(OFFER);
 }
 
 void
 LedgerStateRoot::dropTrustLines()
 {
-    mImpl->dropTrustLines();
+    mImpl->drop(TRUSTLINE);
+}
+
+void
+LedgerStateRoot::Impl::drop(LedgerEntryType let)
+{
+    throwIfChild();
+    mEntryCache.clear();
+    mBestOffersCache.clear();
+    mOffersByAccountCache.clear();
+    mStore->drop(let);
+}
+
+LedgerStateRoot::EntryCacheCounters
+LedgerStateRoot::getEntryCacheCounters() const
+{
+    return mImpl->getEntryCacheCounters();
+}
+
+LedgerStateRoot::EntryCacheCounters
+LedgerStateRoot::Impl::getEntryCacheCounters() const
+{
+    auto counters = mEntryCache.getCounters();
+    return {counters.mHits, counters.mMisses, counters.mEvictions,
+            counters.mSize, counters.mFootprint};
 }
 
 std::map<LedgerKey, LedgerEntry>
@@ -1407,7 +1677,7 @@ LedgerStateRoot::Impl::getAllOffers()
     std::vector<LedgerEntry> offers;
     try
     {
-        offers = loadAllOffers();
+        offers = mStore->loadAllOffers();
     }
     catch (std::exception& e)
     {
@@ -1444,6 +1714,14 @@ LedgerStateRoot::loadBestOffers(std::list<LedgerEntry>& offers,
     return mImpl->loadBestOffers(offers, buying, selling, numOffers, offset);
 }
 
+std::list<LedgerEntry>::const_iterator
+LedgerStateRoot::Impl::loadBestOffers(std::list<LedgerEntry>& offers,
+                                      Asset const& buying, Asset const& selling,
+                                      size_t numOffers, size_t offset) const
+{
+    return mStore->loadBestOffers(offers, buying, selling, numOffers, offset);
+}
+
 static std::shared_ptr<LedgerEntry const>
 findIncludedOffer(std::list<LedgerEntry>::const_iterator iter,
                   std::list<LedgerEntry>::const_iterator const& end,
@@ -1469,8 +1747,8 @@ LedgerStateRoot::Impl::getBestOffer(Asset const& buying, Asset const& selling,
     // that the lists of best offers remain properly sorted. The sort order is
     // that determined by loadBestOffers and isBetterOffer (both induce the same
     // order).
-    BestOffersCacheEntry emptyCacheEntry{{}, false};
-    auto& cached = getFromBestOffersCache(buying, selling, emptyCacheEntry);
+    auto cachedPtr = getFromBestOffersCache(buying, selling);
+    auto& cached = *cachedPtr;
     auto& offers = cached.bestOffers;
 
     auto res = findIncludedOffer(offers.cbegin(), offers.cend(), exclude);
@@ -1505,21 +1783,50 @@ LedgerStateRoot::Impl::getBestOffer(Asset const& buying, Asset const& selling,
     return res;
 }
 
-std::map<LedgerKey, LedgerEntry>
+OrderBookCursor
+LedgerStateRoot::getOrderBook(Asset const& buying, Asset const& selling)
+{
+    return mImpl->getOrderBook(buying, selling);
+}
+
+OrderBookCursor
+LedgerStateRoot::Impl::getOrderBook(Asset const& buying, Asset const& selling)
+{
+    auto cursorImpl = std::make_unique<OrderBookCursorImpl>(
+        *this, buying, selling, getFromBestOffersCache(buying, selling));
+    return OrderBookCursor(std::move(cursorImpl));
+}
+
+std::set<LedgerKey>
 LedgerStateRoot::getOffersByAccountAndAsset(AccountID const& account,
                                             Asset const& asset)
 {
     return mImpl->getOffersByAccountAndAsset(account, asset);
 }
 
-std::map<LedgerKey, LedgerEntry>
+std::set<LedgerKey>
 LedgerStateRoot::Impl::getOffersByAccountAndAsset(AccountID const& account,
                                                   Asset const& asset)
 {
+    auto cacheKey = binToHex(xdr::xdr_to_opaque(account)) +
+                    binToHex(xdr::xdr_to_opaque(asset));
+    try
+    {
+        if (mOffersByAccountCache.exists(cacheKey))
+        {
+            return *mOffersByAccountCache.get(cacheKey);
+        }
+    }
+    catch (...)
+    {
+        mOffersByAccountCache.clear();
+        throw;
+    }
+
     std::vector<LedgerEntry> offers;
     try
     {
-        offers = loadOffersByAccountAndAsset(account, asset);
+        offers = mStore->loadOffersByAccountAndAsset(account, asset);
     }
     catch (std::exception& e)
     {
@@ -1533,12 +1840,26 @@ LedgerStateRoot::Impl::getOffersByAccountAndAsset(AccountID const& account,
                            "and asset from LedgerStateRoot");
     }
 
-    std::map<LedgerKey, LedgerEntry> res;
+    // the offers are kept in the entry cache so that loading them afterwards
+    // does not query the database again
+    auto res = std::make_shared<std::set<LedgerKey>>();
     for (auto const& offer : offers)
     {
-        res.emplace(LedgerEntryKey(offer), offer);
+        auto key = LedgerEntryKey(offer);
+        putInEntryCache(key, std::make_shared<LedgerEntry>(offer));
+        res->emplace_hint(res->end(), std::move(key));
     }
-    return res;
+
+    try
+    {
+        mOffersByAccountCache.put(cacheKey, res);
+    }
+    catch (...)
+    {
+        mOffersByAccountCache.clear();
+        throw;
+    }
+    return *res;
 }
 
 LedgerHeader const&
@@ -1564,7 +1885,7 @@ LedgerStateRoot::Impl::getInflationWinners(size_t maxWinners, int64_t minVotes)
 {
     try
     {
-        return loadInflationWinners(maxWinners, minVotes);
+        return mStore->loadInflationWinners(maxWinners, minVotes);
     }
     catch (std::exception& e)
     {
@@ -1588,7 +1909,7 @@ LedgerStateRoot::getDebtHolders(Asset const& asset)
 std::vector<LedgerEntry>
 LedgerStateRoot::Impl::getDebtHolders(Asset const& asset)
 {
-    return loadDebtHolders(asset);
+    return mStore->loadDebtHolders(asset);
 }
 
 std::vector<LedgerEntry>
@@ -1607,8 +1928,8 @@ LedgerStateRoot::Impl::getLiquidationCandidates(Asset const& asset1,
                                                 double ratio2,
                                                 Asset const& assetBalance)
 {
-    return loadLiquidationCandidates(asset1, ratio1, asset2, ratio2,
-                                     assetBalance);
+    return mStore->loadLiquidationCandidates(asset1, ratio1, asset2, ratio2,
+                                             assetBalance);
 }
 
 std::vector<LedgerEntry>
@@ -1626,8 +1947,8 @@ LedgerStateRoot::Impl::getLiquidationSubjects(
     Asset const& asset1, double ratio1, Asset const& asset2, double ratio2,
     Asset const& assetBalance, bool stillEligible)
 {
-    return loadLiquidationSubjects(asset1, ratio1, asset2, ratio2, assetBalance,
-                                   stillEligible);
+    return mStore->loadLiquidationSubjects(asset1, ratio1, asset2, ratio2,
+                                           assetBalance, stillEligible);
 }
 
 std::shared_ptr<LedgerEntry const>
@@ -1639,32 +1960,15 @@ LedgerStateRoot::getNewestVersion(LedgerKey const& key) const
 std::shared_ptr<LedgerEntry const>
 LedgerStateRoot::Impl::getNewestVersion(LedgerKey const& key) const
 {
-    auto cacheKey = getEntryCacheKey(key);
-    if (mEntryCache.exists(cacheKey))
+    std::shared_ptr<LedgerEntry const> entry;
+    if (getFromEntryCache(key, entry))
     {
-        return getFromEntryCache(cacheKey);
+        return entry;
     }
 
-    std::shared_ptr<LedgerEntry const> entry;
     try
     {
-        switch (key.type())
-        {
-        case ACCOUNT:
-            entry = loadAccount(key);
-            break;
-        case DATA:
-            entry = loadData(key);
-            break;
-        case OFFER:
-            entry = loadOffer(key);
-            break;
-        case TRUSTLINE:
-            entry = loadTrustLine(key);
-            break;
-        default:
-            throw std::runtime_error("Unknown key type");
-        }
+        entry = mStore->load(key);
     }
     catch (std::exception& e)
     {
@@ -1678,7 +1982,7 @@ LedgerStateRoot::Impl::getNewestVersion(LedgerKey const& key) const
                            "LedgerStateRoot");
     }
 
-    putInEntryCache(cacheKey, entry);
+    putInEntryCache(key, entry);
     return entry;
 }
 
@@ -1693,8 +1997,7 @@ LedgerStateRoot::Impl::rollbackChild()
 {
     try
     {
-        mTransaction->rollback();
-        mTransaction.reset();
+        mStore->rollbackTransaction();
     }
     catch (std::exception& e)
     {
@@ -1711,120 +2014,128 @@ LedgerStateRoot::Impl::rollbackChild()
     mChild = nullptr;
 }
 
-void
-LedgerStateRoot::Impl::storeAccount(EntryIterator const& iter)
+bool
+LedgerStateRoot::Impl::getFromEntryCache(
+    LedgerKey const& key, std::shared_ptr<LedgerEntry const>& entry) const
 {
-    if (iter.entryExists())
+    try
     {
-        auto const previous = getNewestVersion(iter.key());
-        insertOrUpdateAccount(iter.entry(), !previous);
-        storeSigners(iter.entry(), previous);
+        return mEntryCache.maybeGet(key, entry);
     }
-    else
+    catch (...)
     {
-        deleteAccount(iter.key());
+        mEntryCache.clear();
+        throw;
     }
 }
 
 void
-LedgerStateRoot::Impl::storeData(EntryIterator const& iter)
+LedgerStateRoot::Impl::putInEntryCache(
+    LedgerKey const& key, std::shared_ptr<LedgerEntry const> const& entry) const
 {
-    if (iter.entryExists())
+    try
     {
-        auto const previous = getNewestVersion(iter.key());
-        insertOrUpdateData(iter.entry(), !previous);
+        mEntryCache.put(key, entry);
     }
-    else
+    catch (...)
     {
-        deleteData(iter.key());
+        mEntryCache.clear();
+        throw;
     }
 }
 
-void
-LedgerStateRoot::Impl::storeOffer(EntryIterator const& iter)
+std::shared_ptr<LedgerStateRoot::Impl::BestOffersCacheEntry>
+LedgerStateRoot::Impl::getFromBestOffersCache(Asset const& buying,
+                                              Asset const& selling) const
 {
-    if (iter.entryExists())
+    try
     {
-        auto const previous = getNewestVersion(iter.key());
-        insertOrUpdateOffer(iter.entry(), !previous);
+        auto cacheKey = binToHex(xdr::xdr_to_opaque(buying)) +
+                        binToHex(xdr::xdr_to_opaque(selling));
+        if (!mBestOffersCache.exists(cacheKey))
+        {
+            auto emptyCacheEntry = std::make_shared<BestOffersCacheEntry>(
+                BestOffersCacheEntry{{}, false});
+            mBestOffersCache.put(cacheKey, emptyCacheEntry);
+            return emptyCacheEntry;
+        }
+        return mBestOffersCache.get(cacheKey);
     }
-    else
+    catch (...)
     {
-        deleteOffer(iter.key());
+        mBestOffersCache.clear();
+        throw;
     }
 }
 
-void
-LedgerStateRoot::Impl::storeTrustLine(EntryIterator const& iter)
+// Implementation of LedgerStateRoot::Impl::OrderBookCursorImpl ---------------
+LedgerStateRoot::Impl::OrderBookCursorImpl::OrderBookCursorImpl(
+    LedgerStateRoot::Impl const& root, Asset const& buying,
+    Asset const& selling,
+    std::shared_ptr<LedgerStateRoot::Impl::BestOffersCacheEntry> cached)
+    : mRoot(root)
+    , mBuying(buying)
+    , mSelling(selling)
+    , mCached(cached)
+    , mIter(mCached->bestOffers.cbegin())
 {
-    if (iter.entryExists())
-    {
-        auto const previous = getNewestVersion(iter.key());
-        insertOrUpdateTrustLine(iter.entry(), !previous);
-    }
-    else
-    {
-        deleteTrustLine(iter.key());
-    }
+    loadIfNeeded();
 }
 
-LedgerStateRoot::Impl::EntryCacheKey
-LedgerStateRoot::Impl::getEntryCacheKey(LedgerKey const& key) const
+void
+LedgerStateRoot::Impl::OrderBookCursorImpl::loadIfNeeded()
 {
-    return binToHex(xdr::xdr_to_opaque(key));
-}
+    auto& offers = mCached->bestOffers;
+    if (mIter != offers.cend() || mCached->allLoaded)
+    {
+        return;
+    }
 
-std::shared_ptr<LedgerEntry const>
-LedgerStateRoot::Impl::getFromEntryCache(EntryCacheKey const& cacheKey) const
-{
+    // batches double in size (up to a limit) so that the number of queries
+    // grows logarithmically with the number of offers enumerated
+    size_t const MIN_BATCH_SIZE = 5;
+    size_t const MAX_BATCH_SIZE = 1024;
+    size_t batchSize =
+        std::min(std::max(MIN_BATCH_SIZE, offers.size()), MAX_BATCH_SIZE);
     try
     {
-        return mEntryCache.get(cacheKey);
+        mIter = mRoot.loadBestOffers(offers, mBuying, mSelling, batchSize,
+                                     offers.size());
+    }
+    catch (std::exception& e)
+    {
+        printErrorAndAbort(
+            "fatal error when getting order book from LedgerStateRoot: ",
+            e.what());
     }
     catch (...)
     {
-        mEntryCache.clear();
-        throw;
+        printErrorAndAbort("unknown fatal error when getting order book "
+                           "from LedgerStateRoot");
+    }
+
+    if (static_cast<size_t>(std::distance(mIter, offers.cend())) < batchSize)
+    {
+        mCached->allLoaded = true;
     }
 }
 
 void
-LedgerStateRoot::Impl::putInEntryCache(
-    EntryCacheKey const& cacheKey,
-    std::shared_ptr<LedgerEntry const> const& entry) const
+LedgerStateRoot::Impl::OrderBookCursorImpl::advance()
 {
-    try
-    {
-        mEntryCache.put(cacheKey, entry);
-    }
-    catch (...)
-    {
-        mEntryCache.clear();
-        throw;
-    }
+    ++mIter;
+    loadIfNeeded();
 }
 
-LedgerStateRoot::Impl::BestOffersCacheEntry&
-LedgerStateRoot::Impl::getFromBestOffersCache(
-    Asset const& buying, Asset const& selling,
-    BestOffersCacheEntry& defaultValue) const
+bool
+LedgerStateRoot::Impl::OrderBookCursorImpl::atEnd() const
 {
-    try
-    {
-        auto cacheKey = binToHex(xdr::xdr_to_opaque(buying)) +
-                        binToHex(xdr::xdr_to_opaque(selling));
-        if (!mBestOffersCache.exists(cacheKey))
-        {
-            mBestOffersCache.put(cacheKey, defaultValue);
-        }
-        return mBestOffersCache.exists(cacheKey)
-                   ? mBestOffersCache.get(cacheKey)
-                   : defaultValue;
-    }
-    catch (...)
-    {
-        mBestOffersCache.clear();
-        throw;
-    }
+    return mIter == mCached->bestOffers.cend();
+}
+
+LedgerEntry const&
+LedgerStateRoot::Impl::OrderBookCursorImpl::entry() const
+{
+    return *mIter;
 }
 }
@@ -6,6 +6,7 @@
 
 #include "ledger/LedgerStateEntry.h"
 #include "ledger/LedgerStateHeader.h"
+#include "util/NonCopyable.h"
 #include "xdr/Stellar-ledger.h"
 #include <functional>
 #include <list>
@@ -16,11 +17,13 @@
 namespace stellar
 {
 
+class Arena;
 class Database;
 struct InflationVotes;
 struct LedgerEntry;
 struct LedgerKey;
 class LedgerRange;
+class LedgerStateStore;
 
 bool isBetterOffer(LedgerEntry const& lhsEntry, LedgerEntry const& rhsEntry);
 
@@ -77,11 +80,48 @@ class EntryIterator
 
     LedgerEntry const& entry() const;
 
+    // The entry shared with the AbstractLedgerState being committed, so that
+    // its parent can keep it without copying it. It must not be modified.
+    std::shared_ptr<LedgerEntry const> const& entryPtr() const;
+
     bool entryExists() const;
 
     LedgerKey const& key() const;
 };
 
+// An abstraction for an object that is iterator-like and permits enumerating
+// the offers with specified buying and selling assets, best offer first (in the
+// order induced by isBetterOffer). Each AbstractLedgerStateParent contributes
+// the offers it stores and hides the versions of those offers stored by its
+// parents, so advancing does not rescan the offers that were already
+// enumerated. The offers enumerated reflect the state at the time the
+// OrderBookCursor was created: offers that were already enumerated can be
+// modified or erased while it is in use, but other offers of the order book
+// must not be. An OrderBookCursor must not be used after the
+// AbstractLedgerStateParent that created it (or any of its parents) has
+// committed or rolled back.
+class OrderBookCursor
+{
+  public:
+    class AbstractImpl;
+
+  private:
+    std::unique_ptr<AbstractImpl> mImpl;
+
+    std::unique_ptr<AbstractImpl> const& getImpl() const;
+
+  public:
+    OrderBookCursor(std::unique_ptr<AbstractImpl>&& impl);
+
+    OrderBookCursor(OrderBookCursor&& other);
+
+    OrderBookCursor& operator++();
+
+    explicit operator bool() const;
+
+    LedgerEntry const& entry() const;
+};
+
 // An abstraction for an object that can be the parent of an AbstractLedgerState
 // (discussed below). Allows children to commit atomically to the parent. Has no
 // notion of a LedgerStateEntry or LedgerStateHeader (discussed respectively in
@@ -107,21 +147,26 @@ class AbstractLedgerStateParent
     virtual void commitChild(EntryIterator iter) = 0;
     virtual void rollbackChild() = 0;
 
-    // getAllOffers, getBestOffer, and getOffersByAccountAndAsset are used to
-    // handle some specific queries related to Offers.
+    // getAllOffers, getBestOffer, getOrderBook, and getOffersByAccountAndAsset
+    // are used to handle some specific queries related to Offers.
     // - getAllOffers
     //     Get XDR for every offer, grouped by account.
     // - getBestOffer
     //     Get XDR for the best offer with specified buying and selling assets.
+    // - getOrderBook
+    //     Get an OrderBookCursor enumerating XDR for the offers with specified
+    //     buying and selling assets, best offer first.
     // - getOffersByAccountAndAsset
-    //     Get XDR for every offer owned by the specified account that is either
-    //     buying or selling the specified asset.
+    //     Get the key of every offer owned by the specified account that is
+    //     either buying or selling the specified asset.
     virtual std::map<LedgerKey, LedgerEntry> getAllOffers() = 0;
     virtual std::shared_ptr<LedgerEntry const>
     getBestOffer(Asset const& buying, Asset const& selling,
                  std::set<LedgerKey>& exclude) = 0;
+    virtual OrderBookCursor getOrderBook(Asset const& buying,
+                                         Asset const& selling) = 0;
 
-    virtual std::map<LedgerKey, LedgerEntry>
+    virtual std::set<LedgerKey>
     getOffersByAccountAndAsset(AccountID const& account,
                                Asset const& asset) = 0;
 
@@ -296,6 +341,13 @@ class LedgerState final : public AbstractLedgerState
 
     virtual ~LedgerState();
 
+    // Number of copies of ledger entries made by all the LedgerState objects
+    // of the process. Entries are shared between a LedgerState and its parents
+    // until they are modified, so this is roughly the number of entries that
+    // were modified (or created) plus the number of entries whose last
+    // modified ledger was updated.
+    static uint64_t getEntryCopyCount();
+
     void addChild(AbstractLedgerState& child) override;
 
     void commit() override;
@@ -318,10 +370,13 @@ class LedgerState final : public AbstractLedgerState
 
     LedgerStateDelta getDelta() override;
 
-    std::map<LedgerKey, LedgerEntry>
+    std::set<LedgerKey>
     getOffersByAccountAndAsset(AccountID const& account,
                                Asset const& asset) override;
 
+    OrderBookCursor getOrderBook(Asset const& buying,
+                                 Asset const& selling) override;
+
     LedgerHeader const& getHeader() const override;
 
     std::vector<InflationWinner>
@@ -369,15 +424,35 @@ class LedgerState final : public AbstractLedgerState
     void unsealHeader(std::function<void(LedgerHeader&)> f) override;
 };
 
+// The LedgerState objects constructed on a thread while a
+// LedgerStateArenaScope exists on it allocate the nodes of their containers
+// from arena (a nullptr arena means the heap). Those LedgerState objects are
+// scratch data: they are expected to be committed or rolled back before the
+// scope ends, at which point the arena is reset if none of them is left.
+class LedgerStateArenaScope : NonMovableOrCopyable
+{
+    Arena* const mArena;
+    Arena* const mPrevious;
+
+  public:
+    explicit LedgerStateArenaScope(Arena* arena);
+    ~LedgerStateArenaScope();
+};
+
 class LedgerStateRoot : public AbstractLedgerStateParent
 {
     class Impl;
     std::unique_ptr<Impl> const mImpl;
 
   public:
+    // stores the entries in the ledger tables of db
     explicit LedgerStateRoot(Database& db, size_t entryCacheSize = 4096,
                              size_t bestOfferCacheSize = 64);
 
+    explicit LedgerStateRoot(std::unique_ptr<LedgerStateStore> store,
+                             size_t entryCacheSize = 4096,
+                             size_t bestOfferCacheSize = 64);
+
     virtual ~LedgerStateRoot();
 
     void addChild(AbstractLedgerState& child) override;
@@ -390,11 +465,31 @@ class LedgerStateRoot : public AbstractLedgerStateParent
 
     void deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) const;
 
+    // Scans the entries of type let whose lastModifiedLedgerSeq is in the
+    // given range and calls f with them in chunks of at most chunkSize
+    // entries, in no particular order. The scan holds the database session so
+    // f must not use it.
+    typedef std::function<void(std::vector<LedgerEntry>&&)> ObjectsChunkFn;
+    void loadObjects(LedgerEntryType let, LedgerRange const& ledgers,
+                     size_t chunkSize, ObjectsChunkFn const& f) const;
+
     void dropAccounts();
     void dropData();
     void dropOffers();
     void dropTrustLines();
 
+    // Lookups, hits and evictions of the entry cache since the root was
+    // created, along with its size and an estimate of the memory it holds
+    struct EntryCacheCounters
+    {
+        uint64_t mHits;
+        uint64_t mMisses;
+        uint64_t mEvictions;
+        size_t mSize;
+        size_t mFootprint;
+    };
+    EntryCacheCounters getEntryCacheCounters() const;
+
     std::map<LedgerKey, LedgerEntry> getAllOffers() override;
 
     std::shared_ptr<LedgerEntry const>
@@ -404,10 +499,13 @@ class LedgerStateRoot : public AbstractLedgerStateParent
     loadBestOffers(std::list<LedgerEntry>& offers, Asset const& buying,
                    Asset const& selling, size_t numOffers, size_t offset) const;
 
-    std::map<LedgerKey, LedgerEntry>
+    std::set<LedgerKey>
     getOffersByAccountAndAsset(AccountID const& account,
                                Asset const& asset) override;
 
+    OrderBookCursor getOrderBook(Asset const& buying,
+                                 Asset const& selling) override;
+
     LedgerHeader const& getHeader() const override;
 
     std::vector<InflationWinner>
@@ -6,7 +6,8 @@
 #include "crypto/SecretKey.h"
 #include "crypto/SignerKey.h"
 #include "database/Database.h"
-#include "ledger/LedgerStateImpl.h"
+#include "ledger/LedgerRange.h"
+#include "ledger/LedgerStateSQLStore.h"
 #include "util/Decoder.h"
 #include "util/XDROperators.h"
 #include "util/types.h"
@@ -14,11 +15,10 @@
 namespace stellar
 {
 
-std::shared_ptr<LedgerEntry const>
-LedgerStateRoot::Impl::loadAccount(LedgerKey const& key) const
+void
+LedgerStateSQLStore::forEachAccountRow(StatementContext& prep,
+                                       RowFn const& f) const
 {
-    std::string actIDStrKey = KeyUtils::toStrKey(key.account().accountID);
-
     std::string inflationDest, homeDomain, thresholds;
     soci::indicator inflationDestInd;
     Liabilities liabilities;
@@ -28,12 +28,6 @@ LedgerStateRoot::Impl::loadAccount(LedgerKey const& key) const
     le.data.type(ACCOUNT);
     auto& account = le.data.account();
 
-    auto prep =
-        mDatabase.getPreparedStatement("SELECT balance, seqnum, numsubentries, "
-                                       "inflationdest, homedomain, thresholds, "
-                                       "flags, lastmodified, "
-                                       "buyingliabilities, sellingliabilities "
-                                       "FROM accounts WHERE accountid=:v1");
     auto& st = prep.statement();
     st.exchange(soci::into(account.balance));
     st.exchange(soci::into(account.seqNum));
@@ -45,49 +39,77 @@ LedgerStateRoot::Impl::loadAccount(LedgerKey const& key) const
     st.exchange(soci::into(le.lastModifiedLedgerSeq));
     st.exchange(soci::into(liabilities.buying, buyingLiabilitiesInd));
     st.exchange(soci::into(liabilities.selling, sellingLiabilitiesInd));
-    st.exchange(soci::use(actIDStrKey));
     st.define_and_bind();
     {
         auto timer = mDatabase.getSelectTimer("account");
         st.execute(true);
     }
-    if (!st.got_data())
+    while (st.got_data())
     {
-        return nullptr;
+        account.homeDomain = homeDomain;
+
+        bn::decode_b64(thresholds.begin(), thresholds.end(),
+                       account.thresholds.begin());
+
+        account.inflationDest.reset();
+        if (inflationDestInd == soci::i_ok)
+        {
+            account.inflationDest.activate() =
+                KeyUtils::fromStrKey<PublicKey>(inflationDest);
+        }
+
+        account.signers.clear();
+
+        assert(buyingLiabilitiesInd == sellingLiabilitiesInd);
+        account.ext.v(0);
+        if (buyingLiabilitiesInd == soci::i_ok)
+        {
+            account.ext.v(1);
+            account.ext.v1().liabilities = liabilities;
+        }
+
+        f(le);
+        st.fetch();
     }
+}
 
-    account.accountID = key.account().accountID;
-    account.homeDomain = homeDomain;
+std::shared_ptr<LedgerEntry const>
+LedgerStateSQLStore::loadAccount(LedgerKey const& key) const
+{
+    std::string actIDStrKey = KeyUtils::toStrKey(key.account().accountID);
 
-    bn::decode_b64(thresholds.begin(), thresholds.end(),
-                   account.thresholds.begin());
+    static RegisteredStatement const sql(
+        "SELECT balance, seqnum, numsubentries, "
+        "inflationdest, homedomain, thresholds, "
+        "flags, lastmodified, "
+        "buyingliabilities, sellingliabilities "
+        "FROM accounts WHERE accountid=:v1");
+    auto prep = mDatabase.getPreparedStatement(sql);
+    auto& st = prep.statement();
+    st.exchange(soci::use(actIDStrKey));
 
-    if (inflationDestInd == soci::i_ok)
+    std::shared_ptr<LedgerEntry> res;
+    forEachAccountRow(prep, [&](LedgerEntry& le) {
+        res = std::make_shared<LedgerEntry>(le);
+    });
+    if (!res)
     {
-        account.inflationDest.activate() =
-            KeyUtils::fromStrKey<PublicKey>(inflationDest);
+        return nullptr;
     }
 
-    account.signers.clear();
+    auto& account = res->data.account();
+    account.accountID = key.account().accountID;
     if (account.numSubEntries != 0)
     {
         auto signers = loadSigners(key);
         account.signers.insert(account.signers.begin(), signers.begin(),
                                signers.end());
     }
-
-    assert(buyingLiabilitiesInd == sellingLiabilitiesInd);
-    if (buyingLiabilitiesInd == soci::i_ok)
-    {
-        account.ext.v(1);
-        account.ext.v1().liabilities = liabilities;
-    }
-
-    return std::make_shared<LedgerEntry const>(std::move(le));
+    return res;
 }
 
 std::vector<Signer>
-LedgerStateRoot::Impl::loadSigners(LedgerKey const& key) const
+LedgerStateSQLStore::loadSigners(LedgerKey const& key) const
 {
     std::vector<Signer> res;
 
@@ -96,8 +118,9 @@ LedgerStateRoot::Impl::loadSigners(LedgerKey const& key) const
     std::string pubKey;
     Signer signer;
 
-    auto prep = mDatabase.getPreparedStatement(
+    static RegisteredStatement const sql(
         "SELECT publickey, weight FROM signers WHERE accountid =:id");
+    auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
     st.exchange(soci::use(actIDStrKey));
     st.exchange(soci::into(pubKey));
@@ -120,9 +143,79 @@ LedgerStateRoot::Impl::loadSigners(LedgerKey const& key) const
     return res;
 }
 
+void
+LedgerStateSQLStore::loadAccounts(LedgerRange const& ledgers,
+                                  size_t chunkSize,
+                                  ObjectsChunkFn const& f) const
+{
+    uint32_t first = ledgers.first();
+    uint32_t last = ledgers.last();
+
+    // signers of the accounts in range are loaded up front as the accounts
+    // are streamed from a statement that stays open until the scan is done
+    std::map<std::string, std::vector<Signer>> signers;
+    {
+        std::string actIDStrKey, pubKey;
+        Signer signer;
+        auto prep = mDatabase.getPreparedStatement(
+            "SELECT accountid, publickey, weight FROM signers WHERE accountid "
+            "IN (SELECT accountid FROM accounts "
+            "WHERE lastmodified >= :v1 AND lastmodified <= :v2)");
+        auto& st = prep.statement();
+        st.exchange(soci::into(actIDStrKey));
+        st.exchange(soci::into(pubKey));
+        st.exchange(soci::into(signer.weight));
+        st.exchange(soci::use(first));
+        st.exchange(soci::use(last));
+        st.define_and_bind();
+        {
+            auto timer = mDatabase.getSelectTimer("signer");
+            st.execute(true);
+        }
+        while (st.got_data())
+        {
+            signer.key = KeyUtils::fromStrKey<SignerKey>(pubKey);
+            signers[actIDStrKey].push_back(signer);
+            st.fetch();
+        }
+    }
+
+    // the key comes before the columns read by forEachAccountRow
+    std::string actIDStrKey;
+    auto prep = mDatabase.getPreparedStatement(
+        "SELECT accountid, balance, seqnum, numsubentries, inflationdest, "
+        "homedomain, thresholds, flags, lastmodified, buyingliabilities, "
+        "sellingliabilities FROM accounts "
+        "WHERE lastmodified >= :v1 AND lastmodified <= :v2");
+    auto& st = prep.statement();
+    st.exchange(soci::into(actIDStrKey));
+    st.exchange(soci::use(first));
+    st.exchange(soci::use(last));
+
+    ChunkedRows chunks(chunkSize, f);
+    forEachAccountRow(prep, [&](LedgerEntry& le) {
+        auto& account = le.data.account();
+        account.accountID = KeyUtils::fromStrKey<PublicKey>(actIDStrKey);
+        auto it = signers.find(actIDStrKey);
+        if (account.numSubEntries != 0 && it != signers.end())
+        {
+            auto& accountSigners = it->second;
+            std::sort(accountSigners.begin(), accountSigners.end(),
+                      [](Signer const& lhs, Signer const& rhs) {
+                          return lhs.key < rhs.key;
+                      });
+            account.signers.insert(account.signers.begin(),
+                                   accountSigners.begin(),
+                                   accountSigners.end());
+        }
+        chunks.add(le);
+    });
+    chunks.flush();
+}
+
 std::vector<InflationWinner>
-LedgerStateRoot::Impl::loadInflationWinners(size_t maxWinners,
-                                            int64_t minBalance) const
+LedgerStateSQLStore::loadInflationWinners(size_t maxWinners,
+                                          int64_t minBalance) const
 {
     InflationWinner w;
     std::string inflationDest;
@@ -154,8 +247,8 @@ LedgerStateRoot::Impl::loadInflationWinners(size_t maxWinners,
 }
 
 void
-LedgerStateRoot::Impl::insertOrUpdateAccount(LedgerEntry const& entry,
-                                             bool isInsert)
+LedgerStateSQLStore::insertOrUpdateAccount(LedgerEntry const& entry,
+                                           bool isInsert)
 {
     auto const& account = entry.data.account();
     std::string actIDStrKey = KeyUtils::toStrKey(account.accountID);
@@ -179,24 +272,20 @@ LedgerStateRoot::Impl::insertOrUpdateAccount(LedgerEntry const& entry,
     std::string thresholds(decoder::encode_b64(account.thresholds));
     std::string homeDomain(account.homeDomain);
 
-    std::string sql;
-    if (isInsert)
-    {
-        sql = "INSERT INTO accounts ( accountid, balance, seqnum, "
-              "numsubentries, inflationdest, homedomain, thresholds, flags, "
-              "lastmodified, buyingliabilities, sellingliabilities ) "
-              "VALUES ( :id, :v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8, :v9, :v10 "
-              ")";
-    }
-    else
-    {
-        sql = "UPDATE accounts SET balance = :v1, seqnum = :v2, "
-              "numsubentries = :v3, inflationdest = :v4, homedomain = :v5, "
-              "thresholds = :v6, flags = :v7, lastmodified = :v8, "
-              "buyingliabilities = :v9, sellingliabilities = :v10 "
-              "WHERE accountid = :id";
-    }
-    auto prep = mDatabase.getPreparedStatement(sql);
+    static RegisteredStatement const insertSql(
+        "INSERT INTO accounts ( accountid, balance, seqnum, "
+        "numsubentries, inflationdest, homedomain, thresholds, flags, "
+        "lastmodified, buyingliabilities, sellingliabilities ) "
+        "VALUES ( :id, :v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8, :v9, :v10 "
+        ")");
+    static RegisteredStatement const updateSql(
+        "UPDATE accounts SET balance = :v1, seqnum = :v2, "
+        "numsubentries = :v3, inflationdest = :v4, homedomain = :v5, "
+        "thresholds = :v6, flags = :v7, lastmodified = :v8, "
+        "buyingliabilities = :v9, sellingliabilities = :v10 "
+        "WHERE accountid = :id");
+    auto prep =
+        mDatabase.getPreparedStatement(isInsert ? insertSql : updateSql);
     soci::statement& st = prep.statement();
     st.exchange(soci::use(actIDStrKey, "id"));
     st.exchange(soci::use(account.balance, "v1"));
@@ -222,7 +311,7 @@ LedgerStateRoot::Impl::insertOrUpdateAccount(LedgerEntry const& entry,
 }
 
 void
-LedgerStateRoot::Impl::storeSigners(
+LedgerStateSQLStore::storeSigners(
     LedgerEntry const& entry,
     std::shared_ptr<LedgerEntry const> const& previous)
 {
@@ -272,9 +361,10 @@ LedgerStateRoot::Impl::storeSigners(
             {
                 std::string signerStrKey = KeyUtils::toStrKey(it_new->key);
                 auto timer = mDatabase.getUpdateTimer("signer");
-                auto prep = mDatabase.getPreparedStatement(
+                static RegisteredStatement const sql(
                     "UPDATE signers set weight=:v1 WHERE "
                     "accountid=:v2 AND publickey=:v3");
+                auto prep = mDatabase.getPreparedStatement(sql);
                 auto& st = prep.statement();
                 st.exchange(soci::use(it_new->weight));
                 st.exchange(soci::use(actIDStrKey));
@@ -294,9 +384,10 @@ LedgerStateRoot::Impl::storeSigners(
             // signer was added
             std::string signerStrKey = KeyUtils::toStrKey(it_new->key);
 
-            auto prep = mDatabase.getPreparedStatement(
+            static RegisteredStatement const sql(
                 "INSERT INTO signers (accountid,publickey,weight) "
                 "VALUES (:v1,:v2,:v3)");
+            auto prep = mDatabase.getPreparedStatement(sql);
             auto& st = prep.statement();
             st.exchange(soci::use(actIDStrKey));
             st.exchange(soci::use(signerStrKey));
@@ -314,8 +405,9 @@ LedgerStateRoot::Impl::storeSigners(
             // signer was deleted
             std::string signerStrKey = KeyUtils::toStrKey(it_old->key);
 
-            auto prep = mDatabase.getPreparedStatement(
+            static RegisteredStatement const sql(
                 "DELETE from signers WHERE accountid=:v2 AND publickey=:v3");
+            auto prep = mDatabase.getPreparedStatement(sql);
             auto& st = prep.statement();
             st.exchange(soci::use(actIDStrKey));
             st.exchange(soci::use(signerStrKey));
@@ -334,13 +426,14 @@ LedgerStateRoot::Impl::storeSigners(
 }
 
 void
-LedgerStateRoot::Impl::deleteAccount(LedgerKey const& key)
+LedgerStateSQLStore::deleteAccount(LedgerKey const& key)
 {
     std::string actIDStrKey = KeyUtils::toStrKey(key.account().accountID);
 
     {
-        auto prep = mDatabase.getPreparedStatement(
+        static RegisteredStatement const sql(
             "DELETE FROM accounts WHERE accountid= :v1");
+        auto prep = mDatabase.getPreparedStatement(sql);
         auto& st = prep.statement();
         st.exchange(soci::use(actIDStrKey));
         st.define_and_bind();
@@ -355,8 +448,9 @@ LedgerStateRoot::Impl::deleteAccount(LedgerKey const& key)
     }
 
     {
-        auto prep = mDatabase.getPreparedStatement(
+        static RegisteredStatement const sql(
             "DELETE FROM signers WHERE accountid= :v1");
+        auto prep = mDatabase.getPreparedStatement(sql);
         auto& st = prep.statement();
         st.exchange(soci::use(actIDStrKey));
         st.define_and_bind();
@@ -368,12 +462,8 @@ LedgerStateRoot::Impl::deleteAccount(LedgerKey const& key)
 }
 
 void
-LedgerStateRoot::Impl::dropAccounts()
+LedgerStateSQLStore::dropAccounts()
 {
-    throwIfChild();
-    mEntryCache.clear();
-    mBestOffersCache.clear();
-
     mDatabase.getSession() << "DROP TABLE IF EXISTS accounts;";
     mDatabase.getSession() << "DROP TABLE IF EXISTS signers;";
 
@@ -5,18 +5,17 @@
 #include "crypto/KeyUtils.h"
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
-#include "ledger/LedgerStateImpl.h"
+#include "ledger/LedgerRange.h"
+#include "ledger/LedgerStateSQLStore.h"
 #include "util/Decoder.h"
 
 namespace stellar
 {
 
-std::shared_ptr<LedgerEntry const>
-LedgerStateRoot::Impl::loadData(LedgerKey const& key) const
+void
+LedgerStateSQLStore::forEachDataRow(StatementContext& prep,
+                                    RowFn const& f) const
 {
-    std::string actIDStrKey = KeyUtils::toStrKey(key.data().accountID);
-    std::string const& dataName = key.data().dataName;
-
     std::string dataValue;
     soci::indicator dataValueIndicator;
 
@@ -24,57 +23,97 @@ LedgerStateRoot::Impl::loadData(LedgerKey const& key) const
     le.data.type(DATA);
     DataEntry& de = le.data.data();
 
-    std::string sql = "SELECT datavalue, lastmodified "
-                      "FROM accountdata "
-                      "WHERE accountid= :id AND dataname= :dataname";
-    auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
     st.exchange(soci::into(dataValue, dataValueIndicator));
     st.exchange(soci::into(le.lastModifiedLedgerSeq));
-    st.exchange(soci::use(actIDStrKey));
-    st.exchange(soci::use(dataName));
     st.define_and_bind();
     st.execute(true);
-    if (!st.got_data())
+    while (st.got_data())
     {
-        return nullptr;
+        if (dataValueIndicator != soci::i_ok)
+        {
+            throw std::runtime_error("bad database state");
+        }
+        decoder::decode_b64(dataValue, de.dataValue);
+
+        f(le);
+        st.fetch();
     }
+}
 
-    de.accountID = key.data().accountID;
-    de.dataName = dataName;
+std::shared_ptr<LedgerEntry const>
+LedgerStateSQLStore::loadData(LedgerKey const& key) const
+{
+    std::string actIDStrKey = KeyUtils::toStrKey(key.data().accountID);
+    std::string const& dataName = key.data().dataName;
 
-    if (dataValueIndicator != soci::i_ok)
-    {
-        throw std::runtime_error("bad database state");
-    }
-    decoder::decode_b64(dataValue, de.dataValue);
+    static RegisteredStatement const sql(
+        "SELECT datavalue, lastmodified "
+        "FROM accountdata "
+        "WHERE accountid= :id AND dataname= :dataname");
+    auto prep = mDatabase.getPreparedStatement(sql);
+    auto& st = prep.statement();
+    st.exchange(soci::use(actIDStrKey));
+    st.exchange(soci::use(dataName));
 
-    return std::make_shared<LedgerEntry const>(std::move(le));
+    std::shared_ptr<LedgerEntry> res;
+    forEachDataRow(prep, [&](LedgerEntry& le) {
+        auto& de = le.data.data();
+        de.accountID = key.data().accountID;
+        de.dataName = dataName;
+        res = std::make_shared<LedgerEntry>(le);
+    });
+    return res;
 }
 
 void
-LedgerStateRoot::Impl::insertOrUpdateData(LedgerEntry const& entry,
-                                          bool isInsert)
+LedgerStateSQLStore::loadData(LedgerRange const& ledgers, size_t chunkSize,
+                              ObjectsChunkFn const& f) const
+{
+    uint32_t first = ledgers.first();
+    uint32_t last = ledgers.last();
+
+    // the key comes before the columns read by forEachDataRow
+    std::string actIDStrKey, dataName;
+    std::string sql = "SELECT accountid, dataname, datavalue, lastmodified "
+                      "FROM accountdata "
+                      "WHERE lastmodified >= :v1 AND lastmodified <= :v2";
+    auto prep = mDatabase.getPreparedStatement(sql);
+    auto& st = prep.statement();
+    st.exchange(soci::into(actIDStrKey));
+    st.exchange(soci::into(dataName));
+    st.exchange(soci::use(first));
+    st.exchange(soci::use(last));
+
+    ChunkedRows chunks(chunkSize, f);
+    forEachDataRow(prep, [&](LedgerEntry& le) {
+        auto& de = le.data.data();
+        de.accountID = KeyUtils::fromStrKey<PublicKey>(actIDStrKey);
+        de.dataName = dataName;
+        chunks.add(le);
+    });
+    chunks.flush();
+}
+
+void
+LedgerStateSQLStore::insertOrUpdateData(LedgerEntry const& entry,
+                                        bool isInsert)
 {
     auto const& data = entry.data.data();
     std::string actIDStrKey = KeyUtils::toStrKey(data.accountID);
     std::string const& dataName = data.dataName;
     std::string dataValue = decoder::encode_b64(data.dataValue);
 
-    std::string sql;
-    if (isInsert)
-    {
-        sql = "INSERT INTO accountdata "
-              "(accountid,dataname,datavalue,lastmodified)"
-              " VALUES (:aid,:dn,:dv,:lm)";
-    }
-    else
-    {
-        sql = "UPDATE accountdata SET datavalue=:dv,lastmodified=:lm "
-              " WHERE accountid=:aid AND dataname=:dn";
-    }
+    static RegisteredStatement const insertSql(
+        "INSERT INTO accountdata "
+        "(accountid,dataname,datavalue,lastmodified)"
+        " VALUES (:aid,:dn,:dv,:lm)");
+    static RegisteredStatement const updateSql(
+        "UPDATE accountdata SET datavalue=:dv,lastmodified=:lm "
+        " WHERE accountid=:aid AND dataname=:dn");
 
-    auto prep = mDatabase.getPreparedStatement(sql);
+    auto prep =
+        mDatabase.getPreparedStatement(isInsert ? insertSql : updateSql);
     auto& st = prep.statement();
     st.exchange(soci::use(actIDStrKey, "aid"));
     st.exchange(soci::use(dataName, "dn"));
@@ -89,14 +128,15 @@ LedgerStateRoot::Impl::insertOrUpdateData(LedgerEntry const& entry,
 }
 
 void
-LedgerStateRoot::Impl::deleteData(LedgerKey const& key)
+LedgerStateSQLStore::deleteData(LedgerKey const& key)
 {
     auto const& data = key.data();
     std::string actIDStrKey = KeyUtils::toStrKey(data.accountID);
     std::string const& dataName = data.dataName;
 
-    auto prep = mDatabase.getPreparedStatement(
+    static RegisteredStatement const sql(
         "DELETE FROM accountdata WHERE accountid=:id AND dataname=:s");
+    auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
     st.exchange(soci::use(actIDStrKey));
     st.exchange(soci::use(dataName));
@@ -112,12 +152,8 @@ LedgerStateRoot::Impl::deleteData(LedgerKey const& key)
 }
 
 void
-LedgerStateRoot::Impl::dropData()
+LedgerStateSQLStore::dropData()
 {
-    throwIfChild();
-    mEntryCache.clear();
-    mBestOffersCache.clear();
-
     mDatabase.getSession() << "DROP TABLE IF EXISTS accountdata;";
     mDatabase.getSession() << "CREATE TABLE accountdata"
                               "("
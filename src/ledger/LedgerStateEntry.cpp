@@ -4,9 +4,11 @@
 
 #include "ledger/LedgerStateEntry.h"
 #include "ledger/LedgerState.h"
+#include "ledger/LedgerStateImpl.h"
 #include "util/XDROperators.h"
 #include "util/types.h"
 #include "xdr/Stellar-ledger-entries.h"
+#include <atomic>
 
 namespace stellar
 {
@@ -15,10 +17,13 @@ namespace stellar
 class LedgerStateEntry::Impl : public EntryImplBase
 {
     AbstractLedgerState& mLedgerState;
-    LedgerEntry& mCurrent;
+    std::shared_ptr<LedgerEntry const>& mCurrent;
+    // set once the entry can be modified
+    LedgerEntry* mModifiable;
 
   public:
-    explicit Impl(AbstractLedgerState& ls, LedgerEntry& current);
+    explicit Impl(AbstractLedgerState& ls,
+                  std::shared_ptr<LedgerEntry const>& current);
 
     ~Impl() override;
 
@@ -39,7 +44,8 @@ class LedgerStateEntry::Impl : public EntryImplBase
 };
 
 std::shared_ptr<LedgerStateEntry::Impl>
-LedgerStateEntry::makeSharedImpl(AbstractLedgerState& ls, LedgerEntry& current)
+LedgerStateEntry::makeSharedImpl(AbstractLedgerState& ls,
+                                 std::shared_ptr<LedgerEntry const>& current)
 {
     return std::make_shared<Impl>(ls, current);
 }
@@ -59,8 +65,9 @@ LedgerStateEntry::LedgerStateEntry(std::shared_ptr<Impl> const& impl)
 {
 }
 
-LedgerStateEntry::Impl::Impl(AbstractLedgerState& ls, LedgerEntry& current)
-    : mLedgerState(ls), mCurrent(current)
+LedgerStateEntry::Impl::Impl(AbstractLedgerState& ls,
+                             std::shared_ptr<LedgerEntry const>& current)
+    : mLedgerState(ls), mCurrent(current), mModifiable(nullptr)
 {
 }
 
@@ -119,13 +126,32 @@ LedgerStateEntry::current() const
 LedgerEntry&
 LedgerStateEntry::Impl::current()
 {
-    return mCurrent;
+    if (!mModifiable)
+    {
+        // Entries may be shared with the parents of the LedgerState, with the
+        // entry cache of the root, or with whoever holds them (such as an
+        // invariant being checked on another thread), so they are copied
+        // before being modified unless mCurrent is the only owner. The fence
+        // orders the accesses of the previous owners before the modifications.
+        if (mCurrent.use_count() == 1)
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        else
+        {
+            // std::shared_ptr assignment is noexcept
+            mCurrent = copyLedgerEntry(*mCurrent);
+        }
+        // All entries are allocated as non-const LedgerEntry objects
+        mModifiable = const_cast<LedgerEntry*>(mCurrent.get());
+    }
+    return *mModifiable;
 }
 
 LedgerEntry const&
 LedgerStateEntry::Impl::current() const
 {
-    return mCurrent;
+    return *mCurrent;
 }
 
 void
@@ -137,7 +163,7 @@ LedgerStateEntry::deactivate()
 void
 LedgerStateEntry::Impl::deactivate()
 {
-    auto key = LedgerEntryKey(mCurrent);
+    auto key = LedgerEntryKey(*mCurrent);
     mLedgerState.deactivate(key);
 }
 
@@ -150,7 +176,7 @@ LedgerStateEntry::erase()
 void
 LedgerStateEntry::Impl::erase()
 {
-    auto key = LedgerEntryKey(mCurrent);
+    auto key = LedgerEntryKey(*mCurrent);
     mLedgerState.erase(key);
 }
 
@@ -186,10 +212,11 @@ LedgerStateEntry::swap(LedgerStateEntry& other)
 class ConstLedgerStateEntry::Impl : public EntryImplBase
 {
     AbstractLedgerState& mLedgerState;
-    LedgerEntry const mCurrent;
+    std::shared_ptr<LedgerEntry const> const mCurrent;
 
   public:
-    explicit Impl(AbstractLedgerState& ls, LedgerEntry const& current);
+    explicit Impl(AbstractLedgerState& ls,
+                  std::shared_ptr<LedgerEntry const> const& current);
 
     ~Impl() override;
 
@@ -207,8 +234,8 @@ class ConstLedgerStateEntry::Impl : public EntryImplBase
 };
 
 std::shared_ptr<ConstLedgerStateEntry::Impl>
-ConstLedgerStateEntry::makeSharedImpl(AbstractLedgerState& ls,
-                                      LedgerEntry const& current)
+ConstLedgerStateEntry::makeSharedImpl(
+    AbstractLedgerState& ls, std::shared_ptr<LedgerEntry const> const& current)
 {
     return std::make_shared<Impl>(ls, current);
 }
@@ -228,8 +255,8 @@ ConstLedgerStateEntry::ConstLedgerStateEntry(std::shared_ptr<Impl> const& impl)
 {
 }
 
-ConstLedgerStateEntry::Impl::Impl(AbstractLedgerState& ls,
-                                  LedgerEntry const& current)
+ConstLedgerStateEntry::Impl::Impl(
+    AbstractLedgerState& ls, std::shared_ptr<LedgerEntry const> const& current)
     : mLedgerState(ls), mCurrent(current)
 {
 }
@@ -283,7 +310,7 @@ ConstLedgerStateEntry::current() const
 LedgerEntry const&
 ConstLedgerStateEntry::Impl::current() const
 {
-    return mCurrent;
+    return *mCurrent;
 }
 
 std::shared_ptr<ConstLedgerStateEntry::Impl>
@@ -317,7 +344,7 @@ ConstLedgerStateEntry::deactivate()
 void
 ConstLedgerStateEntry::Impl::deactivate()
 {
-    auto key = LedgerEntryKey(mCurrent);
+    auto key = LedgerEntryKey(*mCurrent);
     mLedgerState.deactivate(key);
 }
 
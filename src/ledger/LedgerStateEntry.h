@@ -57,8 +57,12 @@ class LedgerStateEntry
 
     void swap(LedgerStateEntry& other);
 
-    static std::shared_ptr<Impl> makeSharedImpl(AbstractLedgerState& ls,
-                                                LedgerEntry& current);
+    // current is the element of the AbstractLedgerState storing the entry, it
+    // is replaced with a copy the first time the entry is modified unless it
+    // is not shared
+    static std::shared_ptr<Impl>
+    makeSharedImpl(AbstractLedgerState& ls,
+                   std::shared_ptr<LedgerEntry const>& current);
 };
 
 class ConstLedgerStateEntry
@@ -95,8 +99,9 @@ class ConstLedgerStateEntry
 
     void swap(ConstLedgerStateEntry& other);
 
-    static std::shared_ptr<Impl> makeSharedImpl(AbstractLedgerState& ls,
-                                                LedgerEntry const& current);
+    static std::shared_ptr<Impl>
+    makeSharedImpl(AbstractLedgerState& ls,
+                   std::shared_ptr<LedgerEntry const> const& current);
 };
 
 std::shared_ptr<EntryImplBase>
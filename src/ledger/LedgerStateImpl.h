@@ -3,12 +3,23 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "database/Database.h"
+#include "ledger/LedgerHashUtils.h"
 #include "ledger/LedgerState.h"
+#include "ledger/LedgerStateStore.h"
+#include "util/Arena.h"
+#include "util/ClockCache.h"
 #include "util/lrucache.hpp"
+#include <unordered_map>
+#include <unordered_set>
 
 namespace stellar
 {
 
+// Copies entry, the copies of the entries stored by LedgerState objects are
+// all made by this function so that they are counted (see
+// LedgerState::getEntryCopyCount).
+std::shared_ptr<LedgerEntry> copyLedgerEntry(LedgerEntry const& entry);
+
 class EntryIterator::AbstractImpl
 {
   public:
@@ -22,11 +33,27 @@ class EntryIterator::AbstractImpl
 
     virtual LedgerEntry const& entry() const = 0;
 
+    virtual std::shared_ptr<LedgerEntry const> const& entryPtr() const = 0;
+
     virtual bool entryExists() const = 0;
 
     virtual LedgerKey const& key() const = 0;
 };
 
+class OrderBookCursor::AbstractImpl
+{
+  public:
+    virtual ~AbstractImpl()
+    {
+    }
+
+    virtual void advance() = 0;
+
+    virtual bool atEnd() const = 0;
+
+    virtual LedgerEntry const& entry() const = 0;
+};
+
 // Many functions in LedgerState::Impl provide a basic exception safety
 // guarantee that states that certain caches may be modified or cleared if an
 // exception is thrown. It is always safe to continue using the LedgerState
@@ -40,21 +67,56 @@ class EntryIterator::AbstractImpl
 class LedgerState::Impl
 {
     class EntryIteratorImpl;
-
-    typedef std::map<LedgerKey, std::shared_ptr<LedgerEntry>> EntryMap;
-
+    class OrderBookCursorImpl;
+
+    // Entries are immutable once they are shared: load stores the newest
+    // version of the parent (without copying it), commitChild keeps the
+    // entries of the child, and so on. An entry is copied when it is first
+    // modified through a LedgerStateEntry unless this LedgerState is its only
+    // owner (see LedgerStateEntry::Impl::current). All entries are allocated
+    // as non-const LedgerEntry objects, which is what makes the modification
+    // of an entry that is not shared well-defined.
+    //
+    // The maps are unordered (the few results that must be deterministic are
+    // sorted when they are produced, see getChanges) and node based, as a
+    // LedgerStateEntry refers to the element of mEntry of its entry. Their
+    // nodes come from the arena of the LedgerStateArenaScope in which the
+    // LedgerState was constructed, if any.
+    typedef std::unordered_map<
+        LedgerKey, std::shared_ptr<LedgerEntry const>, std::hash<LedgerKey>,
+        std::equal_to<LedgerKey>,
+        ArenaAllocator<
+            std::pair<LedgerKey const, std::shared_ptr<LedgerEntry const>>>>
+        EntryMap;
+    typedef std::unordered_map<
+        LedgerKey, std::shared_ptr<EntryImplBase>, std::hash<LedgerKey>,
+        std::equal_to<LedgerKey>,
+        ArenaAllocator<
+            std::pair<LedgerKey const, std::shared_ptr<EntryImplBase>>>>
+        ActiveMap;
+
+    Arena* const mArena;
     AbstractLedgerStateParent& mParent;
     AbstractLedgerState* mChild;
     std::unique_ptr<LedgerHeader> mHeader;
     std::shared_ptr<LedgerStateHeader::Impl> mActiveHeader;
     EntryMap mEntry;
-    std::map<LedgerKey, std::shared_ptr<EntryImplBase>> mActive;
+    ActiveMap mActive;
+    // The keys of the offers in mEntry by seller, so that the offers of an
+    // account are found without going through all of mEntry. Keys are added
+    // before they are inserted in mEntry and never removed, so this may also
+    // hold keys that are no longer in mEntry.
+    std::unordered_map<AccountID, std::unordered_set<LedgerKey>>
+        mOffersBySeller;
     bool const mShouldUpdateLastModified;
     bool mIsSealed;
 
     void throwIfChild() const;
     void throwIfSealed() const;
 
+    // indexOffer has the strong exception safety guarantee
+    void indexOffer(LedgerKey const& key);
+
     // getDeltaVotes has the basic exception safety guarantee. If it throws an
     // exception, then
     // - the prepared statement cache may be, but is not guaranteed to be,
@@ -79,6 +141,10 @@ class LedgerState::Impl
     // maybeUpdateLastModified has the strong exception safety guarantee
     EntryMap maybeUpdateLastModified() const;
 
+    // activate has the strong exception safety guarantee
+    LedgerStateEntry activate(LedgerState& self, LedgerKey const& key,
+                              std::shared_ptr<LedgerEntry const> current);
+
     // maybeUpdateLastModifiedThenInvokeThenSeal has the same exception safety
     // guarantee as f
     void maybeUpdateLastModifiedThenInvokeThenSeal(
@@ -89,6 +155,8 @@ class LedgerState::Impl
     Impl(LedgerState& self, AbstractLedgerStateParent& parent,
          bool shouldUpdateLastModified);
 
+    ~Impl();
+
     // addChild has the strong exception safety guarantee
     void addChild(AbstractLedgerState& child);
 
@@ -157,9 +225,17 @@ class LedgerState::Impl
     // it throws an exception, then
     // - the prepared statement cache may be, but is not guaranteed to be,
     //   modified
-    std::map<LedgerKey, LedgerEntry>
+    std::set<LedgerKey>
     getOffersByAccountAndAsset(AccountID const& account, Asset const& asset);
 
+    // getOrderBook has the basic exception safety guarantee. If it throws an
+    // exception, then
+    // - the prepared statement cache may be, but is not guaranteed to be,
+    //   modified
+    // - the best offers cache may be, but is not guaranteed to be, modified or
+    //   even cleared
+    OrderBookCursor getOrderBook(Asset const& buying, Asset const& selling);
+
     // getHeader does not throw
     LedgerHeader const& getHeader() const;
 
@@ -271,11 +347,41 @@ class LedgerState::Impl::EntryIteratorImpl : public EntryIterator::AbstractImpl
 
     LedgerEntry const& entry() const override;
 
+    std::shared_ptr<LedgerEntry const> const& entryPtr() const override;
+
     bool entryExists() const override;
 
     LedgerKey const& key() const override;
 };
 
+// Merges the offers stored in a LedgerState (sorted once when the cursor is
+// created) with the cursor of its parent, skipping the offers of the parent
+// that are shadowed by an entry of the LedgerState.
+class LedgerState::Impl::OrderBookCursorImpl
+    : public OrderBookCursor::AbstractImpl
+{
+    LedgerState::Impl::EntryMap const& mEntry;
+    std::vector<std::shared_ptr<LedgerEntry const>> mOffers;
+    size_t mNext;
+    OrderBookCursor mParentCursor;
+    bool mFromParent;
+
+    void skipShadowed();
+    void selectCurrent();
+
+  public:
+    OrderBookCursorImpl(
+        LedgerState::Impl::EntryMap const& entries,
+        std::vector<std::shared_ptr<LedgerEntry const>>&& offers,
+        OrderBookCursor&& parentCursor);
+
+    void advance() override;
+
+    bool atEnd() const override;
+
+    LedgerEntry const& entry() const override;
+};
+
 // Many functions in LedgerStateRoot::Impl provide a basic exception safety
 // guarantee that states that certain caches may be modified or cleared if an
 // exception is thrown. It is always safe to continue using the LedgerState
@@ -288,8 +394,14 @@ class LedgerState::Impl::EntryIteratorImpl : public EntryIterator::AbstractImpl
 // been lost.
 class LedgerStateRoot::Impl
 {
-    typedef std::string EntryCacheKey;
-    typedef cache::lru_cache<EntryCacheKey, std::shared_ptr<LedgerEntry const>>
+    class OrderBookCursorImpl;
+
+    typedef LedgerStateRoot::ObjectsChunkFn ObjectsChunkFn;
+    typedef LedgerStateRoot::EntryCacheCounters EntryCacheCounters;
+
+    // keyed by the LedgerKey itself (hashed in place) rather than by its
+    // serialized form, missing entries are cached as nullptr
+    typedef ClockCache<LedgerKey, std::shared_ptr<LedgerEntry const>>
         EntryCache;
 
     typedef std::string BestOffersCacheKey;
@@ -298,78 +410,38 @@ class LedgerStateRoot::Impl
         std::list<LedgerEntry> bestOffers;
         bool allLoaded;
     };
-    typedef cache::lru_cache<std::string, BestOffersCacheEntry> BestOffersCache;
-
-    Database& mDatabase;
+    // entries are shared so that an OrderBookCursor can keep enumerating (and
+    // loading) offers even if the entry is evicted
+    typedef cache::lru_cache<std::string, std::shared_ptr<BestOffersCacheEntry>>
+        BestOffersCache;
+
+    // keys of the offers of an account that buy or sell an asset, keyed by the
+    // account followed by the asset
+    typedef cache::lru_cache<std::string,
+                             std::shared_ptr<std::set<LedgerKey> const>>
+        OffersByAccountCache;
+
+    std::unique_ptr<LedgerStateStore> const mStore;
     std::unique_ptr<LedgerHeader> mHeader;
     mutable EntryCache mEntryCache;
     mutable BestOffersCache mBestOffersCache;
-    std::unique_ptr<soci::transaction> mTransaction;
+    mutable OffersByAccountCache mOffersByAccountCache;
     AbstractLedgerState* mChild;
 
     void throwIfChild() const;
 
-    std::shared_ptr<LedgerEntry const> loadAccount(LedgerKey const& key) const;
-    std::shared_ptr<LedgerEntry const> loadData(LedgerKey const& key) const;
-    std::shared_ptr<LedgerEntry const> loadOffer(LedgerKey const& key) const;
-    std::vector<LedgerEntry> loadAllOffers() const;
-    std::list<LedgerEntry>::const_iterator
-    loadOffers(StatementContext& prep, std::list<LedgerEntry>& offers) const;
-    std::vector<LedgerEntry>
-    loadOffersByAccountAndAsset(AccountID const& accountID,
-                                Asset const& asset) const;
-    std::vector<LedgerEntry> loadOffers(StatementContext& prep) const;
-    std::vector<Signer> loadSigners(LedgerKey const& key) const;
-    std::vector<InflationWinner> loadInflationWinners(size_t maxWinners,
-                                                      int64_t minBalance) const;
-    std::vector<LedgerEntry> loadDebtHolders(Asset const& asset) const;
-    std::vector<LedgerEntry>
-    loadLiquidationCandidates(Asset const& asset1, double ratio1,
-                              Asset const& asset2, double ratio2,
-                              Asset const& assetBalance) const;
-    std::vector<LedgerEntry> loadLiquidationSubjects(
-        Asset const& asset1, double ratio1, Asset const& asset2, double ratio2,
-        Asset const& assetBalance, bool stillEligible) const;
-
-    std::shared_ptr<LedgerEntry const>
-    loadTrustLine(LedgerKey const& key) const;
-
-    std::shared_ptr<LedgerEntry const>
-    loadDebtTrustLine(LedgerKey const& key) const;
-
-    void storeAccount(EntryIterator const& iter);
-    void storeData(EntryIterator const& iter);
-    void storeOffer(EntryIterator const& iter);
-    void storeTrustLine(EntryIterator const& iter);
-
-    void storeSigners(LedgerEntry const& entry,
-                      std::shared_ptr<LedgerEntry const> const& previous);
-
-    void deleteAccount(LedgerKey const& key);
-    void deleteData(LedgerKey const& key);
-    void deleteOffer(LedgerKey const& key);
-    void deleteTrustLine(LedgerKey const& key);
-
-    void insertOrUpdateAccount(LedgerEntry const& entry, bool isInsert);
-    void insertOrUpdateData(LedgerEntry const& entry, bool isInsert);
-    void insertOrUpdateOffer(LedgerEntry const& entry, bool isInsert);
-    void insertOrUpdateTrustLine(LedgerEntry const& entry, bool isInsert);
-
-    static std::string tableFromLedgerEntryType(LedgerEntryType let);
-
-    EntryCacheKey getEntryCacheKey(LedgerKey const& key) const;
-    std::shared_ptr<LedgerEntry const>
-    getFromEntryCache(EntryCacheKey const& key) const;
-    void putInEntryCache(EntryCacheKey const& key,
+    bool getFromEntryCache(LedgerKey const& key,
+                           std::shared_ptr<LedgerEntry const>& entry) const;
+    void putInEntryCache(LedgerKey const& key,
                          std::shared_ptr<LedgerEntry const> const& entry) const;
 
-    BestOffersCacheEntry&
-    getFromBestOffersCache(Asset const& buying, Asset const& selling,
-                           BestOffersCacheEntry& defaultValue) const;
+    std::shared_ptr<BestOffersCacheEntry>
+    getFromBestOffersCache(Asset const& buying, Asset const& selling) const;
 
   public:
     // Constructor has the strong exception safety guarantee
-    Impl(Database& db, size_t entryCacheSize, size_t bestOfferCacheSize);
+    Impl(std::unique_ptr<LedgerStateStore> store, size_t entryCacheSize,
+         size_t bestOfferCacheSize);
 
     ~Impl();
 
@@ -387,12 +459,19 @@ class LedgerStateRoot::Impl
     // deleteObjectsModifiedOnOrAfterLedger has no exception safety guarantees.
     void deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) const;
 
-    // dropAccounts, dropData, dropOffers, and dropTrustLines have no exception
-    // safety guarantees.
-    void dropAccounts();
-    void dropData();
-    void dropOffers();
-    void dropTrustLines();
+    // loadObjects has the basic exception safety guarantee. If it throws an
+    // exception, then
+    // - the prepared statement cache may be, but is not guaranteed to be,
+    //   modified
+    // - f may have been called with some, but not all, of the entries
+    void loadObjects(LedgerEntryType let, LedgerRange const& ledgers,
+                     size_t chunkSize, ObjectsChunkFn const& f) const;
+
+    // drop has no exception safety guarantees.
+    void drop(LedgerEntryType let);
+
+    // getEntryCacheCounters has the strong exception safety guarantee.
+    EntryCacheCounters getEntryCacheCounters() const;
 
     // getAllOffers has the basic exception safety guarantee. If it throws an
     // exception, then
@@ -418,9 +497,17 @@ class LedgerStateRoot::Impl
     // it throws an exception, then
     // - the prepared statement cache may be, but is not guaranteed to be,
     //   modified
-    std::map<LedgerKey, LedgerEntry>
+    // - the entry cache and the offers by account cache may be, but are not
+    //   guaranteed to be, modified or even cleared
+    std::set<LedgerKey>
     getOffersByAccountAndAsset(AccountID const& account, Asset const& asset);
 
+    // getOrderBook has the basic exception safety guarantee. If it throws an
+    // exception, then
+    // - the best offers cache may be, but is not guaranteed to be, modified or
+    //   even cleared
+    OrderBookCursor getOrderBook(Asset const& buying, Asset const& selling);
+
     // getHeader does not throw
     LedgerHeader const& getHeader() const;
 
@@ -453,4 +540,31 @@ class LedgerStateRoot::Impl
     // rollbackChild has the strong exception safety guarantee.
     void rollbackChild();
 };
+
+// Enumerates the best offers cached for an asset pair, loading more offers
+// from the database (in batches of increasing size) as it reaches the end of
+// what was cached.
+class LedgerStateRoot::Impl::OrderBookCursorImpl
+    : public OrderBookCursor::AbstractImpl
+{
+    LedgerStateRoot::Impl const& mRoot;
+    Asset const mBuying;
+    Asset const mSelling;
+    std::shared_ptr<LedgerStateRoot::Impl::BestOffersCacheEntry> mCached;
+    std::list<LedgerEntry>::const_iterator mIter;
+
+    void loadIfNeeded();
+
+  public:
+    OrderBookCursorImpl(
+        LedgerStateRoot::Impl const& root, Asset const& buying,
+        Asset const& selling,
+        std::shared_ptr<LedgerStateRoot::Impl::BestOffersCacheEntry> cached);
+
+    void advance() override;
+
+    bool atEnd() const override;
+
+    LedgerEntry const& entry() const override;
+};
 }
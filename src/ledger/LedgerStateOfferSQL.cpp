@@ -5,7 +5,8 @@
 #include "crypto/KeyUtils.h"
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
-#include "ledger/LedgerStateImpl.h"
+#include "ledger/LedgerRange.h"
+#include "ledger/LedgerStateSQLStore.h"
 #include "util/XDROperators.h"
 #include "util/types.h"
 
@@ -47,35 +48,31 @@ processAsset(Asset& asset, AssetType assetType, std::string const& issuerStr,
 }
 
 std::shared_ptr<LedgerEntry const>
-LedgerStateRoot::Impl::loadOffer(LedgerKey const& key) const
+LedgerStateSQLStore::loadOffer(LedgerKey const& key) const
 {
     uint64_t offerID = key.offer().offerID;
     std::string actIDStrKey = KeyUtils::toStrKey(key.offer().sellerID);
 
-    std::string sql = "SELECT sellerid, offerid, "
-                      "sellingassettype, sellingassetcode, sellingissuer, "
-                      "buyingassettype, buyingassetcode, buyingissuer, "
-                      "amount, pricen, priced, flags, lastmodified "
-                      "FROM offers "
-                      "WHERE sellerid= :id AND offerid= :offerid";
+    static RegisteredStatement const sql(
+        "SELECT sellerid, offerid, "
+        "sellingassettype, sellingassetcode, sellingissuer, "
+        "buyingassettype, buyingassetcode, buyingissuer, "
+        "amount, pricen, priced, flags, lastmodified "
+        "FROM offers "
+        "WHERE sellerid= :id AND offerid= :offerid");
     auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
     st.exchange(soci::use(actIDStrKey));
     st.exchange(soci::use(offerID));
 
-    std::vector<LedgerEntry> offers;
-    {
-        auto timer = mDatabase.getSelectTimer("offer");
-        offers = loadOffers(prep);
-    }
-
+    auto offers = loadOffers(prep);
     return offers.size() == 0
                ? nullptr
-               : std::make_shared<LedgerEntry const>(offers.front());
+               : std::make_shared<LedgerEntry>(offers.front());
 }
 
 std::vector<LedgerEntry>
-LedgerStateRoot::Impl::loadAllOffers() const
+LedgerStateSQLStore::loadAllOffers() const
 {
     std::string sql = "SELECT sellerid, offerid, "
                       "sellingassettype, sellingassetcode, sellingissuer, "
@@ -83,32 +80,60 @@ LedgerStateRoot::Impl::loadAllOffers() const
                       "amount, pricen, priced, flags, lastmodified "
                       "FROM offers";
     auto prep = mDatabase.getPreparedStatement(sql);
-
-    std::vector<LedgerEntry> offers;
-    {
-        auto timer = mDatabase.getSelectTimer("offer");
-        offers = loadOffers(prep);
-    }
-    return offers;
+    return loadOffers(prep);
 }
 
-std::list<LedgerEntry>::const_iterator
-LedgerStateRoot::Impl::loadBestOffers(std::list<LedgerEntry>& offers,
-                                      Asset const& buying, Asset const& selling,
-                                      size_t numOffers, size_t offset) const
+std::string
+LedgerStateSQLStore::bestOffersSQL(bool sellingNative, bool buyingNative)
 {
     std::string sql = "SELECT sellerid, offerid, "
                       "sellingassettype, sellingassetcode, sellingissuer, "
                       "buyingassettype, buyingassetcode, buyingissuer, "
                       "amount, pricen, priced, flags, lastmodified "
                       "FROM offers ";
-
-    std::string sellingAssetCode, sellingIssuerStrKey;
-    if (selling.type() == ASSET_TYPE_NATIVE)
+    if (sellingNative)
+    {
+        sql += " WHERE sellingassettype = 0 AND sellingissuer IS NULL AND "
+               "sellingassetcode IS NULL";
+    }
+    else
+    {
+        sql += " WHERE sellingassetcode = :sac AND sellingissuer = :si";
+    }
+    if (buyingNative)
     {
-        sql += " WHERE sellingassettype = 0 AND sellingissuer IS NULL";
+        sql += " AND buyingassettype = 0 AND buyingissuer IS NULL AND "
+               "buyingassetcode IS NULL";
     }
     else
+    {
+        sql += " AND buyingassetcode = :bac AND buyingissuer = :bi";
+    }
+
+    // price is an approximation of the actual n/d (truncated math, 15 digits)
+    // ordering by offerid gives precendence to older offers for fairness
+    // (the asset codes of native assets are null, filtering on them as well
+    // lets the query be answered in order from bestoffersindex)
+    sql += " ORDER BY price, offerid LIMIT :n OFFSET :o";
+    return sql;
+}
+
+std::list<LedgerEntry>::const_iterator
+LedgerStateSQLStore::loadBestOffers(std::list<LedgerEntry>& offers,
+                                    Asset const& buying, Asset const& selling,
+                                    size_t numOffers, size_t offset) const
+{
+    // indexed by 2 * sellingNative + buyingNative
+    static RegisteredStatement const sqls[] = {
+        RegisteredStatement(bestOffersSQL(false, false)),
+        RegisteredStatement(bestOffersSQL(false, true)),
+        RegisteredStatement(bestOffersSQL(true, false)),
+        RegisteredStatement(bestOffersSQL(true, true))};
+    bool const sellingNative = selling.type() == ASSET_TYPE_NATIVE;
+    bool const buyingNative = buying.type() == ASSET_TYPE_NATIVE;
+
+    std::string sellingAssetCode, sellingIssuerStrKey;
+    if (!sellingNative)
     {
         if (selling.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
         {
@@ -126,15 +151,10 @@ LedgerStateRoot::Impl::loadBestOffers(std::list<LedgerEntry>& offers,
         {
             throw std::runtime_error("unknown asset type");
         }
-        sql += " WHERE sellingassetcode = :sac AND sellingissuer = :si";
     }
 
     std::string buyingAssetCode, buyingIssuerStrKey;
-    if (buying.type() == ASSET_TYPE_NATIVE)
-    {
-        sql += " AND buyingassettype = 0 AND buyingissuer IS NULL";
-    }
-    else
+    if (!buyingNative)
     {
         if (buying.type() == ASSET_TYPE_CREDIT_ALPHANUM4)
         {
@@ -150,32 +170,24 @@ LedgerStateRoot::Impl::loadBestOffers(std::list<LedgerEntry>& offers,
         {
             throw std::runtime_error("unknown asset type");
         }
-        sql += " AND buyingassetcode = :bac AND buyingissuer = :bi";
     }
 
-    // price is an approximation of the actual n/d (truncated math, 15 digits)
-    // ordering by offerid gives precendence to older offers for fairness
-    sql += " ORDER BY price, offerid LIMIT :n OFFSET :o";
-
-    auto prep = mDatabase.getPreparedStatement(sql);
+    auto prep =
+        mDatabase.getPreparedStatement(sqls[2 * sellingNative + buyingNative]);
     auto& st = prep.statement();
-    if (selling.type() != ASSET_TYPE_NATIVE)
+    if (!sellingNative)
     {
         st.exchange(soci::use(sellingAssetCode, "sac"));
         st.exchange(soci::use(sellingIssuerStrKey, "si"));
     }
-    if (buying.type() != ASSET_TYPE_NATIVE)
+    if (!buyingNative)
     {
         st.exchange(soci::use(buyingAssetCode, "bac"));
         st.exchange(soci::use(buyingIssuerStrKey, "bi"));
     }
     st.exchange(soci::use(numOffers, "n"));
     st.exchange(soci::use(offset, "o"));
-
-    {
-        auto timer = mDatabase.getSelectTimer("offer");
-        return loadOffers(prep, offers);
-    }
+    return loadOffers(prep, offers);
 }
 
 // Note: The order induced by this function must match the order used in the
@@ -210,8 +222,8 @@ isBetterOffer(LedgerEntry const& lhsEntry, LedgerEntry const& rhsEntry)
 // a consequence, I have not implemented that possibility so this function
 // throws in that case.
 std::vector<LedgerEntry>
-LedgerStateRoot::Impl::loadOffersByAccountAndAsset(AccountID const& accountID,
-                                                   Asset const& asset) const
+LedgerStateSQLStore::loadOffersByAccountAndAsset(AccountID const& accountID,
+                                                 Asset const& asset) const
 {
     std::string sql = "SELECT sellerid, offerid, "
                       "sellingassettype, sellingassetcode, sellingissuer, "
@@ -246,20 +258,13 @@ LedgerStateRoot::Impl::loadOffersByAccountAndAsset(AccountID const& accountID,
     st.exchange(soci::use(accountStr, "acc"));
     st.exchange(soci::use(assetCode, "code"));
     st.exchange(soci::use(assetIssuer, "iss"));
-
-    std::vector<LedgerEntry> offers;
-    {
-        auto timer = mDatabase.getSelectTimer("offer");
-        offers = loadOffers(prep);
-    }
-    return offers;
+    return loadOffers(prep);
 }
 
-std::vector<LedgerEntry>
-LedgerStateRoot::Impl::loadOffers(StatementContext& prep) const
+void
+LedgerStateSQLStore::forEachOfferRow(StatementContext& prep,
+                                     RowFn const& f) const
 {
-    std::vector<LedgerEntry> offers;
-
     std::string actIDStrKey;
     unsigned int sellingAssetType, buyingAssetType;
     std::string sellingAssetCode, buyingAssetCode, sellingIssuerStrKey,
@@ -286,7 +291,10 @@ LedgerStateRoot::Impl::loadOffers(StatementContext& prep) const
     st.exchange(soci::into(oe.flags));
     st.exchange(soci::into(le.lastModifiedLedgerSeq));
     st.define_and_bind();
-    st.execute(true);
+    {
+        auto timer = mDatabase.getSelectTimer("offer");
+        st.execute(true);
+    }
     while (st.got_data())
     {
         oe.sellerID = KeyUtils::fromStrKey<PublicKey>(actIDStrKey);
@@ -297,56 +305,50 @@ LedgerStateRoot::Impl::loadOffers(StatementContext& prep) const
                      buyingIssuerIndicator, buyingAssetCode,
                      buyingAssetCodeIndicator);
 
-        offers.emplace_back(le);
+        f(le);
         st.fetch();
     }
+}
 
+std::vector<LedgerEntry>
+LedgerStateSQLStore::loadOffers(StatementContext& prep) const
+{
+    std::vector<LedgerEntry> offers;
+    forEachOfferRow(prep,
+                    [&offers](LedgerEntry& le) { offers.emplace_back(le); });
     return offers;
 }
 
-std::list<LedgerEntry>::const_iterator
-LedgerStateRoot::Impl::loadOffers(StatementContext& prep,
-                                  std::list<LedgerEntry>& offers) const
+void
+LedgerStateSQLStore::loadOffers(LedgerRange const& ledgers,
+                                size_t chunkSize,
+                                ObjectsChunkFn const& f) const
 {
-    std::string actIDStrKey;
-    unsigned int sellingAssetType, buyingAssetType;
-    std::string sellingAssetCode, buyingAssetCode, sellingIssuerStrKey,
-        buyingIssuerStrKey;
-    soci::indicator sellingAssetCodeIndicator, buyingAssetCodeIndicator,
-        sellingIssuerIndicator, buyingIssuerIndicator;
-
-    LedgerEntry le;
-    le.data.type(OFFER);
-    OfferEntry& oe = le.data.offer();
+    uint32_t first = ledgers.first();
+    uint32_t last = ledgers.last();
 
+    std::string sql = "SELECT sellerid, offerid, "
+                      "sellingassettype, sellingassetcode, sellingissuer, "
+                      "buyingassettype, buyingassetcode, buyingissuer, "
+                      "amount, pricen, priced, flags, lastmodified "
+                      "FROM offers "
+                      "WHERE lastmodified >= :v1 AND lastmodified <= :v2";
+    auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
-    st.exchange(soci::into(actIDStrKey));
-    st.exchange(soci::into(oe.offerID));
-    st.exchange(soci::into(sellingAssetType));
-    st.exchange(soci::into(sellingAssetCode, sellingAssetCodeIndicator));
-    st.exchange(soci::into(sellingIssuerStrKey, sellingIssuerIndicator));
-    st.exchange(soci::into(buyingAssetType));
-    st.exchange(soci::into(buyingAssetCode, buyingAssetCodeIndicator));
-    st.exchange(soci::into(buyingIssuerStrKey, buyingIssuerIndicator));
-    st.exchange(soci::into(oe.amount));
-    st.exchange(soci::into(oe.price.n));
-    st.exchange(soci::into(oe.price.d));
-    st.exchange(soci::into(oe.flags));
-    st.exchange(soci::into(le.lastModifiedLedgerSeq));
-    st.define_and_bind();
-    st.execute(true);
+    st.exchange(soci::use(first));
+    st.exchange(soci::use(last));
 
-    auto iterNext = offers.cend();
-    while (st.got_data())
-    {
-        oe.sellerID = KeyUtils::fromStrKey<PublicKey>(actIDStrKey);
-        processAsset(oe.selling, (AssetType)sellingAssetType,
-                     sellingIssuerStrKey, sellingIssuerIndicator,
-                     sellingAssetCode, sellingAssetCodeIndicator);
-        processAsset(oe.buying, (AssetType)buyingAssetType, buyingIssuerStrKey,
-                     buyingIssuerIndicator, buyingAssetCode,
-                     buyingAssetCodeIndicator);
+    ChunkedRows chunks(chunkSize, f);
+    forEachOfferRow(prep, [&chunks](LedgerEntry& le) { chunks.add(le); });
+    chunks.flush();
+}
 
+std::list<LedgerEntry>::const_iterator
+LedgerStateSQLStore::loadOffers(StatementContext& prep,
+                                std::list<LedgerEntry>& offers) const
+{
+    auto iterNext = offers.cend();
+    forEachOfferRow(prep, [&offers, &iterNext](LedgerEntry& le) {
         if (iterNext == offers.cend())
         {
             iterNext = offers.emplace(iterNext, le);
@@ -355,15 +357,13 @@ LedgerStateRoot::Impl::loadOffers(StatementContext& prep,
         {
             offers.emplace_back(le);
         }
-        st.fetch();
-    }
-
+    });
     return iterNext;
 }
 
 void
-LedgerStateRoot::Impl::insertOrUpdateOffer(LedgerEntry const& entry,
-                                           bool isInsert)
+LedgerStateSQLStore::insertOrUpdateOffer(LedgerEntry const& entry,
+                                         bool isInsert)
 {
     auto const& offer = entry.data.offer();
     std::string actIDStrKey = KeyUtils::toStrKey(offer.sellerID);
@@ -405,25 +405,21 @@ LedgerStateRoot::Impl::insertOrUpdateOffer(LedgerEntry const& entry,
         buying_ind = soci::i_ok;
     }
 
-    std::string sql;
-    if (isInsert)
-    {
-        sql = "INSERT INTO offers (sellerid,offerid,"
-              "sellingassettype,sellingassetcode,sellingissuer,"
-              "buyingassettype,buyingassetcode,buyingissuer,"
-              "amount,pricen,priced,price,flags,lastmodified) VALUES "
-              "(:sid,:oid,:sat,:sac,:si,:bat,:bac,:bi,:a,:pn,:pd,:p,:f,:l)";
-    }
-    else
-    {
-        sql = "UPDATE offers SET sellingassettype=:sat,"
-              "sellingassetcode=:sac,sellingissuer=:si,"
-              "buyingassettype=:bat,buyingassetcode=:bac,buyingissuer=:bi,"
-              "amount=:a,pricen=:pn,priced=:pd,price=:p,flags=:f,"
-              "lastmodified=:l WHERE offerid=:oid";
-    }
+    static RegisteredStatement const insertSql(
+        "INSERT INTO offers (sellerid,offerid,"
+        "sellingassettype,sellingassetcode,sellingissuer,"
+        "buyingassettype,buyingassetcode,buyingissuer,"
+        "amount,pricen,priced,price,flags,lastmodified) VALUES "
+        "(:sid,:oid,:sat,:sac,:si,:bat,:bac,:bi,:a,:pn,:pd,:p,:f,:l)");
+    static RegisteredStatement const updateSql(
+        "UPDATE offers SET sellingassettype=:sat,"
+        "sellingassetcode=:sac,sellingissuer=:si,"
+        "buyingassettype=:bat,buyingassetcode=:bac,buyingissuer=:bi,"
+        "amount=:a,pricen=:pn,priced=:pd,price=:p,flags=:f,"
+        "lastmodified=:l WHERE offerid=:oid");
 
-    auto prep = mDatabase.getPreparedStatement(sql);
+    auto prep =
+        mDatabase.getPreparedStatement(isInsert ? insertSql : updateSql);
     auto& st = prep.statement();
     if (isInsert)
     {
@@ -455,12 +451,12 @@ LedgerStateRoot::Impl::insertOrUpdateOffer(LedgerEntry const& entry,
 }
 
 void
-LedgerStateRoot::Impl::deleteOffer(LedgerKey const& key)
+LedgerStateSQLStore::deleteOffer(LedgerKey const& key)
 {
     auto const& offer = key.offer();
 
-    auto prep =
-        mDatabase.getPreparedStatement("DELETE FROM offers WHERE offerid=:s");
+    static RegisteredStatement const sql("DELETE FROM offers WHERE offerid=:s");
+    auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
     st.exchange(soci::use(offer.offerID));
     st.define_and_bind();
@@ -475,12 +471,8 @@ LedgerStateRoot::Impl::deleteOffer(LedgerKey const& key)
 }
 
 void
-LedgerStateRoot::Impl::dropOffers()
+LedgerStateSQLStore::dropOffers()
 {
-    throwIfChild();
-    mEntryCache.clear();
-    mBestOffersCache.clear();
-
     mDatabase.getSession() << "DROP TABLE IF EXISTS offers;";
     mDatabase.getSession()
         << "CREATE TABLE offers"
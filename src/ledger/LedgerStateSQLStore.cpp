@@ -0,0 +1,237 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerStateSQLStore.h"
+#include "database/Database.h"
+#include "ledger/LedgerRange.h"
+
+namespace stellar
+{
+
+LedgerStateSQLStore::LedgerStateSQLStore(Database& db) : mDatabase(db)
+{
+}
+
+void
+LedgerStateSQLStore::beginTransaction()
+{
+    mTransaction = std::make_unique<soci::transaction>(mDatabase.getSession());
+}
+
+void
+LedgerStateSQLStore::commitTransaction()
+{
+    mTransaction->commit();
+    mTransaction.reset();
+    mDatabase.clearPreparedStatementCache();
+}
+
+void
+LedgerStateSQLStore::rollbackTransaction()
+{
+    mTransaction->rollback();
+    mTransaction.reset();
+}
+
+std::shared_ptr<LedgerEntry const>
+LedgerStateSQLStore::load(LedgerKey const& key) const
+{
+    switch (key.type())
+    {
+    case ACCOUNT:
+        return loadAccount(key);
+    case DATA:
+        return loadData(key);
+    case OFFER:
+        return loadOffer(key);
+    case TRUSTLINE:
+        return loadTrustLine(key);
+    default:
+        throw std::runtime_error("Unknown key type");
+    }
+}
+
+void
+LedgerStateSQLStore::store(LedgerEntry const& entry,
+                           std::shared_ptr<LedgerEntry const> const& previous)
+{
+    switch (entry.data.type())
+    {
+    case ACCOUNT:
+        insertOrUpdateAccount(entry, !previous);
+        storeSigners(entry, previous);
+        break;
+    case DATA:
+        insertOrUpdateData(entry, !previous);
+        break;
+    case OFFER:
+        insertOrUpdateOffer(entry, !previous);
+        break;
+    case TRUSTLINE:
+        insertOrUpdateTrustLine(entry, !previous);
+        break;
+    default:
+        throw std::runtime_error("Unknown key type");
+    }
+}
+
+void
+LedgerStateSQLStore::erase(LedgerKey const& key)
+{
+    switch (key.type())
+    {
+    case ACCOUNT:
+        deleteAccount(key);
+        break;
+    case DATA:
+        deleteData(key);
+        break;
+    case OFFER:
+        deleteOffer(key);
+        break;
+    case TRUSTLINE:
+        deleteTrustLine(key);
+        break;
+    default:
+        throw std::runtime_error("Unknown key type");
+    }
+}
+
+std::string
+LedgerStateSQLStore::tableFromLedgerEntryType(LedgerEntryType let)
+{
+    switch (let)
+    {
+    case ACCOUNT:
+        return "accounts";
+    case DATA:
+        return "accountdata";
+    case OFFER:
+        return "offers";
+    case TRUSTLINE:
+        return "trustlines";
+    default:
+        throw std::runtime_error("Unknown ledger entry type");
+    }
+}
+
+uint64_t
+LedgerStateSQLStore::countObjects(LedgerEntryType let) const
+{
+    using namespace soci;
+    std::string query =
+        "SELECT COUNT(*) FROM " + tableFromLedgerEntryType(let) + ";";
+    uint64_t count = 0;
+    mDatabase.getSession() << query, into(count);
+    return count;
+}
+
+uint64_t
+LedgerStateSQLStore::countObjects(LedgerEntryType let,
+                                  LedgerRange const& ledgers) const
+{
+    using namespace soci;
+    std::string query = "SELECT COUNT(*) FROM " +
+                        tableFromLedgerEntryType(let) +
+                        " WHERE lastmodified >= :v1 AND lastmodified <= :v2;";
+    uint64_t count = 0;
+    mDatabase.getSession() << query, into(count), use(ledgers.first()),
+        use(ledgers.last());
+    return count;
+}
+
+void
+LedgerStateSQLStore::loadObjects(LedgerEntryType let,
+                                 LedgerRange const& ledgers, size_t chunkSize,
+                                 ObjectsChunkFn const& f) const
+{
+    switch (let)
+    {
+    case ACCOUNT:
+        loadAccounts(ledgers, chunkSize, f);
+        break;
+    case DATA:
+        loadData(ledgers, chunkSize, f);
+        break;
+    case OFFER:
+        loadOffers(ledgers, chunkSize, f);
+        break;
+    case TRUSTLINE:
+        loadTrustLines(ledgers, chunkSize, f);
+        break;
+    default:
+        throw std::runtime_error("Unknown ledger entry type");
+    }
+}
+
+LedgerStateSQLStore::ChunkedRows::ChunkedRows(size_t chunkSize,
+                                              ObjectsChunkFn const& f)
+    : mChunkSize(chunkSize), mChunkFn(f)
+{
+    mChunk.reserve(mChunkSize);
+}
+
+void
+LedgerStateSQLStore::ChunkedRows::add(LedgerEntry const& le)
+{
+    mChunk.emplace_back(le);
+    if (mChunk.size() == mChunkSize)
+    {
+        mChunkFn(std::move(mChunk));
+        mChunk.clear();
+        mChunk.reserve(mChunkSize);
+    }
+}
+
+void
+LedgerStateSQLStore::ChunkedRows::flush()
+{
+    if (!mChunk.empty())
+    {
+        mChunkFn(std::move(mChunk));
+        mChunk.clear();
+    }
+}
+
+void
+LedgerStateSQLStore::deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger)
+{
+    using namespace soci;
+    {
+        std::string query =
+            "DELETE FROM signers WHERE accountid IN"
+            " (SELECT accountid FROM accounts WHERE lastmodified >= :v1)";
+        mDatabase.getSession() << query, use(ledger);
+    }
+
+    for (auto let : {ACCOUNT, DATA, TRUSTLINE, OFFER})
+    {
+        std::string query = "DELETE FROM " + tableFromLedgerEntryType(let) +
+                            " WHERE lastmodified >= :v1";
+        mDatabase.getSession() << query, use(ledger);
+    }
+}
+
+void
+LedgerStateSQLStore::drop(LedgerEntryType let)
+{
+    switch (let)
+    {
+    case ACCOUNT:
+        dropAccounts();
+        break;
+    case DATA:
+        dropData();
+        break;
+    case OFFER:
+        dropOffers();
+        break;
+    case TRUSTLINE:
+        dropTrustLines();
+        break;
+    default:
+        throw std::runtime_error("Unknown ledger entry type");
+    }
+}
+}
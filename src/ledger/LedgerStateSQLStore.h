@@ -0,0 +1,151 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerStateStore.h"
+#include <functional>
+#include <soci.h>
+
+namespace stellar
+{
+
+class Database;
+class StatementContext;
+
+// Stores the ledger entries in the accounts, signers, accountdata, offers and
+// trustlines tables of the database, where Horizon (and other tools) can
+// query them. The queries of each table are in LedgerState*SQL.cpp.
+class LedgerStateSQLStore : public LedgerStateStore
+{
+    Database& mDatabase;
+    std::unique_ptr<soci::transaction> mTransaction;
+
+    // Called with the entry decoded from each row of a select; the entry is
+    // reused for the next row.
+    typedef std::function<void(LedgerEntry&)> RowFn;
+
+    // Collects the entries of a range scan into the chunks given to f.
+    class ChunkedRows
+    {
+        size_t const mChunkSize;
+        ObjectsChunkFn const& mChunkFn;
+        std::vector<LedgerEntry> mChunk;
+
+      public:
+        ChunkedRows(size_t chunkSize, ObjectsChunkFn const& f);
+        void add(LedgerEntry const& le);
+        // gives the last, incomplete, chunk to f
+        void flush();
+    };
+
+    // Decode the rows of the selects of each table: they bind the columns
+    // below to prep, execute it and call f for each row. The columns of the
+    // key, when selected, come first and are bound and set in the entry by
+    // the caller (offers always select their key).
+    //  accounts: balance, seqnum, numsubentries, inflationdest, homedomain,
+    //            thresholds, flags, lastmodified, buyingliabilities,
+    //            sellingliabilities (the signers are left to the caller)
+    //  accountdata: datavalue, lastmodified
+    //  offers: sellerid, offerid, sellingassettype, sellingassetcode,
+    //          sellingissuer, buyingassettype, buyingassetcode, buyingissuer,
+    //          amount, pricen, priced, flags, lastmodified
+    //  trustlines: tlimit, balance, flags, debt, lastmodified,
+    //              buyingliabilities, sellingliabilities
+    void forEachAccountRow(StatementContext& prep, RowFn const& f) const;
+    void forEachDataRow(StatementContext& prep, RowFn const& f) const;
+    void forEachOfferRow(StatementContext& prep, RowFn const& f) const;
+    void forEachTrustLineRow(StatementContext& prep, RowFn const& f) const;
+
+    std::shared_ptr<LedgerEntry const> loadAccount(LedgerKey const& key) const;
+    std::shared_ptr<LedgerEntry const> loadData(LedgerKey const& key) const;
+    std::shared_ptr<LedgerEntry const> loadOffer(LedgerKey const& key) const;
+    std::list<LedgerEntry>::const_iterator
+    loadOffers(StatementContext& prep, std::list<LedgerEntry>& offers) const;
+    std::vector<LedgerEntry> loadOffers(StatementContext& prep) const;
+    std::vector<Signer> loadSigners(LedgerKey const& key) const;
+
+    std::shared_ptr<LedgerEntry const>
+    loadTrustLine(LedgerKey const& key) const;
+
+    std::shared_ptr<LedgerEntry const>
+    loadDebtTrustLine(LedgerKey const& key) const;
+
+    void loadAccounts(LedgerRange const& ledgers, size_t chunkSize,
+                      ObjectsChunkFn const& f) const;
+    void loadData(LedgerRange const& ledgers, size_t chunkSize,
+                  ObjectsChunkFn const& f) const;
+    void loadOffers(LedgerRange const& ledgers, size_t chunkSize,
+                    ObjectsChunkFn const& f) const;
+    void loadTrustLines(LedgerRange const& ledgers, size_t chunkSize,
+                        ObjectsChunkFn const& f) const;
+
+    void storeSigners(LedgerEntry const& entry,
+                      std::shared_ptr<LedgerEntry const> const& previous);
+
+    void deleteAccount(LedgerKey const& key);
+    void deleteData(LedgerKey const& key);
+    void deleteOffer(LedgerKey const& key);
+    void deleteTrustLine(LedgerKey const& key);
+
+    void insertOrUpdateAccount(LedgerEntry const& entry, bool isInsert);
+    void insertOrUpdateData(LedgerEntry const& entry, bool isInsert);
+    void insertOrUpdateOffer(LedgerEntry const& entry, bool isInsert);
+    void insertOrUpdateTrustLine(LedgerEntry const& entry, bool isInsert);
+
+    void dropAccounts();
+    void dropData();
+    void dropOffers();
+    void dropTrustLines();
+
+    static std::string tableFromLedgerEntryType(LedgerEntryType let);
+
+  public:
+    explicit LedgerStateSQLStore(Database& db);
+
+    void beginTransaction() override;
+    void commitTransaction() override;
+    void rollbackTransaction() override;
+
+    std::shared_ptr<LedgerEntry const>
+    load(LedgerKey const& key) const override;
+    void store(LedgerEntry const& entry,
+               std::shared_ptr<LedgerEntry const> const& previous) override;
+    void erase(LedgerKey const& key) override;
+
+    std::vector<LedgerEntry> loadAllOffers() const override;
+    std::list<LedgerEntry>::const_iterator
+    loadBestOffers(std::list<LedgerEntry>& offers, Asset const& buying,
+                   Asset const& selling, size_t numOffers,
+                   size_t offset) const override;
+    std::vector<LedgerEntry>
+    loadOffersByAccountAndAsset(AccountID const& accountID,
+                                Asset const& asset) const override;
+    std::vector<InflationWinner>
+    loadInflationWinners(size_t maxWinners, int64_t minBalance) const override;
+    std::vector<LedgerEntry> loadDebtHolders(Asset const& asset) const override;
+    std::vector<LedgerEntry>
+    loadLiquidationCandidates(Asset const& asset1, double ratio1,
+                              Asset const& asset2, double ratio2,
+                              Asset const& assetBalance) const override;
+    std::vector<LedgerEntry> loadLiquidationSubjects(
+        Asset const& asset1, double ratio1, Asset const& asset2, double ratio2,
+        Asset const& assetBalance, bool stillEligible) const override;
+
+    // the SQL of loadBestOffers (with the named parameters sac, si, bac, bi,
+    // n and o, the asset ones only when the asset is not native) and of
+    // loadDebtHolders (issuer and asset), whose plans are checked by tests
+    static std::string bestOffersSQL(bool sellingNative, bool buyingNative);
+    static std::string debtHoldersSQL();
+
+    uint64_t countObjects(LedgerEntryType let) const override;
+    uint64_t countObjects(LedgerEntryType let,
+                          LedgerRange const& ledgers) const override;
+    void loadObjects(LedgerEntryType let, LedgerRange const& ledgers,
+                     size_t chunkSize, ObjectsChunkFn const& f) const override;
+    void deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) override;
+
+    void drop(LedgerEntryType let) override;
+};
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerState.h"
+#include "util/NonCopyable.h"
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace stellar
+{
+
+class LedgerRange;
+
+// Storage of the ledger entries under LedgerStateRoot. The root keeps the
+// caches and the ledger header and forwards everything else to its store:
+// point lookups, the writes of a committed LedgerState and the queries that
+// need an index (best offers, debt holders, liquidations...).
+//
+// The writes made between beginTransaction and commitTransaction are applied
+// atomically, rollbackTransaction undoes them. Stores are used from the main
+// thread only.
+class LedgerStateStore : NonMovableOrCopyable
+{
+  public:
+    typedef LedgerStateRoot::ObjectsChunkFn ObjectsChunkFn;
+
+    virtual ~LedgerStateStore()
+    {
+    }
+
+    virtual void beginTransaction() = 0;
+    virtual void commitTransaction() = 0;
+    virtual void rollbackTransaction() = 0;
+
+    virtual std::shared_ptr<LedgerEntry const>
+    load(LedgerKey const& key) const = 0;
+
+    // previous is the version of the entry that is replaced (as returned by
+    // load), nullptr if the entry is created
+    virtual void store(LedgerEntry const& entry,
+                       std::shared_ptr<LedgerEntry const> const& previous) = 0;
+    virtual void erase(LedgerKey const& key) = 0;
+
+    virtual std::vector<LedgerEntry> loadAllOffers() const = 0;
+
+    // Appends to offers (at most) numOffers offers selling selling for buying,
+    // skipping the offset best ones, and returns an iterator to the first
+    // appended offer. The offers are ordered as by isBetterOffer.
+    virtual std::list<LedgerEntry>::const_iterator
+    loadBestOffers(std::list<LedgerEntry>& offers, Asset const& buying,
+                   Asset const& selling, size_t numOffers,
+                   size_t offset) const = 0;
+
+    virtual std::vector<LedgerEntry>
+    loadOffersByAccountAndAsset(AccountID const& accountID,
+                                Asset const& asset) const = 0;
+
+    virtual std::vector<InflationWinner>
+    loadInflationWinners(size_t maxWinners, int64_t minBalance) const = 0;
+
+    virtual std::vector<LedgerEntry>
+    loadDebtHolders(Asset const& asset) const = 0;
+
+    virtual std::vector<LedgerEntry>
+    loadLiquidationCandidates(Asset const& asset1, double ratio1,
+                              Asset const& asset2, double ratio2,
+                              Asset const& assetBalance) const = 0;
+
+    virtual std::vector<LedgerEntry> loadLiquidationSubjects(
+        Asset const& asset1, double ratio1, Asset const& asset2, double ratio2,
+        Asset const& assetBalance, bool stillEligible) const = 0;
+
+    virtual uint64_t countObjects(LedgerEntryType let) const = 0;
+    virtual uint64_t countObjects(LedgerEntryType let,
+                                  LedgerRange const& ledgers) const = 0;
+
+    virtual void loadObjects(LedgerEntryType let, LedgerRange const& ledgers,
+                             size_t chunkSize,
+                             ObjectsChunkFn const& f) const = 0;
+
+    virtual void deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) = 0;
+
+    // removes all the entries of type let (and recreates their tables)
+    virtual void drop(LedgerEntryType let) = 0;
+};
+}
@@ -3,6 +3,7 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "ledger/LedgerState.h"
+#include "crypto/KeyUtils.h"
 #include "ledger/LedgerStateEntry.h"
 #include "ledger/LedgerStateHeader.h"
 #include "ledger/LedgerTestUtils.h"
@@ -11,6 +12,7 @@
 #include "test/TestUtils.h"
 #include "test/test.h"
 #include "transactions/TransactionUtils.h"
+#include "util/Arena.h"
 #include "util/XDROperators.h"
 #include <map>
 #include <memory>
@@ -1084,6 +1086,164 @@ TEST_CASE("LedgerState load", "[ledgerstate]")
     }
 }
 
+TEST_CASE("LedgerState copy-on-write", "[ledgerstate]")
+{
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    app->start();
+
+    LedgerEntry le = LedgerTestUtils::generateValidLedgerEntry();
+    le.lastModifiedLedgerSeq =
+        app->getLedgerStateRoot().getHeader().ledgerSeq + 1;
+    LedgerKey key = LedgerEntryKey(le);
+
+    LedgerState ls1(app->getLedgerStateRoot());
+    ls1.loadHeader().current().ledgerSeq = le.lastModifiedLedgerSeq;
+    REQUIRE(ls1.create(le));
+    auto previous = ls1.getNewestVersion(key);
+
+    SECTION("load and commit without modification do not copy")
+    {
+        auto copies = LedgerState::getEntryCopyCount();
+        {
+            LedgerState ls2(ls1);
+            REQUIRE(ls2.load(key));
+            LedgerState ls3(ls2);
+            REQUIRE(ls3.loadWithoutRecord(key));
+            ls3.commit();
+            ls2.commit();
+        }
+        REQUIRE(LedgerState::getEntryCopyCount() == copies);
+        REQUIRE(ls1.getNewestVersion(key) == previous);
+    }
+
+    SECTION("modification copies once and does not affect the parent")
+    {
+        auto copies = LedgerState::getEntryCopyCount();
+        LedgerState ls2(ls1);
+        {
+            auto entry = ls2.load(key);
+            entry.current().lastModifiedLedgerSeq++;
+            entry.current().lastModifiedLedgerSeq--;
+        }
+        {
+            auto entry = ls2.load(key);
+            entry.current().lastModifiedLedgerSeq++;
+        }
+        REQUIRE(LedgerState::getEntryCopyCount() == copies + 1);
+        REQUIRE(*previous == le);
+        REQUIRE(ls2.getNewestVersion(key) != previous);
+
+        SECTION("rollback")
+        {
+            ls2.rollback();
+            REQUIRE(ls1.getNewestVersion(key) == previous);
+        }
+
+        SECTION("commit")
+        {
+            auto current = *ls2.getNewestVersion(key);
+            current.lastModifiedLedgerSeq = le.lastModifiedLedgerSeq;
+            ls2.commit();
+            REQUIRE(*ls1.getNewestVersion(key) == current);
+            REQUIRE(*previous == le);
+        }
+    }
+}
+
+TEST_CASE("LedgerState arena", "[ledgerstate][arena]")
+{
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    app->start();
+
+    LedgerEntry le = LedgerTestUtils::generateValidLedgerEntry();
+    LedgerKey key = LedgerEntryKey(le);
+
+    Arena arena;
+    LedgerState ls1(app->getLedgerStateRoot());
+    auto heapAllocations = getArenaAllocatorHeapAllocationCount();
+
+    SECTION("nested LedgerStates allocate from the arena")
+    {
+        {
+            LedgerStateArenaScope scope(&arena);
+            LedgerState ls2(ls1);
+            REQUIRE(ls2.create(le));
+            ls2.commit();
+        }
+        REQUIRE(arena.getAllocationCount() > 0);
+        // only the node of ls1
+        REQUIRE(getArenaAllocatorHeapAllocationCount() == heapAllocations + 1);
+        REQUIRE(ls1.getNewestVersion(key));
+    }
+
+    SECTION("arena is not reset while a LedgerState uses it")
+    {
+        std::unique_ptr<LedgerState> ls2;
+        {
+            LedgerStateArenaScope scope(&arena);
+            ls2 = std::make_unique<LedgerState>(ls1);
+            REQUIRE(ls2->create(le));
+            {
+                LedgerStateArenaScope inner(&arena);
+            }
+            REQUIRE(ls2->getNewestVersion(key));
+        }
+        REQUIRE(!arena.reset());
+        REQUIRE(ls2->getNewestVersion(key));
+        ls2->commit();
+        REQUIRE(ls1.getNewestVersion(key));
+        REQUIRE(arena.reset());
+    }
+}
+
+TEST_CASE("LedgerState getChanges is ordered by key", "[ledgerstate]")
+{
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    app->start();
+
+    std::set<LedgerKey> keys;
+    LedgerState ls1(app->getLedgerStateRoot());
+    for (auto const& le : LedgerTestUtils::generateValidLedgerEntries(100))
+    {
+        if (keys.insert(LedgerEntryKey(le)).second)
+        {
+            REQUIRE(ls1.create(le));
+        }
+    }
+
+    auto changes = ls1.getChanges();
+    REQUIRE(changes.size() == keys.size());
+    auto iter = keys.begin();
+    for (auto const& change : changes)
+    {
+        REQUIRE(change.type() == LEDGER_ENTRY_CREATED);
+        REQUIRE(LedgerEntryKey(change.created()) == *iter++);
+    }
+}
+
+TEST_CASE("LedgerStateRoot entry cache counters", "[ledgerstate]")
+{
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    app->start();
+
+    auto& root = app->getLedgerStateRoot();
+    auto key = LedgerEntryKey(LedgerTestUtils::generateValidLedgerEntry());
+    auto before = root.getEntryCacheCounters();
+
+    // missing entries are cached too
+    REQUIRE(!root.getNewestVersion(key));
+    REQUIRE(!root.getNewestVersion(key));
+    auto after = root.getEntryCacheCounters();
+    REQUIRE(after.mMisses == before.mMisses + 1);
+    REQUIRE(after.mHits == before.mHits + 1);
+    REQUIRE(after.mSize == before.mSize + 1);
+    REQUIRE(after.mFootprint > before.mFootprint);
+}
+
 TEST_CASE("LedgerState loadWithoutRecord", "[ledgerstate]")
 {
     VirtualClock clock;
@@ -1684,6 +1844,165 @@ TEST_CASE("LedgerState loadBestOffer", "[ledgerstate]")
     }
 }
 
+static void
+testOrderBook(
+    AbstractLedgerStateParent& lsParent, Asset const& buying,
+    Asset const& selling,
+    std::vector<std::tuple<uint64_t, Price, int64_t>> const& expected,
+    std::vector<std::map<std::pair<AccountID, uint64_t>,
+                         std::tuple<Asset, Asset, Price, int64_t>>>::
+        const_iterator begin,
+    std::vector<std::map<std::pair<AccountID, uint64_t>,
+                         std::tuple<Asset, Asset, Price, int64_t>>>::
+        const_iterator const& end)
+{
+    REQUIRE(begin != end);
+    LedgerState ls(lsParent);
+    applyLedgerStateUpdates(ls, *begin);
+
+    if (++begin != end)
+    {
+        testOrderBook(ls, buying, selling, expected, begin, end);
+    }
+    else
+    {
+        auto expectedIter = expected.begin();
+        auto offers = ls.getOrderBook(buying, selling);
+        while (expectedIter != expected.end() && offers)
+        {
+            auto const& oe = offers.entry().data.offer();
+            REQUIRE(oe.buying == buying);
+            REQUIRE(oe.selling == selling);
+            REQUIRE(*expectedIter ==
+                    std::make_tuple(oe.offerID, oe.price, oe.amount));
+            ++expectedIter;
+            ++offers;
+        }
+        REQUIRE(expectedIter == expected.end());
+        REQUIRE(!offers);
+    }
+}
+
+static void
+testOrderBook(
+    Asset const& buying, Asset const& selling,
+    std::vector<std::tuple<uint64_t, Price, int64_t>> const& expected,
+    std::vector<std::map<std::pair<AccountID, uint64_t>,
+                         std::tuple<Asset, Asset, Price, int64_t>>>
+        updates)
+{
+    REQUIRE(!updates.empty());
+
+    auto testAtRoot = [&](Application& app) {
+        {
+            LedgerState ls1(app.getLedgerStateRoot());
+            applyLedgerStateUpdates(ls1, *updates.cbegin());
+            ls1.commit();
+        }
+        testOrderBook(app.getLedgerStateRoot(), buying, selling, expected,
+                      ++updates.cbegin(), updates.cend());
+    };
+
+    // first changes are in LedgerStateRoot with cache
+    if (updates.size() > 1)
+    {
+        VirtualClock clock;
+        auto app = createTestApplication(clock, getTestConfig());
+        app->start();
+        testAtRoot(*app);
+    }
+
+    // first changes are in LedgerStateRoot without cache
+    if (updates.size() > 1)
+    {
+        VirtualClock clock;
+        auto cfg = getTestConfig();
+        cfg.ENTRY_CACHE_SIZE = 0;
+        cfg.BEST_OFFERS_CACHE_SIZE = 0;
+        auto app = createTestApplication(clock, cfg);
+        app->start();
+        testAtRoot(*app);
+    }
+
+    // first changes are in child of LedgerStateRoot
+    {
+        VirtualClock clock;
+        auto app = createTestApplication(clock, getTestConfig());
+        app->start();
+
+        testOrderBook(app->getLedgerStateRoot(), buying, selling, expected,
+                      updates.cbegin(), updates.cend());
+    }
+}
+
+TEST_CASE("LedgerState getOrderBook", "[ledgerstate]")
+{
+    auto a1 = LedgerTestUtils::generateValidAccountEntry().accountID;
+
+    Asset buying = LedgerTestUtils::generateValidOfferEntry().buying;
+    Asset selling = LedgerTestUtils::generateValidOfferEntry().selling;
+    REQUIRE(!(buying == selling));
+
+    SECTION("no offers")
+    {
+        testOrderBook(buying, selling, {}, {{}});
+    }
+
+    SECTION("offers in a single state")
+    {
+        testOrderBook(buying, selling,
+                      {{3, Price{1, 2}, 1},
+                       {1, Price{1, 1}, 1},
+                       {4, Price{1, 1}, 1},
+                       {2, Price{2, 1}, 1}},
+                      {{{{a1, 1}, {buying, selling, Price{1, 1}, 1}},
+                        {{a1, 2}, {buying, selling, Price{2, 1}, 1}},
+                        {{a1, 3}, {buying, selling, Price{1, 2}, 1}},
+                        {{a1, 4}, {buying, selling, Price{1, 1}, 1}},
+                        {{a1, 5}, {selling, buying, Price{1, 3}, 1}}}});
+    }
+
+    SECTION("offers merged across states")
+    {
+        testOrderBook(buying, selling,
+                      {{4, Price{1, 3}, 1},
+                       {3, Price{1, 2}, 5},
+                       {1, Price{1, 1}, 1},
+                       {5, Price{3, 1}, 1}},
+                      {{{{a1, 1}, {buying, selling, Price{1, 1}, 1}},
+                        {{a1, 2}, {buying, selling, Price{2, 1}, 1}},
+                        {{a1, 3}, {buying, selling, Price{1, 1}, 1}}},
+                       {{{a1, 2}, {buying, selling, Price{2, 1}, 0}},
+                        {{a1, 4}, {buying, selling, Price{1, 3}, 1}}},
+                       {{{a1, 3}, {buying, selling, Price{1, 2}, 5}},
+                        {{a1, 5}, {buying, selling, Price{3, 1}, 1}}}});
+    }
+
+    SECTION("modified assets in child")
+    {
+        testOrderBook(buying, selling, {{2, Price{1, 1}, 1}},
+                      {{{{a1, 1}, {buying, selling, Price{1, 1}, 1}},
+                        {{a1, 2}, {selling, buying, Price{1, 1}, 1}}},
+                       {{{a1, 1}, {selling, buying, Price{1, 1}, 1}},
+                        {{a1, 2}, {buying, selling, Price{1, 1}, 1}}}});
+    }
+
+    SECTION("more offers than fit in a batch")
+    {
+        std::map<std::pair<AccountID, uint64_t>,
+                 std::tuple<Asset, Asset, Price, int64_t>>
+            updates;
+        std::vector<std::tuple<uint64_t, Price, int64_t>> expected;
+        for (uint64_t i = 1; i <= 50; ++i)
+        {
+            Price price{static_cast<int32_t>(100 - i), 1};
+            updates[{a1, i}] = std::make_tuple(buying, selling, price, 1);
+            expected.emplace(expected.begin(), i, price, 1);
+        }
+        testOrderBook(buying, selling, expected, {updates, {}});
+    }
+}
+
 static void
 testOffersByAccountAndAsset(
     AbstractLedgerStateParent& lsParent, AccountID const& accountID,
@@ -1877,6 +2196,14 @@ TEST_CASE("LedgerState loadOffersByAccountAndAsset", "[ledgerstate]")
                 {{{{a1, 1}, {buying, native, 1}}},
                  {{{a1, 2}, {buying, native, 1}}}});
         }
+
+        SECTION("offers of other account in child")
+        {
+            testOffersByAccountAndAsset(a1, buying, {{1, buying, native, 1}},
+                                        {{{{a1, 1}, {buying, native, 1}}},
+                                         {{{a2, 2}, {buying, native, 1}},
+                                          {{a2, 3}, {native, buying, 1}}}});
+        }
     }
 
     SECTION("two offers in parent")
@@ -1890,6 +2217,34 @@ TEST_CASE("LedgerState loadOffersByAccountAndAsset", "[ledgerstate]")
             {{{{a1, 1}, {buying, native, 1}}, {{a1, 2}, {native, buying, 1}}},
              {}});
     }
+
+    SECTION("cached in LedgerStateRoot then modified")
+    {
+        VirtualClock clock;
+        auto app = createTestApplication(clock, getTestConfig());
+        app->start();
+        auto& root = app->getLedgerStateRoot();
+
+        std::map<std::pair<AccountID, uint64_t>,
+                 std::tuple<Asset, Asset, int64_t>>
+            updates = {{{a1, 1}, {buying, native, 1}}};
+        {
+            LedgerState ls(root);
+            applyLedgerStateUpdates(ls, updates);
+            ls.commit();
+        }
+        REQUIRE(root.getOffersByAccountAndAsset(a1, buying).size() == 1);
+
+        updates = {{{a1, 2}, {native, buying, 1}},
+                   {{a2, 3}, {native, buying, 1}}};
+        {
+            LedgerState ls(root);
+            applyLedgerStateUpdates(ls, updates);
+            ls.commit();
+        }
+        REQUIRE(root.getOffersByAccountAndAsset(a1, buying).size() == 2);
+        REQUIRE(root.getOffersByAccountAndAsset(a2, buying).size() == 1);
+    }
 }
 
 TEST_CASE("LedgerState unsealHeader", "[ledgerstate]")
@@ -5,7 +5,8 @@
 #include "crypto/KeyUtils.h"
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
-#include "ledger/LedgerStateImpl.h"
+#include "ledger/LedgerRange.h"
+#include "ledger/LedgerStateSQLStore.h"
 #include "transactions/TransactionUtils.h"
 #include "util/XDROperators.h"
 #include "util/types.h"
@@ -14,7 +15,7 @@ namespace stellar
 {
 
 std::shared_ptr<LedgerEntry const>
-LedgerStateRoot::Impl::loadTrustLine(LedgerKey const& key) const
+LedgerStateSQLStore::loadTrustLine(LedgerKey const& key) const
 {
     auto const& asset = key.trustLine().asset;
     if (asset.type() == ASSET_TYPE_NATIVE)
@@ -44,56 +45,56 @@ LedgerStateRoot::Impl::loadTrustLine(LedgerKey const& key) const
         issuerStr = KeyUtils::toStrKey(asset.alphaNum12().issuer);
     }
 
-    Liabilities liabilities;
-    soci::indicator buyingLiabilitiesInd, sellingLiabilitiesInd;
-
-    LedgerEntry le;
-    le.data.type(TRUSTLINE);
-    TrustLineEntry& tl = le.data.trustLine();
-
-    auto prep = mDatabase.getPreparedStatement(
+    static RegisteredStatement const sql(
         "SELECT tlimit, balance, flags, debt, lastmodified, buyingliabilities, "
         "sellingliabilities FROM trustlines "
         "WHERE accountid= :id AND issuer= :issuer AND assetcode= :asset");
+    auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
-    st.exchange(soci::into(tl.limit));
-    st.exchange(soci::into(tl.balance));
-    st.exchange(soci::into(tl.flags));
-    st.exchange(soci::into(tl.debt));
-    st.exchange(soci::into(le.lastModifiedLedgerSeq));
-    st.exchange(soci::into(liabilities.buying, buyingLiabilitiesInd));
-    st.exchange(soci::into(liabilities.selling, sellingLiabilitiesInd));
     st.exchange(soci::use(actIDStrKey));
     st.exchange(soci::use(issuerStr));
     st.exchange(soci::use(assetStr));
-    st.define_and_bind();
-    {
-        auto timer = mDatabase.getSelectTimer("trust");
-        st.execute(true);
-    }
-    if (!st.got_data())
-    {
-        return nullptr;
-    }
-
-    tl.accountID = key.trustLine().accountID;
-    tl.asset = key.trustLine().asset;
 
-    assert(buyingLiabilitiesInd == sellingLiabilitiesInd);
-    if (buyingLiabilitiesInd == soci::i_ok)
-    {
-        tl.ext.v(1);
-        tl.ext.v1().liabilities = liabilities;
-    }
-
-    return std::make_shared<LedgerEntry>(std::move(le));
+    std::shared_ptr<LedgerEntry> res;
+    forEachTrustLineRow(prep, [&](LedgerEntry& le) {
+        auto& tl = le.data.trustLine();
+        tl.accountID = key.trustLine().accountID;
+        tl.asset = key.trustLine().asset;
+        res = std::make_shared<LedgerEntry>(le);
+    });
+    return res;
 }
 
 std::shared_ptr<LedgerEntry const>
-LedgerStateRoot::Impl::loadDebtTrustLine(LedgerKey const& key) const
+LedgerStateSQLStore::loadDebtTrustLine(LedgerKey const& key) const
 {
     std::string actIDStrKey = KeyUtils::toStrKey(key.trustLine().accountID);
 
+    auto prep = mDatabase.getPreparedStatement(
+        "SELECT tlimit, balance, flags, debt, lastmodified, buyingliabilities, "
+        "sellingliabilities FROM trustlines "
+        "WHERE accountid= :id AND debt > 0");
+    auto& st = prep.statement();
+    st.exchange(soci::use(actIDStrKey));
+
+    std::shared_ptr<LedgerEntry> res;
+    forEachTrustLineRow(prep, [&](LedgerEntry& le) {
+        if (res)
+        {
+            return;
+        }
+        auto& tl = le.data.trustLine();
+        tl.accountID = key.trustLine().accountID;
+        tl.asset = key.trustLine().asset;
+        res = std::make_shared<LedgerEntry>(le);
+    });
+    return res;
+}
+
+void
+LedgerStateSQLStore::forEachTrustLineRow(StatementContext& prep,
+                                         RowFn const& f) const
+{
     Liabilities liabilities;
     soci::indicator buyingLiabilitiesInd, sellingLiabilitiesInd;
 
@@ -101,10 +102,6 @@ LedgerStateRoot::Impl::loadDebtTrustLine(LedgerKey const& key) const
     le.data.type(TRUSTLINE);
     TrustLineEntry& tl = le.data.trustLine();
 
-    auto prep = mDatabase.getPreparedStatement(
-        "SELECT tlimit, balance, flags, debt, lastmodified, buyingliabilities, "
-        "sellingliabilities FROM trustlines "
-        "WHERE accountid= :id AND debt > 0");
     auto& st = prep.statement();
     st.exchange(soci::into(tl.limit));
     st.exchange(soci::into(tl.balance));
@@ -113,33 +110,87 @@ LedgerStateRoot::Impl::loadDebtTrustLine(LedgerKey const& key) const
     st.exchange(soci::into(le.lastModifiedLedgerSeq));
     st.exchange(soci::into(liabilities.buying, buyingLiabilitiesInd));
     st.exchange(soci::into(liabilities.selling, sellingLiabilitiesInd));
-    st.exchange(soci::use(actIDStrKey));
-
     st.define_and_bind();
     {
         auto timer = mDatabase.getSelectTimer("trust");
         st.execute(true);
     }
-    if (!st.got_data())
+    while (st.got_data())
     {
-        return nullptr;
+        assert(buyingLiabilitiesInd == sellingLiabilitiesInd);
+        tl.ext.v(0);
+        if (buyingLiabilitiesInd == soci::i_ok)
+        {
+            tl.ext.v(1);
+            tl.ext.v1().liabilities = liabilities;
+        }
+
+        f(le);
+        st.fetch();
     }
+}
 
-    tl.accountID = key.trustLine().accountID;
-    tl.asset = key.trustLine().asset;
+void
+LedgerStateSQLStore::loadTrustLines(LedgerRange const& ledgers,
+                                    size_t chunkSize,
+                                    ObjectsChunkFn const& f) const
+{
+    uint32_t first = ledgers.first();
+    uint32_t last = ledgers.last();
 
-    assert(buyingLiabilitiesInd == sellingLiabilitiesInd);
-    if (buyingLiabilitiesInd == soci::i_ok)
-    {
-        tl.ext.v(1);
-        tl.ext.v1().liabilities = liabilities;
-    }
+    // the key comes before the columns read by forEachTrustLineRow
+    std::string actIDStrKey, issuerStr, assetStr;
+    unsigned int assetType;
+    auto prep = mDatabase.getPreparedStatement(
+        "SELECT accountid, assettype, issuer, assetcode, tlimit, balance, "
+        "flags, debt, lastmodified, buyingliabilities, sellingliabilities "
+        "FROM trustlines "
+        "WHERE lastmodified >= :v1 AND lastmodified <= :v2");
+    auto& st = prep.statement();
+    st.exchange(soci::into(actIDStrKey));
+    st.exchange(soci::into(assetType));
+    st.exchange(soci::into(issuerStr));
+    st.exchange(soci::into(assetStr));
+    st.exchange(soci::use(first));
+    st.exchange(soci::use(last));
+
+    ChunkedRows chunks(chunkSize, f);
+    forEachTrustLineRow(prep, [&](LedgerEntry& le) {
+        auto& tl = le.data.trustLine();
+        tl.accountID = KeyUtils::fromStrKey<PublicKey>(actIDStrKey);
+        tl.asset.type((AssetType)assetType);
+        if (assetType == ASSET_TYPE_CREDIT_ALPHANUM4)
+        {
+            tl.asset.alphaNum4().issuer =
+                KeyUtils::fromStrKey<PublicKey>(issuerStr);
+            strToAssetCode(tl.asset.alphaNum4().assetCode, assetStr);
+        }
+        else if (assetType == ASSET_TYPE_CREDIT_ALPHANUM12)
+        {
+            tl.asset.alphaNum12().issuer =
+                KeyUtils::fromStrKey<PublicKey>(issuerStr);
+            strToAssetCode(tl.asset.alphaNum12().assetCode, assetStr);
+        }
+        else
+        {
+            throw std::runtime_error("bad database state");
+        }
+        chunks.add(le);
+    });
+    chunks.flush();
+}
 
-    return std::make_shared<LedgerEntry>(std::move(le));
+std::string
+LedgerStateSQLStore::debtHoldersSQL()
+{
+    return "SELECT accountid, tlimit, balance, flags, debt, lastmodified, "
+           "buyingliabilities, "
+           "sellingliabilities FROM trustlines "
+           "WHERE issuer= :issuer AND assetcode= :asset AND debt <> 0";
 }
 
 std::vector<LedgerEntry>
-LedgerStateRoot::Impl::loadDebtHolders(Asset const& asset) const
+LedgerStateSQLStore::loadDebtHolders(Asset const& asset) const
 {
     if (asset.type() == ASSET_TYPE_NATIVE)
     {
@@ -158,58 +209,26 @@ LedgerStateRoot::Impl::loadDebtHolders(Asset const& asset) const
         issuerStr = KeyUtils::toStrKey(asset.alphaNum12().issuer);
     }
 
-    std::vector<LedgerEntry> trustlines;
+    // the key comes before the columns read by forEachTrustLineRow
     std::string accountid_str;
-
-    LedgerEntry le;
-    le.data.type(TRUSTLINE);
-    TrustLineEntry& tl = le.data.trustLine();
-    Liabilities liabilities;
-    soci::indicator buyingLiabilitiesInd, sellingLiabilitiesInd;
-
-    auto prep = mDatabase.getPreparedStatement(
-        "SELECT accountid, tlimit, balance, flags, debt, lastmodified, "
-        "buyingliabilities, "
-        "sellingliabilities FROM trustlines "
-        "WHERE issuer= :issuer AND assetcode= :asset AND debt != 0");
+    auto prep = mDatabase.getPreparedStatement(debtHoldersSQL());
     auto& st = prep.statement();
     st.exchange(soci::into(accountid_str));
-    st.exchange(soci::into(tl.limit));
-    st.exchange(soci::into(tl.balance));
-    st.exchange(soci::into(tl.flags));
-    st.exchange(soci::into(tl.debt));
-    st.exchange(soci::into(le.lastModifiedLedgerSeq));
-    st.exchange(soci::into(liabilities.buying, buyingLiabilitiesInd));
-    st.exchange(soci::into(liabilities.selling, sellingLiabilitiesInd));
     st.exchange(soci::use(issuerStr));
     st.exchange(soci::use(assetStr));
-    st.define_and_bind();
-    {
-        auto timer = mDatabase.getSelectTimer("trust");
-        st.execute(true);
-    }
 
-    while (st.got_data())
-    {
+    std::vector<LedgerEntry> trustlines;
+    forEachTrustLineRow(prep, [&](LedgerEntry& le) {
+        auto& tl = le.data.trustLine();
         tl.asset = asset;
-
-        assert(buyingLiabilitiesInd == sellingLiabilitiesInd);
-        if (buyingLiabilitiesInd == soci::i_ok)
-        {
-            tl.ext.v(1);
-            tl.ext.v1().liabilities = liabilities;
-        }
         tl.accountID = KeyUtils::fromStrKey<PublicKey>(accountid_str);
-
         trustlines.emplace_back(le);
-        st.fetch();
-    }
-
+    });
     return trustlines;
 }
 
 std::vector<LedgerEntry>
-LedgerStateRoot::Impl::loadLiquidationCandidates(
+LedgerStateSQLStore::loadLiquidationCandidates(
     Asset const& asset1, double ratio1, Asset const& asset2, double ratio2,
     Asset const& assetBalance) const
 {
@@ -290,7 +309,7 @@ LedgerStateRoot::Impl::loadLiquidationCandidates(
 }
 
 std::vector<LedgerEntry>
-LedgerStateRoot::Impl::loadLiquidationSubjects(
+LedgerStateSQLStore::loadLiquidationSubjects(
     Asset const& asset1, double ratio1, Asset const& asset2, double ratio2,
     Asset const& assetBalance, bool stillEligible) const
 {
@@ -393,8 +412,8 @@ LedgerStateRoot::Impl::loadLiquidationSubjects(
 }
 
 void
-LedgerStateRoot::Impl::insertOrUpdateTrustLine(LedgerEntry const& entry,
-                                               bool isInsert)
+LedgerStateSQLStore::insertOrUpdateTrustLine(LedgerEntry const& entry,
+                                             bool isInsert)
 {
     auto const& tl = entry.data.trustLine();
 
@@ -425,24 +444,18 @@ LedgerStateRoot::Impl::insertOrUpdateTrustLine(LedgerEntry const& entry,
         liabilitiesInd = soci::i_ok;
     }
 
-    std::string sql;
-    if (isInsert)
-    {
-        sql =
-            "INSERT INTO trustlines "
-            "(accountid, assettype, issuer, assetcode, balance, debt, tlimit, "
-            "flags, lastmodified, buyingliabilities, sellingliabilities) "
-            "VALUES (:id, :at, :iss, :ac, :b, :dt, :tl, :f, :lm, :bl, :sl)";
-    }
-    else
-    {
-        sql =
-            "UPDATE trustlines "
-            "SET balance=:b, tlimit=:tl, debt=:dt, flags=:f, lastmodified=:lm, "
-            "buyingliabilities=:bl, sellingliabilities=:sl "
-            "WHERE accountid=:id AND issuer=:iss AND assetcode=:ac";
-    }
-    auto prep = mDatabase.getPreparedStatement(sql);
+    static RegisteredStatement const insertSql(
+        "INSERT INTO trustlines "
+        "(accountid, assettype, issuer, assetcode, balance, debt, tlimit, "
+        "flags, lastmodified, buyingliabilities, sellingliabilities) "
+        "VALUES (:id, :at, :iss, :ac, :b, :dt, :tl, :f, :lm, :bl, :sl)");
+    static RegisteredStatement const updateSql(
+        "UPDATE trustlines "
+        "SET balance=:b, tlimit=:tl, debt=:dt, flags=:f, lastmodified=:lm, "
+        "buyingliabilities=:bl, sellingliabilities=:sl "
+        "WHERE accountid=:id AND issuer=:iss AND assetcode=:ac");
+    auto prep =
+        mDatabase.getPreparedStatement(isInsert ? insertSql : updateSql);
     auto& st = prep.statement();
     st.exchange(soci::use(actIDStrKey, "id"));
     if (isInsert)
@@ -471,7 +484,7 @@ LedgerStateRoot::Impl::insertOrUpdateTrustLine(LedgerEntry const& entry,
 }
 
 void
-LedgerStateRoot::Impl::deleteTrustLine(LedgerKey const& key)
+LedgerStateSQLStore::deleteTrustLine(LedgerKey const& key)
 {
     auto const& tl = key.trustLine();
 
@@ -493,9 +506,10 @@ LedgerStateRoot::Impl::deleteTrustLine(LedgerKey const& key)
                                  "outside of OperationFrame");
     }
 
-    auto prep = mDatabase.getPreparedStatement(
+    static RegisteredStatement const sql(
         "DELETE FROM trustlines "
         "WHERE accountid=:v1 AND issuer=:v2 AND assetcode=:v3");
+    auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
     st.exchange(soci::use(actIDStrKey));
     st.exchange(soci::use(issuerStr));
@@ -512,12 +526,8 @@ LedgerStateRoot::Impl::deleteTrustLine(LedgerKey const& key)
 }
 
 void
-LedgerStateRoot::Impl::dropTrustLines()
+LedgerStateSQLStore::dropTrustLines()
 {
-    throwIfChild();
-    mEntryCache.clear();
-    mBestOffersCache.clear();
-
     mDatabase.getSession() << "DROP TABLE IF EXISTS trustlines;";
     mDatabase.getSession()
         << "CREATE TABLE trustlines"
@@ -0,0 +1,233 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/MarketData.h"
+#include "ledger/LedgerState.h"
+#include "lib/json/json.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "transactions/TransactionUtils.h"
+#include "util/XDROperators.h"
+#include "util/types.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+namespace stellar
+{
+
+int64_t const MarketData::DEPTH_THRESHOLD = 100 * 10000000LL;
+
+static Asset
+makeAsset(TrustConfiguration const& config)
+{
+    Asset asset;
+    asset.type(ASSET_TYPE_CREDIT_ALPHANUM4);
+    asset.alphaNum4().issuer = config.mIssuerKey;
+    strToAssetCode(asset.alphaNum4().assetCode, config.mName);
+    return asset;
+}
+
+// walks the offers buying `buying` and selling `selling` until
+// DEPTH_THRESHOLD is reached (same computation as getAvgOfferPrice)
+static MarketData::Side
+walkOrderBook(AbstractLedgerStateParent& ls, Asset const& buying,
+              Asset const& selling, Asset const& base,
+              std::set<LedgerKey>& walked)
+{
+    MarketData::Side side{false, Price{0, 1}, 0, 0, -1.0};
+
+    bool buyingIsBase = compareAsset(buying, base);
+    if (!buyingIsBase && !compareAsset(selling, base))
+    {
+        return side;
+    }
+
+    int64_t total = 0;
+    int64_t depth = MarketData::DEPTH_THRESHOLD;
+    for (auto offers = ls.getOrderBook(buying, selling); offers && depth > 0;
+         ++offers)
+    {
+        auto const& offer = offers.entry().data.offer();
+        walked.emplace(LedgerEntryKey(offers.entry()));
+        if (!side.mHasBestOffer)
+        {
+            side.mHasBestOffer = true;
+            side.mBestPrice = offer.price;
+            side.mBestAmount = offer.amount;
+        }
+
+        auto const& price = offer.price;
+        int64_t denominatedAmount =
+            buyingIsBase
+                ? bigDivide(offer.amount, price.n, price.d, ROUND_DOWN)
+                : offer.amount;
+        int64_t indexedAmount = std::min(depth, denominatedAmount);
+        total += buyingIsBase
+                     ? bigDivide(indexedAmount, price.d, price.n, ROUND_DOWN)
+                     : bigDivide(indexedAmount, price.n, price.d, ROUND_DOWN);
+        depth -= indexedAmount;
+    }
+
+    side.mDepth = MarketData::DEPTH_THRESHOLD - depth;
+    if (side.mDepth > 0)
+    {
+        side.mAvgPrice = (double)total / (double)side.mDepth;
+    }
+    return side;
+}
+
+static Json::Value
+sideToJson(MarketData::Side const& side)
+{
+    Json::Value res;
+    if (side.mHasBestOffer)
+    {
+        res["best_price"] =
+            (double)side.mBestPrice.n / (double)side.mBestPrice.d;
+        res["best_amount"] = static_cast<Json::Int64>(side.mBestAmount);
+    }
+    res["depth"] = static_cast<Json::Int64>(side.mDepth);
+    if (side.mAvgPrice > 0)
+    {
+        res["avg_price"] = side.mAvgPrice;
+    }
+    return res;
+}
+
+MarketData::MarketData(Application& app)
+    : mApp(app)
+    , mOrderBookWalks(app.getMetrics().NewMeter(
+          {"ledger", "marketdata", "order-book-walk"}, "pair"))
+{
+    for (auto const& kv : mApp.getConfig().TRADING)
+    {
+        auto const& config = kv.second;
+        auto& pair = mPairs[kv.first];
+        pair.mCoin1 = makeAsset(config.mCoin1);
+        pair.mCoin2 = makeAsset(config.mCoin2);
+        pair.mBase = makeAsset(config.mBaseAsset);
+        pair.mFeedKey.type(DATA);
+        pair.mFeedKey.data().accountID = config.mReferenceFeed.mIssuerKey;
+        pair.mFeedKey.data().dataName = config.mReferenceFeed.mName;
+        pair.mOffersDirty = true;
+        pair.mFeedDirty = true;
+    }
+}
+
+void
+MarketData::ledgerClosed(std::vector<LedgerEntry> const& liveEntries,
+                         std::vector<LedgerKey> const& deadEntries)
+{
+    for (auto& kv : mPairs)
+    {
+        auto& pair = kv.second;
+        for (auto const& le : liveEntries)
+        {
+            if (le.data.type() == OFFER)
+            {
+                auto const& oe = le.data.offer();
+                if ((oe.buying == pair.mCoin1 && oe.selling == pair.mCoin2) ||
+                    (oe.buying == pair.mCoin2 && oe.selling == pair.mCoin1) ||
+                    pair.mOffers.find(LedgerEntryKey(le)) !=
+                        pair.mOffers.end())
+                {
+                    pair.mOffersDirty = true;
+                }
+            }
+            else if (le.data.type() == DATA &&
+                     LedgerEntryKey(le) == pair.mFeedKey)
+            {
+                pair.mFeedDirty = true;
+            }
+        }
+        for (auto const& key : deadEntries)
+        {
+            if (key.type() == OFFER &&
+                pair.mOffers.find(key) != pair.mOffers.end())
+            {
+                pair.mOffersDirty = true;
+            }
+            else if (key.type() == DATA && key == pair.mFeedKey)
+            {
+                pair.mFeedDirty = true;
+            }
+        }
+    }
+}
+
+void
+MarketData::invalidate()
+{
+    for (auto& kv : mPairs)
+    {
+        kv.second.mOffersDirty = true;
+        kv.second.mFeedDirty = true;
+    }
+}
+
+void
+MarketData::refresh(PairState& pair, AbstractLedgerStateParent& ls)
+{
+    if (pair.mOffersDirty)
+    {
+        pair.mOffers.clear();
+        pair.mData.mBid = walkOrderBook(ls, pair.mCoin1, pair.mCoin2,
+                                        pair.mBase, pair.mOffers);
+        pair.mData.mAsk = walkOrderBook(ls, pair.mCoin2, pair.mCoin1,
+                                        pair.mBase, pair.mOffers);
+        pair.mOffersDirty = false;
+        mOrderBookWalks.Mark();
+    }
+
+    if (pair.mFeedDirty)
+    {
+        pair.mData.mReferencePrice = -1.0;
+        auto feed = ls.getNewestVersion(pair.mFeedKey);
+        double price;
+        if (feed && parseReferencePrice(feed->data.data().dataValue, price))
+        {
+            pair.mData.mReferencePrice = price;
+        }
+        pair.mFeedDirty = false;
+    }
+}
+
+MarketData::PairData const*
+MarketData::getPairData(std::string const& name)
+{
+    auto it = mPairs.find(name);
+    if (it == mPairs.end())
+    {
+        return nullptr;
+    }
+    // the root only contains committed changes, that is the state as of the
+    // last closed ledger
+    refresh(it->second, mApp.getLedgerStateRoot());
+    return &it->second.mData;
+}
+
+Json::Value
+MarketData::getJsonInfo()
+{
+    Json::Value res(Json::objectValue);
+    for (auto const& kv : mPairs)
+    {
+        auto const& data = *getPairData(kv.first);
+        auto& pairJson = res[kv.first];
+        pairJson["bid"] = sideToJson(data.mBid);
+        pairJson["ask"] = sideToJson(data.mAsk);
+        if (data.mBid.mAvgPrice > 0 && data.mAsk.mAvgPrice > 0)
+        {
+            pairJson["mid_price"] =
+                (data.mBid.mAvgPrice + data.mAsk.mAvgPrice) / 2.0;
+        }
+        if (data.mReferencePrice >= 0)
+        {
+            pairJson["reference_price"] = data.mReferencePrice;
+        }
+    }
+    return res;
+}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "lib/json/json-forwards.h"
+#include "xdr/Stellar-ledger-entries.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace medida
+{
+class Meter;
+}
+
+namespace stellar
+{
+
+class AbstractLedgerStateParent;
+class Application;
+
+// Market data of the trading pairs of the configuration (Config::TRADING) as
+// of the last closed ledger: best offer and depth weighted price on both sides
+// of the order book, and the reference price.
+//
+// The entries changed by each closed ledger are used to find the pairs whose
+// data may have changed, the data of a pair is then recomputed (from the last
+// closed ledger) the next time it is queried. Transactions do not use it as
+// they must see the changes made by the transactions applied before them in
+// the same ledger.
+class MarketData
+{
+  public:
+    // amount (in base asset) over which depth weighted prices are computed,
+    // same as the one used by inflation and liquidation
+    static int64_t const DEPTH_THRESHOLD;
+
+    struct Side
+    {
+        bool mHasBestOffer;
+        Price mBestPrice;
+        int64_t mBestAmount;
+
+        // amount available (in base asset) up to DEPTH_THRESHOLD and average
+        // price over that amount (negative if there are no offers)
+        int64_t mDepth;
+        double mAvgPrice;
+    };
+
+    struct PairData
+    {
+        // offers buying coin 1 and offers buying coin 2, named after the
+        // arguments of getMidOrderbookPrice
+        Side mBid;
+        Side mAsk;
+
+        // negative if the reference feed is missing or invalid
+        double mReferencePrice;
+    };
+
+    explicit MarketData(Application& app);
+
+    // records the entries changed by a ledger that is being closed
+    void ledgerClosed(std::vector<LedgerEntry> const& liveEntries,
+                      std::vector<LedgerKey> const& deadEntries);
+
+    // marks the data of every pair as out of date, for when the last closed
+    // ledger changes without going through ledgerClosed (catchup applying
+    // buckets)
+    void invalidate();
+
+    // returns the data of the trading pair with given name or nullptr if there
+    // is no such pair
+    PairData const* getPairData(std::string const& name);
+
+    Json::Value getJsonInfo();
+
+  private:
+    struct PairState
+    {
+        Asset mCoin1;
+        Asset mCoin2;
+        Asset mBase;
+        LedgerKey mFeedKey;
+
+        PairData mData;
+        // offers that were walked to compute mData
+        std::set<LedgerKey> mOffers;
+        bool mOffersDirty;
+        bool mFeedDirty;
+    };
+
+    Application& mApp;
+    std::map<std::string, PairState> mPairs;
+    // marked each time the order book of a pair is walked again
+    medida::Meter& mOrderBookWalks;
+
+    void refresh(PairState& pair, AbstractLedgerStateParent& ls);
+};
+}
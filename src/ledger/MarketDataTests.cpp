@@ -0,0 +1,134 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerManager.h"
+#include "ledger/MarketData.h"
+#include "lib/catch.hpp"
+#include "lib/json/json.h"
+#include "main/Application.h"
+#include "main/CommandHandler.h"
+#include "main/Config.h"
+#include "test/TestAccount.h"
+#include "test/TestUtils.h"
+#include "test/TxTests.h"
+#include "test/test.h"
+
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+
+using namespace stellar;
+using namespace stellar::txtest;
+
+TEST_CASE("market data", "[ledger][marketdata]")
+{
+    auto issuerKey = getAccount("issuer");
+    auto trust = [&](std::string const& name) {
+        return TrustConfiguration{name, issuerKey.getPublicKey()};
+    };
+
+    Config cfg(getTestConfig(0));
+    cfg.TRADING["BTCUSD"] = TradingConfiguration{
+        "BTCUSD", trust("BTC"), trust("USD"), trust("USD"), trust("BTCUSD")};
+    cfg.TRADING["ETHUSD"] = TradingConfiguration{
+        "ETHUSD", trust("ETH"), trust("USD"), trust("USD"), trust("ETHUSD")};
+
+    VirtualClock clock;
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto& walks = app->getMetrics().NewMeter(
+        {"ledger", "marketdata", "order-book-walk"}, "pair");
+
+    auto root = TestAccount::createRoot(*app);
+    auto const minBalance = app->getLedgerManager().getLastMinBalance(5);
+    auto issuer = root.create(issuerKey, minBalance * 10);
+    auto trader = root.create("trader", minBalance * 10);
+
+    auto btc = makeAsset(issuer, "BTC");
+    auto eth = makeAsset(issuer, "ETH");
+    auto usd = makeAsset(issuer, "USD");
+    int64_t const coin = 10000000;
+    for (auto const& asset : {btc, eth, usd})
+    {
+        trader.changeTrust(asset, 1000000 * coin);
+        issuer.pay(trader, asset, 10000 * coin);
+    }
+    trader.manageOffer(0, eth, usd, Price{10, 1}, 50 * coin);
+
+    auto marketData = [&]() {
+        std::string retStr;
+        app->getCommandHandler().marketData("", retStr);
+        Json::Value res;
+        REQUIRE(Json::Reader().parse(retStr, res));
+        return res;
+    };
+    auto closeLedger = [&](std::vector<TransactionFramePtr> const& txs) {
+        auto ledgerSeq = app->getLedgerManager().getLastClosedLedgerNum() + 1;
+        closeLedgerOn(*app, ledgerSeq, 1, 1, 2018, txs);
+    };
+
+    // no pair has been computed yet
+    auto before = marketData();
+    REQUIRE(walks.count() == 2);
+    REQUIRE(!before["BTCUSD"]["ask"].isMember("best_price"));
+    REQUIRE(before["ETHUSD"]["ask"]["best_price"].asDouble() == 10.0);
+    REQUIRE(before["ETHUSD"]["ask"]["best_amount"].asInt64() == 50 * coin);
+    REQUIRE(!before["ETHUSD"].isMember("reference_price"));
+
+    SECTION("queries do not recompute")
+    {
+        REQUIRE(marketData() == before);
+        REQUIRE(walks.count() == 2);
+    }
+
+    SECTION("ledgers that do not touch the pairs do not recompute")
+    {
+        closeLedger({});
+        closeLedger({root.tx({payment(trader, 1000)})});
+        REQUIRE(marketData() == before);
+        REQUIRE(walks.count() == 2);
+    }
+
+    SECTION("only the pair whose order book changed is recomputed")
+    {
+        closeLedger({trader.tx(
+            {manageOffer(0, btc, usd, Price{6000, 1}, 2 * coin)})});
+        auto after = marketData();
+        REQUIRE(walks.count() == 3);
+        REQUIRE(after["BTCUSD"]["ask"]["best_price"].asDouble() == 6000.0);
+        REQUIRE(after["BTCUSD"]["ask"]["best_amount"].asInt64() == 2 * coin);
+        REQUIRE(after["BTCUSD"]["ask"]["depth"].asInt64() ==
+                MarketData::DEPTH_THRESHOLD);
+        REQUIRE(after["ETHUSD"] == before["ETHUSD"]);
+
+        SECTION("taking the offer")
+        {
+            closeLedger({issuer.tx(
+                {manageOffer(0, usd, btc, Price{1, 6000}, 12000 * coin)})});
+            auto taken = marketData();
+            REQUIRE(walks.count() == 4);
+            REQUIRE(!taken["BTCUSD"]["ask"].isMember("best_price"));
+            REQUIRE(taken["ETHUSD"] == before["ETHUSD"]);
+        }
+    }
+
+    SECTION("reference feed changes do not walk the order books")
+    {
+        DataValue value;
+        std::string price = "12.5";
+        value.insert(value.begin(), price.begin(), price.end());
+        closeLedger({issuer.tx({txtest::manageData("ETHUSD", &value)})});
+        auto after = marketData();
+        REQUIRE(walks.count() == 2);
+        REQUIRE(after["ETHUSD"]["reference_price"].asDouble() == 12.5);
+        REQUIRE(after["BTCUSD"] == before["BTCUSD"]);
+    }
+
+    SECTION("invalidating recomputes every pair")
+    {
+        app->getLedgerManager().getMarketData().invalidate();
+        REQUIRE(marketData() == before);
+        REQUIRE(walks.count() == 4);
+    }
+}
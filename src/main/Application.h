@@ -37,11 +37,13 @@ class OverlayManager;
 class Database;
 class PersistentState;
 class LoadGenerator;
+enum class LoadGenMode;
 class CommandHandler;
 class WorkManager;
 class BanManager;
 class StatusManager;
 class LedgerStateRoot;
+class WorkerPool;
 
 class Application;
 void validateNetworkPassphrase(std::shared_ptr<Application> app);
@@ -214,6 +216,11 @@ class Application
     // with caution.
     virtual asio::io_service& getWorkerIOService() = 0;
 
+    // Get the pool of threads reserved for short tasks that the main thread
+    // is waiting for (see WorkerPool), which must not queue behind the work
+    // posted to the worker IO service.
+    virtual WorkerPool& getWorkerPool() = 0;
+
     virtual void postOnMainThread(std::function<void()>&& f) = 0;
     virtual void postOnMainThreadWithDelay(std::function<void()>&& f) = 0;
     virtual void postOnBackgroundThread(std::function<void()>&& f) = 0;
@@ -240,7 +247,7 @@ class Application
 
     // If config.ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING=true, generate some load
     // against the current application.
-    virtual void generateLoad(bool isCreate, uint32_t nAccounts,
+    virtual void generateLoad(LoadGenMode mode, uint32_t nAccounts,
                               uint32_t offset, uint32_t nTxs, uint32_t txRate,
                               uint32_t batchSize, bool autoRate) = 0;
 
@@ -44,6 +44,7 @@
 #include "simulation/LoadGenerator.h"
 #include "util/GlobalChecks.h"
 #include "util/StatusManager.h"
+#include "util/WorkerPool.h"
 #include "work/WorkManager.h"
 
 #include "util/Logging.h"
@@ -53,6 +54,7 @@
 #include <string>
 
 static const int SHUTDOWN_DELAY_SECONDS = 1;
+static const size_t WORKER_POOL_MAX_QUEUED = 1024;
 
 namespace stellar
 {
@@ -98,6 +100,8 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
     {
         mWorkerThreads.emplace_back([this, t]() { this->runWorkerThread(t); });
     }
+    mWorkerPool = std::make_unique<WorkerPool>(mConfig.WORKER_POOL_THREADS,
+                                               WORKER_POOL_MAX_QUEUED);
 }
 
 void
@@ -465,6 +469,7 @@ ApplicationImpl::joinAllThreads()
     {
         w.join();
     }
+    mWorkerPool->shutdown();
     LOG(DEBUG) << "Joined all " << mWorkerThreads.size() << " threads";
 }
 
@@ -481,12 +486,12 @@ ApplicationImpl::manualClose()
 }
 
 void
-ApplicationImpl::generateLoad(bool isCreate, uint32_t nAccounts,
+ApplicationImpl::generateLoad(LoadGenMode mode, uint32_t nAccounts,
                               uint32_t offset, uint32_t nTxs, uint32_t txRate,
                               uint32_t batchSize, bool autoRate)
 {
     getMetrics().NewMeter({"loadgen", "run", "start"}, "run").Mark();
-    getLoadGenerator().generateLoad(isCreate, nAccounts, offset, nTxs, txRate,
+    getLoadGenerator().generateLoad(mode, nAccounts, offset, nTxs, txRate,
                                     batchSize, autoRate);
 }
 
@@ -738,6 +743,12 @@ ApplicationImpl::getWorkerIOService()
     return mWorkerIOService;
 }
 
+WorkerPool&
+ApplicationImpl::getWorkerPool()
+{
+    return *mWorkerPool;
+}
+
 void
 ApplicationImpl::postOnMainThread(std::function<void()>&& f)
 {
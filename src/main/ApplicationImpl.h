@@ -73,6 +73,7 @@ class ApplicationImpl : public Application
     virtual StatusManager& getStatusManager() override;
 
     virtual asio::io_service& getWorkerIOService() override;
+    virtual WorkerPool& getWorkerPool() override;
     virtual void postOnMainThread(std::function<void()>&& f) override;
     virtual void postOnMainThreadWithDelay(std::function<void()>&& f) override;
     virtual void postOnBackgroundThread(std::function<void()>&& f) override;
@@ -94,7 +95,7 @@ class ApplicationImpl : public Application
 
     virtual bool manualClose() override;
 
-    virtual void generateLoad(bool isCreate, uint32_t nAccounts,
+    virtual void generateLoad(LoadGenMode mode, uint32_t nAccounts,
                               uint32_t offset, uint32_t nTxs, uint32_t txRate,
                               uint32_t batchSize, bool autoRate) override;
 
@@ -156,6 +157,7 @@ class ApplicationImpl : public Application
     std::unique_ptr<LedgerStateRoot> mLedgerStateRoot;
 
     std::vector<std::thread> mWorkerThreads;
+    std::unique_ptr<WorkerPool> mWorkerPool;
 
     asio::signal_set mStopSignals;
 
@@ -5,10 +5,12 @@
 #include "main/CommandHandler.h"
 #include "crypto/Hex.h"
 #include "crypto/KeyUtils.h"
+#include "database/Database.h"
 #include "herder/Herder.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerState.h"
 #include "ledger/LedgerStateEntry.h"
+#include "ledger/MarketData.h"
 #include "lib/http/server.hpp"
 #include "lib/json/json.h"
 #include "lib/util/format.h"
@@ -17,6 +19,7 @@
 #include "main/Maintainer.h"
 #include "overlay/BanManager.h"
 #include "overlay/OverlayManager.h"
+#include "simulation/LoadGenerator.h"
 #include "transactions/TransactionUtils.h"
 #include "util/Logging.h"
 #include "util/StatusManager.h"
@@ -82,12 +85,14 @@ CommandHandler::CommandHandler(Application& app) : mApp(app)
     addRoute("logrotate", &CommandHandler::logRotate);
     addRoute("maintenance", &CommandHandler::maintenance);
     addRoute("manualclose", &CommandHandler::manualClose);
+    addRoute("marketdata", &CommandHandler::marketData);
     addRoute("metrics", &CommandHandler::metrics);
     addRoute("clearmetrics", &CommandHandler::clearMetrics);
     addRoute("peers", &CommandHandler::peers);
     addRoute("quorum", &CommandHandler::quorum);
     addRoute("setcursor", &CommandHandler::setcursor);
     addRoute("scp", &CommandHandler::scpInfo);
+    addRoute("sqlprofile", &CommandHandler::sqlProfile);
     addRoute("testacc", &CommandHandler::testAcc);
     addRoute("testtx", &CommandHandler::testTx);
     addRoute("tx", &CommandHandler::tx);
@@ -260,9 +265,8 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         "/droppeer?node=NODE_ID[&ban=D]</h1>"
         "drops peer identified by PEER_ID, when D is 1 the peer is also banned"
         "</p><p><h1> "
-        "/generateload[?mode=(create|pay)&accounts=N&offset=K&txs=M&txrate=(R|"
-        "auto)&"
-        "batchsize=L]</h1>"
+        "/generateload[?mode=(create|pay|marginsetup|margin|liquidate)&"
+        "accounts=N&offset=K&txs=M&txrate=(R|auto)&batchsize=L]</h1>"
         "artificially generate load for testing; must be used with "
         "ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING set to true. "
         "Depending on the mode, either creates new accounts or generates "
@@ -270,6 +274,11 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         " (where number of accounts can be offset)."
         " Additionally, allows batching up to 100 account creations per "
         "transaction via 'batchsize'."
+        " 'marginsetup' creates the issuers and reference prices of the "
+        "TRADING pairs and funds the accounts specified with their coins,"
+        " 'margin' then generates order book and margin offers on them and "
+        "'liquidate' moves the reference prices down and triggers "
+        "liquidations (M times)."
         "</p><p><h1> /help</h1>"
         "give a list of currently supported commands"
         "</p><p><h1> /info</h1>"
@@ -283,6 +292,9 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         "rotate log files"
         "</p><p><h1> /manualclose</h1>"
         "close the current ledger; must be used with MANUAL_CLOSE set to true"
+        "</p><p><h1> /marketdata</h1>"
+        "returns the order book and reference prices of the trading pairs as "
+        "of the last closed ledger in JSON format"
         "</p><p><h1> /metrics</h1>"
         "returns a snapshot of the metrics registry (for monitoring and "
         "debugging purpose)"
@@ -299,6 +311,11 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         "</p><p><h1> /scp?[limit=n]</h1>"
         "returns a JSON object with the internal state of the SCP engine for "
         "the last n (default 2) ledgers."
+        "</p><p><h1> /sqlprofile?[count=n]</h1>"
+        "returns a JSON array with the n (default 10) prepared SQL statements "
+        "that were borrowed for the most time in total, with their borrow "
+        "times (in ms, including the processing of their rows) and the "
+        "number of rows changed by those that write."
         "</p><p><h1> /tx?blob=BASE64</h1>"
         "submit a transaction to the network.<br>"
         "blob is a base64 encoded XDR serialized 'TransactionEnvelope'<br>"
@@ -343,8 +360,9 @@ CommandHandler::fileNotFound(std::string const& params, std::string& retStr)
         "</p><p><h1> /maintenance[?queue=true[&count=N]]</h1> Performs "
         "maintenance tasks on the instance."
         "<ul><li><i>queue</i> performs deletion of queue data. Deletes at most "
-        "count entries from each table (defaults to 50000). See setcursor for "
-        "more information</li></ul>"
+        "count entries from each table (defaults to 50000), in batches of "
+        "AUTOMATIC_MAINTENANCE_BATCH ledgers that may run in the background. "
+        "See setcursor for more information</li></ul>"
         "</p><p><h1> "
         "/unban?node=NODE_ID</h1>"
         "remove ban for PEER_ID"
@@ -425,20 +443,33 @@ CommandHandler::generateLoad(std::string const& params, std::string& retStr)
         std::map<std::string, std::string> map;
         http::server::server::parseParams(params, map);
 
-        bool isCreate;
+        LoadGenMode loadGenMode;
         maybeParseParam<std::string>(map, "mode", mode);
         if (mode == std::string("create"))
         {
-            isCreate = true;
+            loadGenMode = LoadGenMode::CREATE;
         }
         else if (mode == std::string("pay"))
         {
-            isCreate = false;
+            loadGenMode = LoadGenMode::PAY;
+        }
+        else if (mode == std::string("marginsetup"))
+        {
+            loadGenMode = LoadGenMode::MARGIN_SETUP;
+        }
+        else if (mode == std::string("margin"))
+        {
+            loadGenMode = LoadGenMode::MARGIN;
+        }
+        else if (mode == std::string("liquidate"))
+        {
+            loadGenMode = LoadGenMode::LIQUIDATE;
         }
         else
         {
             throw std::runtime_error("Unknown mode.");
         }
+        bool isCreate = loadGenMode == LoadGenMode::CREATE;
 
         maybeParseParam(map, "accounts", nAccounts);
         maybeParseParam(map, "txs", nTxs);
@@ -465,8 +496,8 @@ CommandHandler::generateLoad(std::string const& params, std::string& retStr)
             batchSize = 100;
             retStr = "Setting batch size to its limit of 100.";
         }
-        mApp.generateLoad(isCreate, nAccounts, offset, nTxs, txRate, batchSize,
-                          autoRate);
+        mApp.generateLoad(loadGenMode, nAccounts, offset, nTxs, txRate,
+                          batchSize, autoRate);
         retStr +=
             fmt::format(" Generating load: {:d} {:s}, {:d} tx/s = {:f} hours",
                         numItems, itemType, txRate, hours);
@@ -517,6 +548,13 @@ CommandHandler::info(std::string const&, std::string& retStr)
     retStr = mApp.getJsonInfo().toStyledString();
 }
 
+void
+CommandHandler::marketData(std::string const&, std::string& retStr)
+{
+    retStr =
+        mApp.getLedgerManager().getMarketData().getJsonInfo().toStyledString();
+}
+
 void
 CommandHandler::metrics(std::string const& params, std::string& retStr)
 {
@@ -525,6 +563,18 @@ CommandHandler::metrics(std::string const& params, std::string& retStr)
     retStr = jr.Report();
 }
 
+void
+CommandHandler::sqlProfile(std::string const& params, std::string& retStr)
+{
+    std::map<std::string, std::string> map;
+    http::server::server::parseParams(params, map);
+
+    size_t count = 10;
+    maybeParseParam(map, "count", count);
+
+    retStr = mApp.getDatabase().getStatementProfiles(count).toStyledString();
+}
+
 void
 CommandHandler::logRotate(std::string const& params, std::string& retStr)
 {
@@ -979,8 +1029,9 @@ CommandHandler::maintenance(std::string const& params, std::string& retStr)
         uint32_t count = 50000;
         maybeParseParam(map, "count", count);
 
-        mApp.getMaintainer().performMaintenance(count);
-        retStr = "Done";
+        auto& maintainer = mApp.getMaintainer();
+        maintainer.performMaintenance(count);
+        retStr = maintainer.isRunning() ? "Maintenance in progress" : "Done";
     }
     else
     {
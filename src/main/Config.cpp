@@ -20,6 +20,7 @@
 #include <functional>
 #include <lib/util/format.h>
 #include <sstream>
+#include <thread>
 #include <unordered_set>
 
 namespace stellar
@@ -56,6 +57,9 @@ Config::Config() : NODE_SEED(SecretKey::random())
     CATCHUP_RECENT = 0;
     AUTOMATIC_MAINTENANCE_PERIOD = std::chrono::seconds{14400};
     AUTOMATIC_MAINTENANCE_COUNT = 50000;
+    AUTOMATIC_MAINTENANCE_BATCH = 64;
+    AUTOMATIC_MAINTENANCE_BATCH_PAUSE = std::chrono::milliseconds{100};
+    HISTORY_PARTITION_LEDGERS = 0;
     ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING = false;
     ARTIFICIALLY_ACCELERATE_TIME_FOR_TESTING = false;
     ARTIFICIALLY_SET_CLOSE_TIME_FOR_TESTING = 0;
@@ -85,8 +89,11 @@ Config::Config() : NODE_SEED(SecretKey::random())
     PREFERRED_PEERS_ONLY = false;
 
     MINIMUM_IDLE_PERCENT = 0;
+    PARALLEL_TX_SET_VALIDATION = false;
+    DEFERRED_INVARIANT_CHECKS = false;
 
     MAX_CONCURRENT_SUBPROCESSES = 16;
+    WORKER_POOL_THREADS = std::thread::hardware_concurrency();
     NODE_IS_VALIDATOR = false;
 
     DATABASE = SecretValue{"sqlite3://:memory:"};
@@ -94,6 +101,9 @@ Config::Config() : NODE_SEED(SecretKey::random())
 
     ENTRY_CACHE_SIZE = 4096;
     BEST_OFFERS_CACHE_SIZE = 64;
+    LEDGER_STATE_ARENA = false;
+    BACKGROUND_SCP_HISTORY = false;
+    SQL_EXPLAIN_SAMPLE_PERCENT = 0;
 }
 
 namespace
@@ -347,6 +357,19 @@ Config::load(std::string const& filename)
             {
                 AUTOMATIC_MAINTENANCE_COUNT = readInt<uint32_t>(item);
             }
+            else if (item.first == "AUTOMATIC_MAINTENANCE_BATCH")
+            {
+                AUTOMATIC_MAINTENANCE_BATCH = readInt<uint32_t>(item, 1);
+            }
+            else if (item.first == "AUTOMATIC_MAINTENANCE_BATCH_PAUSE")
+            {
+                AUTOMATIC_MAINTENANCE_BATCH_PAUSE =
+                    std::chrono::milliseconds{readInt<uint32_t>(item)};
+            }
+            else if (item.first == "HISTORY_PARTITION_LEDGERS")
+            {
+                HISTORY_PARTITION_LEDGERS = readInt<uint32_t>(item);
+            }
             else if (item.first == "MANUAL_CLOSE")
             {
                 MANUAL_CLOSE = readBool(item);
@@ -439,6 +462,11 @@ Config::load(std::string const& filename)
                 MAX_CONCURRENT_SUBPROCESSES =
                     static_cast<size_t>(readInt<int>(item, 1));
             }
+            else if (item.first == "WORKER_POOL_THREADS")
+            {
+                WORKER_POOL_THREADS =
+                    static_cast<size_t>(readInt<int>(item, 0));
+            }
             else if (item.first == "MINIMUM_IDLE_PERCENT")
             {
                 MINIMUM_IDLE_PERCENT = readInt<uint32_t>(item, 0, 100);
@@ -606,6 +634,14 @@ Config::load(std::string const& filename)
             {
                 INVARIANT_CHECKS = readStringArray(item);
             }
+            else if (item.first == "DEFERRED_INVARIANT_CHECKS")
+            {
+                DEFERRED_INVARIANT_CHECKS = readBool(item);
+            }
+            else if (item.first == "PARALLEL_TX_SET_VALIDATION")
+            {
+                PARALLEL_TX_SET_VALIDATION = readBool(item);
+            }
             else if (item.first == "ENTRY_CACHE_SIZE")
             {
                 ENTRY_CACHE_SIZE = readInt<size_t>(item);
@@ -614,6 +650,18 @@ Config::load(std::string const& filename)
             {
                 BEST_OFFERS_CACHE_SIZE = readInt<size_t>(item);
             }
+            else if (item.first == "LEDGER_STATE_ARENA")
+            {
+                LEDGER_STATE_ARENA = readBool(item);
+            }
+            else if (item.first == "BACKGROUND_SCP_HISTORY")
+            {
+                BACKGROUND_SCP_HISTORY = readBool(item);
+            }
+            else if (item.first == "SQL_EXPLAIN_SAMPLE_PERCENT")
+            {
+                SQL_EXPLAIN_SAMPLE_PERCENT = readInt<uint32_t>(item, 0, 100);
+            }
             else
             {
                 std::string err("Unknown configuration entry: '");
@@ -107,6 +107,19 @@ class Config : public std::enable_shared_from_this<Config>
     // maintenance run
     uint32_t AUTOMATIC_MAINTENANCE_COUNT;
 
+    // Number of ledgers whose rows are removed from a table by each of the
+    // statements of a maintenance run
+    uint32_t AUTOMATIC_MAINTENANCE_BATCH;
+
+    // Pause between the statements of a maintenance run when the database is
+    // idle, up to ten times longer when it is busy
+    std::chrono::milliseconds AUTOMATIC_MAINTENANCE_BATCH_PAUSE;
+
+    // If non-zero (and on postgres), the history tables created by --newdb
+    // are partitioned by ranges of that many ledgers, that maintenance drops
+    // once all their ledgers can be deleted
+    uint32_t HISTORY_PARTITION_LEDGERS;
+
     // A config parameter that enables synthetic load generation on demand,
     // using the `generateload` runtime command (see CommandHandler.cpp). This
     // option only exists for stress-testing and should not be enabled in
@@ -196,9 +209,20 @@ class Config : public std::enable_shared_from_this<Config>
     // totally insensitive to overloading.
     uint32_t MINIMUM_IDLE_PERCENT;
 
+    // When set, TxSetFrame validation first verifies the signatures of all
+    // transactions on the worker pool, warming the signature cache, before
+    // running the regular validation. The per-account validation itself
+    // stays serial, as LedgerState cannot be shared across threads.
+    bool PARALLEL_TX_SET_VALIDATION;
+
     // process-management config
     size_t MAX_CONCURRENT_SUBPROCESSES;
 
+    // Most threads the worker pool (signature, invariant and SCP history
+    // tasks) may start; they are started as tasks are queued. With 0 all of
+    // these tasks run on the thread that needs them.
+    size_t WORKER_POOL_THREADS;
+
     // SCP config
     SecretKey NODE_SEED;
     bool NODE_IS_VALIDATOR;
@@ -207,6 +231,10 @@ class Config : public std::enable_shared_from_this<Config>
     // Invariants
     std::vector<std::string> INVARIANT_CHECKS;
 
+    // When set, invariants are checked on each operation apply on the worker
+    // threads, and their results are collected before the ledger is closed.
+    bool DEFERRED_INVARIANT_CHECKS;
+
     std::map<std::string, std::string> VALIDATOR_NAMES;
 
     // History config
@@ -232,6 +260,20 @@ class Config : public std::enable_shared_from_this<Config>
     size_t ENTRY_CACHE_SIZE;
     size_t BEST_OFFERS_CACHE_SIZE;
 
+    // When set, the nested LedgerState objects used to apply a transaction
+    // allocate their containers from an arena that is reset after each
+    // transaction instead of from the heap.
+    bool LEDGER_STATE_ARENA;
+
+    // When set (and the database supports worker connections), the SCP
+    // messages of externalized ledgers are written to scphistory/scpquorums
+    // by a worker thread instead of on the main thread.
+    bool BACKGROUND_SCP_HISTORY;
+
+    // Percentage of the statements run on the main PostgreSQL connection
+    // whose plan and timings are logged by the server (auto_explain).
+    uint32_t SQL_EXPLAIN_SAMPLE_PERCENT;
+
     Config();
 
     void load(std::string const& filename);
@@ -33,6 +33,10 @@ class ExternalQueue
     // deletes the subscription for the resource
     void deleteCursor(std::string const& resid);
 
+    // the last ledger whose data can be deleted: it is neither needed to
+    // publish history nor still to be read by the resources with cursors
+    uint32 getLastDeletableLedger();
+
     // safely delete data, maximum count entries from each table
     void deleteOldEntries(uint32 count);
 
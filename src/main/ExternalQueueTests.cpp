@@ -2,13 +2,19 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "database/Database.h"
+#include "ledger/LedgerManager.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
 #include "main/CommandHandler.h"
 #include "main/Config.h"
 #include "main/ExternalQueue.h"
+#include "main/Maintainer.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
 #include "simulation/Simulation.h"
 #include "test/TestUtils.h"
+#include "test/TxTests.h"
 #include "test/test.h"
 
 using namespace stellar;
@@ -44,3 +50,51 @@ TEST_CASE("cursors", "[externalqueue]")
         REQUIRE(curMap.size() == 2);
     }
 }
+
+TEST_CASE("incremental maintenance", "[externalqueue]")
+{
+    auto test = [](Config::TestDbMode mode) {
+        VirtualClock clock;
+        Config cfg(getTestConfig(0, mode));
+        cfg.AUTOMATIC_MAINTENANCE_BATCH = 4;
+        cfg.AUTOMATIC_MAINTENANCE_BATCH_PAUSE = std::chrono::milliseconds(0);
+        Application::pointer app = createTestApplication(clock, cfg);
+        app->start();
+
+        for (uint32 seq = 2; seq <= 40; ++seq)
+        {
+            txtest::closeLedgerOn(*app, seq, 1, 1, 2018);
+        }
+
+        auto lastDeletable = ExternalQueue(*app).getLastDeletableLedger();
+        REQUIRE(lastDeletable > cfg.AUTOMATIC_MAINTENANCE_BATCH);
+
+        auto& maintainer = app->getMaintainer();
+        maintainer.performMaintenance(50000);
+        while (maintainer.isRunning())
+        {
+            clock.crank(true);
+        }
+
+        uint32_t oldest = 0;
+        app->getDatabase().getSession()
+            << "SELECT MIN(ledgerseq) FROM ledgerheaders",
+            soci::into(oldest);
+        REQUIRE(oldest == lastDeletable + 1);
+
+        // the rows of the ledgerheaders alone took that many batches
+        auto& batches =
+            app->getMetrics().NewTimer({"maintenance", "batch", "delete"});
+        REQUIRE(batches.count() >=
+                lastDeletable / cfg.AUTOMATIC_MAINTENANCE_BATCH);
+    };
+
+    SECTION("on the main thread")
+    {
+        test(Config::TESTDB_IN_MEMORY_SQLITE);
+    }
+    SECTION("on a worker thread")
+    {
+        test(Config::TESTDB_ON_DISK_SQLITE);
+    }
+}
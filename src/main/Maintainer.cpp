@@ -3,14 +3,62 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "main/Maintainer.h"
+#include "database/Database.h"
+#include "database/DatabaseUtils.h"
+#include "ledger/LedgerManager.h"
+#include "main/Application.h"
 #include "main/Config.h"
 #include "main/ExternalQueue.h"
 #include "util/Logging.h"
+#include "util/WorkerPool.h"
+
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <algorithm>
+#include <soci.h>
 
 namespace stellar
 {
 
-Maintainer::Maintainer(Application& app) : mApp{app}, mTimer{mApp}
+namespace
+{
+struct HistoryTable
+{
+    char const* mName;
+    char const* mLedgerSeqColumn;
+    // whether it is range partitioned by ledgerseq when
+    // HISTORY_PARTITION_LEDGERS is set (the unique keys of the others do not
+    // include ledgerseq, which postgres requires of partitioned tables)
+    bool mPartitionable;
+};
+
+HistoryTable const HISTORY_TABLES[] = {
+    {"ledgerheaders", "ledgerseq", false},
+    {"txhistory", "ledgerseq", true},
+    {"txfeehistory", "ledgerseq", true},
+    {"scphistory", "ledgerseq", true},
+    {"scpquorums", "lastledgerseq", false},
+    {"upgradehistory", "ledgerseq", true}};
+
+size_t const HISTORY_TABLE_COUNT =
+    sizeof(HISTORY_TABLES) / sizeof(HISTORY_TABLES[0]);
+
+// the pause between two batches is stretched up to this many times when the
+// database is busy
+uint32_t const MIN_IDLE_PERCENT = 10;
+}
+
+Maintainer::Maintainer(Application& app)
+    : mApp{app}
+    , mTimer{mApp}
+    , mBatchTimer{mApp}
+    , mBackground{mApp.getDatabase().canUsePool()}
+    , mBatchDuration{
+          mApp.getMetrics().NewTimer({"maintenance", "batch", "delete"})}
+    , mRunning{false}
+    , mRun{}
+    , mLastQueryTime{0}
+    , mAliveToken{std::make_shared<bool>(true)}
 {
 }
 
@@ -42,8 +90,231 @@ Maintainer::tick()
 void
 Maintainer::performMaintenance(uint32_t count)
 {
+    if (mRunning)
+    {
+        CLOG(INFO, "History") << "Maintenance already in progress";
+        return;
+    }
+
     LOG(INFO) << "Performing maintenance";
     ExternalQueue ps{mApp};
-    ps.deleteOldEntries(count);
+    mRun = Run{};
+    mRun.mLastDeletable = ps.getLastDeletableLedger();
+    mRun.mCount = count;
+    mRun.mLastClosed = mApp.getLedgerManager().getLastClosedLedgerNum();
+    mRunning = true;
+
+    mLastQueryTime = mApp.getDatabase().totalQueryTime();
+    mLastBatchTime = mApp.getClock().now();
+    startBatch();
+}
+
+bool
+Maintainer::isRunning() const
+{
+    return mRunning;
+}
+
+void
+Maintainer::startBatch()
+{
+    if (!mBackground)
+    {
+        // in-memory sqlite (tests) cannot be shared with a worker thread, the
+        // batches all run at once on the session of the main thread
+        std::string error;
+        bool done = false;
+        auto run = mRun;
+        while (!done && error.empty())
+        {
+            error = tryRunBatch(mApp, mApp.getDatabase().getSession(),
+                                mBatchDuration, run, done);
+        }
+        batchDone(run, done, error);
+        return;
+    }
+
+    // the application and its metrics outlive the workers, which it joins
+    // before it is destroyed, but this object may not
+    auto& app = mApp;
+    auto& timer = mBatchDuration;
+    std::weak_ptr<bool> token = mAliveToken;
+    auto run = mRun;
+    auto posted = app.getWorkerPool().tryPost(
+        [this, &app, &timer, token, run]() mutable {
+            std::string error;
+            bool done = false;
+            try
+            {
+                soci::session sess(app.getDatabase().getPool());
+                error = tryRunBatch(app, sess, timer, run, done);
+            }
+            catch (std::exception& e)
+            {
+                error = e.what();
+            }
+            app.postOnMainThread([this, token, run, done, error]() {
+                if (token.lock())
+                {
+                    batchDone(run, done, error);
+                }
+            });
+        });
+    if (!posted)
+    {
+        // the pool has no thread or is saturated, this batch runs here
+        bool done = false;
+        auto error = tryRunBatch(mApp, mApp.getDatabase().getSession(),
+                                 mBatchDuration, run, done);
+        batchDone(run, done, error);
+    }
+}
+
+std::string
+Maintainer::tryRunBatch(Application& app, soci::session& sess,
+                        medida::Timer& timer, Run& run, bool& done)
+{
+    try
+    {
+        auto t = timer.TimeScope();
+        done = runBatch(app, sess, run);
+    }
+    catch (std::exception& e)
+    {
+        return e.what();
+    }
+    return std::string();
+}
+
+void
+Maintainer::batchDone(Run const& run, bool done, std::string const& error)
+{
+    mRun = run;
+    if (!error.empty())
+    {
+        // the next run starts over from the oldest remaining ledgers
+        CLOG(WARNING, "History") << "Maintenance interrupted: " << error;
+        mRunning = false;
+        return;
+    }
+    if (done)
+    {
+        CLOG(INFO, "History") << "Maintenance done, trimmed history <= ledger "
+                              << mRun.mLastDeletable;
+        mRunning = false;
+        return;
+    }
+
+    // pause for longer when the database has been busy since the previous
+    // batch, so that the batches mostly use the time it is idle
+    auto pause = mApp.getConfig().AUTOMATIC_MAINTENANCE_BATCH_PAUSE;
+    pause = pause * 100 / std::max(recentIdlePercent(), MIN_IDLE_PERCENT);
+    mBatchTimer.expires_from_now(pause);
+    mBatchTimer.async_wait([this]() { startBatch(); },
+                           VirtualTimer::onFailureNoop);
+}
+
+uint32_t
+Maintainer::recentIdlePercent()
+{
+    // Database::recentIdleDbPercent starts a new window at each call, which
+    // would take it from the LoadManager, so the window is kept here
+    auto& db = mApp.getDatabase();
+    auto query = db.totalQueryTime() - mLastQueryTime;
+    std::chrono::nanoseconds total = mApp.getClock().now() - mLastBatchTime;
+    mLastQueryTime = db.totalQueryTime();
+    mLastBatchTime = mApp.getClock().now();
+
+    if (total <= std::chrono::nanoseconds::zero())
+    {
+        return 100;
+    }
+    if (query >= total)
+    {
+        return 0;
+    }
+    return static_cast<uint32_t>(100 - (100 * query.count()) / total.count());
+}
+
+bool
+Maintainer::runBatch(Application& app, soci::session& sess, Run& run)
+{
+    auto const& cfg = app.getConfig();
+    auto isPostgres = sess.get_backend_name() == "postgresql";
+    auto partitionLedgers =
+        isPostgres ? app.getDatabase().getHistoryPartitionLedgers() : 0;
+
+    if (!run.mPartitionsDone)
+    {
+        run.mPartitionsDone = true;
+        if (partitionLedgers != 0)
+        {
+            for (auto const& table : HISTORY_TABLES)
+            {
+                if (!table.mPartitionable ||
+                    !DatabaseUtils::isPartitioned(sess, table.mName))
+                {
+                    continue;
+                }
+                // create them ahead so that the rows of the ledgers to come
+                // do not go to the default partition
+                DatabaseUtils::createPartitions(
+                    sess, table.mName, partitionLedgers, run.mLastClosed,
+                    run.mLastClosed + 2 * partitionLedgers);
+                auto dropped = DatabaseUtils::dropOldPartitions(
+                    sess, table.mName, partitionLedgers, run.mLastDeletable);
+                if (dropped != 0)
+                {
+                    CLOG(INFO, "History")
+                        << "Dropped " << dropped << " partitions of "
+                        << table.mName;
+                }
+            }
+            return false;
+        }
+    }
+
+    while (run.mTable < HISTORY_TABLE_COUNT)
+    {
+        auto const& table = HISTORY_TABLES[run.mTable];
+        if (!run.mHaveLimit)
+        {
+            uint32_t oldest = 0;
+            if (run.mCount == 0 ||
+                !DatabaseUtils::getOldestLedger(
+                    sess, table.mName, table.mLedgerSeqColumn, oldest) ||
+                oldest > run.mLastDeletable)
+            {
+                ++run.mTable;
+                continue;
+            }
+            run.mLimit = static_cast<uint32_t>(
+                std::min<uint64_t>(static_cast<uint64_t>(oldest) + run.mCount,
+                                 run.mLastDeletable));
+            run.mHaveLimit = true;
+        }
+
+        bool more;
+        {
+            soci::transaction tx(sess);
+            if (isPostgres)
+            {
+                // only rows of old ledgers are touched, a serialization
+                // failure against ledger close would just waste the batch
+                sess << "SET TRANSACTION ISOLATION LEVEL READ COMMITTED";
+            }
+            more = DatabaseUtils::deleteOldEntriesBatch(
+                sess, run.mLimit, cfg.AUTOMATIC_MAINTENANCE_BATCH, table.mName,
+                table.mLedgerSeqColumn);
+            tx.commit();
+        }
+        if (!more)
+        {
+            ++run.mTable;
+            run.mHaveLimit = false;
+        }
+        return run.mTable == HISTORY_TABLE_COUNT;
+    }
+    return true;
 }
 }
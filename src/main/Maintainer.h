@@ -6,13 +6,45 @@
 
 #include "util/Timer.h"
 
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <string>
+
+namespace medida
+{
+class Timer;
+}
+
+namespace soci
+{
+class session;
+}
 
 namespace stellar
 {
 
 class Application;
 
+// Deletes from the history tables (txhistory, scphistory...) the rows of the
+// ledgers that are neither needed to publish history nor still to be read by
+// the resources with cursors (see ExternalQueue).
+//
+// A maintenance run goes through the tables one batch of
+// AUTOMATIC_MAINTENANCE_BATCH ledgers at a time, each in its own short
+// transaction. When the database has a connection pool the batches run on a
+// worker thread (or on the main thread when no worker takes them), so that
+// ledger close does not wait behind the deletes. Between two batches the run
+// pauses, for longer the busier the database has been. Without a pool
+// (in-memory sqlite) the whole run is performed at once.
+//
+// With HISTORY_PARTITION_LEDGERS, the first step of a run creates the
+// partitions of the ledgers to come and drops those of deleted ledgers. On
+// postgres 11, CREATE TABLE ... PARTITION OF and DROP TABLE of a partition
+// take an ACCESS EXCLUSIVE lock on the parent table: while one of them waits
+// for or holds it, the inserts of ledger close into that table wait too. This
+// happens about once every HISTORY_PARTITION_LEDGERS ledgers per table, and
+// the statements themselves only touch the catalog.
 class Maintainer
 {
   public:
@@ -21,14 +53,60 @@ class Maintainer
     // start automatic mainanining according to app.getConfig()
     void start();
 
-    // removes maximum count entries from tables like txhistory or scphistory
+    // starts a run that removes the rows of at most count ledgers from each
+    // table, unless one is already in progress
     void performMaintenance(uint32_t count);
 
+    // true while a run is in progress
+    bool isRunning() const;
+
   private:
+    // the progress of a run, copied to the thread that deletes a batch
+    struct Run
+    {
+        // nothing after this ledger is deleted
+        uint32_t mLastDeletable;
+        // ledgers deleted from each table
+        uint32_t mCount;
+        // partitions are created ahead of this ledger
+        uint32_t mLastClosed;
+        // the first step of a run maintains the partitions
+        bool mPartitionsDone;
+        // index in the tables of the one being trimmed, and the last ledger
+        // trimmed from it (once known)
+        size_t mTable;
+        bool mHaveLimit;
+        uint32_t mLimit;
+    };
+
     Application& mApp;
     VirtualTimer mTimer;
+    VirtualTimer mBatchTimer;
+    bool const mBackground;
+    medida::Timer& mBatchDuration;
+
+    bool mRunning;
+    Run mRun;
+    std::chrono::nanoseconds mLastQueryTime;
+    VirtualClock::time_point mLastBatchTime;
+
+    // only lives as long as this object, lets the callbacks posted by the
+    // batches detect that it is gone
+    std::shared_ptr<bool> mAliveToken;
 
     void scheduleMaintenance();
     void tick();
+
+    void startBatch();
+    void batchDone(Run const& run, bool done, std::string const& error);
+    uint32_t recentIdlePercent();
+
+    // deletes the next batch of run, returns true once the run is complete;
+    // only reads the configuration of app, so that it can run on any thread
+    static bool runBatch(Application& app, soci::session& sess, Run& run);
+    // runs runBatch timed by timer, returns what it threw if anything
+    static std::string tryRunBatch(Application& app, soci::session& sess,
+                                   medida::Timer& timer, Run& run,
+                                   bool& done);
 };
 }
@@ -818,16 +818,18 @@ Peer::recvSCPMessage(StellarMessage const& msg)
 
     mApp.getOverlayManager().recvFloodedMsg(msg, shared_from_this());
 
+    // the herder times the processing of the envelope, which happens once
+    // its signature is checked
     auto type = msg.envelope().statement.pledges.type();
-    auto t = (type == SCP_ST_PREPARE
-                  ? mRecvSCPPrepareTimer.TimeScope()
-                  : (type == SCP_ST_CONFIRM
-                         ? mRecvSCPConfirmTimer.TimeScope()
-                         : (type == SCP_ST_EXTERNALIZE
-                                ? mRecvSCPExternalizeTimer.TimeScope()
-                                : (mRecvSCPNominateTimer.TimeScope()))));
-
-    mApp.getHerder().recvSCPEnvelope(envelope);
+    auto& timer =
+        (type == SCP_ST_PREPARE
+             ? mRecvSCPPrepareTimer
+             : (type == SCP_ST_CONFIRM
+                    ? mRecvSCPConfirmTimer
+                    : (type == SCP_ST_EXTERNALIZE ? mRecvSCPExternalizeTimer
+                                                  : mRecvSCPNominateTimer)));
+
+    mApp.getHerder().queueSCPEnvelope(envelope, timer);
 }
 
 void
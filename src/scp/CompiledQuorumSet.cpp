@@ -0,0 +1,167 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "scp/CompiledQuorumSet.h"
+#include "util/XDROperators.h"
+
+#include <algorithm>
+#include <bitset>
+
+namespace stellar
+{
+
+constexpr size_t NodeIndex::npos;
+
+size_t
+NodeIndex::add(NodeID const& nodeID)
+{
+    return mIndex.emplace(nodeID, mIndex.size()).first->second;
+}
+
+size_t
+NodeIndex::find(NodeID const& nodeID) const
+{
+    auto it = mIndex.find(nodeID);
+    return it == mIndex.end() ? npos : it->second;
+}
+
+NodeBitSet::NodeBitSet(size_t size) : mWords((size + 63) / 64, 0)
+{
+}
+
+void
+NodeBitSet::set(size_t i)
+{
+    mWords[i / 64] |= (uint64_t{1} << (i % 64));
+}
+
+void
+NodeBitSet::reset(size_t i)
+{
+    mWords[i / 64] &= ~(uint64_t{1} << (i % 64));
+}
+
+bool
+NodeBitSet::test(size_t i) const
+{
+    return (mWords[i / 64] & (uint64_t{1} << (i % 64))) != 0;
+}
+
+size_t
+NodeBitSet::countCommon(NodeBitSet const& other) const
+{
+    size_t res = 0;
+    auto n = std::min(mWords.size(), other.mWords.size());
+    for (size_t i = 0; i < n; i++)
+    {
+        res += std::bitset<64>(mWords[i] & other.mWords[i]).count();
+    }
+    return res;
+}
+
+CompiledQuorumSet::CompiledQuorumSet(SCPQuorumSet const& qSet,
+                                     NodeIndex const& index)
+    : mThreshold(qSet.threshold)
+    , mEntries(qSet.validators.size() + qSet.innerSets.size())
+    , mValidators(index.size())
+{
+    for (auto const& validator : qSet.validators)
+    {
+        auto i = index.find(validator);
+        if (i == NodeIndex::npos)
+        {
+            continue;
+        }
+        if (mValidators.test(i))
+        {
+            mDuplicates.emplace_back(i);
+        }
+        else
+        {
+            mValidators.set(i);
+        }
+    }
+
+    mInnerSets.reserve(qSet.innerSets.size());
+    for (auto const& inner : qSet.innerSets)
+    {
+        mInnerSets.emplace_back(inner, index);
+    }
+}
+
+size_t
+CompiledQuorumSet::countValidators(NodeBitSet const& nodes) const
+{
+    auto res = mValidators.countCommon(nodes);
+    for (auto i : mDuplicates)
+    {
+        if (nodes.test(i))
+        {
+            res++;
+        }
+    }
+    return res;
+}
+
+bool
+CompiledQuorumSet::isQuorumSlice(NodeBitSet const& nodes) const
+{
+    // a slice needs at least one node
+    if (mThreshold == 0)
+    {
+        return false;
+    }
+
+    size_t count = countValidators(nodes);
+    if (count >= mThreshold)
+    {
+        return true;
+    }
+
+    for (auto const& inner : mInnerSets)
+    {
+        if (inner.isQuorumSlice(nodes))
+        {
+            count++;
+            if (count >= mThreshold)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool
+CompiledQuorumSet::isVBlocking(NodeBitSet const& nodes) const
+{
+    // There is no v-blocking set for {\empty}
+    if (mThreshold == 0)
+    {
+        return false;
+    }
+
+    int64_t leftTillBlock = static_cast<int64_t>(1 + mEntries) - mThreshold;
+    size_t needed = static_cast<size_t>(std::max<int64_t>(1, leftTillBlock));
+
+    size_t count = countValidators(nodes);
+    if (count >= needed)
+    {
+        return true;
+    }
+
+    for (auto const& inner : mInnerSets)
+    {
+        if (inner.isVBlocking(nodes))
+        {
+            count++;
+            if (count >= needed)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "crypto/SecretKey.h"
+#include "xdr/Stellar-SCP.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace stellar
+{
+
+/**
+ * Dense numbering of a set of nodes: each node gets an index in [0, size()),
+ * which allows subsets of nodes to be represented as NodeBitSet.
+ */
+class NodeIndex
+{
+  public:
+    static constexpr size_t npos = SIZE_MAX;
+
+    // returns the index of nodeID, adding it if needed
+    size_t add(NodeID const& nodeID);
+
+    // returns the index of nodeID or npos if it is not known
+    size_t find(NodeID const& nodeID) const;
+
+    size_t
+    size() const
+    {
+        return mIndex.size();
+    }
+
+  private:
+    std::unordered_map<NodeID, size_t> mIndex;
+};
+
+/**
+ * Set of node indices (as defined by a NodeIndex).
+ */
+class NodeBitSet
+{
+  public:
+    explicit NodeBitSet(size_t size);
+
+    void set(size_t i);
+    void reset(size_t i);
+    bool test(size_t i) const;
+
+    // number of nodes present in both this and other
+    size_t countCommon(NodeBitSet const& other) const;
+
+  private:
+    std::vector<uint64_t> mWords;
+};
+
+/**
+ * Quorum set where validators are replaced by their index in a NodeIndex.
+ *
+ * Checks against a NodeBitSet are threshold checks on the number of common
+ * bits instead of searches of each validator in a list of nodes. Validators
+ * that are not part of the index can never be in a NodeBitSet and are dropped
+ * (the number of entries of the original quorum set is retained as it
+ * matters for v-blocking checks).
+ */
+class CompiledQuorumSet
+{
+  public:
+    CompiledQuorumSet(SCPQuorumSet const& qSet, NodeIndex const& index);
+
+    // see LocalNode::isQuorumSlice and LocalNode::isVBlocking
+    bool isQuorumSlice(NodeBitSet const& nodes) const;
+    bool isVBlocking(NodeBitSet const& nodes) const;
+
+  private:
+    uint32 mThreshold;
+    size_t mEntries;
+    NodeBitSet mValidators;
+    // extra occurrences of validators listed more than once, counted once
+    // per occurrence
+    std::vector<size_t> mDuplicates;
+    std::vector<CompiledQuorumSet> mInnerSets;
+
+    size_t countValidators(NodeBitSet const& nodes) const;
+};
+}
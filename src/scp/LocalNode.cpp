@@ -8,6 +8,7 @@
 #include "crypto/KeyUtils.h"
 #include "crypto/SHA.h"
 #include "lib/json/json.h"
+#include "scp/CompiledQuorumSet.h"
 #include "scp/QuorumSetUtils.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
@@ -126,38 +127,6 @@ LocalNode::getNodeWeight(NodeID const& nodeID, SCPQuorumSet const& qset)
     return 0;
 }
 
-bool
-LocalNode::isQuorumSliceInternal(SCPQuorumSet const& qset,
-                                 std::vector<NodeID> const& nodeSet)
-{
-    uint32 thresholdLeft = qset.threshold;
-    for (auto const& validator : qset.validators)
-    {
-        auto it = std::find(nodeSet.begin(), nodeSet.end(), validator);
-        if (it != nodeSet.end())
-        {
-            thresholdLeft--;
-            if (thresholdLeft <= 0)
-            {
-                return true;
-            }
-        }
-    }
-
-    for (auto const& inner : qset.innerSets)
-    {
-        if (isQuorumSliceInternal(inner, nodeSet))
-        {
-            thresholdLeft--;
-            if (thresholdLeft <= 0)
-            {
-                return true;
-            }
-        }
-    }
-    return false;
-}
-
 bool
 LocalNode::isQuorumSlice(SCPQuorumSet const& qSet,
                          std::vector<NodeID> const& nodeSet)
@@ -165,49 +134,18 @@ LocalNode::isQuorumSlice(SCPQuorumSet const& qSet,
     CLOG(TRACE, "SCP") << "LocalNode::isQuorumSlice"
                        << " nodeSet.size: " << nodeSet.size();
 
-    return isQuorumSliceInternal(qSet, nodeSet);
-}
-
-// called recursively
-bool
-LocalNode::isVBlockingInternal(SCPQuorumSet const& qset,
-                               std::vector<NodeID> const& nodeSet)
-{
-    // There is no v-blocking set for {\empty}
-    if (qset.threshold == 0)
-    {
-        return false;
-    }
-
-    int leftTillBlock =
-        (int)((1 + qset.validators.size() + qset.innerSets.size()) -
-              qset.threshold);
-
-    for (auto const& validator : qset.validators)
+    NodeIndex index;
+    for (auto const& n : nodeSet)
     {
-        auto it = std::find(nodeSet.begin(), nodeSet.end(), validator);
-        if (it != nodeSet.end())
-        {
-            leftTillBlock--;
-            if (leftTillBlock <= 0)
-            {
-                return true;
-            }
-        }
+        index.add(n);
     }
-    for (auto const& inner : qset.innerSets)
+    NodeBitSet nodes(index.size());
+    for (size_t i = 0; i < index.size(); i++)
     {
-        if (isVBlockingInternal(inner, nodeSet))
-        {
-            leftTillBlock--;
-            if (leftTillBlock <= 0)
-            {
-                return true;
-            }
-        }
+        nodes.set(i);
     }
 
-    return false;
+    return CompiledQuorumSet(qSet, index).isQuorumSlice(nodes);
 }
 
 bool
@@ -217,7 +155,18 @@ LocalNode::isVBlocking(SCPQuorumSet const& qSet,
     CLOG(TRACE, "SCP") << "LocalNode::isVBlocking"
                        << " nodeSet.size: " << nodeSet.size();
 
-    return isVBlockingInternal(qSet, nodeSet);
+    NodeIndex index;
+    for (auto const& n : nodeSet)
+    {
+        index.add(n);
+    }
+    NodeBitSet nodes(index.size());
+    for (size_t i = 0; i < index.size(); i++)
+    {
+        nodes.set(i);
+    }
+
+    return CompiledQuorumSet(qSet, index).isVBlocking(nodes);
 }
 
 bool
@@ -225,16 +174,18 @@ LocalNode::isVBlocking(SCPQuorumSet const& qSet,
                        std::map<NodeID, SCPEnvelope> const& map,
                        std::function<bool(SCPStatement const&)> const& filter)
 {
-    std::vector<NodeID> pNodes;
+    NodeIndex index;
+    NodeBitSet nodes(map.size());
     for (auto const& it : map)
     {
+        auto i = index.add(it.first);
         if (filter(it.second.statement))
         {
-            pNodes.push_back(it.first);
+            nodes.set(i);
         }
     }
 
-    return isVBlocking(qSet, pNodes);
+    return CompiledQuorumSet(qSet, index).isVBlocking(nodes);
 }
 
 bool
@@ -243,38 +194,48 @@ LocalNode::isQuorum(
     std::function<SCPQuorumSetPtr(SCPStatement const&)> const& qfun,
     std::function<bool(SCPStatement const&)> const& filter)
 {
-    std::vector<NodeID> pNodes;
+    // nodes are indexed in map order
+    NodeIndex index;
+    for (auto const& it : map)
+    {
+        index.add(it.first);
+    }
+
+    NodeBitSet nodes(index.size());
+    std::vector<std::unique_ptr<CompiledQuorumSet>> qSets(index.size());
+    size_t i = 0;
     for (auto const& it : map)
     {
         if (filter(it.second.statement))
         {
-            pNodes.push_back(it.first);
+            nodes.set(i);
+            auto qSetPtr = qfun(it.second.statement);
+            if (qSetPtr)
+            {
+                qSets[i] = std::make_unique<CompiledQuorumSet>(*qSetPtr, index);
+            }
         }
+        i++;
     }
 
-    size_t count = 0;
+    // remove nodes that do not have a slice within the set until reaching a
+    // fixpoint: what is left is the largest quorum within the filtered nodes
+    bool changed;
     do
     {
-        count = pNodes.size();
-        std::vector<NodeID> fNodes(pNodes.size());
-        auto quorumFilter = [&](NodeID nodeID) -> bool {
-            auto qSetPtr = qfun(map.find(nodeID)->second.statement);
-            if (qSetPtr)
-            {
-                return isQuorumSlice(*qSetPtr, pNodes);
-            }
-            else
+        changed = false;
+        for (i = 0; i < qSets.size(); i++)
+        {
+            if (nodes.test(i) &&
+                (!qSets[i] || !qSets[i]->isQuorumSlice(nodes)))
             {
-                return false;
+                nodes.reset(i);
+                changed = true;
             }
-        };
-        auto it = std::copy_if(pNodes.begin(), pNodes.end(), fNodes.begin(),
-                               quorumFilter);
-        fNodes.resize(std::distance(fNodes.begin(), it));
-        pNodes = fNodes;
-    } while (count != pNodes.size());
-
-    return isQuorumSlice(qSet, pNodes);
+        }
+    } while (changed);
+
+    return CompiledQuorumSet(qSet, index).isQuorumSlice(nodes);
 }
 
 std::vector<NodeID>
@@ -107,10 +107,6 @@ class LocalNode
     static SCPQuorumSet buildSingletonQSet(NodeID const& nodeID);
 
     // called recursively
-    static bool isQuorumSliceInternal(SCPQuorumSet const& qset,
-                                      std::vector<NodeID> const& nodeSet);
-    static bool isVBlockingInternal(SCPQuorumSet const& qset,
-                                    std::vector<NodeID> const& nodeSet);
     static void forAllNodesInternal(SCPQuorumSet const& qset,
                                     std::function<void(NodeID const&)> proc);
 };
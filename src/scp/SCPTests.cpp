@@ -421,6 +421,116 @@ TEST_CASE("vblocking and quorum", "[scp]")
     REQUIRE(LocalNode::isVBlocking(qSet, nodeSet) == true);
 }
 
+TEST_CASE("transitive quorum", "[scp]")
+{
+    SIMULATION_CREATE_NODE(0);
+    SIMULATION_CREATE_NODE(1);
+    SIMULATION_CREATE_NODE(2);
+    SIMULATION_CREATE_NODE(3);
+    SIMULATION_CREATE_NODE(4);
+
+    SCPQuorumSet qSet;
+    qSet.threshold = 3;
+    qSet.validators.push_back(v0NodeID);
+    qSet.validators.push_back(v1NodeID);
+    qSet.validators.push_back(v2NodeID);
+    qSet.validators.push_back(v3NodeID);
+
+    // v0, v1 and v2 trust each other, v3 depends on v4
+    auto qSet012 = std::make_shared<SCPQuorumSet>();
+    qSet012->threshold = 2;
+    qSet012->validators.push_back(v0NodeID);
+    qSet012->validators.push_back(v1NodeID);
+    qSet012->validators.push_back(v2NodeID);
+    auto qSet4 = std::make_shared<SCPQuorumSet>();
+    qSet4->threshold = 1;
+    qSet4->validators.push_back(v4NodeID);
+
+    std::map<NodeID, SCPQuorumSetPtr> qSets;
+    qSets[v0NodeID] = qSet012;
+    qSets[v1NodeID] = qSet012;
+    qSets[v2NodeID] = qSet012;
+    qSets[v3NodeID] = qSet4;
+
+    std::map<NodeID, SCPEnvelope> envs;
+    for (auto const& q : qSets)
+    {
+        envs[q.first].statement.nodeID = q.first;
+    }
+
+    auto qfun = [&](SCPStatement const& st) { return qSets[st.nodeID]; };
+
+    // v3 is dropped as it has no slice, {v0, v1, v2} is left
+    REQUIRE(LocalNode::isQuorum(qSet, envs, qfun));
+
+    qSet.threshold = 4;
+    REQUIRE(!LocalNode::isQuorum(qSet, envs, qfun));
+
+    auto notV1 = [&](SCPStatement const& st) {
+        return !(st.nodeID == v1NodeID);
+    };
+    auto onlyV1 = [&](SCPStatement const& st) {
+        return st.nodeID == v1NodeID;
+    };
+
+    qSet.threshold = 2;
+    REQUIRE(LocalNode::isQuorum(qSet, envs, qfun, notV1));
+    REQUIRE(!LocalNode::isVBlocking(qSet, envs, onlyV1));
+
+    qSet.threshold = 3;
+    REQUIRE(!LocalNode::isQuorum(qSet, envs, qfun, notV1));
+    REQUIRE(!LocalNode::isVBlocking(qSet, envs, onlyV1));
+
+    qSet.threshold = 4;
+    REQUIRE(LocalNode::isVBlocking(qSet, envs, onlyV1));
+}
+
+TEST_CASE("quorum evaluation benchmark", "[scp][bench][!hide]")
+{
+    // 3 levels of 10 groups each: 1000 validators
+    std::vector<SecretKey> keys;
+    SCPQuorumSet qSet;
+    qSet.threshold = 7;
+    for (int i = 0; i < 10; i++)
+    {
+        SCPQuorumSet mid;
+        mid.threshold = 7;
+        for (int j = 0; j < 10; j++)
+        {
+            SCPQuorumSet leaf;
+            leaf.threshold = 7;
+            for (int k = 0; k < 10; k++)
+            {
+                keys.emplace_back(SecretKey::random());
+                leaf.validators.emplace_back(keys.back().getPublicKey());
+            }
+            mid.innerSets.emplace_back(leaf);
+        }
+        qSet.innerSets.emplace_back(mid);
+    }
+    auto qSetPtr = std::make_shared<SCPQuorumSet>(qSet);
+
+    std::map<NodeID, SCPEnvelope> envs;
+    for (auto const& k : keys)
+    {
+        envs[k.getPublicKey()].statement.nodeID = k.getPublicKey();
+    }
+    auto qfun = [&](SCPStatement const&) { return qSetPtr; };
+
+    size_t n = 100;
+    LOG(INFO) << "Benchmarking " << n << " quorum and v-blocking evaluations"
+              << " over " << keys.size() << " nodes";
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++)
+    {
+        REQUIRE(LocalNode::isQuorum(qSet, envs, qfun));
+        REQUIRE(LocalNode::isVBlocking(qSet, envs));
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    LOG(INFO) << "Evaluation took " << elapsed.count() / n << "us on average";
+}
+
 TEST_CASE("v-blocking distance", "[scp]")
 {
     SIMULATION_CREATE_NODE(0);
@@ -15,8 +15,10 @@
 #include "lib/catch.hpp"
 #include "lib/util/format.h"
 #include "main/Application.h"
+#include "main/Config.h"
 #include "medida/stats/snapshot.h"
 #include "overlay/StellarXDR.h"
+#include "simulation/LoadGenerator.h"
 #include "simulation/Topologies.h"
 #include "test/test.h"
 #include "transactions/TransactionFrame.h"
@@ -354,7 +356,8 @@ TEST_CASE("Stress test on 2 nodes 3 accounts 10 random transactions 10tx/sec",
     auto nodes = simulation->getNodes();
     auto& app = *nodes[0]; // pick a node to generate load
 
-    app.getLoadGenerator().generateLoad(true, 3, 0, 0, 10, 100, false);
+    app.getLoadGenerator().generateLoad(LoadGenMode::CREATE, 3, 0, 0, 10, 100,
+                                        false);
     try
     {
         simulation->crankUntil(
@@ -367,7 +370,8 @@ TEST_CASE("Stress test on 2 nodes 3 accounts 10 random transactions 10tx/sec",
             },
             3 * Herder::EXP_LEDGER_TIMESPAN_SECONDS, false);
 
-        app.getLoadGenerator().generateLoad(false, 3, 0, 10, 10, 100, false);
+        app.getLoadGenerator().generateLoad(LoadGenMode::PAY, 3, 0, 10, 10,
+                                            100, false);
         simulation->crankUntil(
             [&]() {
                 return simulation->haveAllExternalized(8, 2) &&
@@ -384,8 +388,8 @@ TEST_CASE("Stress test on 2 nodes 3 accounts 10 random transactions 10tx/sec",
     LOG(INFO) << simulation->metricsSummary("database");
 }
 
-Application::pointer
-newLoadTestApp(VirtualClock& clock)
+Config
+getLoadTestConfig()
 {
     Config cfg =
 #ifdef USE_POSTGRES
@@ -397,6 +401,12 @@ newLoadTestApp(VirtualClock& clock)
     // ledger close
     cfg.TESTING_UPGRADE_MAX_TX_PER_LEDGER = 10000;
     cfg.USE_CONFIG_FOR_GENESIS = true;
+    return cfg;
+}
+
+Application::pointer
+newLoadTestApp(VirtualClock& clock, Config const& cfg = getLoadTestConfig())
+{
     Application::pointer appPtr = Application::create(clock, cfg);
     appPtr->start();
     return appPtr;
@@ -407,7 +417,7 @@ TEST_CASE("Auto-calibrated single node load test", "[autoload][!hide]")
     VirtualClock clock(VirtualClock::REAL_TIME);
     auto appPtr = newLoadTestApp(clock);
     // Create accounts
-    appPtr->generateLoad(true, 100000, 0, 0, 10, 3, true);
+    appPtr->generateLoad(LoadGenMode::CREATE, 100000, 0, 0, 10, 3, true);
     auto& io = clock.getIOService();
     asio::io_service::work mainWork(io);
     auto& complete =
@@ -417,13 +427,49 @@ TEST_CASE("Auto-calibrated single node load test", "[autoload][!hide]")
         clock.crank();
     }
     // Generate payments
-    appPtr->generateLoad(false, 100000, 0, 100000, 10, 100, true);
+    appPtr->generateLoad(LoadGenMode::PAY, 100000, 0, 100000, 10, 100, true);
     while (!io.stopped() && complete.count() == 1)
     {
         clock.crank();
     }
 }
 
+TEST_CASE("Margin single node load test", "[marginload][!hide]")
+{
+    auto cfg = getLoadTestConfig();
+    auto loadGenAccount = [](std::string const& name) {
+        return TrustConfiguration{
+            name, LoadGenerator::getIssuerKey(name).getPublicKey()};
+    };
+    cfg.TRADING["BTCUSD"] =
+        TradingConfiguration{"BTCUSD", loadGenAccount("BTC"),
+                             loadGenAccount("USD"), loadGenAccount("USD"),
+                             loadGenAccount("BTCUSD")};
+
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    auto appPtr = newLoadTestApp(clock, cfg);
+    auto& io = clock.getIOService();
+    asio::io_service::work mainWork(io);
+    auto& complete =
+        appPtr->getMetrics().NewMeter({"loadgen", "run", "complete"}, "run");
+    auto run = [&](LoadGenMode mode, uint32_t nTxs) {
+        auto count = complete.count();
+        appPtr->generateLoad(mode, 1000, 0, nTxs, 100, 100, false);
+        while (!io.stopped() && complete.count() == count)
+        {
+            clock.crank();
+        }
+    };
+
+    run(LoadGenMode::CREATE, 0);
+    run(LoadGenMode::MARGIN_SETUP, 0);
+    run(LoadGenMode::MARGIN, 10000);
+    run(LoadGenMode::LIQUIDATE, 3);
+    REQUIRE(appPtr->getMetrics()
+                .NewMeter({"loadgen", "liquidation", "any"}, "liquidation")
+                .count() == 3);
+}
+
 class ScaleReporter
 {
     std::vector<std::string> mColumns;
@@ -501,7 +547,7 @@ TEST_CASE("Accounts vs. latency", "[scalability][!hide]")
     uint32_t numItems = 500000;
 
     // Create accounts
-    lg.generateLoad(true, numItems, 0, 0, 10, 100, true);
+    lg.generateLoad(LoadGenMode::CREATE, numItems, 0, 0, 10, 100, true);
 
     auto& complete =
         appPtr->getMetrics().NewMeter({"loadgen", "run", "complete"}, "run");
@@ -516,7 +562,8 @@ TEST_CASE("Accounts vs. latency", "[scalability][!hide]")
     txtime.Clear();
 
     // Generate payment txs
-    lg.generateLoad(false, numItems, 0, numItems / 10, 10, 100, true);
+    lg.generateLoad(LoadGenMode::PAY, numItems, 0, numItems / 10, 10, 100,
+                    true);
     while (!io.stopped() && complete.count() == 1)
     {
         clock.crank();
@@ -549,7 +596,8 @@ netTopologyTest(std::string const& name,
         assert(!nodes.empty());
         auto& app = *nodes[0];
 
-        app.getLoadGenerator().generateLoad(true, 50, 0, 0, 10, 100, false);
+        app.getLoadGenerator().generateLoad(LoadGenMode::CREATE, 50, 0, 0, 10,
+                                            100, false);
         auto& complete =
             app.getMetrics().NewMeter({"loadgen", "run", "complete"}, "run");
 
@@ -24,7 +24,10 @@
 
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
+#include "medida/stats/snapshot.h"
+#include "medida/timer.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <set>
@@ -40,12 +43,54 @@ const uint32_t LoadGenerator::STEP_MSECS = 100;
 //
 const uint32_t LoadGenerator::TX_SUBMIT_MAX_TRIES = 1000;
 
+// Amount of each coin of the trading pairs given to every account by
+// MARGIN_SETUP.
+static const int64_t MARGIN_COIN_BALANCE = 1000 * 10000000LL;
+// Offers are placed at up to this fraction away from the reference price:
+// above it for order book offers, below it (so that they cross the book) for
+// margin offers.
+static const double MAX_OFFER_SPREAD = 0.05;
+static const int64_t MAX_MARGIN_LEVERAGE = 5;
+static const int32_t PRICE_SCALE = 10000;
+// Each LIQUIDATE round multiplies the reference prices by this factor.
+static const double LIQUIDATION_PRICE_MOVE = 0.9;
+
+static Price
+toPrice(double price)
+{
+    double n = std::round(price * PRICE_SCALE);
+    n = std::min(std::max(n, 1.0), static_cast<double>(INT32_MAX));
+    return Price{static_cast<int32_t>(n), PRICE_SCALE};
+}
+
+static DataValue
+makeReferencePriceValue(double price)
+{
+    auto str = fmt::format("{:.7f}", price);
+    DataValue value;
+    value.assign(str.begin(), str.end());
+    return value;
+}
+
 LoadGenerator::LoadGenerator(Application& app)
-    : mMinBalance(0), mLastSecond(0), mApp(app)
+    : mMinBalance(0)
+    , mLastSecond(0)
+    , mApp(app)
+    , mSetupPrepared(false)
+    , mWaitingForSetupStage(false)
+    , mSetupStageLedger(0)
+    , mLastLiquidationLedger(0)
 {
     createRootAccount();
 }
 
+SecretKey
+LoadGenerator::getIssuerKey(std::string const& assetName)
+{
+    auto name = "LoadGenIssuer-" + assetName;
+    return txtest::getAccount(name.c_str());
+}
+
 LoadGenerator::~LoadGenerator()
 {
     clear();
@@ -136,12 +181,17 @@ void
 LoadGenerator::clear()
 {
     mAccounts.clear();
+    mIssuers.clear();
+    mTradingPairs.clear();
+    mSetupStages.clear();
+    mSetupPrepared = false;
+    mWaitingForSetupStage = false;
     mRoot.reset();
 }
 
 // Schedule a callback to generateLoad() STEP_MSECS miliseconds from now.
 void
-LoadGenerator::scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
+LoadGenerator::scheduleLoadGeneration(LoadGenMode mode, uint32_t nAccounts,
                                       uint32_t offset, uint32_t nTxs,
                                       uint32_t txRate, uint32_t batchSize,
                                       bool autoRate)
@@ -155,11 +205,11 @@ LoadGenerator::scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
     {
         mLoadTimer->expires_from_now(std::chrono::milliseconds(STEP_MSECS));
         mLoadTimer->async_wait([this, nAccounts, offset, nTxs, txRate,
-                                batchSize, isCreate,
+                                batchSize, mode,
                                 autoRate](asio::error_code const& error) {
             if (!error)
             {
-                this->generateLoad(isCreate, nAccounts, offset, nTxs, txRate,
+                this->generateLoad(mode, nAccounts, offset, nTxs, txRate,
                                    batchSize, autoRate);
             }
         });
@@ -171,11 +221,11 @@ LoadGenerator::scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
             << mApp.getState();
         mLoadTimer->expires_from_now(std::chrono::seconds(10));
         mLoadTimer->async_wait([this, nAccounts, offset, nTxs, txRate,
-                                batchSize, isCreate,
+                                batchSize, mode,
                                 autoRate](asio::error_code const& error) {
             if (!error)
             {
-                this->scheduleLoadGeneration(isCreate, nAccounts, offset, nTxs,
+                this->scheduleLoadGeneration(mode, nAccounts, offset, nTxs,
                                              txRate, batchSize, autoRate);
             }
         });
@@ -187,12 +237,28 @@ LoadGenerator::scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
 // If work remains after the current step, call scheduleLoadGeneration()
 // with the remainder.
 void
-LoadGenerator::generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
-                            uint32_t nTxs, uint32_t txRate, uint32_t batchSize,
-                            bool autoRate)
+LoadGenerator::generateLoad(LoadGenMode mode, uint32_t nAccounts,
+                            uint32_t offset, uint32_t nTxs, uint32_t txRate,
+                            uint32_t batchSize, bool autoRate)
 {
     createRootAccount();
 
+    uint32_t ledgerNum = mApp.getLedgerManager().getLastClosedLedgerNum() + 1;
+
+    if (mode == LoadGenMode::MARGIN_SETUP && !mSetupPrepared)
+    {
+        updateMinBalance();
+        nTxs = prepareMarginSetup(nAccounts, offset, batchSize, ledgerNum);
+    }
+    else if ((mode == LoadGenMode::MARGIN || mode == LoadGenMode::LIQUIDATE) &&
+             !loadTradingPairs(ledgerNum))
+    {
+        CLOG(ERROR, "LoadGen") << "No trading pair to generate load on";
+        nTxs = 0;
+    }
+
+    bool isCreate = mode == LoadGenMode::CREATE;
+
     // Finish if no more txs need to be created.
     if ((isCreate && nAccounts == 0) || (!isCreate && nTxs == 0))
     {
@@ -216,22 +282,40 @@ LoadGenerator::generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
         mApp.getMetrics().NewTimer({"loadgen", "step", "submit"});
     auto submitScope = submitTimer.TimeScope();
 
-    uint32_t ledgerNum = mApp.getLedgerManager().getLastClosedLedgerNum() + 1;
-
     for (uint32_t i = 0; i < txPerStep; ++i)
     {
-        if (isCreate)
+        if ((mode == LoadGenMode::MARGIN_SETUP &&
+             !marginSetupStageApplied(ledgerNum)) ||
+            (mode == LoadGenMode::LIQUIDATE &&
+             mLastLiquidationLedger == ledgerNum))
         {
-            nAccounts =
-                submitCreationTx(nAccounts, offset, batchSize, ledgerNum);
+            // Wait for the next ledger
+            break;
         }
-        else
+
+        switch (mode)
         {
+        case LoadGenMode::CREATE:
+            nAccounts =
+                submitCreationTx(nAccounts, offset, batchSize, ledgerNum);
+            break;
+        case LoadGenMode::PAY:
             nTxs =
                 submitPaymentTx(nAccounts, offset, batchSize, ledgerNum, nTxs);
+            break;
+        case LoadGenMode::MARGIN_SETUP:
+            nTxs = submitMarginSetupTx(batchSize, ledgerNum, nTxs);
+            break;
+        case LoadGenMode::MARGIN:
+            nTxs =
+                submitMarginTx(nAccounts, offset, batchSize, ledgerNum, nTxs);
+            break;
+        case LoadGenMode::LIQUIDATE:
+            nTxs = submitLiquidationTxs(batchSize, ledgerNum, nTxs);
+            break;
         }
 
-        if (nAccounts == 0 || (!isCreate && nTxs == 0))
+        if ((isCreate && nAccounts == 0) || (!isCreate && nTxs == 0))
         {
             // Nothing to do for the rest of the step
             break;
@@ -253,10 +337,10 @@ LoadGenerator::generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
     // Emit a log message once per second.
     if (secondBoundary)
     {
-        logProgress(submit, isCreate, nAccounts, nTxs, batchSize, txRate);
+        logProgress(submit, mode, nAccounts, nTxs, batchSize, txRate);
     }
 
-    scheduleLoadGeneration(isCreate, nAccounts, offset, nTxs, txRate, batchSize,
+    scheduleLoadGeneration(mode, nAccounts, offset, nTxs, txRate, batchSize,
                            autoRate);
 }
 
@@ -272,7 +356,7 @@ LoadGenerator::submitCreationTx(uint32_t nAccounts, uint32_t offset,
     bool createDuplicate = false;
     int numTries = 0;
 
-    while ((status = tx.execute(mApp, true, code, batchSize)) !=
+    while ((status = tx.execute(mApp, LoadGenMode::CREATE, code, batchSize)) !=
            Herder::TX_STATUS_PENDING)
     {
         handleFailedSubmission(tx.mFrom, status, code); // Update seq num
@@ -310,7 +394,7 @@ LoadGenerator::submitPaymentTx(uint32_t nAccounts, uint32_t offset,
     Herder::TransactionSubmitStatus status;
     int numTries = 0;
 
-    while ((status = tx.execute(mApp, false, code, batchSize)) !=
+    while ((status = tx.execute(mApp, LoadGenMode::PAY, code, batchSize)) !=
            Herder::TX_STATUS_PENDING)
     {
         handleFailedSubmission(tx.mFrom, status, code); // Update seq num
@@ -329,6 +413,87 @@ LoadGenerator::submitPaymentTx(uint32_t nAccounts, uint32_t offset,
     return nTxs;
 }
 
+bool
+LoadGenerator::submitTx(TxInfo& tx, LoadGenMode mode, uint32_t batchSize)
+{
+    TransactionResultCode code;
+    Herder::TransactionSubmitStatus status;
+    int numTries = 0;
+
+    while ((status = tx.execute(mApp, mode, code, batchSize)) !=
+           Herder::TX_STATUS_PENDING)
+    {
+        handleFailedSubmission(tx.mFrom, status, code); // Update seq num
+        if (status == Herder::TX_STATUS_DUPLICATE)
+        {
+            break;
+        }
+        if (++numTries >= TX_SUBMIT_MAX_TRIES)
+        {
+            CLOG(ERROR, "LoadGen") << "Error submitting tx: did you run "
+                                      "generateload in marginsetup mode?";
+            clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t
+LoadGenerator::submitMarginSetupTx(uint32_t batchSize, uint32_t ledgerNum,
+                                   uint32_t nTxs)
+{
+    if (mSetupStages.empty())
+    {
+        return 0;
+    }
+
+    auto& stage = mSetupStages.front();
+    TxInfo tx = stage.front();
+    stage.pop_front();
+    if (stage.empty())
+    {
+        mSetupStages.pop_front();
+        mWaitingForSetupStage = true;
+        mSetupStageLedger = ledgerNum;
+    }
+
+    if (!submitTx(tx, LoadGenMode::MARGIN_SETUP, batchSize))
+    {
+        return 0;
+    }
+    return nTxs - 1;
+}
+
+uint32_t
+LoadGenerator::submitMarginTx(uint32_t nAccounts, uint32_t offset,
+                              uint32_t batchSize, uint32_t ledgerNum,
+                              uint32_t nTxs)
+{
+    auto sourceAccountId = rand_uniform<uint64_t>(0, nAccounts - 1) + offset;
+    TxInfo tx = marginTransaction(ledgerNum, sourceAccountId);
+    if (!submitTx(tx, LoadGenMode::MARGIN, batchSize))
+    {
+        return 0;
+    }
+    return nTxs - 1;
+}
+
+uint32_t
+LoadGenerator::submitLiquidationTxs(uint32_t batchSize, uint32_t ledgerNum,
+                                    uint32_t nTxs)
+{
+    mLastLiquidationLedger = ledgerNum;
+    for (auto& tx : liquidationTransactions())
+    {
+        if (!submitTx(tx, LoadGenMode::LIQUIDATE, batchSize))
+        {
+            return 0;
+        }
+    }
+    return nTxs - 1;
+}
+
 void
 LoadGenerator::inspectRate(uint32_t ledgerNum, uint32_t& txRate)
 {
@@ -398,8 +563,8 @@ LoadGenerator::inspectRate(uint32_t ledgerNum, uint32_t& txRate)
 }
 
 void
-LoadGenerator::logProgress(std::chrono::nanoseconds submitTimer, bool isCreate,
-                           uint32_t nAccounts, uint32_t nTxs,
+LoadGenerator::logProgress(std::chrono::nanoseconds submitTimer,
+                           LoadGenMode mode, uint32_t nAccounts, uint32_t nTxs,
                            uint32_t batchSize, uint32_t txRate)
 {
     using namespace std::chrono;
@@ -410,7 +575,8 @@ LoadGenerator::logProgress(std::chrono::nanoseconds submitTimer, bool isCreate,
 
     auto submitSteps = duration_cast<milliseconds>(submitTimer).count();
 
-    auto remainingTxCount = isCreate ? nAccounts / batchSize : nTxs;
+    auto remainingTxCount =
+        mode == LoadGenMode::CREATE ? nAccounts / batchSize : nTxs;
     auto etaSecs =
         (uint32_t)(((double)remainingTxCount) / applyTx.one_minute_rate());
 
@@ -430,6 +596,276 @@ LoadGenerator::logProgress(std::chrono::nanoseconds submitTimer, bool isCreate,
     txm.report();
 }
 
+void
+LoadGenerator::logOperationLatencies()
+{
+    auto& lm = mApp.getLedgerManager();
+    for (auto type : {CREATE_ACCOUNT, PAYMENT, CHANGE_TRUST, SET_OPTIONS,
+                      MANAGE_DATA, MANAGE_OFFER, CREATE_MARGIN_OFFER,
+                      LIQUIDATION})
+    {
+        auto& timer = lm.getOperationApplyTimer(type);
+        if (timer.count() == 0)
+        {
+            continue;
+        }
+        auto snapshot = timer.GetSnapshot();
+        CLOG(INFO, "LoadGen")
+            << xdr::xdr_traits<OperationType>::enum_name(type)
+            << " apply latency over " << timer.count() << " ops: "
+            << std::setprecision(3) << snapshot.getMedian() << "ms median, "
+            << snapshot.get95thPercentile() << "ms p95, "
+            << snapshot.get99thPercentile() << "ms p99";
+    }
+}
+
+bool
+LoadGenerator::loadTradingPairs(uint32_t ledgerNum)
+{
+    if (!mTradingPairs.empty())
+    {
+        return true;
+    }
+
+    auto getIssuer = [&](TrustConfiguration const& config) -> TestAccountPtr {
+        auto key = getIssuerKey(config.mName);
+        if (!(key.getPublicKey() == config.mIssuerKey))
+        {
+            return nullptr;
+        }
+        auto it = mIssuers.find(config.mName);
+        if (it == mIssuers.end())
+        {
+            SequenceNumber sn = static_cast<SequenceNumber>(ledgerNum) << 32;
+            auto issuer = make_shared<TestAccount>(mApp, key, sn);
+            // picks up the sequence number if it already exists
+            loadAccount(issuer, mApp);
+            it = mIssuers.emplace(config.mName, issuer).first;
+        }
+        return it->second;
+    };
+
+    for (auto const& kv : mApp.getConfig().TRADING)
+    {
+        auto const& config = kv.second;
+        TradingPair pair;
+        pair.mCoin1Issuer = getIssuer(config.mCoin1);
+        pair.mCoin2Issuer = getIssuer(config.mCoin2);
+        pair.mBaseIssuer = getIssuer(config.mBaseAsset);
+        pair.mFeed = getIssuer(config.mReferenceFeed);
+        if (!pair.mCoin1Issuer || !pair.mCoin2Issuer || !pair.mBaseIssuer ||
+            !pair.mFeed)
+        {
+            CLOG(WARNING, "LoadGen")
+                << "Skipping trading pair " << kv.first
+                << ": its accounts are not the ones of the load generator";
+            continue;
+        }
+
+        pair.mCoin1 =
+            makeAsset(pair.mCoin1Issuer->getSecretKey(), config.mCoin1.mName);
+        pair.mCoin2 =
+            makeAsset(pair.mCoin2Issuer->getSecretKey(), config.mCoin2.mName);
+        pair.mCoin1IsBase =
+            pair.mCoin1 == makeAsset(pair.mBaseIssuer->getSecretKey(),
+                                     config.mBaseAsset.mName);
+        pair.mFeedName = config.mReferenceFeed.mName;
+
+        // continue from the published price, if any
+        pair.mReferencePrice = 1.0;
+        {
+            LedgerState ls(mApp.getLedgerStateRoot());
+            PublicKey feedKey = pair.mFeed->getPublicKey();
+            double price = 1.0;
+            if (getReferencePrice(ls, pair.mFeedName, feedKey, price) &&
+                price > 0)
+            {
+                pair.mReferencePrice = price;
+            }
+        }
+        mTradingPairs.emplace_back(pair);
+    }
+    return !mTradingPairs.empty();
+}
+
+uint32_t
+LoadGenerator::prepareMarginSetup(uint32_t nAccounts, uint32_t offset,
+                                  uint32_t batchSize, uint32_t ledgerNum)
+{
+    mSetupPrepared = true;
+    if (!loadTradingPairs(ledgerNum))
+    {
+        CLOG(ERROR, "LoadGen") << "No trading pair to set up";
+        return 0;
+    }
+
+    // consecutive operations of the same account share transactions
+    auto add = [batchSize](std::deque<TxInfo>& stage, TestAccountPtr from,
+                           Operation const& op) {
+        if (stage.empty() || stage.back().mFrom != from ||
+            stage.back().mOps.size() >= std::max<uint32_t>(batchSize, 1))
+        {
+            stage.emplace_back(TxInfo{from, {}});
+        }
+        stage.back().mOps.emplace_back(op);
+    };
+
+    std::vector<std::pair<Asset, TestAccountPtr>> coins;
+    auto addCoin = [&](Asset const& asset, TestAccountPtr const& issuer) {
+        if (std::find_if(coins.begin(), coins.end(),
+                         [&](std::pair<Asset, TestAccountPtr> const& coin) {
+                             return coin.first == asset;
+                         }) == coins.end())
+        {
+            coins.emplace_back(asset, issuer);
+        }
+    };
+    for (auto const& pair : mTradingPairs)
+    {
+        addCoin(pair.mCoin1, pair.mCoin1Issuer);
+        addCoin(pair.mCoin2, pair.mCoin2Issuer);
+    }
+
+    // the issuers and feeds are created first
+    std::deque<TxInfo> issuers;
+    for (auto const& kv : mIssuers)
+    {
+        if (!loadAccount(kv.second, mApp))
+        {
+            add(issuers, mRoot,
+                txtest::createAccount(kv.second->getPublicKey(),
+                                      mMinBalance * 1000));
+        }
+    }
+
+    // then the base asset flags, reference prices and trustlines
+    std::deque<TxInfo> trust;
+    std::set<std::string> baseIssuers, feeds;
+    for (auto const& pair : mTradingPairs)
+    {
+        if (baseIssuers.insert(pair.mBaseIssuer->getAccountId()).second)
+        {
+            add(trust, pair.mBaseIssuer,
+                txtest::setOptions(txtest::setFlags(BASE_ASSET_FLAG)));
+        }
+        if (feeds.insert(pair.mFeedName).second)
+        {
+            auto value = makeReferencePriceValue(pair.mReferencePrice);
+            add(trust, pair.mFeed, txtest::manageData(pair.mFeedName, &value));
+        }
+    }
+    for (uint64_t i = offset; i < offset + nAccounts; i++)
+    {
+        auto account = findAccount(i, ledgerNum);
+        trust.emplace_back(TxInfo{account, {}});
+        for (auto const& coin : coins)
+        {
+            trust.back().mOps.emplace_back(
+                txtest::changeTrust(coin.first, INT64_MAX));
+        }
+    }
+
+    // and finally the coins are issued to the accounts
+    std::deque<TxInfo> funding;
+    for (auto const& coin : coins)
+    {
+        for (uint64_t i = offset; i < offset + nAccounts; i++)
+        {
+            add(funding, coin.second,
+                txtest::payment(findAccount(i, ledgerNum)->getPublicKey(),
+                                coin.first, MARGIN_COIN_BALANCE));
+        }
+    }
+
+    uint32_t nTxs = 0;
+    for (auto stage : {&issuers, &trust, &funding})
+    {
+        if (!stage->empty())
+        {
+            nTxs += static_cast<uint32_t>(stage->size());
+            mSetupStages.emplace_back(std::move(*stage));
+        }
+    }
+    CLOG(INFO, "LoadGen") << "Setting up " << mTradingPairs.size()
+                          << " trading pairs for " << nAccounts
+                          << " accounts in " << mSetupStages.size()
+                          << " stages (" << nTxs << " txs)";
+    return nTxs;
+}
+
+bool
+LoadGenerator::marginSetupStageApplied(uint32_t ledgerNum)
+{
+    if (!mWaitingForSetupStage)
+    {
+        return true;
+    }
+    // the transactions of the stage cannot have been applied before the
+    // ledger they were submitted for is closed, and accounts are only
+    // reloaded once per ledger after that
+    if (ledgerNum <= mSetupStageLedger)
+    {
+        return false;
+    }
+    if (!checkAccountSynced(mApp).empty())
+    {
+        mSetupStageLedger = ledgerNum;
+        return false;
+    }
+    mWaitingForSetupStage = false;
+    return true;
+}
+
+LoadGenerator::TxInfo
+LoadGenerator::marginTransaction(uint32_t ledgerNum, uint64_t sourceAccount)
+{
+    auto from = findAccount(sourceAccount, ledgerNum);
+    auto const& pair = rand_element(mTradingPairs);
+
+    // price of coin 2 in coin 1
+    double price2 = pair.mCoin1IsBase ? pair.mReferencePrice
+                                      : 1.0 / pair.mReferencePrice;
+    bool sellCoin1 = rand_flip();
+    Asset const& selling = sellCoin1 ? pair.mCoin1 : pair.mCoin2;
+    Asset const& buying = sellCoin1 ? pair.mCoin2 : pair.mCoin1;
+    // price of selling in terms of buying
+    double mid = sellCoin1 ? 1.0 / price2 : price2;
+    double spread = rand_fraction() * MAX_OFFER_SPREAD;
+    int64_t amount =
+        rand_uniform<int64_t>(1, 100) * (MARGIN_COIN_BALANCE / 1000);
+
+    Operation op;
+    if (rand_flip())
+    {
+        // rests in the book, deepening it
+        op = txtest::manageOffer(0, selling, buying,
+                                 toPrice(mid * (1.0 + spread)), amount);
+    }
+    else
+    {
+        // crosses the book, opening (or growing) a leveraged position
+        op = txtest::createMarginOffer(
+            selling, buying, toPrice(mid * (1.0 - spread)),
+            amount * rand_uniform<int64_t>(1, MAX_MARGIN_LEVERAGE));
+    }
+    return TxInfo{from, {op}};
+}
+
+std::vector<LoadGenerator::TxInfo>
+LoadGenerator::liquidationTransactions()
+{
+    std::vector<TxInfo> txs;
+    for (auto& pair : mTradingPairs)
+    {
+        pair.mReferencePrice *= LIQUIDATION_PRICE_MOVE;
+        auto value = makeReferencePriceValue(pair.mReferencePrice);
+        txs.emplace_back(
+            TxInfo{pair.mFeed, {txtest::manageData(pair.mFeedName, &value)}});
+    }
+    txs.emplace_back(TxInfo{mRoot, {txtest::liquidation()}});
+    return txs;
+}
+
 LoadGenerator::TxInfo
 LoadGenerator::creationTransaction(uint64_t startAccount, uint64_t numItems,
                                    uint32_t ledgerNum)
@@ -578,10 +1014,19 @@ LoadGenerator::handleFailedSubmission(TestAccountPtr sourceAccount,
 std::vector<LoadGenerator::TestAccountPtr>
 LoadGenerator::checkAccountSynced(Application& app)
 {
-    std::vector<TestAccountPtr> result;
+    std::vector<TestAccountPtr> accounts;
     for (auto const& acc : mAccounts)
     {
-        TestAccountPtr account = acc.second;
+        accounts.emplace_back(acc.second);
+    }
+    for (auto const& acc : mIssuers)
+    {
+        accounts.emplace_back(acc.second);
+    }
+
+    std::vector<TestAccountPtr> result;
+    for (auto const& account : accounts)
+    {
         auto currentSeqNum = account->getLastSequenceNumber();
         auto reloadRes = loadAccount(account, app);
         // reload the account
@@ -610,6 +1055,7 @@ LoadGenerator::waitTillComplete()
     if (inconsistencies.empty())
     {
         CLOG(INFO, "LoadGen") << "Load generation complete.";
+        logOperationLatencies();
         mApp.getMetrics()
             .NewMeter({"loadgen", "run", "complete"}, "run")
             .Mark();
@@ -637,6 +1083,9 @@ LoadGenerator::TxMetrics::TxMetrics(medida::MetricsRegistry& m)
     : mAccountCreated(m.NewMeter({"loadgen", "account", "created"}, "account"))
     , mPayment(m.NewMeter({"loadgen", "payment", "any"}, "payment"))
     , mNativePayment(m.NewMeter({"loadgen", "payment", "native"}, "payment"))
+    , mOffer(m.NewMeter({"loadgen", "offer", "any"}, "offer"))
+    , mMarginOffer(m.NewMeter({"loadgen", "offer", "margin"}, "offer"))
+    , mLiquidation(m.NewMeter({"loadgen", "liquidation", "any"}, "liquidation"))
     , mTxnAttempted(m.NewMeter({"loadgen", "txn", "attempted"}, "txn"))
     , mTxnRejected(m.NewMeter({"loadgen", "txn", "rejected"}, "txn"))
     , mTxnBytes(m.NewMeter({"loadgen", "txn", "bytes"}, "txn"))
@@ -651,7 +1100,10 @@ LoadGenerator::TxMetrics::report()
                            << mTxnBytes.count() << " by, "
                            << mAccountCreated.count() << " ac ("
                            << mPayment.count() << " pa ("
-                           << mNativePayment.count() << " na, ";
+                           << mNativePayment.count() << " na, "
+                           << mOffer.count() << " of ("
+                           << mMarginOffer.count() << " mo, "
+                           << mLiquidation.count() << " lq, ";
 
     CLOG(DEBUG, "LoadGen") << "Rates/sec (1m EWMA): " << std::setprecision(3)
                            << mTxnAttempted.one_minute_rate() << " tx, "
@@ -663,7 +1115,7 @@ LoadGenerator::TxMetrics::report()
 }
 
 Herder::TransactionSubmitStatus
-LoadGenerator::TxInfo::execute(Application& app, bool isCreate,
+LoadGenerator::TxInfo::execute(Application& app, LoadGenMode mode,
                                TransactionResultCode& code, int32_t batchSize)
 {
     auto seqNum = mFrom->getLastSequenceNumber();
@@ -674,18 +1126,39 @@ LoadGenerator::TxInfo::execute(Application& app, bool isCreate,
     TxMetrics txm(app.getMetrics());
 
     // Record tx metrics.
-    if (isCreate)
+    if (mode == LoadGenMode::CREATE)
     {
         while (batchSize--)
         {
             txm.mAccountCreated.Mark();
         }
     }
-    else
+    else if (mode == LoadGenMode::PAY)
     {
         txm.mPayment.Mark();
         txm.mNativePayment.Mark();
     }
+    else
+    {
+        for (auto const& op : mOps)
+        {
+            switch (op.body.type())
+            {
+            case MANAGE_OFFER:
+                txm.mOffer.Mark();
+                break;
+            case CREATE_MARGIN_OFFER:
+                txm.mOffer.Mark();
+                txm.mMarginOffer.Mark();
+                break;
+            case LIQUIDATION:
+                txm.mLiquidation.Mark();
+                break;
+            default:
+                break;
+            }
+        }
+    }
     txm.mTxnAttempted.Mark();
 
     StellarMessage msg;
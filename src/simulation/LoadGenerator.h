@@ -10,6 +10,7 @@
 #include "test/TestAccount.h"
 #include "test/TxTests.h"
 #include "xdr/Stellar-types.h"
+#include <deque>
 #include <util/format.h>
 #include <vector>
 
@@ -26,6 +27,23 @@ namespace stellar
 
 class VirtualTimer;
 
+enum class LoadGenMode
+{
+    // create accounts
+    CREATE,
+    // payments between existing accounts
+    PAY,
+    // issuers, reference price data entries and trustlines (funded with both
+    // coins) of existing accounts for the trading pairs of the configuration
+    MARGIN_SETUP,
+    // order book offers around the reference price and leveraged positions on
+    // the trading pairs, by accounts that went through MARGIN_SETUP
+    MARGIN,
+    // moves the reference prices of the trading pairs and triggers
+    // liquidations
+    LIQUIDATE
+};
+
 class LoadGenerator
 {
   public:
@@ -42,6 +60,12 @@ class LoadGenerator
     static const uint32_t STEP_MSECS;
     static const uint32_t TX_SUBMIT_MAX_TRIES;
 
+    // The issuers of the assets of the trading pairs are derived from the
+    // asset names (and so is the account holding the reference price data
+    // entry from the name of the entry), the keys of Config::TRADING must
+    // be the public keys of these accounts.
+    static SecretKey getIssuerKey(std::string const& assetName);
+
     std::unique_ptr<VirtualTimer> mLoadTimer;
     int64 mMinBalance;
     uint64_t mLastSecond;
@@ -50,7 +74,7 @@ class LoadGenerator
     uint32_t getTxPerStep(uint32_t txRate);
 
     // Schedule a callback to generateLoad() STEP_MSECS miliseconds from now.
-    void scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
+    void scheduleLoadGeneration(LoadGenMode mode, uint32_t nAccounts,
                                 uint32_t offset, uint32_t nTxs, uint32_t txRate,
                                 uint32_t batchSize, bool autoRate);
 
@@ -58,7 +82,9 @@ class LoadGenerator
     // given target number of accounts and txs, and a given target tx/s rate.
     // If work remains after the current step, call scheduleLoadGeneration()
     // with the remainder.
-    void generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
+    // In MARGIN_SETUP mode, nTxs is ignored: the number of transactions
+    // depends on the number of accounts and trading pairs.
+    void generateLoad(LoadGenMode mode, uint32_t nAccounts, uint32_t offset,
                       uint32_t nTxs, uint32_t txRate, uint32_t batchSize,
                       bool autoRate);
 
@@ -81,15 +107,41 @@ class LoadGenerator
     TxInfo creationTransaction(uint64_t startAccount, uint64_t numItems,
                                uint32_t ledgerNum);
     std::vector<TestAccountPtr> checkAccountSynced(Application& app);
-    void logProgress(std::chrono::nanoseconds submitTimer, bool isCreate,
+    void logProgress(std::chrono::nanoseconds submitTimer, LoadGenMode mode,
                      uint32_t nAccounts, uint32_t nTxs, uint32_t batchSize,
                      uint32_t txRate);
+    // logs the median, 95th and 99th percentiles of the time taken to apply
+    // each type of operation
+    void logOperationLatencies();
+
+    // Loads the trading pairs of the configuration whose issuers can be
+    // derived with getIssuerKey, returns false if there are none.
+    bool loadTradingPairs(uint32_t ledgerNum);
+    // Queues the transactions setting up the trading pairs for accounts
+    // [offset, offset + nAccounts) and returns their number.
+    uint32_t prepareMarginSetup(uint32_t nAccounts, uint32_t offset,
+                                uint32_t batchSize, uint32_t ledgerNum);
+    // Returns true once every transaction of the last submitted setup stage
+    // has been applied, so that the next stage can be submitted.
+    bool marginSetupStageApplied(uint32_t ledgerNum);
+    TxInfo marginTransaction(uint32_t ledgerNum, uint64_t sourceAccount);
+    std::vector<TxInfo> liquidationTransactions();
 
     uint32_t submitCreationTx(uint32_t nAccounts, uint32_t offset,
                               uint32_t batchSize, uint32_t ledgerNum);
     uint32_t submitPaymentTx(uint32_t nAccounts, uint32_t offset,
                              uint32_t batchSize, uint32_t ledgerNum,
                              uint32_t nTxs);
+    uint32_t submitMarginSetupTx(uint32_t batchSize, uint32_t ledgerNum,
+                                 uint32_t nTxs);
+    uint32_t submitMarginTx(uint32_t nAccounts, uint32_t offset,
+                            uint32_t batchSize, uint32_t ledgerNum,
+                            uint32_t nTxs);
+    uint32_t submitLiquidationTxs(uint32_t batchSize, uint32_t ledgerNum,
+                                  uint32_t nTxs);
+    // submits tx, retrying (after reloading the source account) until it is
+    // accepted, returns false if it never was
+    bool submitTx(TxInfo& tx, LoadGenMode mode, uint32_t batchSize);
 
     void updateMinBalance();
     void waitTillComplete();
@@ -99,6 +151,9 @@ class LoadGenerator
         medida::Meter& mAccountCreated;
         medida::Meter& mPayment;
         medida::Meter& mNativePayment;
+        medida::Meter& mOffer;
+        medida::Meter& mMarginOffer;
+        medida::Meter& mLiquidation;
         medida::Meter& mTxnAttempted;
         medida::Meter& mTxnRejected;
         medida::Meter& mTxnBytes;
@@ -111,15 +166,44 @@ class LoadGenerator
     {
         TestAccountPtr mFrom;
         std::vector<Operation> mOps;
-        Herder::TransactionSubmitStatus execute(Application& app, bool isCreate,
+        Herder::TransactionSubmitStatus execute(Application& app,
+                                                LoadGenMode mode,
                                                 TransactionResultCode& code,
                                                 int32_t batchSize);
     };
 
+    struct TradingPair
+    {
+        Asset mCoin1;
+        TestAccountPtr mCoin1Issuer;
+        Asset mCoin2;
+        TestAccountPtr mCoin2Issuer;
+        TestAccountPtr mBaseIssuer;
+        bool mCoin1IsBase;
+        TestAccountPtr mFeed;
+        std::string mFeedName;
+        // price of coin 2 in coin 1 when coin 1 is the base asset (the other
+        // way around otherwise), as published in the reference feed
+        double mReferencePrice;
+    };
+
   protected:
     Application& mApp;
     TestAccountPtr mRoot;
     // Accounts cache
     std::map<uint64_t, TestAccountPtr> mAccounts;
+    // Issuers of the trading pairs (and reference feed accounts), by name
+    std::map<std::string, TestAccountPtr> mIssuers;
+    std::vector<TradingPair> mTradingPairs;
+    // transactions of MARGIN_SETUP that remain to be submitted, a stage is
+    // only submitted once all the transactions of the previous one have
+    // been applied
+    std::deque<std::deque<TxInfo>> mSetupStages;
+    bool mSetupPrepared;
+    bool mWaitingForSetupStage;
+    // ledger in which the last setup stage can be applied at the earliest
+    uint32_t mSetupStageLedger;
+    // reference prices are moved at most once per ledger
+    uint32_t mLastLiquidationLedger;
 };
 }
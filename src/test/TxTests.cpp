@@ -552,6 +552,20 @@ createPassiveOffer(Asset const& selling, Asset const& buying,
     return op;
 }
 
+Operation
+createMarginOffer(Asset const& selling, Asset const& buying,
+                  Price const& price, int64_t amount)
+{
+    Operation op;
+    op.body.type(CREATE_MARGIN_OFFER);
+    op.body.createMarginOfferOp().amount = amount;
+    op.body.createMarginOfferOp().selling = selling;
+    op.body.createMarginOfferOp().buying = buying;
+    op.body.createMarginOfferOp().price = price;
+
+    return op;
+}
+
 Operation
 manageOffer(uint64 offerId, Asset const& selling, Asset const& buying,
             Price const& price, int64_t amount)
@@ -873,6 +887,15 @@ inflation()
     return op;
 }
 
+Operation
+liquidation()
+{
+    Operation op;
+    op.body.type(LIQUIDATION);
+
+    return op;
+}
+
 Operation
 accountMerge(PublicKey const& dest)
 {
@@ -135,6 +135,11 @@ Operation manageOffer(uint64 offerId, Asset const& selling, Asset const& buying,
 Operation createPassiveOffer(Asset const& selling, Asset const& buying,
                              Price const& price, int64_t amount);
 
+Operation createMarginOffer(Asset const& selling, Asset const& buying,
+                            Price const& price, int64_t amount);
+
+Operation liquidation();
+
 // returns the ID of the new offer if created
 uint64_t applyManageOffer(Application& app, uint64 offerId,
                           SecretKey const& source, Asset const& selling,
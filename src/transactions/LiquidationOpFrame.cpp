@@ -14,6 +14,7 @@
 #include "medida/metrics_registry.h"
 #include "overlay/StellarXDR.h"
 #include "transactions/CreateLiquidationOfferOpFrame.h"
+#include "transactions/MarginEngine.h"
 #include "transactions/TransactionUtils.h"
 #include "util/Logging.h"
 #include "util/types.h"
@@ -125,16 +126,62 @@ LiquidationOpFrame::doApply(Application& app, AbstractLedgerState& ls)
         CLOG(DEBUG, "Tx") << "coin1 " << config.mCoin1.mName << " " << price1
                           << " " << config.mCoin2.mName << " " << price2;
 
+        MarginBase marginBase = MarginBase::OTHER;
+        if (compareAsset(coin1, base))
+        {
+            marginBase = MarginBase::COIN1;
+        }
+        else if (compareAsset(coin2, base))
+        {
+            marginBase = MarginBase::COIN2;
+        }
+        // used when the price computed from the position overflows
+        auto fallback = (stellar::int32)floor(refPrice * PRICE_MULTIPLE);
+
         {
             // mark trustlines that should be liquidated
             auto trustlines = stellar::loadTrustLinesShouldLiquidate(
                 ls, coin1, price1, coin2, price2, base);
 
+            // compute the prices of all the liquidation offers in one pass
+            // over the positions as they are before any of them is processed
+            MarginPositions positions;
+            positions.reserve(trustlines.size());
+            for (auto const& trustline : trustlines)
+            {
+                auto const& tl = trustline.data.trustLine();
+                LedgerKey key1(TRUSTLINE);
+                key1.trustLine().accountID = tl.accountID;
+                key1.trustLine().asset = coin1;
+                LedgerKey key2(TRUSTLINE);
+                key2.trustLine().accountID = tl.accountID;
+                key2.trustLine().asset = coin2;
+
+                // loaded into ls, where the loop below finds them again
+                // without going back to the database (it loads them anyway
+                // to flag them)
+                auto tl1 = ls.load(key1);
+                auto tl2 = ls.load(key2);
+                if (tl1 && tl2)
+                {
+                    auto const& t1 = tl1.current().data.trustLine();
+                    auto const& t2 = tl2.current().data.trustLine();
+                    positions.add(t1.balance, t1.debt, t2.balance, t2.debt);
+                }
+                else
+                {
+                    positions.add(0, 0, 0, 0);
+                }
+            }
+            std::vector<Price> prices;
+            computeLiquidationPrices(positions, marginBase, PRICE_MULTIPLE,
+                                     fallback, prices);
+
             // LedgerState lsinner(ls);
 
-            for (auto& trustline : trustlines)
+            for (size_t i = 0; i < trustlines.size(); i++)
             {
-                TrustLineEntry& tl = trustline.data.trustLine();
+                TrustLineEntry& tl = trustlines[i].data.trustLine();
                 CLOG(DEBUG, "Tx") << KeyUtils::toStrKey(tl.accountID) << " "
                                   << tl.balance << " " << tl.debt;
 
@@ -158,48 +205,21 @@ LiquidationOpFrame::doApply(Application& app, AbstractLedgerState& ls)
                 auto tl1 = trustLineEntry1.current().data.trustLine();
                 auto tl2 = trustLineEntry2.current().data.trustLine();
 
-                Price price(PRICE_MULTIPLE, PRICE_MULTIPLE);
                 // price = n / d
                 // there's a requirement that amount * price.n / price.d is also an integar
                 // other adjustOffer in exchange will change the amount
                 // in that case debt might not be completely repaid
-                try
+                Price price = prices[i];
+                if (tl1.balance != positions.mBalance1[i] ||
+                    tl1.debt != positions.mDebt1[i] ||
+                    tl2.balance != positions.mBalance2[i] ||
+                    tl2.debt != positions.mDebt2[i])
                 {
-                    // n if coin1 is base as two decimal usually enough for coin
-                    if (compareAsset(coin1, base))
-                    {
-                        price.d = bigDivide(
-                            abs(tl2.debt - tl2.balance), PRICE_MULTIPLE,
-                            abs(tl1.balance - tl1.debt), ROUND_DOWN);
-                    }
-                    else if (compareAsset(coin2, base))
-                    {
-                        price.n = bigDivide(
-                            abs(tl1.balance - tl1.debt), PRICE_MULTIPLE,
-                            abs(tl2.debt - tl2.balance), ROUND_DOWN);
-                    }
-                    else
-                    {
-                        // TODO: altcoin perpetual case
-                    }
-                }
-                catch (...)
-                {
-                    // if overflowed, use ref price instead
-                    if (compareAsset(coin1, base))
-                    {
-                        price.d =
-                            (stellar::int32)floor(refPrice * PRICE_MULTIPLE);
-                    }
-                    else if (compareAsset(coin2, base))
-                    {
-                        price.n =
-                            (stellar::int32)floor(refPrice * PRICE_MULTIPLE);
-                    }
-                    else
-                    {
-                        // TODO: altcoin perpetual case
-                    }
+                    // the offers of a previous account crossed the offers of
+                    // this one
+                    price = computeLiquidationPrice(
+                        tl1.balance, tl1.debt, tl2.balance, tl2.debt,
+                        marginBase, PRICE_MULTIPLE, fallback);
                 }
 
                 // process liquidation accounts
@@ -343,20 +363,15 @@ LiquidationOpFrame::applyCreateLiquidationOffer(
     bool hasQualifiedOffer = false;
     if (offers.size() == 1)
     {
-        for (auto const& x : offers)
-        {
-            LedgerEntry le = x.second;
-            CLOG(DEBUG, "Tx")
-                << "compare " << le.data.offer().amount << " " << amount << " "
-                << le.data.offer().price.n << " " << price.n << " "
-                << le.data.offer().price.d << " " << price.d;
-            if (compareAsset(le.data.offer().selling, selling) &&
-                compareAsset(le.data.offer().buying, buying) &&
-                le.data.offer().amount == amount &&
-                le.data.offer().price.n == price.n &&
-                le.data.offer().price.d == price.d)
-                hasQualifiedOffer = true;
-        }
+        auto offer = ls.getNewestVersion(*offers.begin());
+        auto const& oe = offer->data.offer();
+        CLOG(DEBUG, "Tx") << "compare " << oe.amount << " " << amount << " "
+                          << oe.price.n << " " << price.n << " " << oe.price.d
+                          << " " << price.d;
+        if (compareAsset(oe.selling, selling) &&
+            compareAsset(oe.buying, buying) && oe.amount == amount &&
+            oe.price.n == price.n && oe.price.d == price.d)
+            hasQualifiedOffer = true;
     }
 
     if (hasQualifiedOffer && !justCancel)
@@ -365,17 +380,18 @@ LiquidationOpFrame::applyCreateLiquidationOffer(
     }
 
     // no qualified offer, cancel all exisitng offers
-    for (auto const& x : offers)
+    for (auto const& key : offers)
     {
-        LedgerEntry le = x.second;
+        // keeps the offer alive while it is being cancelled
+        auto offer = ls.getNewestVersion(key);
+        auto const& oe = offer->data.offer();
 
         OperationResult cancelresult;
         cancelresult.code(opINNER);
         cancelresult.tr().type(MANAGE_OFFER);
 
-        auto cancel_op = createCancelOffer(
-            accountid, le.data.offer().offerID, le.data.offer().selling,
-            le.data.offer().buying, le.data.offer().price);
+        auto cancel_op = createCancelOffer(accountid, oe.offerID, oe.selling,
+                                           oe.buying, oe.price);
         CreateLiquidationOfferOpFrame frame(cancel_op, cancelresult, mParentTx);
 
         if (!frame.doCheckValid(app, lh.ledgerVersion) ||
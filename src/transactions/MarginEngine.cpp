@@ -0,0 +1,132 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/MarginEngine.h"
+#include "util/numeric.h"
+
+namespace stellar
+{
+
+size_t
+MarginPositions::size() const
+{
+    return mBalance1.size();
+}
+
+void
+MarginPositions::reserve(size_t n)
+{
+    mBalance1.reserve(n);
+    mDebt1.reserve(n);
+    mBalance2.reserve(n);
+    mDebt2.reserve(n);
+}
+
+void
+MarginPositions::add(int64_t balance1, int64_t debt1, int64_t balance2,
+                     int64_t debt2)
+{
+    mBalance1.emplace_back(balance1);
+    mDebt1.emplace_back(debt1);
+    mBalance2.emplace_back(balance2);
+    mDebt2.emplace_back(debt2);
+}
+
+static inline uint64_t
+absDiff(int64_t a, int64_t b)
+{
+    return a > b ? uint64_t(a) - uint64_t(b) : uint64_t(b) - uint64_t(a);
+}
+
+// computes a * multiple / c rounded down, returns false if c is 0 or if the
+// result does not fit in an int64 (the cases where bigDivide throws)
+static inline bool
+scaledQuotient(uint64_t a, uint64_t c, uint64_t multiple, uint64_t& q)
+{
+    if (c == 0)
+    {
+        return false;
+    }
+    if (a <= UINT64_MAX / multiple)
+    {
+        // common case, the product fits in 64 bits
+        q = a * multiple / c;
+    }
+    else if (!bigDivide(q, bigMultiply(a, multiple), c, ROUND_DOWN))
+    {
+        return false;
+    }
+    return q <= INT64_MAX;
+}
+
+// the price fields are int32 and the quotient is truncated to them, as
+// LiquidationOpFrame always did
+static inline int32_t
+scaledPriceTerm(uint64_t a, uint64_t c, uint64_t multiple, int32_t fallback)
+{
+    uint64_t q;
+    return scaledQuotient(a, c, multiple, q) ? static_cast<int32_t>(q)
+                                             : fallback;
+}
+
+Price
+computeLiquidationPrice(int64_t balance1, int64_t debt1, int64_t balance2,
+                        int64_t debt2, MarginBase base, int64_t multiple,
+                        int32_t fallback)
+{
+    auto m = static_cast<int32_t>(multiple);
+    switch (base)
+    {
+    case MarginBase::COIN1:
+        return Price(m, scaledPriceTerm(absDiff(debt2, balance2),
+                                        absDiff(balance1, debt1), multiple,
+                                        fallback));
+    case MarginBase::COIN2:
+        return Price(scaledPriceTerm(absDiff(balance1, debt1),
+                                     absDiff(debt2, balance2), multiple,
+                                     fallback),
+                     m);
+    default:
+        // neither coin is the base asset: the altcoin perpetual case, left
+        // open by the TODO in LiquidationOpFrame::doApply
+        return Price(m, m);
+    }
+}
+
+void
+computeLiquidationPrices(MarginPositions const& positions, MarginBase base,
+                         int64_t multiple, int32_t fallback,
+                         std::vector<Price>& prices)
+{
+    size_t n = positions.size();
+    auto m = static_cast<int32_t>(multiple);
+    prices.assign(n, Price(m, m));
+    if (base == MarginBase::OTHER)
+    {
+        return;
+    }
+
+    int64_t const* balance1 = positions.mBalance1.data();
+    int64_t const* debt1 = positions.mDebt1.data();
+    int64_t const* balance2 = positions.mBalance2.data();
+    int64_t const* debt2 = positions.mDebt2.data();
+
+    // the term depending on the position is d when coin1 is the base and n
+    // when coin2 is the base, the other one stays at multiple
+    bool coin1IsBase = base == MarginBase::COIN1;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t amount1 = absDiff(balance1[i], debt1[i]);
+        uint64_t amount2 = absDiff(debt2[i], balance2[i]);
+        if (coin1IsBase)
+        {
+            prices[i].d = scaledPriceTerm(amount2, amount1, multiple, fallback);
+        }
+        else
+        {
+            prices[i].n = scaledPriceTerm(amount1, amount2, multiple, fallback);
+        }
+    }
+}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "xdr/Stellar-ledger-entries.h"
+#include <vector>
+
+namespace stellar
+{
+
+// Which coin of a trading pair is the base asset
+enum class MarginBase
+{
+    COIN1,
+    COIN2,
+    OTHER
+};
+
+// Balances and debts of margin accounts on a trading pair, stored one array
+// per field so that a whole set of positions can be evaluated in one pass
+// over contiguous memory.
+struct MarginPositions
+{
+    std::vector<int64_t> mBalance1;
+    std::vector<int64_t> mDebt1;
+    std::vector<int64_t> mBalance2;
+    std::vector<int64_t> mDebt2;
+
+    size_t size() const;
+    void reserve(size_t n);
+    void add(int64_t balance1, int64_t debt1, int64_t balance2, int64_t debt2);
+};
+
+// Price of the liquidation offer of a position (n / d):
+//   base coin1: multiple / (|debt2 - balance2| * multiple / |balance1 - debt1|)
+//   base coin2: (|balance1 - debt1| * multiple / |debt2 - balance2|) / multiple
+//   otherwise:  multiple / multiple
+// When the computed term does not fit in an int64 (or the divisor is 0), the
+// scaled reference price `fallback` is used instead. Never throws.
+Price computeLiquidationPrice(int64_t balance1, int64_t debt1,
+                              int64_t balance2, int64_t debt2, MarginBase base,
+                              int64_t multiple, int32_t fallback);
+
+// Same as computeLiquidationPrice for every position, prices[i] is the price
+// of positions[i]
+void computeLiquidationPrices(MarginPositions const& positions,
+                              MarginBase base, int64_t multiple,
+                              int32_t fallback, std::vector<Price>& prices);
+}
@@ -0,0 +1,162 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "lib/catch.hpp"
+#include "transactions/MarginEngine.h"
+#include "util/Logging.h"
+#include "util/XDROperators.h"
+#include "util/types.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+
+using namespace stellar;
+
+namespace
+{
+
+int64_t const MULTIPLE = 10000;
+int32_t const FALLBACK = 12345;
+
+// the computation LiquidationOpFrame used to do for each position (with a
+// divisor of 0, where bigDivide asserts, falling back to the reference price)
+Price
+referencePrice(int64_t balance1, int64_t debt1, int64_t balance2,
+               int64_t debt2, MarginBase base)
+{
+    Price price(MULTIPLE, MULTIPLE);
+    int64_t amount1 = std::abs(balance1 - debt1);
+    int64_t amount2 = std::abs(debt2 - balance2);
+    try
+    {
+        if (base == MarginBase::COIN1)
+        {
+            if (amount1 == 0)
+            {
+                throw std::overflow_error("no collateral");
+            }
+            price.d = static_cast<int32_t>(
+                bigDivide(amount2, MULTIPLE, amount1, ROUND_DOWN));
+        }
+        else if (base == MarginBase::COIN2)
+        {
+            if (amount2 == 0)
+            {
+                throw std::overflow_error("no collateral");
+            }
+            price.n = static_cast<int32_t>(
+                bigDivide(amount1, MULTIPLE, amount2, ROUND_DOWN));
+        }
+    }
+    catch (std::overflow_error&)
+    {
+        if (base == MarginBase::COIN1)
+        {
+            price.d = FALLBACK;
+        }
+        else if (base == MarginBase::COIN2)
+        {
+            price.n = FALLBACK;
+        }
+    }
+    return price;
+}
+
+MarginPositions
+randomPositions(size_t n, std::default_random_engine& gen)
+{
+    std::vector<int64_t> values = {1,
+                                   2,
+                                   9999,
+                                   10000,
+                                   10000000,
+                                   INT64_MAX / MULTIPLE,
+                                   INT64_MAX / MULTIPLE + 1,
+                                   INT64_MAX / 2,
+                                   INT64_MAX};
+    std::uniform_int_distribution<size_t> pick(0, values.size());
+    std::uniform_int_distribution<int64_t> amount(1, INT64_MAX);
+    auto next = [&]() {
+        auto i = pick(gen);
+        return i < values.size() ? values[i] : amount(gen);
+    };
+
+    MarginPositions positions;
+    positions.reserve(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        positions.add(next(), next(), next(), next());
+    }
+    return positions;
+}
+}
+
+TEST_CASE("liquidation prices", "[tx][liquidation]")
+{
+    std::default_random_engine gen(1234);
+    auto positions = randomPositions(10000, gen);
+
+    for (auto base :
+         {MarginBase::COIN1, MarginBase::COIN2, MarginBase::OTHER})
+    {
+        std::vector<Price> prices;
+        computeLiquidationPrices(positions, base, MULTIPLE, FALLBACK, prices);
+        REQUIRE(prices.size() == positions.size());
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            auto expected = referencePrice(
+                positions.mBalance1[i], positions.mDebt1[i],
+                positions.mBalance2[i], positions.mDebt2[i], base);
+            REQUIRE(prices[i] == expected);
+            REQUIRE(computeLiquidationPrice(
+                        positions.mBalance1[i], positions.mDebt1[i],
+                        positions.mBalance2[i], positions.mDebt2[i], base,
+                        MULTIPLE, FALLBACK) == expected);
+        }
+    }
+
+    SECTION("no collateral left uses the reference price")
+    {
+        REQUIRE(computeLiquidationPrice(100, 100, 0, 50, MarginBase::COIN1,
+                                        MULTIPLE,
+                                        FALLBACK) == Price(MULTIPLE, FALLBACK));
+        REQUIRE(computeLiquidationPrice(50, 0, 100, 100, MarginBase::COIN2,
+                                        MULTIPLE,
+                                        FALLBACK) == Price(FALLBACK, MULTIPLE));
+    }
+}
+
+TEST_CASE("liquidation prices benchmark", "[tx][liquidation][bench][!hide]")
+{
+    size_t n = 1000000;
+    std::default_random_engine gen(1234);
+    auto positions = randomPositions(n, gen);
+
+    LOG(INFO) << "Benchmarking liquidation prices of " << n << " positions";
+    std::vector<Price> prices;
+    auto start = std::chrono::steady_clock::now();
+    computeLiquidationPrices(positions, MarginBase::COIN1, MULTIPLE, FALLBACK,
+                             prices);
+    auto batch = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    start = std::chrono::steady_clock::now();
+    size_t mismatches = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!(referencePrice(positions.mBalance1[i], positions.mDebt1[i],
+                             positions.mBalance2[i], positions.mDebt2[i],
+                             MarginBase::COIN1) == prices[i]))
+        {
+            mismatches++;
+        }
+    }
+    auto scalar = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    REQUIRE(mismatches == 0);
+    LOG(INFO) << "Batch pass took " << batch.count() << "us, per position "
+              << "bigDivide took " << scalar.count() << "us";
+}
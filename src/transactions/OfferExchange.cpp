@@ -13,6 +13,7 @@
 #include "transactions/ManageOfferOpFrame.h"
 #include "transactions/TransactionUtils.h"
 #include "util/Logging.h"
+#include "util/types.h"
 
 namespace stellar
 {
@@ -1409,15 +1410,21 @@ convertWithOffers(
     sheepSend = 0;
     wheatReceived = 0;
 
+    // offers are only modified (or erased) after the cursor moved past them
+    auto wheatOffers = lsOuter.getOrderBook(sheep, wheat);
+
     bool needMore = (maxWheatReceive > 0 && maxSheepSend > 0);
     while (needMore)
     {
-        LedgerState ls(lsOuter);
-        auto wheatOffer = ls.loadBestOffer(sheep, wheat);
-        if (!wheatOffer)
+        if (!wheatOffers)
         {
             break;
         }
+        auto wheatOfferKey = LedgerEntryKey(wheatOffers.entry());
+        ++wheatOffers;
+
+        LedgerState ls(lsOuter);
+        auto wheatOffer = ls.load(wheatOfferKey);
         if (filter && filter(wheatOffer) == OfferFilterResult::eStop)
         {
             return ConvertResult::eFilterStop;
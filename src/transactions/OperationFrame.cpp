@@ -28,6 +28,8 @@
 #include "transactions/TransactionUtils.h"
 #include "util/Logging.h"
 #include "xdrpp/marshal.h"
+#include <algorithm>
+#include <cctype>
 #include <string>
 
 #include "medida/meter.h"
@@ -98,6 +100,17 @@ OperationFrame::makeHelper(Operation const& op, OperationResult& res,
     }
 }
 
+medida::Timer&
+OperationFrame::getApplyTimer(medida::MetricsRegistry& metrics,
+                              OperationType type)
+{
+    std::string name = xdr::xdr_traits<OperationType>::enum_name(type);
+    std::transform(name.begin(), name.end(), name.begin(), [](char c) {
+        return c == '_' ? '-' : static_cast<char>(std::tolower(c));
+    });
+    return metrics.NewTimer({"transaction", "op-type", name});
+}
+
 OperationFrame::OperationFrame(Operation const& op, OperationResult& res,
                                TransactionFrame& parentTx)
     : mOperation(op), mParentTx(parentTx), mResult(res)
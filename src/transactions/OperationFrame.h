@@ -12,6 +12,7 @@
 namespace medida
 {
 class MetricsRegistry;
+class Timer;
 }
 
 namespace stellar
@@ -56,6 +57,12 @@ class OperationFrame
     makeHelper(Operation const& op, OperationResult& res,
                TransactionFrame& parentTx);
 
+    // time spent applying operations of a given type (such as
+    // transaction.op-type.create-margin-offer), creates the timer: use
+    // LedgerManager::getOperationApplyTimer on the apply path
+    static medida::Timer& getApplyTimer(medida::MetricsRegistry& metrics,
+                                        OperationType type);
+
     OperationFrame(Operation const& op, OperationResult& res,
                    TransactionFrame& parentTx);
     OperationFrame(OperationFrame const&) = delete;
@@ -13,6 +13,7 @@
 #include "herder/TxSetFrame.h"
 #include "invariant/InvariantManager.h"
 #include "ledger/LedgerHeaderUtils.h"
+#include "ledger/LedgerManager.h"
 #include "ledger/LedgerState.h"
 #include "ledger/LedgerStateEntry.h"
 #include "ledger/LedgerStateHeader.h"
@@ -28,8 +29,10 @@
 #include "xdrpp/marshal.h"
 #include <string>
 
+#include "medida/histogram.h"
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
 #include <algorithm>
 #include <numeric>
@@ -598,9 +601,16 @@ TransactionFrame::applyOperations(SignatureChecker& signatureChecker,
     // shield outer scope of any side effects with LedgerState
     LedgerState lsTx(ls);
     auto& opTimer = app.getMetrics().NewTimer({"transaction", "op", "apply"});
+    auto& opEntryCopies =
+        app.getMetrics().NewHistogram({"transaction", "op", "entry-copies"});
     for (auto& op : mOperations)
     {
         auto time = opTimer.TimeScope();
+        auto entryCopies = LedgerState::getEntryCopyCount();
+        auto opTypeTime = app.getLedgerManager()
+                              .getOperationApplyTimer(
+                                  op->getOperation().body.type())
+                              .TimeScope();
         LedgerState lsOp(lsTx);
         bool txRes = op->apply(signatureChecker, app, lsOp);
 
@@ -615,6 +625,8 @@ TransactionFrame::applyOperations(SignatureChecker& signatureChecker,
         }
         meta.operations.emplace_back(lsOp.getChanges());
         lsOp.commit();
+        opEntryCopies.Update(static_cast<int64_t>(
+            LedgerState::getEntryCopyCount() - entryCopies));
     }
 
     if (!errorEncountered)
@@ -683,81 +695,167 @@ TransactionFrame::toStellarMessage() const
 }
 
 void
-TransactionFrame::storeTransaction(Database& db, uint32_t ledgerSeq,
-                                   TransactionMeta& tm, int txindex,
-                                   TransactionResultSet& resultSet) const
+TransactionFrame::appendTransaction(TransactionHistoryRows& rows,
+                                    uint32_t ledgerSeq, TransactionMeta& tm,
+                                    int txindex,
+                                    TransactionResultSet& resultSet) const
 {
+    assert(rows.mTxIDs.empty() || rows.mLedgerSeq == ledgerSeq);
+    rows.mLedgerSeq = ledgerSeq;
+
     auto txBytes(xdr::xdr_to_opaque(mEnvelope));
 
     resultSet.results.emplace_back(getResultPair());
     auto txResultBytes(xdr::xdr_to_opaque(resultSet.results.back()));
 
-    std::string txBody;
-    txBody = decoder::encode_b64(txBytes);
-
-    std::string txResult;
-    txResult = decoder::encode_b64(txResultBytes);
-
     xdr::opaque_vec<> txMeta(xdr::xdr_to_opaque(tm));
 
-    std::string meta;
-    meta = decoder::encode_b64(txMeta);
+    rows.mTxIDs.emplace_back(binToHex(getContentsHash()));
+    rows.mTxIndexes.emplace_back(txindex);
+    rows.mTxBodies.emplace_back(decoder::encode_b64(txBytes));
+    rows.mTxResults.emplace_back(decoder::encode_b64(txResultBytes));
+    rows.mTxMetas.emplace_back(decoder::encode_b64(txMeta));
+}
 
-    string txIDString(binToHex(getContentsHash()));
+void
+TransactionFrame::storeTransactions(Database& db,
+                                    TransactionHistoryRows const& rows)
+{
+    size_t n = rows.mTxIDs.size();
+    if (n == 0)
+    {
+        return;
+    }
 
-    auto prep = db.getPreparedStatement(
-        "INSERT INTO txhistory "
-        "( txid, ledgerseq, txindex,  txbody, txresult, txmeta) VALUES "
-        "(:id,  :seq,      :txindex, :txb,   :txres,   :meta)");
+    std::vector<int> ledgerSeqs(n, static_cast<int>(rows.mLedgerSeq));
+    std::string sql;
+    if (db.isSqlite())
+    {
+        // SQLite runs in process: a bulk statement steps the same prepared
+        // INSERT once per row
+        sql = "INSERT INTO txhistory "
+              "( txid, ledgerseq, txindex,  txbody, txresult, txmeta) VALUES "
+              "(:id,  :seq,      :txindex, :txb,   :txres,   :meta)";
+    }
+    else
+    {
+        // one statement (and one round trip) for the whole ledger
+        sql = "INSERT INTO txhistory "
+              "( txid, ledgerseq, txindex, txbody, txresult, txmeta) "
+              "SELECT unnest(:id::TEXT[]), unnest(:seq::INT[]), "
+              "unnest(:txindex::INT[]), unnest(:txb::TEXT[]), "
+              "unnest(:txres::TEXT[]), unnest(:meta::TEXT[])";
+    }
 
+    std::string ids, seqs, indexes, bodies, results, metas;
+    auto prep = db.getPreparedStatement(sql);
     auto& st = prep.statement();
-    st.exchange(soci::use(txIDString));
-    st.exchange(soci::use(ledgerSeq));
-    st.exchange(soci::use(txindex));
-    st.exchange(soci::use(txBody));
-    st.exchange(soci::use(txResult));
-    st.exchange(soci::use(meta));
+    if (db.isSqlite())
+    {
+        st.exchange(soci::use(rows.mTxIDs));
+        st.exchange(soci::use(ledgerSeqs));
+        st.exchange(soci::use(rows.mTxIndexes));
+        st.exchange(soci::use(rows.mTxBodies));
+        st.exchange(soci::use(rows.mTxResults));
+        st.exchange(soci::use(rows.mTxMetas));
+    }
+    else
+    {
+        ids = DatabaseUtils::toPGArray(rows.mTxIDs);
+        seqs = DatabaseUtils::toPGArray(ledgerSeqs);
+        indexes = DatabaseUtils::toPGArray(rows.mTxIndexes);
+        bodies = DatabaseUtils::toPGArray(rows.mTxBodies);
+        results = DatabaseUtils::toPGArray(rows.mTxResults);
+        metas = DatabaseUtils::toPGArray(rows.mTxMetas);
+        st.exchange(soci::use(ids));
+        st.exchange(soci::use(seqs));
+        st.exchange(soci::use(indexes));
+        st.exchange(soci::use(bodies));
+        st.exchange(soci::use(results));
+        st.exchange(soci::use(metas));
+    }
     st.define_and_bind();
     {
         auto timer = db.getInsertTimer("txhistory");
         st.execute(true);
     }
 
-    if (st.get_affected_rows() != 1)
+    if (static_cast<size_t>(st.get_affected_rows()) != n)
     {
         throw std::runtime_error("Could not update data in SQL");
     }
 }
 
 void
-TransactionFrame::storeTransactionFee(Database& db, uint32_t ledgerSeq,
-                                      LedgerEntryChanges const& changes,
-                                      int txindex) const
+TransactionFrame::appendTransactionFee(TransactionFeeHistoryRows& rows,
+                                       uint32_t ledgerSeq,
+                                       LedgerEntryChanges const& changes,
+                                       int txindex) const
 {
+    assert(rows.mTxIDs.empty() || rows.mLedgerSeq == ledgerSeq);
+    rows.mLedgerSeq = ledgerSeq;
+
     xdr::opaque_vec<> txChanges(xdr::xdr_to_opaque(changes));
 
-    std::string txChanges64;
-    txChanges64 = decoder::encode_b64(txChanges);
+    rows.mTxIDs.emplace_back(binToHex(getContentsHash()));
+    rows.mTxIndexes.emplace_back(txindex);
+    rows.mTxChanges.emplace_back(decoder::encode_b64(txChanges));
+}
 
-    string txIDString(binToHex(getContentsHash()));
+void
+TransactionFrame::storeTransactionFees(Database& db,
+                                       TransactionFeeHistoryRows const& rows)
+{
+    size_t n = rows.mTxIDs.size();
+    if (n == 0)
+    {
+        return;
+    }
 
-    auto prep = db.getPreparedStatement(
-        "INSERT INTO txfeehistory "
-        "( txid, ledgerseq, txindex,  txchanges) VALUES "
-        "(:id,  :seq,      :txindex, :txchanges)");
+    std::vector<int> ledgerSeqs(n, static_cast<int>(rows.mLedgerSeq));
+    std::string sql;
+    if (db.isSqlite())
+    {
+        sql = "INSERT INTO txfeehistory "
+              "( txid, ledgerseq, txindex,  txchanges) VALUES "
+              "(:id,  :seq,      :txindex, :txchanges)";
+    }
+    else
+    {
+        sql = "INSERT INTO txfeehistory "
+              "( txid, ledgerseq, txindex, txchanges) "
+              "SELECT unnest(:id::TEXT[]), unnest(:seq::INT[]), "
+              "unnest(:txindex::INT[]), unnest(:txchanges::TEXT[])";
+    }
 
+    std::string ids, seqs, indexes, changes;
+    auto prep = db.getPreparedStatement(sql);
     auto& st = prep.statement();
-    st.exchange(soci::use(txIDString));
-    st.exchange(soci::use(ledgerSeq));
-    st.exchange(soci::use(txindex));
-    st.exchange(soci::use(txChanges64));
+    if (db.isSqlite())
+    {
+        st.exchange(soci::use(rows.mTxIDs));
+        st.exchange(soci::use(ledgerSeqs));
+        st.exchange(soci::use(rows.mTxIndexes));
+        st.exchange(soci::use(rows.mTxChanges));
+    }
+    else
+    {
+        ids = DatabaseUtils::toPGArray(rows.mTxIDs);
+        seqs = DatabaseUtils::toPGArray(ledgerSeqs);
+        indexes = DatabaseUtils::toPGArray(rows.mTxIndexes);
+        changes = DatabaseUtils::toPGArray(rows.mTxChanges);
+        st.exchange(soci::use(ids));
+        st.exchange(soci::use(seqs));
+        st.exchange(soci::use(indexes));
+        st.exchange(soci::use(changes));
+    }
     st.define_and_bind();
     {
         auto timer = db.getInsertTimer("txfeehistory");
         st.execute(true);
     }
 
-    if (st.get_affected_rows() != 1)
+    if (static_cast<size_t>(st.get_affected_rows()) != n)
     {
         throw std::runtime_error("Could not update data in SQL");
     }
@@ -939,7 +1037,9 @@ TransactionFrame::dropAll(Database& db)
                        "txresult    TEXT NOT NULL,"
                        "txmeta      TEXT NOT NULL,"
                        "PRIMARY KEY (ledgerseq, txindex)"
-                       ")";
+                       ")"
+                    << DatabaseUtils::historyPartitionClause(db);
+    DatabaseUtils::createHistoryPartitions(db, "txhistory");
     db.getSession() << "CREATE INDEX histbyseq ON txhistory (ledgerseq);";
 
     db.getSession() << "CREATE TABLE txfeehistory ("
@@ -948,7 +1048,9 @@ TransactionFrame::dropAll(Database& db)
                        "txindex     INT NOT NULL,"
                        "txchanges   TEXT NOT NULL,"
                        "PRIMARY KEY (ledgerseq, txindex)"
-                       ")";
+                       ")"
+                    << DatabaseUtils::historyPartitionClause(db);
+    DatabaseUtils::createHistoryPartitions(db, "txfeehistory");
     db.getSession() << "CREATE INDEX histfeebyseq ON txfeehistory (ledgerseq);";
 }
 
@@ -9,6 +9,8 @@
 
 #include <memory>
 #include <set>
+#include <string>
+#include <vector>
 
 namespace soci
 {
@@ -36,6 +38,31 @@ class SHA256;
 class TransactionFrame;
 using TransactionFramePtr = std::shared_ptr<TransactionFrame>;
 
+// Rows of txhistory for the transactions of one ledger, buffered while the
+// ledger is closed and written with a single statement by
+// TransactionFrame::storeTransactions. The columns keep their base64 XDR
+// text encoding: getTransactionHistoryResults, copyTransactionsToStream and
+// external readers of the database all decode it as such.
+struct TransactionHistoryRows
+{
+    uint32_t mLedgerSeq{0};
+    std::vector<std::string> mTxIDs;
+    std::vector<int> mTxIndexes;
+    std::vector<std::string> mTxBodies;
+    std::vector<std::string> mTxResults;
+    std::vector<std::string> mTxMetas;
+};
+
+// Rows of txfeehistory for the transactions of one ledger, written by
+// TransactionFrame::storeTransactionFees
+struct TransactionFeeHistoryRows
+{
+    uint32_t mLedgerSeq{0};
+    std::vector<std::string> mTxIDs;
+    std::vector<int> mTxIndexes;
+    std::vector<std::string> mTxChanges;
+};
+
 class TransactionFrame
 {
   protected:
@@ -187,14 +214,22 @@ class TransactionFrame
                                  LedgerStateHeader const& header,
                                  AccountID const& accountID);
 
-    // transaction history
-    void storeTransaction(Database& db, uint32_t ledgerSeq, TransactionMeta& tm,
-                          int txindex, TransactionResultSet& resultSet) const;
-
-    // fee history
-    void storeTransactionFee(Database& db, uint32_t ledgerSeq,
-                             LedgerEntryChanges const& changes,
-                             int txindex) const;
+    // transaction history: the row of this transaction is appended to rows
+    // (which must be for ledgerSeq), the rows of a ledger are then written at
+    // once by storeTransactions
+    void appendTransaction(TransactionHistoryRows& rows, uint32_t ledgerSeq,
+                           TransactionMeta& tm, int txindex,
+                           TransactionResultSet& resultSet) const;
+    static void storeTransactions(Database& db,
+                                  TransactionHistoryRows const& rows);
+
+    // fee history, same as above
+    void appendTransactionFee(TransactionFeeHistoryRows& rows,
+                              uint32_t ledgerSeq,
+                              LedgerEntryChanges const& changes,
+                              int txindex) const;
+    static void storeTransactionFees(Database& db,
+                                     TransactionFeeHistoryRows const& rows);
 
     // access to history tables
     static TransactionResultSet getTransactionHistoryResults(Database& db,
@@ -11,7 +11,6 @@
 #include "ledger/TrustLineWrapper.h"
 #include "transactions/ManageOfferOpFrame.h"
 #include "transactions/OfferExchange.h"
-#include "util/Decoder.h"
 #include "util/XDROperators.h"
 #include "util/types.h"
 
@@ -772,24 +771,27 @@ getReferencePrice(AbstractLedgerState& lsouter, std::string feedName,
     auto data = stellar::loadData(ls, issuerKey, feedName);
     if (data)
     {
-        try
-        {
-            DataValue val = data.current().data.data().dataValue;
-            std::string base64_str = decoder::encode_b64(val);
-            std::string res_str = base64_decode(base64_str);
-            // CLOG(DEBUG, "Tx") << base64_str << " " << res_str;
-
-            result = std::stod(res_str);
-        }
-        catch (...)
-        {
-            return false;
-        }
+        return parseReferencePrice(data.current().data.data().dataValue,
+                                   result);
     }
 
     return true;
 }
 
+bool
+parseReferencePrice(DataValue const& value, double& result)
+{
+    try
+    {
+        result = std::stod(std::string(value.begin(), value.end()));
+    }
+    catch (...)
+    {
+        return false;
+    }
+    return true;
+}
+
 bool
 isAuthorized(LedgerEntry const& le)
 {
@@ -1081,12 +1083,10 @@ getMidOrderbookPrice(AbstractLedgerState& ls, Asset const& coin1,
 }
 
 bool
-getAvgOfferPrice(AbstractLedgerState& lsouter, Asset const& coin1,
+getAvgOfferPrice(AbstractLedgerState& ls, Asset const& coin1,
                  Asset const& coin2, Asset const& base, double& result,
                  int64 DEPTH_THRESHOLD)
 {
-    LedgerState ls(lsouter);
-
     bool coin1IsBase = false;
     if (compareAsset(coin1, base))
     {
@@ -1102,47 +1102,28 @@ getAvgOfferPrice(AbstractLedgerState& lsouter, Asset const& coin1,
     }
 
     // assets are denominated in base
-    std::set<LedgerKey> excludes;
     int64 total = 0;
     int64 depth = DEPTH_THRESHOLD;
 
-    while (depth > 0)
+    for (auto offers = ls.getOrderBook(coin1, coin2); offers && depth > 0;
+         ++offers)
     {
-        std::list<LedgerEntry>::const_iterator iter;
-        auto le = ls.getBestOffer(coin1, coin2, excludes);
-        if (le)
-        {
-
-            auto entry = ls.load(LedgerEntryKey(*le));
-            Price price = entry.current().data.offer().price;
-            int64 amount = entry.current().data.offer().amount;
-            int64 denominated_amount =
-                coin1IsBase ? bigDivide(amount, price.n, price.d, ROUND_DOWN)
-                            : amount;
-            // CLOG(DEBUG, "Tx") << "amount1 " << amount << " " << price.n << "
-            // "
-            //                 << price.d << " " << coin1IsBase;
-
-            int64 indexed_amount =
-                depth < denominated_amount ? depth : denominated_amount;
-            // CLOG(DEBUG, "Tx")
-            //    << "amount " << denominated_amount << " " << indexed_amount;
-
-            if (coin1IsBase)
-                total +=
-                    bigDivide(indexed_amount, price.d, price.n, ROUND_DOWN);
-            else
-                total +=
-                    bigDivide(indexed_amount, price.n, price.d, ROUND_DOWN);
-
-            depth -= indexed_amount;
-
-            excludes.insert(LedgerEntryKey(*le));
-        }
+        auto const& offer = offers.entry().data.offer();
+        Price price = offer.price;
+        int64 amount = offer.amount;
+        int64 denominated_amount =
+            coin1IsBase ? bigDivide(amount, price.n, price.d, ROUND_DOWN)
+                        : amount;
+
+        int64 indexed_amount =
+            depth < denominated_amount ? depth : denominated_amount;
+
+        if (coin1IsBase)
+            total += bigDivide(indexed_amount, price.d, price.n, ROUND_DOWN);
         else
-        {
-            break;
-        }
+            total += bigDivide(indexed_amount, price.n, price.d, ROUND_DOWN);
+
+        depth -= indexed_amount;
     }
     if (depth == DEPTH_THRESHOLD)
     {
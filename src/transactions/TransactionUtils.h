@@ -132,6 +132,8 @@ uint64_t getStartingSequenceNumber(LedgerStateHeader const& header);
 
 bool getReferencePrice(AbstractLedgerState& lsouter, std::string feedName,
                        PublicKey& issuerKey, double& result);
+// parses the value of a reference feed data entry
+bool parseReferencePrice(DataValue const& value, double& result);
 bool getMidOrderbookPrice(AbstractLedgerState& ls, Asset const& coin1,
                           Asset const& coin2, Asset const& base, double& result,
                           int64 DEPTH_THRESHOLD);
@@ -0,0 +1,125 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/Arena.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+namespace stellar
+{
+
+static std::atomic<uint64_t> gHeapAllocationCount{0};
+
+uint64_t
+getArenaAllocatorHeapAllocationCount()
+{
+    return gHeapAllocationCount.load(std::memory_order_relaxed);
+}
+
+void
+countArenaAllocatorHeapAllocation()
+{
+    gHeapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+Arena::Arena(size_t blockSize)
+    : mBlockSize(blockSize)
+    , mCurrent(0)
+    , mOffset(0)
+    , mUsers(0)
+    , mAllocations(0)
+    , mBytes(0)
+{
+}
+
+void*
+Arena::allocate(size_t bytes, size_t alignment)
+{
+    // blocks are allocated with new char[], so they are suitably aligned for
+    // any fundamental alignment and only the offset has to be aligned
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 ||
+        alignment > alignof(std::max_align_t))
+    {
+        throw std::invalid_argument("unsupported alignment");
+    }
+
+    while (mCurrent < mBlocks.size())
+    {
+        auto& block = mBlocks[mCurrent];
+        size_t offset = (mOffset + alignment - 1) & ~(alignment - 1);
+        if (offset <= block.mSize && bytes <= block.mSize - offset)
+        {
+            mOffset = offset + bytes;
+            mAllocations++;
+            mBytes += bytes;
+            return block.mData.get() + offset;
+        }
+        // the rest of the block is wasted until the next reset
+        mCurrent++;
+        mOffset = 0;
+    }
+
+    Block block;
+    block.mSize = std::max(mBlockSize, bytes);
+    block.mData.reset(new char[block.mSize]);
+    mBlocks.emplace_back(std::move(block));
+    mCurrent = mBlocks.size() - 1;
+    mOffset = bytes;
+    mAllocations++;
+    mBytes += bytes;
+    return mBlocks.back().mData.get();
+}
+
+void
+Arena::addUser()
+{
+    mUsers++;
+}
+
+void
+Arena::removeUser()
+{
+    if (mUsers == 0)
+    {
+        throw std::runtime_error("Arena has no user");
+    }
+    mUsers--;
+}
+
+bool
+Arena::reset()
+{
+    if (mUsers != 0)
+    {
+        return false;
+    }
+    mCurrent = 0;
+    mOffset = 0;
+    return true;
+}
+
+uint64_t
+Arena::getAllocationCount() const
+{
+    return mAllocations;
+}
+
+uint64_t
+Arena::getBytesAllocated() const
+{
+    return mBytes;
+}
+
+size_t
+Arena::getCapacity() const
+{
+    size_t res = 0;
+    for (auto const& block : mBlocks)
+    {
+        res += block.mSize;
+    }
+    return res;
+}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace stellar
+{
+
+// Monotonic arena: memory is carved out of large blocks and is never given
+// back individually, everything allocated is released at once by reset (the
+// blocks are kept to be reused). An arena is not thread-safe.
+//
+// Objects allocated from an arena must all be gone when it is reset, users of
+// the arena register themselves (addUser / removeUser) so that it is only
+// reset when none of them is left.
+class Arena : NonMovableOrCopyable
+{
+    struct Block
+    {
+        std::unique_ptr<char[]> mData;
+        size_t mSize;
+    };
+
+    size_t const mBlockSize;
+    std::vector<Block> mBlocks;
+    // block being allocated from and offset of the next allocation in it
+    size_t mCurrent;
+    size_t mOffset;
+    size_t mUsers;
+
+    uint64_t mAllocations;
+    uint64_t mBytes;
+
+  public:
+    explicit Arena(size_t blockSize = 64 * 1024);
+
+    void* allocate(size_t bytes, size_t alignment);
+
+    void addUser();
+    void removeUser();
+
+    // releases everything that was allocated if the arena has no user left,
+    // returns false (and does nothing) otherwise
+    bool reset();
+
+    // number of allocations and bytes allocated since the arena was created
+    uint64_t getAllocationCount() const;
+    uint64_t getBytesAllocated() const;
+
+    // memory held by the blocks of the arena
+    size_t getCapacity() const;
+};
+
+// Number of allocations made from the heap by ArenaAllocator objects that are
+// not bound to an arena, across all threads
+uint64_t getArenaAllocatorHeapAllocationCount();
+void countArenaAllocatorHeapAllocation();
+
+// Allocator for standard containers that allocates from an arena, or from the
+// heap when it is not bound to one. Deallocation is a no-op for an arena.
+template <typename T> class ArenaAllocator
+{
+    template <typename U> friend class ArenaAllocator;
+
+    Arena* mArena;
+
+  public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    explicit ArenaAllocator(Arena* arena = nullptr) : mArena(arena)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(ArenaAllocator<U> const& other) : mArena(other.mArena)
+    {
+    }
+
+    T*
+    allocate(size_t n)
+    {
+        if (n > SIZE_MAX / sizeof(T))
+        {
+            throw std::bad_alloc();
+        }
+        if (mArena)
+        {
+            return static_cast<T*>(mArena->allocate(n * sizeof(T), alignof(T)));
+        }
+        countArenaAllocatorHeapAllocation();
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void
+    deallocate(T* p, size_t)
+    {
+        if (!mArena)
+        {
+            ::operator delete(p);
+        }
+    }
+
+    Arena*
+    getArena() const
+    {
+        return mArena;
+    }
+
+    template <typename U>
+    bool
+    operator==(ArenaAllocator<U> const& other) const
+    {
+        return mArena == other.mArena;
+    }
+
+    template <typename U>
+    bool
+    operator!=(ArenaAllocator<U> const& other) const
+    {
+        return mArena != other.mArena;
+    }
+};
+}
@@ -0,0 +1,106 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/Arena.h"
+#include "lib/catch.hpp"
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+using namespace stellar;
+
+TEST_CASE("arena allocate", "[arena]")
+{
+    Arena arena(256);
+
+    SECTION("allocations are aligned and do not overlap")
+    {
+        auto a = static_cast<char*>(arena.allocate(3, 1));
+        auto b = static_cast<char*>(arena.allocate(8, 8));
+        auto c = static_cast<char*>(arena.allocate(16, 16));
+        REQUIRE(reinterpret_cast<uintptr_t>(b) % 8 == 0);
+        REQUIRE(reinterpret_cast<uintptr_t>(c) % 16 == 0);
+        REQUIRE(b >= a + 3);
+        REQUIRE(c >= b + 8);
+        REQUIRE(arena.getAllocationCount() == 3);
+        REQUIRE(arena.getBytesAllocated() == 27);
+        REQUIRE(arena.getCapacity() == 256);
+    }
+
+    SECTION("large allocations get their own block")
+    {
+        arena.allocate(100, 8);
+        arena.allocate(1000, 8);
+        REQUIRE(arena.getCapacity() == 256 + 1000);
+    }
+
+    SECTION("unsupported alignment")
+    {
+        REQUIRE_THROWS_AS(arena.allocate(8, 3), std::invalid_argument);
+        REQUIRE_THROWS_AS(arena.allocate(8, 2 * alignof(std::max_align_t)),
+                          std::invalid_argument);
+    }
+
+    SECTION("reset reuses the blocks")
+    {
+        auto first = arena.allocate(200, 8);
+        arena.allocate(200, 8);
+        REQUIRE(arena.getCapacity() == 512);
+        REQUIRE(arena.reset());
+        REQUIRE(arena.allocate(200, 8) == first);
+        arena.allocate(200, 8);
+        REQUIRE(arena.getCapacity() == 512);
+    }
+
+    SECTION("reset waits for the users")
+    {
+        auto first = arena.allocate(8, 8);
+        arena.addUser();
+        REQUIRE(!arena.reset());
+        REQUIRE(arena.allocate(8, 8) != first);
+        arena.removeUser();
+        REQUIRE(arena.reset());
+        REQUIRE(arena.allocate(8, 8) == first);
+        REQUIRE_THROWS_AS(arena.removeUser(), std::runtime_error);
+    }
+}
+
+TEST_CASE("arena allocator", "[arena]")
+{
+    typedef std::map<int, std::string, std::less<int>,
+                     ArenaAllocator<std::pair<int const, std::string>>>
+        ArenaMap;
+
+    SECTION("from an arena")
+    {
+        Arena arena;
+        auto heapAllocations = getArenaAllocatorHeapAllocationCount();
+        {
+            ArenaMap m(ArenaMap::allocator_type(&arena));
+            for (int i = 0; i < 100; i++)
+            {
+                m[i] = std::to_string(i);
+            }
+            auto copy = m;
+            m.swap(copy);
+            REQUIRE(m.size() == 100);
+            REQUIRE(m[42] == "42");
+        }
+        REQUIRE(arena.getAllocationCount() == 200);
+        REQUIRE(getArenaAllocatorHeapAllocationCount() == heapAllocations);
+    }
+
+    SECTION("from the heap")
+    {
+        auto heapAllocations = getArenaAllocatorHeapAllocationCount();
+        ArenaMap m;
+        for (int i = 0; i < 100; i++)
+        {
+            m[i] = std::to_string(i);
+        }
+        REQUIRE(getArenaAllocatorHeapAllocationCount() ==
+                heapAllocations + 100);
+    }
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace stellar
+{
+
+// Cache evicting entries with the CLOCK algorithm (an approximation of LRU
+// that only sets a bit on a hit instead of reordering a list), split in
+// shards that each have their own lock so that it can be read concurrently.
+// Keys are spread over the shards by their hash, each shard holding up to
+// maxSize / numShards entries.
+//
+// The footprint is an estimate of the memory held by the cache: the size of
+// its slots and index nodes plus the weight of each value (as given by the
+// optional weigh function).
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ClockCache : NonMovableOrCopyable
+{
+  public:
+    struct Counters
+    {
+        uint64_t mHits;
+        uint64_t mMisses;
+        uint64_t mEvictions;
+        size_t mSize;
+        size_t mFootprint;
+    };
+
+    typedef std::function<size_t(V const&)> WeighFn;
+
+  private:
+    typedef std::unordered_map<K, size_t, Hash> Index;
+
+    struct Slot
+    {
+        // points to the key of the element of the index referring to the slot
+        // (elements of an unordered_map do not move on rehash)
+        K const* mKey;
+        V mValue;
+        size_t mWeight;
+        bool mReferenced;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mMutex;
+        Index mIndex;
+        std::vector<Slot> mSlots;
+        size_t mHand{0};
+        size_t mWeight{0};
+        uint64_t mHits{0};
+        uint64_t mMisses{0};
+        uint64_t mEvictions{0};
+    };
+
+    // approximate overhead of an entry, besides the weight of its value
+    static size_t const ENTRY_OVERHEAD =
+        sizeof(Slot) + sizeof(typename Index::value_type) + 3 * sizeof(void*);
+
+    Hash const mHash;
+    WeighFn const mWeigh;
+    size_t const mShardCapacity;
+    std::vector<Shard> mShards;
+
+    Shard&
+    getShard(K const& key)
+    {
+        // the index of a shard uses the low bits of the hash too, mix the high
+        // bits in to pick the shard
+        uint64_t h = mHash(key);
+        h ^= h >> 29;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 32;
+        return mShards[h % mShards.size()];
+    }
+
+    size_t
+    weigh(V const& value) const
+    {
+        return mWeigh ? mWeigh(value) : 0;
+    }
+
+    // returns the index of a slot that can be overwritten, evicting the entry
+    // it holds if needed
+    size_t
+    reclaimSlot(Shard& shard)
+    {
+        if (shard.mSlots.size() < mShardCapacity)
+        {
+            shard.mSlots.emplace_back();
+            return shard.mSlots.size() - 1;
+        }
+
+        // every referenced slot gets a second chance, so this terminates after
+        // at most one full turn
+        while (shard.mSlots[shard.mHand].mReferenced)
+        {
+            shard.mSlots[shard.mHand].mReferenced = false;
+            shard.mHand = (shard.mHand + 1) % shard.mSlots.size();
+        }
+
+        auto res = shard.mHand;
+        shard.mHand = (shard.mHand + 1) % shard.mSlots.size();
+
+        auto& slot = shard.mSlots[res];
+        shard.mWeight -= slot.mWeight;
+        shard.mIndex.erase(*slot.mKey);
+        slot.mValue = V();
+        shard.mEvictions++;
+        return res;
+    }
+
+    static size_t
+    getShardCount(size_t maxSize, size_t numShards)
+    {
+        return std::max<size_t>(std::min(numShards, maxSize), 1);
+    }
+
+  public:
+    explicit ClockCache(size_t maxSize, size_t numShards = 16,
+                        WeighFn weigh = WeighFn())
+        : mHash()
+        , mWeigh(std::move(weigh))
+        , mShardCapacity((maxSize + getShardCount(maxSize, numShards) - 1) /
+                         getShardCount(maxSize, numShards))
+        , mShards(getShardCount(maxSize, numShards))
+    {
+    }
+
+    // Copies the value cached for key to value and returns true if there is
+    // one, returns false otherwise.
+    bool
+    maybeGet(K const& key, V& value)
+    {
+        auto& shard = getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mMutex);
+        auto iter = shard.mIndex.find(key);
+        if (iter == shard.mIndex.end())
+        {
+            shard.mMisses++;
+            return false;
+        }
+        shard.mHits++;
+        auto& slot = shard.mSlots[iter->second];
+        slot.mReferenced = true;
+        value = slot.mValue;
+        return true;
+    }
+
+    void
+    put(K const& key, V const& value)
+    {
+        if (mShardCapacity == 0)
+        {
+            return;
+        }
+
+        auto& shard = getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mMutex);
+        auto weight = weigh(value);
+        auto iter = shard.mIndex.find(key);
+        if (iter != shard.mIndex.end())
+        {
+            auto& slot = shard.mSlots[iter->second];
+            shard.mWeight = shard.mWeight - slot.mWeight + weight;
+            slot.mValue = value;
+            slot.mWeight = weight;
+            slot.mReferenced = true;
+            return;
+        }
+
+        auto index = reclaimSlot(shard);
+        auto res = shard.mIndex.emplace(key, index);
+        auto& slot = shard.mSlots[index];
+        slot.mKey = &res.first->first;
+        slot.mValue = value;
+        slot.mWeight = weight;
+        // new entries must be hit once before they survive a turn of the hand
+        slot.mReferenced = false;
+        shard.mWeight += weight;
+    }
+
+    // clears the entries, counters are kept
+    void
+    clear()
+    {
+        for (auto& shard : mShards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            shard.mIndex.clear();
+            shard.mSlots.clear();
+            shard.mHand = 0;
+            shard.mWeight = 0;
+        }
+    }
+
+    Counters
+    getCounters() const
+    {
+        Counters res{0, 0, 0, 0, 0};
+        for (auto const& shard : mShards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mMutex);
+            res.mHits += shard.mHits;
+            res.mMisses += shard.mMisses;
+            res.mEvictions += shard.mEvictions;
+            res.mSize += shard.mIndex.size();
+            res.mFootprint +=
+                shard.mIndex.size() * ENTRY_OVERHEAD + shard.mWeight;
+        }
+        return res;
+    }
+};
+}
@@ -0,0 +1,100 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/ClockCache.h"
+#include "lib/catch.hpp"
+#include <string>
+
+using namespace stellar;
+
+TEST_CASE("clock cache", "[clockcache]")
+{
+    SECTION("get and put")
+    {
+        ClockCache<int, std::string> cache(100);
+        std::string value;
+        REQUIRE(!cache.maybeGet(1, value));
+        cache.put(1, "one");
+        REQUIRE(cache.maybeGet(1, value));
+        REQUIRE(value == "one");
+        cache.put(1, "uno");
+        REQUIRE(cache.maybeGet(1, value));
+        REQUIRE(value == "uno");
+
+        auto counters = cache.getCounters();
+        REQUIRE(counters.mHits == 2);
+        REQUIRE(counters.mMisses == 1);
+        REQUIRE(counters.mEvictions == 0);
+        REQUIRE(counters.mSize == 1);
+    }
+
+    SECTION("evicts entries that were not hit first")
+    {
+        ClockCache<int, int> cache(4, 1);
+        for (int i = 0; i < 4; i++)
+        {
+            cache.put(i, i);
+        }
+        int value;
+        REQUIRE(cache.maybeGet(0, value));
+        REQUIRE(cache.maybeGet(2, value));
+
+        cache.put(4, 4);
+        REQUIRE(!cache.maybeGet(1, value));
+        cache.put(5, 5);
+        REQUIRE(!cache.maybeGet(3, value));
+        REQUIRE(cache.maybeGet(0, value));
+        REQUIRE(cache.maybeGet(2, value));
+        REQUIRE(cache.maybeGet(4, value));
+        REQUIRE(cache.maybeGet(5, value));
+
+        auto counters = cache.getCounters();
+        REQUIRE(counters.mEvictions == 2);
+        REQUIRE(counters.mSize == 4);
+    }
+
+    SECTION("size is bounded across shards")
+    {
+        ClockCache<int, int> cache(64, 8);
+        for (int i = 0; i < 1000; i++)
+        {
+            cache.put(i, i);
+        }
+        auto counters = cache.getCounters();
+        REQUIRE(counters.mSize <= 64);
+        REQUIRE(counters.mEvictions == 1000 - counters.mSize);
+    }
+
+    SECTION("empty cache")
+    {
+        ClockCache<int, int> cache(0);
+        cache.put(1, 1);
+        int value;
+        REQUIRE(!cache.maybeGet(1, value));
+        REQUIRE(cache.getCounters().mSize == 0);
+    }
+
+    SECTION("footprint and clear")
+    {
+        ClockCache<int, std::string> cache(
+            16, 4, [](std::string const& s) { return s.size(); });
+        cache.put(1, std::string(1000, 'a'));
+        cache.put(2, std::string(500, 'b'));
+        auto footprint = cache.getCounters().mFootprint;
+        REQUIRE(footprint >= 1500);
+
+        cache.put(2, std::string(100, 'b'));
+        REQUIRE(cache.getCounters().mFootprint == footprint - 400);
+
+        std::string value;
+        REQUIRE(cache.maybeGet(1, value));
+        cache.clear();
+        REQUIRE(!cache.maybeGet(1, value));
+        auto counters = cache.getCounters();
+        REQUIRE(counters.mSize == 0);
+        REQUIRE(counters.mFootprint == 0);
+        REQUIRE(counters.mHits == 1);
+        REQUIRE(counters.mMisses == 1);
+    }
+}
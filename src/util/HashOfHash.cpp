@@ -1,4 +1,37 @@
 #include "HashOfHash.h"
+#include <cstring>
+#include <sodium.h>
+
+namespace stellar
+{
+
+namespace
+{
+struct ShortHashKey
+{
+    unsigned char mKey[crypto_shorthash_KEYBYTES];
+
+    ShortHashKey()
+    {
+        randombytes_buf(mKey, sizeof(mKey));
+    }
+};
+}
+
+size_t
+shortHash(void const* data, size_t size) noexcept
+{
+    static_assert(sizeof(size_t) <= crypto_shorthash_BYTES,
+                  "size_t wider than the hash");
+    static ShortHashKey const key;
+    unsigned char out[crypto_shorthash_BYTES];
+    crypto_shorthash(out, static_cast<unsigned char const*>(data), size,
+                     key.mKey);
+    size_t res;
+    std::memcpy(&res, out, sizeof(res));
+    return res;
+}
+}
 
 namespace std
 {
@@ -6,10 +39,6 @@ namespace std
 size_t
 hash<stellar::uint256>::operator()(stellar::uint256 const& x) const noexcept
 {
-    size_t res = x[0];
-    res = (res << 8) | x[1];
-    res = (res << 8) | x[2];
-    res = (res << 8) | x[3];
-    return res;
+    return stellar::shortHash(x.data(), x.size());
 }
 }
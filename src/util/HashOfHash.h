@@ -1,6 +1,15 @@
 #pragma once
+#include <cstddef>
 #include <xdr/Stellar-types.h>
 
+namespace stellar
+{
+// SipHash of the given bytes, keyed with a secret drawn once per process so
+// that peers cannot choose keys (account IDs, hashes, names...) that collide
+// in the unordered containers
+size_t shortHash(void const* data, size_t size) noexcept;
+}
+
 namespace std
 {
 template <> struct hash<stellar::uint256>
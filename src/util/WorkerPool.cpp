@@ -0,0 +1,198 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/WorkerPool.h"
+#include <algorithm>
+
+namespace stellar
+{
+
+WorkerPool::Task::Task(std::function<void()> f)
+    : mFunction(std::move(f)), mStarted(false), mFinished(false)
+{
+}
+
+bool
+WorkerPool::Task::tryRun()
+{
+    if (mStarted.exchange(true))
+    {
+        return false;
+    }
+
+    std::exception_ptr error;
+    try
+    {
+        mFunction();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    // release what the function holds before anyone is told it is done
+    mFunction = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mError = error;
+        mFinished = true;
+    }
+    mDone.notify_all();
+    return true;
+}
+
+WorkerPool::WorkerPool(size_t threads, size_t maxQueued)
+    : mMaxThreads(threads), mMaxQueued(maxQueued), mIdle(0), mStopping(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    shutdown();
+}
+
+size_t
+WorkerPool::getThreadCount() const
+{
+    return mMaxThreads;
+}
+
+bool
+WorkerPool::enqueue(TaskPtr const& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mStopping || mMaxThreads == 0)
+        {
+            return false;
+        }
+        if (mQueue.size() >= mMaxQueued)
+        {
+            // tasks joined before a worker got to them do not count
+            mQueue.erase(std::remove_if(mQueue.begin(), mQueue.end(),
+                                        [](TaskPtr const& t) {
+                                            return t->mStarted.load();
+                                        }),
+                         mQueue.end());
+            if (mQueue.size() >= mMaxQueued)
+            {
+                return false;
+            }
+        }
+        mQueue.push_back(task);
+        // a thread is only added when the idle ones cannot take every
+        // queued task
+        if (mQueue.size() > mIdle && mThreads.size() < mMaxThreads)
+        {
+            mThreads.emplace_back([this]() { runWorker(); });
+        }
+    }
+    mWakeUp.notify_one();
+    return true;
+}
+
+WorkerPool::TaskPtr
+WorkerPool::post(std::function<void()> f)
+{
+    auto task = std::make_shared<Task>(std::move(f));
+    enqueue(task);
+    return task;
+}
+
+void
+WorkerPool::join(Task& task)
+{
+    if (!task.tryRun())
+    {
+        std::unique_lock<std::mutex> lock(task.mMutex);
+        task.mDone.wait(lock, [&task]() { return task.mFinished; });
+    }
+    if (task.mError)
+    {
+        std::rethrow_exception(task.mError);
+    }
+}
+
+bool
+WorkerPool::tryPost(std::function<void()> f)
+{
+    return enqueue(std::make_shared<Task>(std::move(f)));
+}
+
+void
+WorkerPool::run(std::vector<std::function<void()>> tasks)
+{
+    std::vector<TaskPtr> posted;
+    posted.reserve(tasks.size());
+    for (auto& f : tasks)
+    {
+        posted.emplace_back(post(std::move(f)));
+    }
+
+    // the workers take the tasks from the front of the queue, the calling
+    // thread from the back; all are waited for before anything is rethrown
+    // as the tasks may use the caller's data
+    std::exception_ptr error;
+    for (auto it = posted.rbegin(); it != posted.rend(); ++it)
+    {
+        try
+        {
+            join(**it);
+        }
+        catch (...)
+        {
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void
+WorkerPool::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mStopping)
+        {
+            return;
+        }
+        mStopping = true;
+    }
+    mWakeUp.notify_all();
+    for (auto& t : mThreads)
+    {
+        t.join();
+    }
+}
+
+void
+WorkerPool::runWorker()
+{
+    for (;;)
+    {
+        TaskPtr task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            ++mIdle;
+            mWakeUp.wait(lock,
+                         [this]() { return mStopping || !mQueue.empty(); });
+            --mIdle;
+            if (mQueue.empty())
+            {
+                return;
+            }
+            task = std::move(mQueue.front());
+            mQueue.pop_front();
+        }
+        // tasks that were joined in the meantime have already run
+        task->tryRun();
+    }
+}
+}
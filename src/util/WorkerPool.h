@@ -0,0 +1,96 @@
+#pragma once
+
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stellar
+{
+
+// A bounded set of threads for the short tasks the main thread needs done
+// quickly (signature and invariant checks, SCP history writes, maintenance
+// batches). They are kept apart from the io_service behind
+// Application::postOnBackgroundThread, where they would queue behind bucket
+// merges and other long jobs. Threads are only started as tasks are queued,
+// up to the size the pool was created with, so a node that never uses the
+// pool never runs them.
+//
+// A task returned by post is joined by whoever posted it: join runs it on the
+// calling thread if no worker has started it yet, so the caller only ever
+// waits for tasks that are actually running, and nothing hangs when the pool
+// has no thread. The queue is bounded: post leaves the tasks it has no room
+// for to join, and tryPost refuses them.
+class WorkerPool : NonMovableOrCopyable
+{
+  public:
+    class Task : NonMovableOrCopyable
+    {
+        friend class WorkerPool;
+
+        std::function<void()> mFunction;
+        std::atomic<bool> mStarted;
+        std::mutex mMutex;
+        std::condition_variable mDone;
+        bool mFinished;
+        std::exception_ptr mError;
+
+        // runs the task unless it was started already, returns false if it was
+        bool tryRun();
+
+      public:
+        explicit Task(std::function<void()> f);
+    };
+    typedef std::shared_ptr<Task> TaskPtr;
+
+    WorkerPool(size_t threads, size_t maxQueued);
+    ~WorkerPool();
+
+    // the number of threads the pool may start, not those running yet
+    size_t getThreadCount() const;
+
+    // queues f if there is room, the returned task must be joined
+    TaskPtr post(std::function<void()> f);
+
+    // runs task on the calling thread unless a worker started it, in which
+    // case waits for it to finish; rethrows what the task threw
+    static void join(Task& task);
+
+    // queues f to run on a worker without being joined, what it throws is
+    // lost; returns false (f is then not run) if there is no room
+    bool tryPost(std::function<void()> f);
+
+    // runs all tasks, spread over the workers and the calling thread, and
+    // rethrows the first exception once they are all done
+    void run(std::vector<std::function<void()>> tasks);
+
+    // stops the threads once they have run the queued tasks, later tasks
+    // are all left to join
+    void shutdown();
+
+  private:
+    size_t const mMaxThreads;
+    size_t const mMaxQueued;
+    std::vector<std::thread> mThreads;
+    size_t mIdle;
+
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    std::deque<TaskPtr> mQueue;
+    bool mStopping;
+
+    bool enqueue(TaskPtr const& task);
+    void runWorker();
+};
+}
@@ -0,0 +1,58 @@
+// Copyright 2018 Stellar Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/WorkerPool.h"
+#include "lib/catch.hpp"
+#include <atomic>
+#include <stdexcept>
+
+using namespace stellar;
+
+TEST_CASE("worker pool", "[workerpool]")
+{
+    for (size_t threads : {0, 1, 4})
+    {
+        SECTION(std::to_string(threads) + " threads")
+        {
+            WorkerPool pool(threads, 4);
+            REQUIRE(pool.getThreadCount() == threads);
+
+            SECTION("run")
+            {
+                std::atomic<int> count{0};
+                std::vector<std::function<void()>> tasks;
+                for (int i = 0; i < 100; ++i)
+                {
+                    tasks.emplace_back([&count]() { ++count; });
+                }
+                pool.run(std::move(tasks));
+                REQUIRE(count == 100);
+            }
+
+            SECTION("join rethrows")
+            {
+                auto task = pool.post(
+                    []() { throw std::runtime_error("task failed"); });
+                REQUIRE_THROWS_AS(WorkerPool::join(*task),
+                                  std::runtime_error);
+            }
+
+            SECTION("tryPost")
+            {
+                std::atomic<int> count{0};
+                int posted = 0;
+                for (int i = 0; i < 10; ++i)
+                {
+                    posted += pool.tryPost([&count]() { ++count; }) ? 1 : 0;
+                }
+                pool.shutdown();
+                REQUIRE(count == posted);
+                if (threads == 0)
+                {
+                    REQUIRE(posted == 0);
+                }
+            }
+        }
+    }
+}